@@ -449,8 +449,8 @@ function(_halide_runtime_target_name HALIDE_TARGET OUTVAR)
 
     # Halide Target Features we know about. (This need not be exact, but should
     # be close for best compression.)
-    list(APPEND KNOWN_FEATURES armv7s avx avx2 avx512 avx512_cannonlake avx512_knl 
-         avx512_skylake c_plus_plus_name_mangling cl_doubles cuda cuda_capability_30 
+    list(APPEND KNOWN_FEATURES arm_dot_prod armv7s avx avx2 avx512 avx512_cannonlake 
+         avx512_cascadelake avx512_knl avx512_skylake c_plus_plus_name_mangling cl_doubles cuda cuda_capability_30 
          cuda_capability_32 cuda_capability_35 cuda_capability_50 cuda_capability_61 
          debug f16c fma fma4 fuzz_float_stores hvx_128 hvx_64 hvx_shared_object 
          hvx_v62 hvx_v65 hvx_v66 jit large_buffers matlab metal mingw msan no_asserts 
@@ -0,0 +1,253 @@
+#include "AsyncProducers.h"
+#include "FindCalls.h"
+#include "Function.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::set;
+using std::string;
+
+namespace {
+
+// Check if a statement contains the produce node for a func.
+class ContainsProducer : public IRVisitor {
+    const string &func;
+
+    using IRVisitor::visit;
+
+    void visit(const ProducerConsumer *op) override {
+        if (op->is_producer && op->name == func) {
+            result = true;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+public:
+    bool result = false;
+    ContainsProducer(const string &f) : func(f) {}
+};
+
+bool contains_producer(const Stmt &s, const string &func) {
+    ContainsProducer c(func);
+    s.accept(&c);
+    return c.result;
+}
+
+// The producer side of the fork. Keeps the loops, lets and
+// conditions around the produce nodes of the async func, drops all
+// the work that belongs to its consumers, and releases the semaphore
+// after each produce node.
+class GenerateProducerBody : public IRMutator2 {
+    const string &func;
+    Expr sema;
+    const map<string, Function> &dependencies;
+
+    using IRMutator2::visit;
+
+    Stmt visit(const ProducerConsumer *op) override {
+        if (op->name == func) {
+            if (op->is_producer) {
+                Expr release = Call::make(Int(32), "halide_semaphore_release",
+                                          {sema, 1}, Call::Extern);
+                return Block::make(op, Evaluate::make(release));
+            } else {
+                return Evaluate::make(0);
+            }
+        } else if (op->is_producer && !contains_producer(op->body, func)) {
+            user_assert(!dependencies.count(op->name))
+                << "Func " << func << " is scheduled to be computed asynchronously, "
+                << "but it calls Func " << op->name << ", which is computed within "
+                << "the loops between the storage and compute levels of " << func
+                << ". Compute " << op->name << " outside of those loops, "
+                << "or inside " << func << ".\n";
+            return Evaluate::make(0);
+        } else {
+            return mutate(op->body);
+        }
+    }
+
+    Stmt visit(const Realize *op) override {
+        return mutate(op->body);
+    }
+
+    Stmt visit(const Provide *op) override {
+        return Evaluate::make(0);
+    }
+
+    Stmt visit(const Evaluate *op) override {
+        return Evaluate::make(0);
+    }
+
+    Stmt visit(const Prefetch *op) override {
+        return Evaluate::make(0);
+    }
+
+public:
+    GenerateProducerBody(const string &f, Expr s, const map<string, Function> &d) :
+        func(f), sema(s), dependencies(d) {}
+};
+
+// The consumer side of the fork. Everything but the produce nodes of
+// the async func, which are replaced by waits on the semaphore.
+class GenerateConsumerBody : public IRMutator2 {
+    const string &func;
+    Expr sema;
+
+    using IRMutator2::visit;
+
+    Stmt visit(const ProducerConsumer *op) override {
+        if (op->name == func && op->is_producer) {
+            Expr acquire = Call::make(Int(32), "halide_semaphore_acquire",
+                                      {sema, 1}, Call::Extern);
+            return Evaluate::make(acquire);
+        } else {
+            return IRMutator2::visit(op);
+        }
+    }
+
+public:
+    GenerateConsumerBody(const string &f, Expr s) :
+        func(f), sema(s) {}
+};
+
+// Split s into a producer and a consumer of func, run as the two
+// tasks of a parallel loop with a semaphore between them.
+Stmt fork_producer(const string &func, const map<string, Function> &dependencies, const Stmt &s) {
+    string sema_name = func + ".semaphore";
+    Expr sema = Variable::make(Handle(), sema_name);
+    Stmt producer = GenerateProducerBody(func, sema, dependencies).mutate(s);
+    Stmt consumer = GenerateConsumerBody(func, sema).mutate(s);
+
+    // The thread pool always starts the first task of a parallel loop
+    // first, so the producer never waits behind its consumer, even
+    // with one thread. The loop is named like a loop of the func, as
+    // later passes expect.
+    string fork_name = func + ".s0.__fork";
+    Expr fork = Variable::make(Int(32), fork_name);
+    Stmt result = IfThenElse::make(fork == 0, producer, consumer);
+    result = For::make(fork_name, 0, 2, ForType::Parallel, DeviceAPI::None, result);
+
+    // A zero-initialized semaphore on the stack.
+    Expr sema_space = Call::make(Handle(), Call::make_struct,
+                                 {make_zero(UInt(64)), make_zero(UInt(64))},
+                                 Call::Intrinsic);
+    return LetStmt::make(sema_name, sema_space, result);
+}
+
+Stmt fork_in_parallel_loops(const string &func, const map<string, Function> &dependencies, const Stmt &s);
+
+// The iterations of a parallel loop between the storage and compute
+// levels of an async func would all release and acquire the same
+// semaphore, so a consumer could take a release meant for another
+// iteration and read what hasn't been produced yet. So we fork inside
+// such loops instead, giving each iteration a semaphore of its own.
+class ForkInParallelLoops : public IRMutator2 {
+    const string &func;
+    const map<string, Function> &dependencies;
+
+    using IRMutator2::visit;
+
+    Stmt visit(const For *op) override {
+        if (!contains_producer(op->body, func)) {
+            return op;
+        }
+        user_assert(op->device_api == DeviceAPI::None ||
+                    op->device_api == DeviceAPI::Host)
+            << "Func " << func << " is scheduled to be computed asynchronously, "
+            << "but loop " << op->name << " between its storage and compute "
+            << "levels is a GPU loop.\n";
+        if (op->for_type != ForType::Parallel) {
+            return IRMutator2::visit(op);
+        }
+        found = true;
+        Stmt body = fork_in_parallel_loops(func, dependencies, op->body);
+        return For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+    }
+
+public:
+    bool found = false;
+    ForkInParallelLoops(const string &f, const map<string, Function> &d) :
+        func(f), dependencies(d) {}
+};
+
+// Fork the producer of func from its consumers within s, or within
+// the innermost parallel loops of s that compute func.
+Stmt fork_in_parallel_loops(const string &func, const map<string, Function> &dependencies, const Stmt &s) {
+    ForkInParallelLoops forker(func, dependencies);
+    Stmt result = forker.mutate(s);
+    if (forker.found) {
+        return result;
+    }
+    return fork_producer(func, dependencies, s);
+}
+
+class ForkAsyncProducers : public IRMutator2 {
+    const map<string, Function> &env;
+    set<string> forked;
+    bool in_device_loop = false;
+
+    using IRMutator2::visit;
+
+    Stmt visit(const For *op) override {
+        bool old_in_device_loop = in_device_loop;
+        if (op->device_api != DeviceAPI::None &&
+            op->device_api != DeviceAPI::Host) {
+            in_device_loop = true;
+        }
+        Stmt s = IRMutator2::visit(op);
+        in_device_loop = old_in_device_loop;
+        return s;
+    }
+
+    Stmt visit(const Realize *op) override {
+        Stmt body = mutate(op->body);
+
+        auto it = env.find(op->name);
+        if (it == env.end() || !it->second.schedule().async()) {
+            if (body.same_as(op->body)) {
+                return op;
+            }
+            return Realize::make(op->name, op->types, op->bounds, op->condition, body);
+        }
+
+        user_assert(!in_device_loop)
+            << "Func " << op->name << " is scheduled to be computed asynchronously, "
+            << "but it is stored inside a GPU kernel.\n";
+
+        forked.insert(op->name);
+
+        map<string, Function> dependencies = find_transitive_calls(it->second);
+        dependencies.erase(op->name);
+
+        Stmt s = fork_in_parallel_loops(op->name, dependencies, body);
+        return Realize::make(op->name, op->types, op->bounds, op->condition, s);
+    }
+
+public:
+    ForkAsyncProducers(const map<string, Function> &e) : env(e) {}
+
+    void check_all_forked() const {
+        for (const auto &p : env) {
+            user_assert(!p.second.schedule().async() || forked.count(p.first))
+                << "Func " << p.first << " is scheduled to be computed asynchronously, "
+                << "but it is an output of the pipeline, so nothing consumes it.\n";
+        }
+    }
+};
+
+}  // namespace
+
+Stmt fork_async_producers(Stmt s, const map<string, Function> &env) {
+    ForkAsyncProducers fork(env);
+    s = fork.mutate(s);
+    fork.check_all_forked();
+    return s;
+}
+
+}
+}
@@ -0,0 +1,28 @@
+#ifndef HALIDE_ASYNC_PRODUCERS_H
+#define HALIDE_ASYNC_PRODUCERS_H
+
+/** \file
+ * Defines the lowering pass that runs the producers of Funcs scheduled
+ * with async concurrently with their consumers.
+ */
+
+#include <map>
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Split the loop nest within the realization of each Func scheduled
+ * with async into a producer side and a consumer side, which run as
+ * the two tasks of a parallel loop. The producer side releases a
+ * semaphore after each time it produces the Func, and the consumer
+ * side acquires it where it would have produced the Func. Should run
+ * after storage folding, and before storage flattening removes the
+ * Realize nodes. */
+Stmt fork_async_producers(Stmt s, const std::map<std::string, Function> &env);
+
+}
+}
+
+#endif
@@ -1,11 +1,72 @@
 #include "BoundSmallAllocations.h"
 #include "Bounds.h"
+#include "ExprUsesVar.h"
 #include "IRMutator.h"
+#include "IRPrinter.h"
 #include "Simplify.h"
 
 namespace Halide {
 namespace Internal {
 
+// Check that an allocation stored in registers is only accessed at
+// indices that don't vary within the allocation. Loops that have been
+// unrolled or vectorized are already gone, so any remaining loop the
+// index depends on would need a dynamically indexed array.
+class CheckRegisterAccesses : public IRVisitor {
+    using IRVisitor::visit;
+
+    const std::string &name;
+
+    // Loop variables, and lets that depend on them
+    Scope<> varying;
+
+    void visit(const For *op) override {
+        op->min.accept(this);
+        op->extent.accept(this);
+        ScopedBinding<> bind(varying, op->name);
+        op->body.accept(this);
+    }
+
+    template<typename LetOrLetStmt>
+    void visit_let(const LetOrLetStmt *op) {
+        op->value.accept(this);
+        if (expr_uses_vars(op->value, varying)) {
+            ScopedBinding<> bind(varying, op->name);
+            op->body.accept(this);
+        } else {
+            op->body.accept(this);
+        }
+    }
+
+    void visit(const Let *op) override {
+        visit_let(op);
+    }
+
+    void visit(const LetStmt *op) override {
+        visit_let(op);
+    }
+
+    void check_index(const std::string &n, const Expr &index) {
+        user_assert(n != name || !expr_uses_vars(index, varying))
+            << "Func " << name << " is stored in registers, but is accessed "
+            << "at an index that varies within a loop: " << index << ". "
+            << "Try unrolling or vectorizing the loops over it.\n";
+    }
+
+    void visit(const Load *op) override {
+        check_index(op->name, op->index);
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Store *op) override {
+        check_index(op->name, op->index);
+        IRVisitor::visit(op);
+    }
+
+public:
+    CheckRegisterAccesses(const std::string &name) : name(name) {}
+};
+
 // Find a constant upper bound on the size of each thread-local allocation
 class BoundSmallAllocations : public IRMutator2 {
     using IRMutator2::visit;
@@ -52,17 +113,29 @@ class BoundSmallAllocations : public IRMutator2 {
             << "Allocation " << op->name << " has a dynamic size. "
             << "Only fixed-size allocations are supported on the gpu. "
             << "Try storing into shared memory instead.";
+        bool must_be_constant = (op->memory_type == MemoryType::Stack ||
+                                 op->memory_type == MemoryType::Register);
+        user_assert(!must_be_constant || bound.defined())
+            << "Allocation " << op->name << " is scheduled to be stored in "
+            << op->memory_type << " memory, but has a dynamic size. "
+            << "Try using Func::bound to give it a constant size.\n";
         // 128 bytes is a typical minimum allocation size in
         // halide_malloc. For now we are very conservative, and only
         // round sizes up to a constant if they're smaller than that.
         Expr malloc_overhead = 128 / op->type.bytes();
         if (bound.defined() &&
             (in_thread_loop ||
-             can_prove(bound <= malloc_overhead))) {
+             must_be_constant ||
+             (op->memory_type != MemoryType::Heap &&
+              can_prove(bound <= malloc_overhead)))) {
             user_assert(can_prove(bound <= Int(32).max()))
                 << "Allocation " << op->name << " has a size greater than 2^31: " << bound << "\n";
             bound = simplify(cast<int32_t>(bound));
-            return Allocate::make(op->name, op->type, {bound}, op->condition,
+            if (op->memory_type == MemoryType::Register) {
+                CheckRegisterAccesses check(op->name);
+                op->body.accept(&check);
+            }
+            return Allocate::make(op->name, op->type, op->memory_type, {bound}, op->condition,
                                   mutate(op->body), op->new_expr, op->free_function);
         } else {
             return IRMutator2::visit(op);
@@ -16,7 +16,10 @@ namespace Internal {
  * Use bounds analysis to attempt to bound the sizes of small
  * allocations. Inside GPU kernels this is necessary in order to
  * compile. On the CPU this is also useful, because it prevents malloc
- * calls for (provably) tiny allocations. */
+ * calls for (provably) tiny allocations. Allocations stored in
+ * MemoryType::Stack or MemoryType::Register must be bounded, and
+ * allocations stored in registers must not be accessed at indices
+ * that vary within a loop. */
 Stmt bound_small_allocations(const Stmt &s);
 
 }
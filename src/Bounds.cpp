@@ -830,6 +830,31 @@ private:
         interval = result;
     }
 
+    void visit(const VectorReduce *op) {
+        op->value.accept(this);
+        int factor = op->value.type().lanes() / op->type.lanes();
+        switch (op->op) {
+        case VectorReduce::Add:
+            if (interval.has_lower_bound()) {
+                interval.min = interval.min * factor;
+            }
+            if (interval.has_upper_bound()) {
+                interval.max = interval.max * factor;
+            }
+            break;
+        case VectorReduce::Min:
+        case VectorReduce::Max:
+        case VectorReduce::And:
+        case VectorReduce::Or:
+            // The reduction of some lanes is bounded by the bounds of
+            // the lanes.
+            break;
+        case VectorReduce::Mul:
+            interval = Interval::everything();
+            break;
+        }
+    }
+
     void visit(const LetStmt *) {
         internal_error << "Bounds of statement\n";
     }
@@ -1774,44 +1799,47 @@ Interval compute_pure_function_definition_value_bounds(
     return result;
 }
 
-FuncValueBounds compute_function_value_bounds(const vector<string> &order,
-                                              const map<string, Function> &env) {
-    FuncValueBounds fb;
+void compute_function_value_bounds(const Function &f, FuncValueBounds &fb) {
+    const vector<string> f_args = f.args();
+    for (int j = 0; j < f.outputs(); j++) {
+        pair<string, int> key = { f.name(), j };
 
-    for (size_t i = 0; i < order.size(); i++) {
-        Function f = env.find(order[i])->second;
-        const vector<string> f_args = f.args();
-        for (int j = 0; j < f.outputs(); j++) {
-            pair<string, int> key = { f.name(), j };
+        Interval result;
 
-            Interval result;
-
-            if (f.is_pure()) {
-
-                // Make a scope that says the args could be anything.
-                Scope<Interval> arg_scope;
-                for (size_t k = 0; k < f.args().size(); k++) {
-                    arg_scope.push(f_args[k], Interval::everything());
-                }
+        if (f.is_pure()) {
 
-                result = compute_pure_function_definition_value_bounds(f.definition(), arg_scope, fb, j);
-                // These can expand combinatorially as we go down the
-                // pipeline if we don't run CSE on them.
-                if (result.has_lower_bound()) {
-                    result.min = simplify(common_subexpression_elimination(result.min));
-                }
+            // Make a scope that says the args could be anything.
+            Scope<Interval> arg_scope;
+            for (size_t k = 0; k < f.args().size(); k++) {
+                arg_scope.push(f_args[k], Interval::everything());
+            }
 
-                if (result.has_upper_bound()) {
-                    result.max = simplify(common_subexpression_elimination(result.max));
-                }
+            result = compute_pure_function_definition_value_bounds(f.definition(), arg_scope, fb, j);
+            // These can expand combinatorially as we go down the
+            // pipeline if we don't run CSE on them.
+            if (result.has_lower_bound()) {
+                result.min = simplify(common_subexpression_elimination(result.min));
+            }
 
-                fb[key] = result;
+            if (result.has_upper_bound()) {
+                result.max = simplify(common_subexpression_elimination(result.max));
             }
 
-            debug(2) << "Bounds on value " << j
-                     << " for func " << order[i]
-                     << " are: " << result.min << ", " << result.max << "\n";
+            fb[key] = result;
         }
+
+        debug(2) << "Bounds on value " << j
+                 << " for func " << f.name()
+                 << " are: " << result.min << ", " << result.max << "\n";
+    }
+}
+
+FuncValueBounds compute_function_value_bounds(const vector<string> &order,
+                                              const map<string, Function> &env) {
+    FuncValueBounds fb;
+
+    for (size_t i = 0; i < order.size(); i++) {
+        compute_function_value_bounds(env.find(order[i])->second, fb);
     }
 
     return fb;
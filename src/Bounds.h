@@ -157,6 +157,11 @@ Box box_touched(Stmt s, std::string fn,
                 const FuncValueBounds &func_bounds = FuncValueBounds());
 // @}
 
+/** Compute the maximum and minimum possible value of each output of
+ * a function, given those of the functions it calls, and add them to
+ * fb. */
+void compute_function_value_bounds(const Function &f, FuncValueBounds &fb);
+
 /** Compute the maximum and minimum possible value for each function
  * in an environment. */
 FuncValueBounds compute_function_value_bounds(const std::vector<std::string> &order,
@@ -955,6 +955,37 @@ void CodeGen_ARM::visit(const Call *op) {
     CodeGen_Posix::visit(op);
 }
 
+void CodeGen_ARM::visit(const VectorReduce *op) {
+    const Mul *mul = op->value.as<Mul>();
+    const int input_lanes = op->value.type().lanes();
+    const int factor = input_lanes / op->type.lanes();
+
+    // udot and sdot sum groups of four products of bytes.
+    if (target.bits == 64 &&
+        target.has_feature(Target::ARMDotProd) &&
+        op->op == VectorReduce::Add &&
+        op->type.bits() == 32 &&
+        !op->type.is_float() &&
+        mul && factor % 4 == 0 && input_lanes >= 8) {
+        Type t = op->type.with_lanes(input_lanes / 4);
+        Expr a = lossless_cast(UInt(8, input_lanes), mul->a);
+        Expr b = lossless_cast(UInt(8, input_lanes), mul->b);
+        const char *intrin = "llvm.aarch64.neon.udot.v4i32.v16i8";
+        if (!a.defined() || !b.defined()) {
+            a = lossless_cast(Int(8, input_lanes), mul->a);
+            b = lossless_cast(Int(8, input_lanes), mul->b);
+            intrin = "llvm.aarch64.neon.sdot.v4i32.v16i8";
+        }
+        if (a.defined() && b.defined()) {
+            Value *partial = call_intrin(t, 4, intrin, {make_zero(t), a, b});
+            value = codegen_vector_reduce(op, partial);
+            return;
+        }
+    }
+
+    CodeGen_Posix::visit(op);
+}
+
 string CodeGen_ARM::mcpu() const {
     if (target.bits == 32) {
         if (target.has_feature(Target::ARMv7s)) {
@@ -981,11 +1012,14 @@ string CodeGen_ARM::mattrs() const {
             return "-neon";
         }
     } else {
+        std::string features;
         if (target.os == Target::IOS || target.os == Target::OSX) {
-            return "+reserve-x18";
-        } else {
-            return "";
+            features = "+reserve-x18";
+        }
+        if (target.has_feature(Target::ARMDotProd)) {
+            features += features.empty() ? "+dotprod" : ",+dotprod";
         }
+        return features;
     }
 }
 
@@ -187,6 +187,16 @@ public:
         IRGraphVisitor::visit(op);
     }
 
+    // Vector reductions are emitted as shuffles and arithmetic on
+    // narrower vectors. Make sure those types exist too. The
+    // expansions are kept alive so that the addresses of their nodes
+    // in the visited set aren't reused.
+    std::vector<Expr> expanded_vector_reduces;
+    void visit(const VectorReduce *op) {
+        expanded_vector_reduces.push_back(expand_vector_reduce(op));
+        include(expanded_vector_reduces.back());
+    }
+
     void visit(const For *op) {
         for_types_used.insert(op->for_type);
         IRGraphVisitor::visit(op);
@@ -2448,7 +2458,10 @@ void CodeGen_C::visit(const Allocate *op) {
                            << op->name << " is constant but exceeds 2^31 - 1.\n";
             } else {
                 size_id = print_expr(Expr(static_cast<int32_t>(constant_size)));
-                if (can_allocation_fit_on_stack(stack_bytes)) {
+                if (op->memory_type == MemoryType::Stack ||
+                    op->memory_type == MemoryType::Register ||
+                    (op->memory_type == MemoryType::Auto &&
+                     can_allocation_fit_on_stack(stack_bytes))) {
                     on_stack = true;
                 }
             }
@@ -2552,6 +2565,16 @@ void CodeGen_C::visit(const Prefetch *op) {
     internal_error << "Cannot emit prefetch statements to C\n";
 }
 
+void CodeGen_C::visit(const Atomic *op) {
+    // Parallel loops are OpenMP loops, so a critical section makes
+    // the stores in the body atomic with respect to each other.
+    do_indent();
+    stream << "#pragma omp critical\n";
+    open_scope();
+    op->body.accept(this);
+    close_scope("atomic " + print_name(op->producer_name));
+}
+
 void CodeGen_C::visit(const IfThenElse *op) {
     string cond_id = print_expr(op->condition);
 
@@ -2615,6 +2638,10 @@ void CodeGen_C::visit(const Shuffle *op) {
     print_assignment(op->type, rhs.str());
 }
 
+void CodeGen_C::visit(const VectorReduce *op) {
+    print_expr(expand_vector_reduce(op));
+}
+
 void CodeGen_C::test() {
     LoweredArgument buffer_arg("buf", Argument::OutputBuffer, Int(32), 3);
     LoweredArgument float_arg("alpha", Argument::InputScalar, Float(32), 0);
@@ -2628,9 +2655,9 @@ void CodeGen_C::test() {
     Stmt s = Store::make("buf", e, x, Parameter(), const_true());
     s = LetStmt::make("x", beta+1, s);
     s = Block::make(s, Free::make("tmp.stack"));
-    s = Allocate::make("tmp.stack", Int(32), {127}, const_true(), s);
+    s = Allocate::make("tmp.stack", Int(32), MemoryType::Stack, {127}, const_true(), s);
     s = Block::make(s, Free::make("tmp.heap"));
-    s = Allocate::make("tmp.heap", Int(32), {43, beta}, const_true(), s);
+    s = Allocate::make("tmp.heap", Int(32), MemoryType::Heap, {43, beta}, const_true(), s);
     Expr buf = Variable::make(Handle(), "buf.buffer");
     s = LetStmt::make("buf", Call::make(Handle(), Call::buffer_get_host, {buf}, Call::Extern), s);
 
@@ -200,7 +200,9 @@ protected:
     void visit(const IfThenElse *);
     void visit(const Evaluate *);
     void visit(const Shuffle *);
+    void visit(const VectorReduce *);
     void visit(const Prefetch *);
+    void visit(const Atomic *);
 
     void visit_binop(Type t, Expr a, Expr b, const char *op);
 
@@ -1,7 +1,10 @@
+#include <mutex>
+
 #include "CodeGen_Internal.h"
 #include "IROperator.h"
 #include "IRMutator.h"
 #include "CSE.h"
+#include "CompilerProfiling.h"
 #include "Debug.h"
 
 namespace Halide {
@@ -168,6 +171,7 @@ bool function_takes_user_context(const std::string &name) {
         "halide_trace",
         "halide_trace_helper",
         "halide_memoization_cache_lookup",
+        "halide_memoization_cache_lookup_partitioned",
         "halide_memoization_cache_store",
         "halide_memoization_cache_release",
         "halide_cuda_run",
@@ -433,6 +437,19 @@ void clone_target_options(const llvm::Module &from, llvm::Module &to) {
     }
 }
 
+int64_t llvm_module_size(const llvm::Module &module) {
+    if (!CompileProfiler::enabled()) {
+        return -1;
+    }
+    int64_t size = 0;
+    for (const llvm::Function &f : module) {
+        for (const llvm::BasicBlock &b : f) {
+            size += b.size();
+        }
+    }
+    return size;
+}
+
 std::unique_ptr<llvm::TargetMachine> make_target_machine(const llvm::Module &module) {
     std::string error_string;
 
@@ -464,6 +481,91 @@ std::unique_ptr<llvm::TargetMachine> make_target_machine(const llvm::Module &mod
                                                 llvm::CodeGenOpt::Aggressive));
 }
 
+namespace {
+
+// TargetMachines that aren't in use, keyed on everything
+// make_target_machine configures differently per module.
+class TargetMachinePool {
+    std::mutex mutex;
+    map<string, vector<std::unique_ptr<llvm::TargetMachine>>> idle;
+
+    // Beyond this many idle TargetMachines for a given key, returned
+    // ones are just deleted.
+    static const size_t max_idle_per_key = 8;
+
+public:
+    static string key(const string &triple, const string &mcpu,
+                      const string &mattrs, llvm::FloatABI::ABIType float_abi) {
+        return triple + "|" + mcpu + "|" + mattrs + "|" + std::to_string((int)float_abi);
+    }
+
+    std::unique_ptr<llvm::TargetMachine> take(const string &k) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = idle.find(k);
+        if (it == idle.end() || it->second.empty()) {
+            return nullptr;
+        }
+        std::unique_ptr<llvm::TargetMachine> tm = std::move(it->second.back());
+        it->second.pop_back();
+        return tm;
+    }
+
+    void put(const string &k, std::unique_ptr<llvm::TargetMachine> tm) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto &tms = idle[k];
+        if (tms.size() < max_idle_per_key) {
+            tms.push_back(std::move(tm));
+        }
+    }
+
+    static TargetMachinePool &get() {
+        // Intentionally leaked, so that TargetMachines aren't
+        // destroyed after LLVM's own statics at exit.
+        static TargetMachinePool *pool = new TargetMachinePool;
+        return *pool;
+    }
+};
+
+// HL_TARGET_MACHINE_POOL=0 makes every compilation use a fresh
+// TargetMachine, to rule the pool out when chasing a codegen bug.
+bool target_machine_pool_enabled() {
+    return get_env_variable("HL_TARGET_MACHINE_POOL") != "0";
+}
+
+}  // namespace
+
+void ReleaseTargetMachine::operator()(llvm::TargetMachine *tm) const {
+    std::unique_ptr<llvm::TargetMachine> owned(tm);
+    if (owned && target_machine_pool_enabled()) {
+        string k = TargetMachinePool::key(owned->getTargetTriple().str(),
+                                          owned->getTargetCPU().str(),
+                                          owned->getTargetFeatureString().str(),
+                                          owned->Options.FloatABIType);
+        TargetMachinePool::get().put(k, std::move(owned));
+    }
+}
+
+PooledTargetMachine acquire_target_machine(const llvm::Module &module) {
+    llvm::TargetOptions options;
+    std::string mcpu = "";
+    std::string mattrs = "";
+    get_target_options(module, options, mcpu, mattrs);
+    string k = TargetMachinePool::key(module.getTargetTriple(), mcpu, mattrs, options.FloatABIType);
+
+    std::unique_ptr<llvm::TargetMachine> tm;
+    if (target_machine_pool_enabled()) {
+        tm = TargetMachinePool::get().take(k);
+    }
+    if (tm) {
+        debug(2) << "Reusing pooled TargetMachine for " << module.getTargetTriple() << "\n";
+        // Undo anything a previous user changed.
+        tm->Options = options;
+    } else {
+        tm = make_target_machine(module);
+    }
+    return PooledTargetMachine(tm.release());
+}
+
 void set_function_attributes_for_target(llvm::Function *fn, Target t) {
     // Turn off approximate reciprocals for division. It's too
     // inaccurate even for us.
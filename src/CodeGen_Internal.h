@@ -75,6 +75,26 @@ void clone_target_options(const llvm::Module &from, llvm::Module &to);
 /** Given an llvm::Module, get or create an llvm:TargetMachine */
 std::unique_ptr<llvm::TargetMachine> make_target_machine(const llvm::Module &module);
 
+/** Deleter for TargetMachines from acquire_target_machine, which
+ * returns them to the pool they came from. */
+struct ReleaseTargetMachine {
+    void operator()(llvm::TargetMachine *tm) const;
+};
+
+typedef std::unique_ptr<llvm::TargetMachine, ReleaseTargetMachine> PooledTargetMachine;
+
+/** Given an llvm::Module, get an llvm::TargetMachine for it from a
+ * process-wide pool of idle ones, or make one if there are none. The
+ * caller has exclusive use of it until the returned pointer is
+ * destroyed, so this is safe to call from multiple threads. Making a
+ * TargetMachine is a noticeable part of the cost of compiling a small
+ * pipeline. */
+PooledTargetMachine acquire_target_machine(const llvm::Module &module);
+
+/** The number of instructions in an llvm::Module, for the compile
+ * profiler, or -1 if compile profiling is off. */
+int64_t llvm_module_size(const llvm::Module &module);
+
 /** Set the appropriate llvm Function attributes given a Target. */
 void set_function_attributes_for_target(llvm::Function *, Target);
 
@@ -12,12 +12,16 @@
 #include "Simplify.h"
 #include "JITModule.h"
 #include "CodeGen_Internal.h"
+#include "CompilerProfiling.h"
 #include "Lerp.h"
 #include "Util.h"
 #include "LLVM_Runtime_Linker.h"
 #include "MatlabWrapper.h"
 #include "IntegerDivisionTable.h"
 #include "CSE.h"
+#include "ExprUsesVar.h"
+#include "IRMutator.h"
+#include "IRVisitor.h"
 
 #include "CodeGen_X86.h"
 #include "CodeGen_GPU_Host.h"
@@ -250,7 +254,8 @@ CodeGen_LLVM::CodeGen_LLVM(Target t) :
 
     min_f64(Float(64).min()),
     max_f64(Float(64).max()),
-    destructor_block(nullptr) {
+    destructor_block(nullptr),
+    emit_atomic_stores(false) {
     initialize_llvm();
 }
 
@@ -483,6 +488,8 @@ MangledNames get_mangled_names(const LoweredFunc &f, const Target &target) {
 std::unique_ptr<llvm::Module> CodeGen_LLVM::compile(const Module &input) {
     input_module = &input;
 
+    CompileProfiler profiler(input.name());
+    profiler.begin("LLVM runtime linking");
     init_module();
 
     debug(1) << "Target triple of initial module: " << module->getTargetTriple() << "\n";
@@ -522,6 +529,7 @@ std::unique_ptr<llvm::Module> CodeGen_LLVM::compile(const Module &input) {
     add_external_code(input);
 
     // Generate the code for this module.
+    profiler.begin("LLVM IR generation", llvm_module_size(*module));
     debug(1) << "Generating llvm bitcode...\n";
     for (const auto &b : input.buffers()) {
         compile_buffer(b);
@@ -551,7 +559,9 @@ std::unique_ptr<llvm::Module> CodeGen_LLVM::compile(const Module &input) {
     debug(2) << "Done generating llvm bitcode\n";
 
     // Optimize
+    profiler.begin("LLVM optimization", llvm_module_size(*module));
     CodeGen_LLVM::optimize_module();
+    profiler.end(llvm_module_size(*module));
 
     input_module = nullptr;
 
@@ -1023,7 +1033,7 @@ void CodeGen_LLVM::optimize_module() {
     MyFunctionPassManager function_pass_manager(module.get());
     MyModulePassManager module_pass_manager;
 
-    std::unique_ptr<TargetMachine> TM = make_target_machine(*module);
+    PooledTargetMachine TM = acquire_target_machine(*module);
     module_pass_manager.add(createTargetTransformInfoWrapperPass(TM ? TM->getTargetIRAnalysis() : TargetIRAnalysis()));
     function_pass_manager.add(createTargetTransformInfoWrapperPass(TM ? TM->getTargetIRAnalysis() : TargetIRAnalysis()));
 
@@ -2820,6 +2830,162 @@ void CodeGen_LLVM::visit(const Call *op) {
     }
 }
 
+namespace {
+
+// Replace the loads of the location a store writes to with some other
+// expression.
+class ReplaceStoredLocation : public IRMutator2 {
+    const Store *store;
+    Expr replacement;
+
+    using IRMutator2::visit;
+
+    Expr visit(const Load *op) override {
+        if (op->name == store->name && equal(op->index, store->index)) {
+            found = true;
+            return replacement;
+        }
+        return IRMutator2::visit(op);
+    }
+
+public:
+    bool found = false;
+    ReplaceStoredLocation(const Store *s, Expr r) : store(s), replacement(r) {}
+};
+
+// Checks whether an Expr loads from a given buffer.
+class LoadsFromBuffer : public IRVisitor {
+    const string &name;
+
+    using IRVisitor::visit;
+
+    void visit(const Load *op) override {
+        if (op->name == name) {
+            result = true;
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    bool result = false;
+    LoadsFromBuffer(const string &n) : name(n) {}
+};
+
+bool loads_from_buffer(const Expr &e, const string &name) {
+    LoadsFromBuffer loads(name);
+    e.accept(&loads);
+    return loads.result;
+}
+
+}  // namespace
+
+void CodeGen_LLVM::visit(const Atomic *op) {
+    bool old_emit_atomic_stores = emit_atomic_stores;
+    emit_atomic_stores = true;
+    codegen(op->body);
+    emit_atomic_stores = old_emit_atomic_stores;
+}
+
+void CodeGen_LLVM::codegen_atomic_store(const Store *op) {
+    Halide::Type t = op->value.type();
+    internal_assert(t.is_scalar()) << "Vector atomic store should have been scalarized\n";
+    user_assert(!t.is_bool()) << "Can't make stores of booleans to " << op->name << " atomic.\n";
+
+    if (!is_one(op->predicate)) {
+        Stmt store = Store::make(op->name, op->value, op->index, op->param, const_true());
+        codegen(IfThenElse::make(op->predicate, store));
+        return;
+    }
+
+    string old_name = unique_name('t');
+    Expr old_value = Variable::make(t, old_name);
+    ReplaceStoredLocation replace(op, old_value);
+    Expr new_value = replace.mutate(op->value);
+    Value *ptr = codegen_buffer_pointer(op->name, t, op->index);
+
+    // Loads of the stored buffer that weren't recognized as the stored
+    // location (e.g. at an index that is equal, but not
+    // syntactically) might read it anyway, so the value must then be
+    // recomputed until it is stored over the value it was computed
+    // from.
+    bool loads_buffer = loads_from_buffer(new_value, op->name);
+
+    if (!replace.found && !loads_buffer) {
+        // The store doesn't depend on the value it overwrites, so an
+        // ordinary store is enough.
+        StoreInst *store = builder->CreateAlignedStore(codegen(op->value), ptr, t.bytes());
+        add_tbaa_metadata(store, op->name, op->index);
+        return;
+    }
+
+    // Use a native atomic instruction if the new value is the old
+    // value combined with something that doesn't depend on it.
+    if ((t.is_int() || t.is_uint()) && !loads_buffer) {
+        AtomicRMWInst::BinOp rmw_op = AtomicRMWInst::BAD_BINOP;
+        Expr operand;
+        if (const Add *add = new_value.as<Add>()) {
+            rmw_op = AtomicRMWInst::Add;
+            if (equal(add->a, old_value)) {
+                operand = add->b;
+            } else if (equal(add->b, old_value)) {
+                operand = add->a;
+            }
+        } else if (const Sub *sub = new_value.as<Sub>()) {
+            rmw_op = AtomicRMWInst::Sub;
+            if (equal(sub->a, old_value)) {
+                operand = sub->b;
+            }
+        } else if (const Min *min = new_value.as<Min>()) {
+            rmw_op = t.is_int() ? AtomicRMWInst::Min : AtomicRMWInst::UMin;
+            if (equal(min->a, old_value)) {
+                operand = min->b;
+            } else if (equal(min->b, old_value)) {
+                operand = min->a;
+            }
+        } else if (const Max *max = new_value.as<Max>()) {
+            rmw_op = t.is_int() ? AtomicRMWInst::Max : AtomicRMWInst::UMax;
+            if (equal(max->a, old_value)) {
+                operand = max->b;
+            } else if (equal(max->b, old_value)) {
+                operand = max->a;
+            }
+        }
+        if (operand.defined() && !expr_uses_var(operand, old_name)) {
+            builder->CreateAtomicRMW(rmw_op, ptr, codegen(operand), AtomicOrdering::Monotonic);
+            return;
+        }
+    }
+
+    // Otherwise recompute the new value from the current one until a
+    // compare-and-swap of it succeeds. Any other loads of the buffer
+    // are redone each time around. Compare-and-swap works on
+    // integers, so floats are bitcast.
+    llvm::Type *int_type = llvm::Type::getIntNTy(*context, t.bits());
+    Value *int_ptr = builder->CreatePointerCast(ptr, int_type->getPointerTo());
+    Value *orig = builder->CreateAlignedLoad(int_ptr, t.bytes());
+
+    BasicBlock *pre_bb = builder->GetInsertBlock();
+    BasicBlock *loop_bb = BasicBlock::Create(*context, "atomic_cas_loop", function);
+    BasicBlock *after_bb = BasicBlock::Create(*context, "atomic_cas_after", function);
+    builder->CreateBr(loop_bb);
+    builder->SetInsertPoint(loop_bb);
+
+    PHINode *phi = builder->CreatePHI(int_type, 2);
+    phi->addIncoming(orig, pre_bb);
+    sym_push(old_name, builder->CreateBitCast(phi, llvm_type_of(t)));
+    Value *val = builder->CreateBitCast(codegen(new_value), int_type);
+    sym_pop(old_name);
+
+    Value *cmpxchg = builder->CreateAtomicCmpXchg(int_ptr, phi, val,
+                                                  AtomicOrdering::SequentiallyConsistent,
+                                                  AtomicOrdering::SequentiallyConsistent);
+    Value *loaded = builder->CreateExtractValue(cmpxchg, {0});
+    Value *success = builder->CreateExtractValue(cmpxchg, {1});
+    phi->addIncoming(loaded, builder->GetInsertBlock());
+    builder->CreateCondBr(success, after_bb, loop_bb);
+    builder->SetInsertPoint(after_bb);
+}
+
 void CodeGen_LLVM::visit(const Prefetch *op) {
     internal_error << "Prefetch encountered during codegen\n";
 }
@@ -3106,6 +3272,11 @@ void CodeGen_LLVM::visit(const Store *op) {
         return;
     }
 
+    if (emit_atomic_stores) {
+        codegen_atomic_store(op);
+        return;
+    }
+
     // Predicated store
     if (!is_one(op->predicate)) {
         codegen_predicated_vector_store(op);
@@ -3273,6 +3444,23 @@ void CodeGen_LLVM::visit(const Shuffle *op) {
     }
 }
 
+void CodeGen_LLVM::visit(const VectorReduce *op) {
+    value = codegen(expand_vector_reduce(op));
+}
+
+Value *CodeGen_LLVM::codegen_vector_reduce(const VectorReduce *op, Value *partial) {
+    int partial_lanes = partial->getType()->getVectorNumElements();
+    if (partial_lanes == op->type.lanes()) {
+        return partial;
+    }
+    string name = unique_name('t');
+    Type t = op->type.with_lanes(partial_lanes);
+    sym_push(name, partial);
+    Value *result = codegen(VectorReduce::make(op->op, Variable::make(t, name), op->type.lanes()));
+    sym_pop(name);
+    return result;
+}
+
 Value *CodeGen_LLVM::create_alloca_at_entry(llvm::Type *t, int n, bool zero_initialize, const string &name) {
     IRBuilderBase::InsertPoint here = builder->saveIP();
     BasicBlock *entry = &builder->GetInsertBlock()->getParent()->getEntryBlock();
@@ -344,6 +344,8 @@ protected:
     virtual void visit(const Evaluate *);
     virtual void visit(const Shuffle *);
     virtual void visit(const Prefetch *);
+    virtual void visit(const Atomic *);
+    virtual void visit(const VectorReduce *);
     // @}
 
     /** Generate code for an allocate node. It has no default
@@ -405,6 +407,12 @@ protected:
                              const std::string &name, std::vector<llvm::Value *>);
     // @}
 
+    /** Finish a vector reduction that a backend has partially done
+     * with some horizontally-reducing instruction. 'partial' is the
+     * reduction of the input to some number of lanes between the
+     * input and output lanes of op. */
+    llvm::Value *codegen_vector_reduce(const VectorReduce *op, llvm::Value *partial);
+
     /** Take a slice of lanes out of an llvm vector. Pads with undefs
      * if you ask for more lanes than the vector has. */
     virtual llvm::Value *slice_vector(llvm::Value *vec, int start, int extent);
@@ -457,6 +465,10 @@ private:
      * to this block. */
     llvm::BasicBlock *destructor_block;
 
+    /** Are we inside an Atomic node? Stores are then emitted as
+     * atomic read-modify-writes. */
+    bool emit_atomic_stores;
+
     /** Embed an instance of halide_filter_metadata_t in the code, using
      * the given name (by convention, this should be ${FUNCTIONNAME}_metadata)
      * as extern "C" linkage. Note that the return value is a function-returning-
@@ -475,6 +487,8 @@ private:
 
     virtual void codegen_predicated_vector_load(const Load *op);
     virtual void codegen_predicated_vector_store(const Store *op);
+
+    void codegen_atomic_store(const Store *op);
 };
 
 }
@@ -422,6 +422,11 @@ void CodeGen_Metal_Dev::CodeGen_Metal_C::visit(const Free *op) {
     }
 }
 
+void CodeGen_Metal_Dev::CodeGen_Metal_C::visit(const Atomic *op) {
+    user_error << "Atomic stores to " << op->producer_name
+               << " are not supported inside Metal kernels.\n";
+}
+
 void CodeGen_Metal_Dev::CodeGen_Metal_C::visit(const Cast *op) {
     print_assignment(op->type, print_type(op->type) + "(" + print_expr(op->value) + ")");
 }
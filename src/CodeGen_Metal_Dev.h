@@ -78,6 +78,7 @@ protected:
         void visit(const Select *op);
         void visit(const Allocate *op);
         void visit(const Free *op);
+        void visit(const Atomic *op);
         void visit(const Cast *op);
     };
 
@@ -444,6 +444,11 @@ void CodeGen_OpenCL_Dev::CodeGen_OpenCL_C::visit(const AssertStmt *op) {
     user_warning << "Ignoring assertion inside OpenCL kernel: " << op->condition << "\n";
 }
 
+void CodeGen_OpenCL_Dev::CodeGen_OpenCL_C::visit(const Atomic *op) {
+    user_error << "Atomic stores to " << op->producer_name
+               << " are not supported inside OpenCL kernels.\n";
+}
+
 void CodeGen_OpenCL_Dev::CodeGen_OpenCL_C::visit(const Shuffle *op) {
     if (op->is_interleave()) {
         int op_lanes = op->type.lanes();
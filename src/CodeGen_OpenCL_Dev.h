@@ -75,6 +75,7 @@ protected:
         void visit(const Allocate *op);
         void visit(const Free *op);
         void visit(const AssertStmt *op);
+        void visit(const Atomic *op);
         void visit(const Shuffle *op);
         void visit(const Min *op);
         void visit(const Max *op);
@@ -287,6 +287,10 @@ void CodeGen_GLSLBase::visit(const GE *op) {
     }
 }
 
+void CodeGen_GLSLBase::visit(const Atomic *op) {
+    user_error << "GLSL: atomic stores to " << op->producer_name << " are not supported.\n";
+}
+
 void CodeGen_GLSLBase::visit(const Shuffle *op) {
     // The halide Shuffle represents the llvm intrinisc
     // shufflevector, however, for GLSL its use is limited to swizzling
@@ -76,6 +76,8 @@ protected:
 
     void visit(const Shuffle *);
 
+    void visit(const Atomic *);
+
 private:
     std::map<std::string, std::string> builtin;
 };
@@ -79,9 +79,15 @@ int CodeGen_Posix::allocation_padding(Type type) const {
     return type.bytes();
 }
 
-CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &name, Type type,
+CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &name, Type type, MemoryType memory_type,
                                                            const std::vector<Expr> &extents, Expr condition,
                                                            Expr new_expr, std::string free_function) {
+    user_assert(!new_expr.defined() ||
+                (memory_type != MemoryType::Stack &&
+                 memory_type != MemoryType::Register))
+        << "Allocation " << name << " is scheduled to be stored in "
+        << memory_type << " memory, but its memory is provided by a custom allocator.\n";
+
     Value *llvm_size = nullptr;
     int64_t stack_bytes = 0;
     int32_t constant_bytes = Allocate::constant_allocation_size(extents, name);
@@ -92,11 +98,17 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
         if (stack_bytes > target.maximum_buffer_size()) {
             const string str_max_size = target.has_large_buffers() ? "2^63 - 1" : "2^31 - 1";
             user_error << "Total size for allocation " << name << " is constant but exceeds " << str_max_size << ".";
-        } else if (!can_allocation_fit_on_stack(stack_bytes)) {
+        } else if (memory_type == MemoryType::Heap ||
+                   (memory_type == MemoryType::Auto &&
+                    !can_allocation_fit_on_stack(stack_bytes))) {
             stack_bytes = 0;
             llvm_size = codegen(Expr(constant_bytes));
         }
     } else {
+        user_assert(memory_type != MemoryType::Stack &&
+                    memory_type != MemoryType::Register)
+            << "Allocation " << name << " is scheduled to be stored in "
+            << memory_type << " memory, but does not have a constant size.\n";
         llvm_size = codegen_allocation_size(name, type, extents);
     }
 
@@ -119,6 +131,7 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
     allocation.constant_bytes = constant_bytes;
     allocation.stack_bytes = new_expr.defined() ? 0 : stack_bytes;
     allocation.type = type;
+    allocation.memory_type = memory_type;
     allocation.ptr = nullptr;
     allocation.destructor = nullptr;
     allocation.destructor_function = nullptr;
@@ -133,17 +146,21 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
         debug(4) << "cur_stack_alloc_total += " << allocation.stack_bytes << " -> " << cur_stack_alloc_total << " for " << name << "\n";
     } else if (!new_expr.defined() && stack_bytes != 0) {
 
-        // Try to find a free stack allocation we can use.
+        // Try to find a free stack allocation we can use. Allocations
+        // meant to live in registers get their own alloca, because
+        // sharing it would prevent llvm from promoting it.
         vector<Allocation>::iterator free = free_stack_allocs.end();
-        for (free = free_stack_allocs.begin(); free != free_stack_allocs.end(); ++free) {
-            AllocaInst *alloca_inst = dyn_cast<AllocaInst>(free->ptr);
-            llvm::Function *allocated_in = alloca_inst ? alloca_inst->getParent()->getParent() : nullptr;
-            llvm::Function *current_func = builder->GetInsertBlock()->getParent();
-
-            if (allocated_in == current_func &&
-                free->type == type &&
-                free->stack_bytes >= stack_bytes) {
-                break;
+        if (memory_type != MemoryType::Register) {
+            for (free = free_stack_allocs.begin(); free != free_stack_allocs.end(); ++free) {
+                AllocaInst *alloca_inst = dyn_cast<AllocaInst>(free->ptr);
+                llvm::Function *allocated_in = alloca_inst ? alloca_inst->getParent()->getParent() : nullptr;
+                llvm::Function *current_func = builder->GetInsertBlock()->getParent();
+
+                if (allocated_in == current_func &&
+                    free->type == type &&
+                    free->stack_bytes >= stack_bytes) {
+                    break;
+                }
             }
         }
         if (free != free_stack_allocs.end()) {
@@ -241,8 +258,11 @@ void CodeGen_Posix::free_allocation(const std::string &name) {
     Allocation alloc = allocations.get(name);
 
     if (alloc.stack_bytes) {
-        // Remember this allocation so it can be re-used by a later allocation.
-        free_stack_allocs.push_back(alloc);
+        // Remember this allocation so it can be re-used by a later
+        // allocation, unless it is meant to live in registers.
+        if (alloc.memory_type != MemoryType::Register) {
+            free_stack_allocs.push_back(alloc);
+        }
         cur_stack_alloc_total -= alloc.stack_bytes;
         debug(4) << "cur_stack_alloc_total -= " << alloc.stack_bytes << " -> " << cur_stack_alloc_total << " for " << name << "\n";
     } else {
@@ -268,7 +288,7 @@ void CodeGen_Posix::visit(const Allocate *alloc) {
                    << alloc->name << "\n";
     }
 
-    Allocation allocation = create_allocation(alloc->name, alloc->type,
+    Allocation allocation = create_allocation(alloc->name, alloc->type, alloc->memory_type,
                                               alloc->extents, alloc->condition,
                                               alloc->new_expr, alloc->free_function);
     sym_push(alloc->name, allocation.ptr);
@@ -24,7 +24,8 @@ protected:
 
     /** Posix implementation of Allocate. Small constant-sized allocations go
      * on the stack. The rest go on the heap by calling "halide_malloc"
-     * and "halide_free" in the standard library. */
+     * and "halide_free" in the standard library. The memory type of the
+     * allocation can override this choice. */
     // @{
     void visit(const Allocate *);
     void visit(const Free *);
@@ -58,6 +59,9 @@ protected:
          * heap allocation. */
         int stack_bytes;
 
+        /** The type of memory requested for this allocation. */
+        MemoryType memory_type;
+
         /** A unique name for this allocation. May not be equal to the
          * Allocate node name in cases where we detect multiple
          * Allocate nodes can share a single allocation. */
@@ -92,7 +96,11 @@ private:
      * allocations this calls halide_malloc in the runtime, and for
      * stack allocations it either reuses an existing block from the
      * free_stack_blocks list, or it saves the stack pointer and calls
-     * alloca.
+     * alloca. MemoryType::Heap always uses halide_malloc, and
+     * MemoryType::Stack always uses alloca. MemoryType::Register
+     * always gets a fresh alloca in the entry block, which is never
+     * shared with other allocations, so that llvm can promote it to
+     * registers.
      *
      * This call returns the allocation, pushes it onto the
      * 'allocations' map, and adds an entry to the symbol table called
@@ -100,7 +108,7 @@ private:
      *
      * When the allocation can be freed call 'free_allocation', and
      * when it goes out of scope call 'destroy_allocation'. */
-    Allocation create_allocation(const std::string &name, Type type,
+    Allocation create_allocation(const std::string &name, Type type, MemoryType memory_type,
                                  const std::vector<Expr> &extents,
                                  Expr condition, Expr new_expr, std::string free_function);
 
@@ -199,6 +199,61 @@ void CodeGen_X86::visit(const Select *op) {
     }
 }
 
+void CodeGen_X86::visit(const VectorReduce *op) {
+    const Mul *mul = op->value.as<Mul>();
+    const int input_lanes = op->value.type().lanes();
+    const int factor = input_lanes / op->type.lanes();
+
+    if (op->op == VectorReduce::Add &&
+        op->type.element_of() == Int(32) &&
+        mul) {
+        // vpdpbusd sums groups of four products of unsigned and
+        // signed bytes.
+        if (target.has_feature(Target::AVX512_Cascadelake) &&
+            factor % 4 == 0 && input_lanes >= 8) {
+            Expr a = lossless_cast(UInt(8, input_lanes), mul->a);
+            Expr b = lossless_cast(Int(8, input_lanes), mul->b);
+            if (!a.defined() || !b.defined()) {
+                a = lossless_cast(UInt(8, input_lanes), mul->b);
+                b = lossless_cast(Int(8, input_lanes), mul->a);
+            }
+            if (a.defined() && b.defined()) {
+                llvm::Type *t = llvm_type_of(Int(32, input_lanes / 4));
+                vector<Value *> args = {Constant::getNullValue(t),
+                                        builder->CreateBitCast(codegen(a), t),
+                                        builder->CreateBitCast(codegen(b), t)};
+                #if LLVM_VERSION >= 70
+                Value *partial = call_intrin(t, 16, "llvm.x86.avx512.vpdpbusd.512", args);
+                #else
+                args.push_back(ConstantInt::get(i16_t, -1));
+                Value *partial = call_intrin(t, 16, "llvm.x86.avx512.mask.vpdpbusd.512", args);
+                #endif
+                value = codegen_vector_reduce(op, partial);
+                return;
+            }
+        }
+
+        // pmaddwd sums pairs of products of 16-bit integers.
+        if (factor % 2 == 0 && input_lanes >= 4) {
+            Expr a = lossless_cast(Int(16, input_lanes), mul->a);
+            Expr b = lossless_cast(Int(16, input_lanes), mul->b);
+            if (a.defined() && b.defined()) {
+                Type t = Int(32, input_lanes / 2);
+                Value *partial;
+                if (target.has_feature(Target::AVX2) && t.lanes() > 4) {
+                    partial = call_intrin(t, 8, "llvm.x86.avx2.pmadd.wd", {a, b});
+                } else {
+                    partial = call_intrin(t, 4, "llvm.x86.sse2.pmadd.wd", {a, b});
+                }
+                value = codegen_vector_reduce(op, partial);
+                return;
+            }
+        }
+    }
+
+    CodeGen_Posix::visit(op);
+}
+
 void CodeGen_X86::visit(const Cast *op) {
 
     if (!op->type.is_vector()) {
@@ -343,7 +398,8 @@ Expr CodeGen_X86::mulhi_shr(Expr a, Expr b, int shr) {
 
 string CodeGen_X86::mcpu() const {
     if (target.has_feature(Target::AVX512_Cannonlake)) return "cannonlake";
-    if (target.has_feature(Target::AVX512_Skylake)) return "skylake-avx512";
+    if (target.has_feature(Target::AVX512_Skylake) ||
+        target.has_feature(Target::AVX512_Cascadelake)) return "skylake-avx512";
     if (target.has_feature(Target::AVX512_KNL)) return "knl";
     if (target.has_feature(Target::AVX2)) return "haswell";
     if (target.has_feature(Target::AVX)) return "corei7-avx";
@@ -371,19 +427,24 @@ string CodeGen_X86::mattrs() const {
     if (target.has_feature(Target::AVX512) ||
         target.has_feature(Target::AVX512_KNL) ||
         target.has_feature(Target::AVX512_Skylake) ||
-        target.has_feature(Target::AVX512_Cannonlake)) {
+        target.has_feature(Target::AVX512_Cannonlake) ||
+        target.has_feature(Target::AVX512_Cascadelake)) {
         features += separator + "+avx512f,+avx512cd";
         separator = ",";
         if (target.has_feature(Target::AVX512_KNL)) {
             features += ",+avx512pf,+avx512er";
         }
         if (target.has_feature(Target::AVX512_Skylake) ||
-            target.has_feature(Target::AVX512_Cannonlake)) {
+            target.has_feature(Target::AVX512_Cannonlake) ||
+            target.has_feature(Target::AVX512_Cascadelake)) {
             features += ",+avx512vl,+avx512bw,+avx512dq";
         }
         if (target.has_feature(Target::AVX512_Cannonlake)) {
             features += ",+avx512ifma,+avx512vbmi";
         }
+        if (target.has_feature(Target::AVX512_Cascadelake)) {
+            features += ",+avx512vnni";
+        }
     }
     return features;
 }
@@ -396,7 +457,8 @@ int CodeGen_X86::native_vector_bits() const {
     if (target.has_feature(Target::AVX512) ||
         target.has_feature(Target::AVX512_Skylake) ||
         target.has_feature(Target::AVX512_KNL) ||
-        target.has_feature(Target::AVX512_Cannonlake)) {
+        target.has_feature(Target::AVX512_Cannonlake) ||
+        target.has_feature(Target::AVX512_Cascadelake)) {
         return 512;
     } else if (target.has_feature(Target::AVX) ||
                target.has_feature(Target::AVX2)) {
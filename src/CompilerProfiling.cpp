@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <stdio.h>
+#include <unistd.h>
+#endif
+
+#include "CompilerProfiling.h"
+#include "IRVisitor.h"
+#include "Util.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::string;
+using std::vector;
+
+namespace {
+
+struct PassRecord {
+    string pipeline, pass;
+    double time;
+    int64_t size_before, size_after;
+    int64_t memory_delta;
+};
+
+double now_in_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The resident set size of the process, in bytes, or 0 if unknown.
+int64_t current_memory() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.WorkingSetSize;
+    }
+    return 0;
+#elif defined(__APPLE__)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return info.resident_size;
+#else
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f) {
+        return 0;
+    }
+    long long size = 0, resident = 0;
+    int fields = fscanf(f, "%lld %lld", &size, &resident);
+    fclose(f);
+    if (fields != 2) {
+        return 0;
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+// The records of all pipelines compiled, written out when the process
+// exits.
+class CompileProfile {
+    std::mutex mutex;
+    vector<PassRecord> records;
+
+    // Group the records by pipeline, in the order pipelines were
+    // first seen. Pipelines may be compiled concurrently.
+    vector<vector<const PassRecord *>> by_pipeline() const {
+        vector<vector<const PassRecord *>> result;
+        vector<string> names;
+        for (const PassRecord &r : records) {
+            size_t i = std::find(names.begin(), names.end(), r.pipeline) - names.begin();
+            if (i == names.size()) {
+                names.push_back(r.pipeline);
+                result.emplace_back();
+            }
+            result[i].push_back(&r);
+        }
+        return result;
+    }
+
+    void write_table(std::ostream &out) const {
+        for (const auto &pipeline : by_pipeline()) {
+            out << "Compile profile for " << pipeline[0]->pipeline << ":\n"
+                << "  " << std::left << std::setw(56) << "pass" << std::right
+                << std::setw(12) << "time (ms)"
+                << std::setw(12) << "IR before"
+                << std::setw(12) << "IR after"
+                << std::setw(16) << "mem delta (MB)" << "\n";
+            double total = 0;
+            for (const PassRecord *r : pipeline) {
+                out << "  " << std::left << std::setw(56) << r->pass << std::right
+                    << std::setw(12) << std::fixed << std::setprecision(2) << r->time * 1000
+                    << std::setw(12) << r->size_before
+                    << std::setw(12) << r->size_after
+                    << std::setw(16) << std::setprecision(1) << r->memory_delta / (1024.0 * 1024.0) << "\n";
+                total += r->time;
+            }
+            out << "  " << std::left << std::setw(56) << "total" << std::right
+                << std::setw(12) << std::setprecision(2) << total * 1000 << "\n\n";
+        }
+    }
+
+    void write_json(std::ostream &out) const {
+        out << "{\"pipelines\": [";
+        bool first_pipeline = true;
+        for (const auto &pipeline : by_pipeline()) {
+            out << (first_pipeline ? "\n" : ",\n")
+                << "  {\"name\": \"" << pipeline[0]->pipeline << "\",\n"
+                << "   \"passes\": [";
+            first_pipeline = false;
+            bool first_pass = true;
+            for (const PassRecord *r : pipeline) {
+                out << (first_pass ? "\n" : ",\n")
+                    << "    {\"name\": \"" << r->pass << "\""
+                    << ", \"time_ms\": " << r->time * 1000
+                    << ", \"ir_before\": " << r->size_before
+                    << ", \"ir_after\": " << r->size_after
+                    << ", \"memory_delta_bytes\": " << r->memory_delta << "}";
+                first_pass = false;
+            }
+            out << "]}";
+        }
+        out << "\n]}\n";
+    }
+
+public:
+    void add(const PassRecord &r) {
+        std::lock_guard<std::mutex> lock(mutex);
+        records.push_back(r);
+    }
+
+    ~CompileProfile() {
+        if (records.empty()) {
+            return;
+        }
+        string destination = get_env_variable("HL_COMPILE_PROFILE");
+        if (ends_with(destination, ".json")) {
+            std::ofstream out(destination);
+            if (out) {
+                write_json(out);
+            } else {
+                std::cerr << "Could not write compile profile to " << destination << "\n";
+            }
+        } else {
+            write_table(std::cerr);
+        }
+    }
+};
+
+CompileProfile &compile_profile() {
+    static CompileProfile profile;
+    return profile;
+}
+
+class CountIRNodes : public IRGraphVisitor {
+    std::set<const IRNode *> seen;
+
+    using IRGraphVisitor::include;
+
+    void include(const Expr &e) override {
+        if (seen.insert(e.get()).second) {
+            count++;
+            e.accept(this);
+        }
+    }
+
+    void include(const Stmt &s) override {
+        if (seen.insert(s.get()).second) {
+            count++;
+            s.accept(this);
+        }
+    }
+
+public:
+    int64_t count = 0;
+
+    void count_stmt(const Stmt &s) {
+        if (s.defined()) {
+            include(s);
+        }
+    }
+};
+
+}  // namespace
+
+int64_t count_ir_nodes(const Stmt &s) {
+    CountIRNodes counter;
+    counter.count_stmt(s);
+    return counter.count;
+}
+
+bool CompileProfiler::enabled() {
+    static bool on = !get_env_variable("HL_COMPILE_PROFILE").empty();
+    return on;
+}
+
+CompileProfiler::CompileProfiler(const string &pipeline_name) :
+    pipeline_name(pipeline_name), size_before(-1), memory_before(0), start_time(0),
+    active(enabled()), in_pass(false) {
+    if (active) {
+        // Make sure the records outlive this profiler, so that they
+        // are still there to write out at exit.
+        compile_profile();
+    }
+}
+
+CompileProfiler::~CompileProfiler() {
+    end();
+}
+
+// Counting IR nodes can take a while, so it is kept out of the time
+// of the passes on either side.
+
+void CompileProfiler::begin(const string &pass, const Stmt &s) {
+    if (!active) {
+        return;
+    }
+    double end_time = now_in_seconds();
+    int64_t size = count_ir_nodes(s);
+    finish(end_time, size);
+    pass_name = pass;
+    size_before = size;
+    memory_before = current_memory();
+    in_pass = true;
+    start_time = now_in_seconds();
+}
+
+void CompileProfiler::begin(const string &pass, int64_t size) {
+    if (!active) {
+        return;
+    }
+    finish(now_in_seconds(), size);
+    pass_name = pass;
+    size_before = size;
+    memory_before = current_memory();
+    in_pass = true;
+    start_time = now_in_seconds();
+}
+
+void CompileProfiler::end(const Stmt &s) {
+    if (active && in_pass) {
+        double end_time = now_in_seconds();
+        finish(end_time, count_ir_nodes(s));
+    }
+}
+
+void CompileProfiler::end(int64_t size) {
+    if (active) {
+        finish(now_in_seconds(), size);
+    }
+}
+
+void CompileProfiler::finish(double end_time, int64_t size) {
+    if (!in_pass) {
+        return;
+    }
+    compile_profile().add({pipeline_name, pass_name, end_time - start_time, size_before, size,
+                           current_memory() - memory_before});
+    in_pass = false;
+}
+
+}
+}
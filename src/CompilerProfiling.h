@@ -0,0 +1,81 @@
+#ifndef HALIDE_COMPILER_PROFILING_H
+#define HALIDE_COMPILER_PROFILING_H
+
+/** \file
+ * Defines a profiler for the passes of lowering and code generation.
+ */
+
+#include <string>
+#include <stdint.h>
+
+#include "Expr.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Records the wall-clock time, the size of the IR before and after,
+ * and the change in the resident memory of the process over each of
+ * a sequence of compiler passes over one pipeline. Does nothing unless the
+ * environment variable HL_COMPILE_PROFILE is set. The records for
+ * every pipeline compiled are written at exit: as JSON if
+ * HL_COMPILE_PROFILE names a file ending in .json, and otherwise as a
+ * table on stderr.
+ *
+ * Passes run back to back, so beginning one ends the one in progress:
+ *
+ \code
+ CompileProfiler profiler(pipeline_name);
+ profiler.begin("sliding window", s);
+ s = sliding_window(s, env);
+ profiler.begin("storage folding", s);
+ s = storage_folding(s, env);
+ profiler.end(s);
+ \endcode
+ *
+ * IR sizes are the number of distinct Halide IR nodes for passes
+ * over Stmts, or whatever the caller passes in for other phases
+ * (e.g. the number of LLVM instructions), and -1 if unknown.
+ */
+class CompileProfiler {
+    std::string pipeline_name;
+    std::string pass_name;
+    int64_t size_before;
+    int64_t memory_before;
+    double start_time;
+    bool active;
+    bool in_pass;
+
+    void finish(double end_time, int64_t size);
+
+public:
+    EXPORT CompileProfiler(const std::string &pipeline_name);
+
+    /** Ends the pass in progress, if any, with an unknown size. */
+    EXPORT ~CompileProfiler();
+
+    /** Begin a pass over the given Stmt. */
+    EXPORT void begin(const std::string &pass, const Stmt &s);
+
+    /** Begin a pass over something that isn't a Stmt. */
+    EXPORT void begin(const std::string &pass, int64_t size = -1);
+
+    /** End the pass in progress, which produced the given Stmt. */
+    EXPORT void end(const Stmt &s);
+
+    /** End the pass in progress, which produced something of the
+     * given size. */
+    EXPORT void end(int64_t size = -1);
+
+    /** Whether HL_COMPILE_PROFILE is set. Use this to avoid computing
+     * sizes that won't be recorded. */
+    EXPORT static bool enabled();
+};
+
+/** The number of distinct nodes in a Stmt. Shared subexpressions are
+ * counted once. */
+EXPORT int64_t count_ir_nodes(const Stmt &s);
+
+}
+}
+
+#endif
@@ -326,6 +326,20 @@ private:
             return Shuffle::make({op}, indices);
         }
     }
+
+    Expr visit(const VectorReduce *op) override {
+        // Gather the groups of input lanes that reduce to the
+        // selected output lanes.
+        int factor = op->value.type().lanes() / op->type.lanes();
+        std::vector<int> indices;
+        for (int i = 0; i < new_lanes; i++) {
+            int idx = i * lane_stride + starting_lane;
+            for (int j = 0; j < factor; j++) {
+                indices.push_back(idx * factor + j);
+            }
+        }
+        return VectorReduce::make(op->op, Shuffle::make({op->value}, indices), new_lanes);
+    }
 };
 
 Expr extract_odd_lanes(Expr e, const Scope<> &lets) {
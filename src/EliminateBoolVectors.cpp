@@ -210,6 +210,28 @@ private:
         return expr;
     }
 
+    Expr visit(const VectorReduce *op) override {
+        Expr value = mutate(op->value);
+        if (value.type() == op->value.type()) {
+            if (value.same_as(op->value)) {
+                return op;
+            }
+            return VectorReduce::make(op->op, value, op->type.lanes());
+        }
+
+        // This is a reduction of a bool vector, which is now a vector
+        // of signed masks. True is all ones, i.e. -1, so And and Or
+        // become Max and Min.
+        internal_assert(op->op == VectorReduce::And || op->op == VectorReduce::Or);
+        VectorReduce::Operator reduce_op =
+            op->op == VectorReduce::And ? VectorReduce::Max : VectorReduce::Min;
+        Expr expr = VectorReduce::make(reduce_op, value, op->type.lanes());
+        if (op->type.is_scalar()) {
+            expr = NE::make(expr, make_zero(expr.type()));
+        }
+        return expr;
+    }
+
     template <typename NodeType, typename LetType>
     NodeType visit_let(const LetType *op) {
         Expr value = mutate(op->value);
@@ -65,6 +65,8 @@ enum class IRNodeType {
     Evaluate,
     Shuffle,
     Prefetch,
+    Atomic,
+    VectorReduce,
 };
 
 /** The abstract base classes for a node in the Halide IR. */
@@ -177,6 +179,17 @@ struct IRHandle : public IntrusivePtr<const IRNode> {
     }
 };
 
+struct IntImm;
+struct UIntImm;
+
+/** Small integer constants are by far the most common leaf nodes, so
+ * there is a single shared node for each small value of each integer
+ * type. These return that node, or nullptr if the value isn't one of
+ * the shared ones. */
+// @{
+EXPORT const IntImm *shared_int_imm(int bits, int64_t value);
+EXPORT const UIntImm *shared_uint_imm(int bits, uint64_t value);
+// @}
 
 /** Integer constants */
 struct IntImm : public ExprNode<IntImm> {
@@ -196,6 +209,10 @@ struct IntImm : public ExprNode<IntImm> {
         // Then sign-extending to get them back
         value >>= (64 - t.bits());
 
+        if (const IntImm *shared = shared_int_imm(t.bits(), value)) {
+            return shared;
+        }
+
         IntImm *node = new IntImm;
         node->type = t;
         node->value = value;
@@ -219,6 +236,10 @@ struct UIntImm : public ExprNode<UIntImm> {
         value <<= (64 - t.bits());
         value >>= (64 - t.bits());
 
+        if (const UIntImm *shared = shared_uint_imm(t.bits(), value)) {
+            return shared;
+        }
+
         UIntImm *node = new UIntImm;
         node->type = t;
         node->value = value;
@@ -341,6 +362,28 @@ const DeviceAPI all_device_apis[] = {DeviceAPI::None,
                                      DeviceAPI::Metal,
                                      DeviceAPI::Hexagon};
 
+/** An enum describing where the storage of a Func lives. Used by
+ * schedules, and in the Allocate IR node. */
+enum class MemoryType {
+    /** Let Halide pick. Small constant-size allocations go on the
+     * stack, and the rest go on the heap. */
+    Auto,
+
+    /** The stack. The allocation must have a constant size, or be
+     * bounded by a constant size. */
+    Stack,
+
+    /** The heap, even if the allocation is small. */
+    Heap,
+
+    /** Registers. The allocation must have a constant size, and
+     * after unrolling and vectorization every access to it must be
+     * at a constant index, so that it can be promoted to SSA
+     * values. Use this for small intermediates computed within
+     * unrolled or vectorized loops. */
+    Register,
+};
+
 namespace Internal {
 
 /** An enum describing a type of loop traversal. Used in schedules, and in
@@ -279,6 +279,19 @@ const std::string &Stage::name() const {
     return stage_name;
 }
 
+bool Stage::args_use_rvars() const {
+    Scope<> rvars;
+    for (const ReductionVariable &rv : definition.schedule().rvars()) {
+        rvars.push(rv.var);
+    }
+    for (const Expr &arg : definition.args()) {
+        if (expr_uses_vars(arg, rvars)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void Stage::set_dim_type(VarOrRVar var, ForType t) {
     bool found = false;
     vector<Dim> &dims = definition.schedule().dims();
@@ -289,15 +302,22 @@ void Stage::set_dim_type(VarOrRVar var, ForType t) {
 
             // If it's an rvar and the for type is parallel, we need to
             // validate that this doesn't introduce a race condition.
+            // Vectorizing is safe if every lane updates the same
+            // location, because vectorization turns that into a
+            // reduction across the lanes.
             if (!dims[i].is_pure() && var.is_rvar &&
-                (t == ForType::Vectorized || t == ForType::Parallel ||
-                 t == ForType::GPUBlock || t == ForType::GPUThread)) {
-                user_assert(definition.schedule().allow_race_conditions())
+                (t == ForType::Parallel ||
+                 t == ForType::GPUBlock || t == ForType::GPUThread ||
+                 (t == ForType::Vectorized && args_use_rvars()))) {
+                user_assert(definition.schedule().allow_race_conditions() ||
+                            definition.schedule().atomic())
                     << "In schedule for " << stage_name
                     << ", marking var " << var.name()
                     << " as parallel or vectorized may introduce a race"
                     << " condition resulting in incorrect output."
-                    << " It is possible to override this error using"
+                    << " If the only conflicting accesses are updates of the"
+                    << " same location, make them atomic with the atomic()"
+                    << " method. It is also possible to override this error using"
                     << " the allow_race_conditions() method. Use this"
                     << " with great caution, and only when you are willing"
                     << " to accept non-deterministic output, or you can prove"
@@ -1371,6 +1391,54 @@ Stage &Stage::allow_race_conditions() {
     return *this;
 }
 
+Stage &Stage::atomic() {
+    definition.schedule().atomic() = true;
+    return *this;
+}
+
+namespace {
+// Recover the Func name and stage index from a stage name of the
+// form "f" or "f.update(i)". The pure definition is stage 0.
+void parse_stage_name(const string &stage_name, string &func_name, int &stage) {
+    vector<string> tmp = split_string(stage_name, ".update(");
+    internal_assert(!tmp.empty() && !tmp[0].empty());
+    func_name = tmp[0];
+    stage = 0;
+    if (tmp.size() > 1) {
+        stage = std::atoi(tmp.back().c_str()) + 1;
+    }
+}
+}  // namespace
+
+Stage &Stage::compute_with(Stage s, VarOrRVar var) {
+    string func_name, other_func_name;
+    int stage = 0, other_stage = 0;
+    parse_stage_name(stage_name, func_name, stage);
+    parse_stage_name(s.stage_name, other_func_name, other_stage);
+
+    user_assert(func_name != other_func_name || stage == other_stage + 1)
+        << "In schedule for " << stage_name
+        << ", can only compute_with the immediately preceding stage of the same Func, not "
+        << s.stage_name << "\n";
+
+    const vector<Dim> &dims = s.definition.schedule().dims();
+    string fused_var;
+    for (const Dim &d : dims) {
+        if (var_name_match(d.var, var.name())) {
+            fused_var = d.var;
+            break;
+        }
+    }
+    user_assert(!fused_var.empty())
+        << "In schedule for " << stage_name
+        << ", could not find dimension " << var.name()
+        << " to compute_with in " << s.stage_name << "\n"
+        << s.dump_argument_list();
+
+    definition.schedule().fuse_level() = FuseLoopLevel(other_func_name, other_stage, fused_var);
+    return *this;
+}
+
 Stage &Stage::serial(VarOrRVar var) {
     set_dim_type(var, ForType::Serial);
     return *this;
@@ -1939,12 +2007,36 @@ Func &Func::allow_race_conditions() {
     return *this;
 }
 
+Func &Func::atomic() {
+    invalidate_cache();
+    Stage(func.definition(), name(), args(), func.schedule()).atomic();
+    return *this;
+}
+
+Func &Func::compute_with(Stage s, VarOrRVar var) {
+    invalidate_cache();
+    Stage(func.definition(), name(), args(), func.schedule()).compute_with(s, var);
+    return *this;
+}
+
 Func &Func::memoize() {
     invalidate_cache();
     func.schedule().memoized() = true;
     return *this;
 }
 
+Func &Func::async() {
+    invalidate_cache();
+    func.schedule().async() = true;
+    return *this;
+}
+
+Func &Func::store_in(MemoryType memory_type) {
+    invalidate_cache();
+    func.schedule().memory_type() = memory_type;
+    return *this;
+}
+
 Stage Func::specialize(Expr c) {
     invalidate_cache();
     return Stage(func.definition(), name(), args(), func.schedule()).specialize(c);
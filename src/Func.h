@@ -60,6 +60,7 @@ class Stage {
     Internal::FuncSchedule func_schedule;
 
     void set_dim_type(VarOrRVar var, Internal::ForType t);
+    bool args_use_rvars() const;
     void set_dim_device_api(VarOrRVar var, DeviceAPI device_api);
     void split(const std::string &old, const std::string &outer, const std::string &inner,
                Expr factor, bool exact, TailStrategy tail);
@@ -289,6 +290,35 @@ public:
 
     EXPORT Stage &allow_race_conditions();
 
+    /** Make the stores of this stage atomic, so that the loops over
+     * the reduction domain of a scattering update, such as a
+     * histogram, can be parallelized or vectorized without rfactor.
+     * Stores that read the value they overwrite become an atomic
+     * read-modify-write of that location: a native atomic instruction
+     * for integer add, subtract, min and max, and a compare-and-swap
+     * loop otherwise. Vectorized atomic stores are performed one lane
+     * at a time, unless every lane combines its value into the same
+     * location with an associative operator, in which case the lanes
+     * are reduced first. (That case doesn't need atomic() to be
+     * vectorized.) The update must have a single value, and may only
+     * read the Func being updated at the location it writes. Call
+     * this before marking reduction variables parallel or
+     * vectorized. */
+    EXPORT Stage &atomic();
+
+    /** Schedule the loops of this stage to be fused with the loops of
+     * another stage 's', from the outermost loop down to and including
+     * the loop over 'var'. Within the fused loops, an iteration of 's'
+     * runs followed by the matching iteration of this stage, and the
+     * fused loops cover the union of the bounds of both stages. The
+     * two stages must be either the pure definitions of two Funcs
+     * computed and stored at the same loop level, or consecutive
+     * stages of the same Func. Both stages must have the same loops
+     * down to 'var'. If 'this' is an update definition, 'var' must be
+     * a pure var that the update reads and writes only at the current
+     * coordinate. */
+    EXPORT Stage &compute_with(Stage s, VarOrRVar var);
+
     EXPORT Stage &hexagon(VarOrRVar x = Var::outermost());
     EXPORT Stage &prefetch(const Func &f, VarOrRVar var, Expr offset = 1,
                            PrefetchBoundStrategy strategy = PrefetchBoundStrategy::GuardWithIf);
@@ -1259,7 +1289,9 @@ public:
      * task_size. After this call, var refers to the outer dimension of
      * the split. The inner dimension has a new anonymous name. If you
      * wish to mutate it, or schedule with respect to it, do the split
-     * manually. */
+     * manually. The default thread pool already claims runs of
+     * consecutive tasks at once, so this is only needed to set a
+     * minimum grain for loops whose iterations are very cheap. */
     EXPORT Func &parallel(VarOrRVar var, Expr task_size, TailStrategy tail = TailStrategy::Auto);
 
     /** Mark a dimension to be computed all-at-once as a single
@@ -1363,6 +1395,14 @@ public:
      * different values at different times or on different machines. */
     EXPORT Func &allow_race_conditions();
 
+    /** Make the stores of the pure definition of this Func
+     * atomic. See \ref Stage::atomic */
+    EXPORT Func &atomic();
+
+    /** Fuse the loops of the pure definition of this Func with the
+     * loops of another stage. See \ref Stage::compute_with */
+    EXPORT Func &compute_with(Stage s, VarOrRVar var);
+
 
     /** Specialize a Func. This creates a special-case version of the
      * Func where the given condition is true. The most effective
@@ -1922,6 +1962,40 @@ public:
      */
     EXPORT Func &memoize();
 
+    /** Produce this Func asynchronously in a separate task, which can
+     * run concurrently with the consumers of this Func. The consumer
+     * waits on a semaphore, released once per execution of the
+     * producer, before each place it would have computed this Func.
+     *
+     * This is only useful if the storage of this Func is hoisted out
+     * of the loop at which it's computed (using store_at or
+     * store_root), so that the producer can run ahead of the consumer
+     * into the next iterations of that loop. It's intended for I/O
+     * bound or serial producers, such as an extern decode stage,
+     * which would otherwise leave most of the machine idle. If some
+     * of the loops between the storage and compute levels are
+     * parallel, each iteration of the innermost of them forks a
+     * producer of its own, which runs ahead of its consumer across
+     * the serial loops inside that iteration.
+     *
+     * The storage of an async Func is never folded, because the
+     * producer doesn't wait for the consumer. Any other Funcs the
+     * producer calls must be computed outside of the loops between
+     * this Func's storage and compute levels, or inside this Func.
+     */
+    EXPORT Func &async();
+
+    /** Set the type of memory this Func should be stored in. By
+     * default (MemoryType::Auto) small constant-size allocations are
+     * placed on the stack, and everything else on the heap. Stack
+     * and Register require the size of the allocation to be bounded
+     * by a constant, either directly or via Func::bound. Register
+     * additionally requires every access to the Func to be at a
+     * constant index once the loops around it have been unrolled or
+     * vectorized, so that the allocation can be replaced with
+     * registers. */
+    EXPORT Func &store_in(MemoryType memory_type);
+
 
     /** Allocate storage for this function within f's loop over
      * var. Scheduling storage is optional, and can be used to
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "IR.h"
 #include "IRPrinter.h"
 #include "IRVisitor.h"
@@ -6,6 +8,92 @@
 namespace Halide {
 namespace Internal {
 
+namespace {
+
+// The range of values for which IntImm and UIntImm nodes are shared.
+const int64_t shared_imm_min = -16, shared_imm_max = 256;
+
+int int_bits_index(int bits) {
+    switch (bits) {
+    case 8: return 0;
+    case 16: return 1;
+    case 32: return 2;
+    case 64: return 3;
+    default: return -1;
+    }
+}
+
+int uint_bits_index(int bits) {
+    switch (bits) {
+    case 1: return 0;
+    case 8: return 1;
+    case 16: return 2;
+    case 32: return 3;
+    case 64: return 4;
+    default: return -1;
+    }
+}
+
+struct SharedImms {
+    // Each holds a reference to its nodes, so they are never freed.
+    std::vector<Expr> ints[4], uints[5];
+    int64_t int_min[4], int_max[4];
+    uint64_t uint_max[5];
+
+    SharedImms() {
+        const int int_bits[] = {8, 16, 32, 64};
+        for (int i = 0; i < 4; i++) {
+            int bits = int_bits[i];
+            // Every integer type can hold shared_imm_min.
+            int_min[i] = shared_imm_min;
+            int_max[i] = std::min(shared_imm_max, ((int64_t)1 << std::min(bits - 1, 62)) - 1);
+            for (int64_t v = int_min[i]; v <= int_max[i]; v++) {
+                IntImm *node = new IntImm;
+                node->type = Int(bits);
+                node->value = v;
+                ints[i].push_back(node);
+            }
+        }
+        const int uint_bits[] = {1, 8, 16, 32, 64};
+        for (int i = 0; i < 5; i++) {
+            int bits = uint_bits[i];
+            uint_max[i] = std::min((uint64_t)shared_imm_max, ((uint64_t)1 << std::min(bits, 63)) - 1);
+            for (uint64_t v = 0; v <= uint_max[i]; v++) {
+                UIntImm *node = new UIntImm;
+                node->type = UInt(bits);
+                node->value = v;
+                uints[i].push_back(node);
+            }
+        }
+    }
+};
+
+const SharedImms &shared_imms() {
+    // Deliberately leaked, so the nodes outlive any static Exprs.
+    static const SharedImms *imms = new SharedImms;
+    return *imms;
+}
+
+}  // namespace
+
+const IntImm *shared_int_imm(int bits, int64_t value) {
+    const SharedImms &imms = shared_imms();
+    int i = int_bits_index(bits);
+    if (i < 0 || value < imms.int_min[i] || value > imms.int_max[i]) {
+        return nullptr;
+    }
+    return (const IntImm *)imms.ints[i][value - imms.int_min[i]].get();
+}
+
+const UIntImm *shared_uint_imm(int bits, uint64_t value) {
+    const SharedImms &imms = shared_imms();
+    int i = uint_bits_index(bits);
+    if (i < 0 || value > imms.uint_max[i]) {
+        return nullptr;
+    }
+    return (const UIntImm *)imms.uints[i][value].get();
+}
+
 Expr Cast::make(Type t, Expr v) {
     internal_assert(v.defined()) << "Cast of undefined\n";
     internal_assert(t.lanes() == v.type().lanes()) << "Cast may not change vector widths\n";
@@ -376,7 +464,8 @@ Stmt Provide::make(const std::string &name, const std::vector<Expr> &values, con
     return node;
 }
 
-Stmt Allocate::make(const std::string &name, Type type, const std::vector<Expr> &extents,
+Stmt Allocate::make(const std::string &name, Type type, MemoryType memory_type,
+                    const std::vector<Expr> &extents,
                     Expr condition, Stmt body,
                     Expr new_expr, const std::string &free_function) {
     for (size_t i = 0; i < extents.size(); i++) {
@@ -390,6 +479,7 @@ Stmt Allocate::make(const std::string &name, Type type, const std::vector<Expr>
     Allocate *node = new Allocate;
     node->name = name;
     node->type = type;
+    node->memory_type = memory_type;
     node->extents = extents;
     node->new_expr = std::move(new_expr);
     node->free_function = free_function;
@@ -477,6 +567,31 @@ Stmt Prefetch::make(const std::string &name, const std::vector<Type> &types, con
     return node;
 }
 
+Stmt Atomic::make(const std::string &producer_name, Stmt body) {
+    internal_assert(body.defined()) << "Atomic of undefined\n";
+
+    Atomic *node = new Atomic;
+    node->producer_name = producer_name;
+    node->body = std::move(body);
+    return node;
+}
+
+Expr VectorReduce::make(VectorReduce::Operator op, Expr vec, int lanes) {
+    internal_assert(vec.defined()) << "VectorReduce of undefined\n";
+    internal_assert(lanes > 0) << "VectorReduce must have a positive number of lanes\n";
+    internal_assert(vec.type().lanes() % lanes == 0)
+        << "The number of lanes of a VectorReduce must divide the number of lanes of its argument\n";
+    if (op == And || op == Or) {
+        internal_assert(vec.type().is_bool()) << "VectorReduce And and Or only apply to bools\n";
+    }
+
+    VectorReduce *node = new VectorReduce;
+    node->type = vec.type().with_lanes(lanes);
+    node->value = std::move(vec);
+    node->op = op;
+    return node;
+}
+
 Stmt Block::make(Stmt first, Stmt rest) {
     internal_assert(first.defined()) << "Block of undefined\n";
     internal_assert(rest.defined()) << "Block of undefined\n";
@@ -762,6 +877,7 @@ template<> EXPORT void ExprNode<Ramp>::accept(IRVisitor *v) const { v->visit((co
 template<> EXPORT void ExprNode<Broadcast>::accept(IRVisitor *v) const { v->visit((const Broadcast *)this); }
 template<> EXPORT void ExprNode<Call>::accept(IRVisitor *v) const { v->visit((const Call *)this); }
 template<> EXPORT void ExprNode<Shuffle>::accept(IRVisitor *v) const { v->visit((const Shuffle *)this); }
+template<> EXPORT void ExprNode<VectorReduce>::accept(IRVisitor *v) const { v->visit((const VectorReduce *)this); }
 template<> EXPORT void ExprNode<Let>::accept(IRVisitor *v) const { v->visit((const Let *)this); }
 template<> EXPORT void StmtNode<LetStmt>::accept(IRVisitor *v) const { v->visit((const LetStmt *)this); }
 template<> EXPORT void StmtNode<AssertStmt>::accept(IRVisitor *v) const { v->visit((const AssertStmt *)this); }
@@ -776,6 +892,7 @@ template<> EXPORT void StmtNode<Block>::accept(IRVisitor *v) const { v->visit((c
 template<> EXPORT void StmtNode<IfThenElse>::accept(IRVisitor *v) const { v->visit((const IfThenElse *)this); }
 template<> EXPORT void StmtNode<Evaluate>::accept(IRVisitor *v) const { v->visit((const Evaluate *)this); }
 template<> EXPORT void StmtNode<Prefetch>::accept(IRVisitor *v) const { v->visit((const Prefetch *)this); }
+template<> EXPORT void StmtNode<Atomic>::accept(IRVisitor *v) const { v->visit((const Atomic *)this); }
 
 template<> EXPORT Expr ExprNode<IntImm>::mutate_expr(IRMutator2 *v) const { return v->visit((const IntImm *)this); }
 template<> EXPORT Expr ExprNode<UIntImm>::mutate_expr(IRMutator2 *v) const { return v->visit((const UIntImm *)this); }
@@ -805,6 +922,7 @@ template<> EXPORT Expr ExprNode<Ramp>::mutate_expr(IRMutator2 *v) const { return
 template<> EXPORT Expr ExprNode<Broadcast>::mutate_expr(IRMutator2 *v) const { return v->visit((const Broadcast *)this); }
 template<> EXPORT Expr ExprNode<Call>::mutate_expr(IRMutator2 *v) const { return v->visit((const Call *)this); }
 template<> EXPORT Expr ExprNode<Shuffle>::mutate_expr(IRMutator2 *v) const { return v->visit((const Shuffle *)this); }
+template<> EXPORT Expr ExprNode<VectorReduce>::mutate_expr(IRMutator2 *v) const { return v->visit((const VectorReduce *)this); }
 template<> EXPORT Expr ExprNode<Let>::mutate_expr(IRMutator2 *v) const { return v->visit((const Let *)this); }
 
 template<> EXPORT Stmt StmtNode<LetStmt>::mutate_stmt(IRMutator2 *v) const { return v->visit((const LetStmt *)this); }
@@ -820,6 +938,7 @@ template<> EXPORT Stmt StmtNode<Block>::mutate_stmt(IRMutator2 *v) const { retur
 template<> EXPORT Stmt StmtNode<IfThenElse>::mutate_stmt(IRMutator2 *v) const { return v->visit((const IfThenElse *)this); }
 template<> EXPORT Stmt StmtNode<Evaluate>::mutate_stmt(IRMutator2 *v) const { return v->visit((const Evaluate *)this); }
 template<> EXPORT Stmt StmtNode<Prefetch>::mutate_stmt(IRMutator2 *v) const { return v->visit((const Prefetch *)this); }
+template<> EXPORT Stmt StmtNode<Atomic>::mutate_stmt(IRMutator2 *v) const { return v->visit((const Atomic *)this); }
 
 
 Call::ConstString Call::debug_to_file = "debug_to_file";
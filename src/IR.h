@@ -342,6 +342,7 @@ struct Provide : public StmtNode<Provide> {
 struct Allocate : public StmtNode<Allocate> {
     std::string name;
     Type type;
+    MemoryType memory_type;
     std::vector<Expr> extents;
     Expr condition;
 
@@ -356,7 +357,8 @@ struct Allocate : public StmtNode<Allocate> {
     std::string free_function;
     Stmt body;
 
-    EXPORT static Stmt make(const std::string &name, Type type, const std::vector<Expr> &extents,
+    EXPORT static Stmt make(const std::string &name, Type type, MemoryType memory_type,
+                            const std::vector<Expr> &extents,
                             Expr condition, Stmt body,
                             Expr new_expr = Expr(), const std::string &free_function = std::string());
 
@@ -740,6 +742,41 @@ struct Prefetch : public StmtNode<Prefetch> {
     static const IRNodeType _node_type = IRNodeType::Prefetch;
 };
 
+/** Perform the stores in the body atomically. Stores to a Func that
+ * read the location they write are lowered to an atomic
+ * read-modify-write of that location. See \ref Stage::atomic */
+struct Atomic : public StmtNode<Atomic> {
+    std::string producer_name;
+    Stmt body;
+
+    EXPORT static Stmt make(const std::string &producer_name, Stmt body);
+
+    static const IRNodeType _node_type = IRNodeType::Atomic;
+};
+
+/** Horizontally reduce a vector to a vector with fewer lanes, using
+ * some associative binary operator. The input lanes are divided into
+ * as many groups of adjacent lanes as there are output lanes, and
+ * each group is reduced to a single lane of the output. The number of
+ * output lanes must divide the number of input lanes. */
+struct VectorReduce : public ExprNode<VectorReduce> {
+    typedef enum {
+        Add,
+        Mul,
+        Min,
+        Max,
+        And,
+        Or,
+    } Operator;
+
+    Expr value;
+    Operator op;
+
+    EXPORT static Expr make(Operator op, Expr vec, int lanes);
+
+    static const IRNodeType _node_type = IRNodeType::VectorReduce;
+};
+
 }
 }
 
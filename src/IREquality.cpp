@@ -90,6 +90,8 @@ private:
     void visit(const Evaluate *);
     void visit(const Shuffle *);
     void visit(const Prefetch *);
+    void visit(const Atomic *);
+    void visit(const VectorReduce *);
 };
 
 template<typename T>
@@ -389,6 +391,7 @@ void IRComparer::visit(const Allocate *op) {
     const Allocate *s = stmt.as<Allocate>();
 
     compare_names(s->name, op->name);
+    compare_scalar(s->memory_type, op->memory_type);
     compare_expr_vector(s->extents, op->extents);
     compare_stmt(s->body, op->body);
     compare_expr(s->condition, op->condition);
@@ -462,6 +465,21 @@ void IRComparer::visit(const Prefetch *op) {
     }
 }
 
+void IRComparer::visit(const Atomic *op) {
+    const Atomic *s = stmt.as<Atomic>();
+
+    compare_names(s->producer_name, op->producer_name);
+    compare_stmt(s->body, op->body);
+}
+
+void IRComparer::visit(const VectorReduce *op) {
+    const VectorReduce *e = expr.as<VectorReduce>();
+
+    compare_scalar(e->op, op->op);
+    // We've already compared types, so it's enough to compare the value
+    compare_expr(e->value, op->value);
+}
+
 } // namespace
 
 
@@ -90,6 +90,8 @@ protected:
     EXPORT virtual void visit(const Evaluate *);
     EXPORT virtual void visit(const Shuffle *);
     EXPORT virtual void visit(const Prefetch *);
+    EXPORT virtual void visit(const Atomic *);
+    EXPORT virtual void visit(const VectorReduce *);
 };
 
 
@@ -150,6 +152,7 @@ protected:
     EXPORT virtual Expr visit(const Call *);
     EXPORT virtual Expr visit(const Let *);
     EXPORT virtual Expr visit(const Shuffle *);
+    EXPORT virtual Expr visit(const VectorReduce *);
 
     EXPORT virtual Stmt visit(const LetStmt *);
     EXPORT virtual Stmt visit(const AssertStmt *);
@@ -164,6 +167,7 @@ protected:
     EXPORT virtual Stmt visit(const IfThenElse *);
     EXPORT virtual Stmt visit(const Evaluate *);
     EXPORT virtual Stmt visit(const Prefetch *);
+    EXPORT virtual Stmt visit(const Atomic *);
 };
 
 /** A mutator that caches and reapplies previously-done mutations, so
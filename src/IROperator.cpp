@@ -760,6 +760,71 @@ Expr strided_ramp_base(Expr e, int stride) {
     return Expr();
 }
 
+Expr vector_reduce_binop(VectorReduce::Operator op, Expr a, Expr b) {
+    switch (op) {
+    case VectorReduce::Add:
+        return Add::make(std::move(a), std::move(b));
+    case VectorReduce::Mul:
+        return Mul::make(std::move(a), std::move(b));
+    case VectorReduce::Min:
+        return Min::make(std::move(a), std::move(b));
+    case VectorReduce::Max:
+        return Max::make(std::move(a), std::move(b));
+    case VectorReduce::And:
+        return And::make(std::move(a), std::move(b));
+    case VectorReduce::Or:
+        return Or::make(std::move(a), std::move(b));
+    }
+    return Expr();
+}
+
+Expr expand_vector_reduce(const VectorReduce *op) {
+    int lanes = op->type.lanes();
+    int factor = op->value.type().lanes() / lanes;
+
+    // Each step reads its input twice, so bind it to a let.
+    std::vector<std::pair<std::string, Expr>> lets;
+    Expr result = op->value;
+    auto bind = [&](Expr e) {
+        std::string name = unique_name('t');
+        Type t = e.type();
+        lets.push_back({name, std::move(e)});
+        return Variable::make(t, name);
+    };
+
+    while (factor % 2 == 0) {
+        // Combine pairs of lanes. For a total reduction we combine
+        // the two halves of the vector. Otherwise we combine the even
+        // and odd lanes, which keeps the remaining groups of lanes
+        // adjacent.
+        Expr v = bind(result);
+        int half = v.type().lanes() / 2;
+        if (lanes == 1) {
+            result = vector_reduce_binop(op->op,
+                                         Shuffle::make_slice(v, 0, 1, half),
+                                         Shuffle::make_slice(v, half, 1, half));
+        } else {
+            result = vector_reduce_binop(op->op,
+                                         Shuffle::make_slice(v, 0, 2, half),
+                                         Shuffle::make_slice(v, 1, 2, half));
+        }
+        factor /= 2;
+    }
+
+    if (factor > 1) {
+        Expr v = bind(result);
+        result = Shuffle::make_slice(v, 0, factor, lanes);
+        for (int i = 1; i < factor; i++) {
+            result = vector_reduce_binop(op->op, result, Shuffle::make_slice(v, i, factor, lanes));
+        }
+    }
+
+    for (size_t i = lets.size(); i > 0; i--) {
+        result = Let::make(lets[i - 1].first, lets[i - 1].second, result);
+    }
+    return result;
+}
+
 } // namespace Internal
 
 Expr fast_log(Expr x) {
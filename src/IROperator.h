@@ -198,6 +198,15 @@ struct BufferBuilder {
  * otherwise undefined. */
 Expr strided_ramp_base(Expr e, int stride = 1);
 
+/** Combine two expressions with the binary operator that a vector
+ * reduction uses. */
+EXPORT Expr vector_reduce_binop(VectorReduce::Operator op, Expr a, Expr b);
+
+/** Expand a VectorReduce node into slices of its argument combined
+ * with the binary operator of the reduction, for backends that have
+ * no better way to do it. */
+EXPORT Expr expand_vector_reduce(const VectorReduce *op);
+
 } // namespace Internal
 
 /** Cast an expression to the halide type corresponding to the C++ type T. */
@@ -39,6 +39,9 @@ EXPORT std::ostream &operator<<(std::ostream &stream, const DeviceAPI &);
 /** Emit a halide LoopLevel in a human readable form */
 EXPORT std::ostream &operator<<(std::ostream &stream, const LoopLevel &);
 
+/** Emit a halide memory type in a human readable form */
+EXPORT std::ostream &operator<<(std::ostream &stream, const MemoryType &);
+
 namespace Internal {
 
 struct AssociativePattern;
@@ -69,6 +72,9 @@ EXPORT std::ostream &operator<<(std::ostream &stream, const LoweredFunc &);
 /** Emit a halide linkage value in a human readable format */
 EXPORT std::ostream &operator<<(std::ostream &stream, const LoweredFunc::LinkageType &);
 
+/** Emit a halide vector reduction operator in a human readable format */
+EXPORT std::ostream &operator<<(std::ostream &stream, const VectorReduce::Operator &);
+
 /** An IRVisitor that emits IR to the given output stream in a human
  * readable form. Can be subclassed if you want to modify the way in
  * which it prints.
@@ -146,6 +152,8 @@ protected:
     void visit(const Evaluate *);
     void visit(const Shuffle *);
     void visit(const Prefetch *);
+    void visit(const Atomic *);
+    void visit(const VectorReduce *);
 };
 }
 }
@@ -216,6 +216,10 @@ void IRVisitor::visit(const Prefetch *op) {
     }
 }
 
+void IRVisitor::visit(const Atomic *op) {
+    op->body.accept(this);
+}
+
 void IRVisitor::visit(const Block *op) {
     op->first.accept(this);
     if (op->rest.defined()) {
@@ -241,6 +245,10 @@ void IRVisitor::visit(const Shuffle *op) {
     }
 }
 
+void IRVisitor::visit(const VectorReduce *op) {
+    op->value.accept(this);
+}
+
 void IRGraphVisitor::include(const Expr &e) {
     if (!visited.count(e.get())) {
         visited.insert(e.get());
@@ -449,6 +457,10 @@ void IRGraphVisitor::visit(const Prefetch *op) {
     }
 }
 
+void IRGraphVisitor::visit(const Atomic *op) {
+    include(op->body);
+}
+
 void IRGraphVisitor::visit(const Block *op) {
     include(op->first);
     if (op->rest.defined()) include(op->rest);
@@ -472,5 +484,9 @@ void IRGraphVisitor::visit(const Shuffle *op) {
     }
 }
 
+void IRGraphVisitor::visit(const VectorReduce *op) {
+    include(op->value);
+}
+
 }
 }
@@ -2,19 +2,24 @@
 #include <stdint.h>
 #include <mutex>
 #include <set>
+#include <sstream>
 
 #ifndef _WIN32
 #include <sys/mman.h>
 #endif
 
 #include "CodeGen_Internal.h"
+#include "CompilerProfiling.h"
 #include "JITModule.h"
 #include "LLVM_Headers.h"
 #include "LLVM_Runtime_Linker.h"
 #include "Debug.h"
+#include "IRMutator.h"
+#include "IRPrinter.h"
 #include "LLVM_Output.h"
 #include "CodeGen_LLVM.h"
 #include "Pipeline.h"
+#include "Scope.h"
 
 
 #if defined(_MSC_VER) && !defined(NOMINMAX)
@@ -167,6 +172,225 @@ JITModule::Symbol compile_and_get_function(ExecutionEngine &ee, const string &na
     return symbol;
 }
 
+// Identifies this build of Halide by a hash of the binary this code
+// was loaded from (libHalide, or the executable it was linked into),
+// so that any change to the compiler or runtime gets new cache
+// keys. Empty if the binary can't be found or read.
+const std::string &halide_build_id() {
+    static const std::string id = []() -> std::string {
+        std::string path;
+#ifdef _WIN32
+        HMODULE module = nullptr;
+        char name[MAX_PATH];
+        if (GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+                               GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                               (LPCSTR)&halide_build_id, &module) &&
+            GetModuleFileNameA(module, name, sizeof(name))) {
+            path = name;
+        }
+#else
+        Dl_info info;
+        if (dladdr((void *)&halide_build_id, &info) && info.dli_fname) {
+            path = info.dli_fname;
+        }
+#endif
+        auto binary = llvm::MemoryBuffer::getFile(path, -1, false);
+        if (!binary) {
+            // The main executable may only be known by the name it
+            // was run as.
+            path = llvm::sys::fs::getMainExecutable(nullptr, (void *)&halide_build_id);
+            binary = llvm::MemoryBuffer::getFile(path, -1, false);
+        }
+        if (!binary) {
+            debug(1) << "JIT cache: could not read the Halide binary " << path << "\n";
+            return "";
+        }
+        llvm::MD5 hash;
+        hash.update(binary.get()->getBuffer());
+        llvm::MD5::MD5Result result;
+        hash.final(result);
+        llvm::SmallString<32> id;
+        llvm::MD5::stringifyResult(result, id);
+        return id.str().str();
+    }();
+    return id;
+}
+
+// Renames the variables bound by Lets and LetStmts to names that
+// depend only on their position in the IR. Lowering names many of
+// these using unique_name, so lowering the same pipeline twice never
+// produces equal IR otherwise.
+class CanonicalizeLetNames : public IRMutator2 {
+    Scope<string> renamed;
+    int counter = 0;
+
+    using IRMutator2::visit;
+
+    Expr visit(const Variable *op) override {
+        if (renamed.contains(op->name)) {
+            return Variable::make(op->type, renamed.get(op->name), op->image,
+                                  op->param, op->reduction_domain);
+        }
+        return op;
+    }
+
+    template<typename LetOrLetStmt, typename Body>
+    Body visit_let(const LetOrLetStmt *op) {
+        Expr value = mutate(op->value);
+        string new_name = "_let" + std::to_string(counter++);
+        renamed.push(op->name, new_name);
+        Body body = mutate(op->body);
+        renamed.pop(op->name);
+        return LetOrLetStmt::make(new_name, value, body);
+    }
+
+    Expr visit(const Let *op) override { return visit_let<Let, Expr>(op); }
+    Stmt visit(const LetStmt *op) override { return visit_let<LetStmt, Stmt>(op); }
+};
+
+// An on-disk cache of the object code of JIT-compiled pipelines,
+// enabled by pointing HL_JIT_CACHE_DIR at a directory. Entries are
+// keyed by a hash of the lowered Module (which includes the Target,
+// and has its let-bound names canonicalized so that lowering the
+// same pipeline again finds the same entry), the LLVM version, and
+// the build id of this copy of Halide, so a rebuilt Halide doesn't
+// pick up stale code. Each entry is the object code LLVM produced,
+// and a bitcode module holding just the entry points, which stands
+// in for the real module on a hit so that LLVM optimization and
+// codegen are skipped and only linking against the shared runtime
+// remains. Failing to read or write the cache is never an error; the
+// pipeline is just compiled as usual.
+class JITObjectCache : public llvm::ObjectCache {
+    std::string path_prefix;
+    std::unique_ptr<llvm::MemoryBuffer> object;
+
+    static void write_atomically(const std::string &path, llvm::StringRef data) {
+        // Write to a temporary file first, so that other processes
+        // sharing the cache never see a partial entry.
+        int fd;
+        llvm::SmallString<128> temp_path;
+        if (llvm::sys::fs::createUniqueFile(path + "-%%%%%%.tmp", fd, temp_path)) {
+            debug(1) << "JIT cache: could not create a temporary file for " << path << "\n";
+            return;
+        }
+        {
+            llvm::raw_fd_ostream out(fd, true);
+            out << data;
+            out.close();
+            if (out.has_error()) {
+                out.clear_error();
+                llvm::sys::fs::remove(temp_path);
+                debug(1) << "JIT cache: could not write " << path << "\n";
+                return;
+            }
+        }
+        if (llvm::sys::fs::rename(temp_path, path)) {
+            llvm::sys::fs::remove(temp_path);
+            debug(1) << "JIT cache: could not write " << path << "\n";
+        }
+    }
+
+public:
+    JITObjectCache(const std::string &dir, const Module &m) {
+        std::ostringstream stream;
+        stream << "module name=" << m.name() << ", target=" << m.target().to_string() << "\n";
+        for (const LoweredFunc &f : m.functions()) {
+            stream << f.linkage << " " << (int)f.name_mangling << " func " << f.name << " (";
+            for (const LoweredArgument &arg : f.args) {
+                stream << arg.name << ":" << (int)arg.kind << ":" << arg.type
+                       << ":" << (int)arg.dimensions
+                       << ":" << arg.alignment.modulus << ":" << arg.alignment.remainder << " ";
+            }
+            stream << ") {\n"
+                   << CanonicalizeLetNames().mutate(f.body)
+                   << "}\n";
+        }
+        llvm::MD5 hash;
+        hash.update(stream.str());
+        for (const Buffer<> &b : m.buffers()) {
+            hash.update(b.name());
+            if (b.data()) {
+                hash.update(llvm::ArrayRef<uint8_t>((const uint8_t *)b.data(), b.size_in_bytes()));
+            }
+        }
+        for (const ExternalCode &code : m.external_code()) {
+            hash.update(code.name());
+            hash.update(llvm::ArrayRef<uint8_t>(code.contents()));
+        }
+        hash.update(std::to_string(LLVM_VERSION));
+        hash.update(halide_build_id());
+        llvm::MD5::MD5Result result;
+        hash.final(result);
+        llvm::SmallString<32> key;
+        llvm::MD5::stringifyResult(result, key);
+
+        if (llvm::sys::fs::create_directories(dir)) {
+            debug(1) << "JIT cache: could not create directory " << dir << "\n";
+        }
+        path_prefix = dir + "/" + m.name() + "-" + key.str().str();
+    }
+
+    // Load the entry points of a cached pipeline, or return null if
+    // it isn't in the cache.
+    std::unique_ptr<llvm::Module> load(llvm::LLVMContext &context) {
+        // The entry points are written last, so if they are there the
+        // object code is too.
+        auto entry_points = llvm::MemoryBuffer::getFile(path_prefix + ".bc");
+        if (!entry_points) {
+            return nullptr;
+        }
+        auto object_buffer = llvm::MemoryBuffer::getFile(path_prefix + ".o");
+        if (!object_buffer) {
+            return nullptr;
+        }
+        auto module = llvm::parseBitcodeFile(entry_points.get()->getMemBufferRef(), context);
+        if (!module) {
+            llvm::consumeError(module.takeError());
+            debug(1) << "JIT cache: could not read " << path_prefix << ".bc\n";
+            return nullptr;
+        }
+        object = std::move(object_buffer.get());
+        debug(1) << "JIT cache: hit " << path_prefix << "\n";
+        return std::move(module.get());
+    }
+
+    // Make a module with the same target options as m, and a
+    // definition of each named function that does nothing. It stands
+    // in for m next time, when the object code comes from the cache.
+    std::unique_ptr<llvm::Module> make_entry_points(const llvm::Module &m, const std::vector<std::string> &names) {
+        std::unique_ptr<llvm::Module> stub(new llvm::Module(m.getModuleIdentifier(), m.getContext()));
+        clone_target_options(m, *stub);
+        stub->setDataLayout(m.getDataLayout());
+        for (const std::string &name : names) {
+            llvm::Function *f = m.getFunction(name);
+            internal_assert(f) << "JIT cache: no function " << name << " in module\n";
+            llvm::Function *g = llvm::Function::Create(f->getFunctionType(), llvm::GlobalValue::ExternalLinkage,
+                                                       name, stub.get());
+            llvm::BasicBlock *block = llvm::BasicBlock::Create(m.getContext(), "entry", g);
+            new llvm::UnreachableInst(m.getContext(), block);
+        }
+        return stub;
+    }
+
+    void save_entry_points(const llvm::Module &stub) {
+        llvm::SmallVector<char, 4096> buffer;
+        llvm::raw_svector_ostream stream(buffer);
+        WriteBitcodeToFile(&stub, stream);
+        write_atomically(path_prefix + ".bc", llvm::StringRef(buffer.data(), buffer.size()));
+    }
+
+    void notifyObjectCompiled(const llvm::Module *, llvm::MemoryBufferRef obj) override {
+        write_atomically(path_prefix + ".o", obj.getBuffer());
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *) override {
+        if (!object) {
+            return nullptr;
+        }
+        return llvm::MemoryBuffer::getMemBufferCopy(object->getBuffer(), object->getBufferIdentifier());
+    }
+};
+
 // Expand LLVM's search for symbols to include code contained in a set of JITModule.
 // TODO: Does this need to be conditionalized to llvm 3.6?
 class HalideJITMemoryManager : public SectionMemoryManager {
@@ -242,16 +466,41 @@ JITModule::JITModule() {
 JITModule::JITModule(const Module &m, const LoweredFunc &fn,
                      const std::vector<JITModule> &dependencies) {
     jit_module = new JITModuleContents();
-    std::unique_ptr<llvm::Module> llvm_module(compile_module_to_llvm_module(m, jit_module->context));
+
+    std::unique_ptr<JITObjectCache> cache;
+    std::unique_ptr<llvm::Module> entry_points;
+    std::unique_ptr<llvm::Module> llvm_module;
+    std::string cache_dir = get_env_variable("HL_JIT_CACHE_DIR");
+    if (!cache_dir.empty() && halide_build_id().empty()) {
+        debug(1) << "JIT cache: disabled, since this build of Halide can't be identified\n";
+    } else if (!cache_dir.empty()) {
+        cache.reset(new JITObjectCache(cache_dir, m));
+        llvm_module = cache->load(jit_module->context);
+    }
+    if (!llvm_module) {
+        llvm_module = compile_module_to_llvm_module(m, jit_module->context);
+        if (cache) {
+            entry_points = cache->make_entry_points(*llvm_module, {fn.name, fn.name + "_argv"});
+        }
+    }
+
     std::vector<JITModule> deps_with_runtime = dependencies;
     std::vector<JITModule> shared_runtime = JITSharedRuntime::get(llvm_module.get(), m.target());
     deps_with_runtime.insert(deps_with_runtime.end(), shared_runtime.begin(), shared_runtime.end());
-    compile_module(std::move(llvm_module), fn.name, m.target(), deps_with_runtime);
+    compile_module(std::move(llvm_module), fn.name, m.target(), deps_with_runtime,
+                   std::vector<std::string>(), cache.get());
+
+    // Only record the entry points once the object code is safely in
+    // the cache.
+    if (entry_points) {
+        cache->save_entry_points(*entry_points);
+    }
 }
 
 void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &function_name, const Target &target,
                                const std::vector<JITModule> &dependencies,
-                               const std::vector<std::string> &requested_exports) {
+                               const std::vector<std::string> &requested_exports,
+                               llvm::ObjectCache *object_cache) {
 
     // Ensure that LLVM is initialized
     CodeGen_LLVM::initialize_llvm();
@@ -269,6 +518,9 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
     DataLayout initial_module_data_layout = m->getDataLayout();
     string module_name = m->getModuleIdentifier();
 
+    CompileProfiler profiler(module_name);
+    profiler.begin("LLVM JIT code generation", llvm_module_size(*m));
+
     llvm::EngineBuilder engine_builder((std::move(m)));
     engine_builder.setTargetOptions(options);
     engine_builder.setErrorStr(&error_string);
@@ -297,6 +549,10 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
     if (!ee) std::cerr << error_string << "\n";
     internal_assert(ee) << "Couldn't create execution engine\n";
 
+    if (object_cache) {
+        ee->setObjectCache(object_cache);
+    }
+
     // Do any target-specific initialization
     std::vector<llvm::JITEventListener *> listeners;
 
@@ -332,6 +588,12 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
     debug(2) << "Finalizing object\n";
     ee->finalizeObject();
     memory_manager->work_around_llvm_bugs();
+    profiler.end();
+
+    // The cache only needs to see this module's codegen.
+    if (object_cache) {
+        ee->setObjectCache(nullptr);
+    }
 
     // Do any target-specific post-compilation module meddling
     for (size_t i = 0; i < listeners.size(); i++) {
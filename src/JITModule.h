@@ -15,6 +15,7 @@
 
 namespace llvm {
 class Module;
+class ObjectCache;
 class Type;
 }
 
@@ -107,11 +108,14 @@ struct JITModule {
     EXPORT Symbol find_symbol_by_name(const std::string &) const;
 
     /** Take an llvm module and compile it. The requested exports will
-        be available via the exports method. */
+        be available via the exports method. If an object cache is
+        given, it is consulted for the module's object code before
+        running LLVM codegen, and told about what codegen produced. */
     EXPORT void compile_module(std::unique_ptr<llvm::Module> mod,
                                const std::string &function_name, const Target &target,
                                const std::vector<JITModule> &dependencies = std::vector<JITModule>(),
-                               const std::vector<std::string> &requested_exports = std::vector<std::string>());
+                               const std::vector<std::string> &requested_exports = std::vector<std::string>(),
+                               llvm::ObjectCache *object_cache = nullptr);
 
     /** Encapsulate device (GPU) and buffer interactions. */
     EXPORT void memoization_cache_set_size(int64_t size) const;
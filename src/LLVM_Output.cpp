@@ -4,6 +4,7 @@
 #include "CodeGen_LLVM.h"
 #include "CodeGen_C.h"
 #include "CodeGen_Internal.h"
+#include "CompilerProfiling.h"
 
 #include <iostream>
 #include <fstream>
@@ -339,11 +340,19 @@ void emit_file(const llvm::Module &module_in, Internal::LLVMOStream& out, llvm::
     Internal::debug(1) << "emit_file.Compiling to native code...\n";
     Internal::debug(2) << "Target triple: " << module_in.getTargetTriple() << "\n";
 
+    // Each kind of output is generated separately, so each gets a
+    // record of its own.
+    Internal::CompileProfiler profiler(module_in.getModuleIdentifier());
+    profiler.begin(file_type == llvm::TargetMachine::CGFT_AssemblyFile ?
+                   "LLVM code generation (assembly)" :
+                   "LLVM code generation (object)",
+                   Internal::llvm_module_size(module_in));
+
     // Work on a copy of the module to avoid modifying the original.
     std::unique_ptr<llvm::Module> module = clone_module(module_in);
 
     // Get the target specific parser.
-    auto target_machine = Internal::make_target_machine(*module);
+    auto target_machine = Internal::acquire_target_machine(*module);
     internal_assert(target_machine.get()) << "Could not allocate target machine!\n";
 
     llvm::DataLayout target_data_layout(target_machine->createDataLayout());
@@ -79,6 +79,7 @@ DECLARE_CPP_INITMOD(cuda)
 DECLARE_CPP_INITMOD(destructors)
 DECLARE_CPP_INITMOD(device_interface)
 DECLARE_CPP_INITMOD(errors)
+DECLARE_CPP_INITMOD(fake_perf_counters)
 DECLARE_CPP_INITMOD(fake_thread_pool)
 DECLARE_CPP_INITMOD(float16_t)
 DECLARE_CPP_INITMOD(gcd_thread_pool)
@@ -88,6 +89,7 @@ DECLARE_CPP_INITMOD(ios_io)
 DECLARE_CPP_INITMOD(linux_clock)
 DECLARE_CPP_INITMOD(linux_host_cpu_count)
 DECLARE_CPP_INITMOD(linux_opengl_context)
+DECLARE_CPP_INITMOD(linux_perf_counters)
 DECLARE_CPP_INITMOD(matlab)
 DECLARE_CPP_INITMOD(metadata)
 DECLARE_CPP_INITMOD(mingw_math)
@@ -136,6 +138,7 @@ DECLARE_CPP_INITMOD(write_debug_image)
 DECLARE_LL_INITMOD(posix_math)
 DECLARE_LL_INITMOD(win32_math)
 DECLARE_LL_INITMOD(ptx_dev)
+DECLARE_LL_INITMOD(spin_pause)
 
 // Various conditional initmods follow (both LL and CPP).
 #ifdef WITH_METAL
@@ -169,11 +172,19 @@ DECLARE_NO_INITMOD(arm_cpu_features)
 #ifdef WITH_AARCH64
 DECLARE_LL_INITMOD(aarch64)
 DECLARE_CPP_INITMOD(aarch64_cpu_features)
+DECLARE_CPP_INITMOD(aarch64_generic_cpu_features)
 #else
 DECLARE_NO_INITMOD(aarch64)
 DECLARE_NO_INITMOD(aarch64_cpu_features)
+DECLARE_NO_INITMOD(aarch64_generic_cpu_features)
 #endif  // WITH_AARCH64
 
+#if defined(WITH_ARM) || defined(WITH_AARCH64)
+DECLARE_LL_INITMOD(arm_spin_pause)
+#else
+DECLARE_NO_INITMOD(arm_spin_pause)
+#endif
+
 #ifdef WITH_PTX
 DECLARE_LL_INITMOD(ptx_compute_20)
 DECLARE_LL_INITMOD(ptx_compute_30)
@@ -184,11 +195,13 @@ DECLARE_LL_INITMOD(ptx_compute_35)
 DECLARE_LL_INITMOD(x86_avx)
 DECLARE_LL_INITMOD(x86)
 DECLARE_LL_INITMOD(x86_sse41)
+DECLARE_LL_INITMOD(x86_spin_pause)
 DECLARE_CPP_INITMOD(x86_cpu_features)
 #else
 DECLARE_NO_INITMOD(x86_avx)
 DECLARE_NO_INITMOD(x86)
 DECLARE_NO_INITMOD(x86_sse41)
+DECLARE_NO_INITMOD(x86_spin_pause)
 DECLARE_NO_INITMOD(x86_cpu_features)
 #endif  // WITH_X86
 
@@ -748,6 +761,11 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 t.os != Target::QuRT) {
                 // MIPS doesn't support the atomics the profiler requires.
                 modules.push_back(get_initmod_profiler(c, bits_64, debug));
+                if (t.os == Target::Linux && t.arch == Target::X86) {
+                    modules.push_back(get_initmod_linux_perf_counters(c, bits_64, debug));
+                } else {
+                    modules.push_back(get_initmod_fake_perf_counters(c, bits_64, debug));
+                }
             }
 
             if (t.has_feature(Target::MSAN)) {
@@ -755,6 +773,16 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
             } else {
                 modules.push_back(get_initmod_msan_stubs(c, bits_64, debug));
             }
+
+            // The spin-wait hint used by the thread pool.
+            if (t.arch == Target::X86) {
+                modules.push_back(get_initmod_x86_spin_pause_ll(c));
+            } else if (t.arch == Target::ARM &&
+                       (bits_64 || !t.has_feature(Target::NoNEON))) {
+                modules.push_back(get_initmod_arm_spin_pause_ll(c));
+            } else {
+                modules.push_back(get_initmod_spin_pause_ll(c));
+            }
         }
 
         if (module_type != ModuleJITShared) {
@@ -807,10 +835,12 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 modules.push_back(get_initmod_x86_cpu_features(c, bits_64, debug));
             }
             if (t.arch == Target::ARM) {
-                if (t.bits == 64) {
+                if (t.bits == 32) {
                     modules.push_back(get_initmod_arm_cpu_features(c, bits_64, debug));
-                } else {
+                } else if (t.os == Target::Linux || t.os == Target::Android) {
                     modules.push_back(get_initmod_aarch64_cpu_features(c, bits_64, debug));
+                } else {
+                    modules.push_back(get_initmod_aarch64_generic_cpu_features(c, bits_64, debug));
                 }
             }
             if (t.arch == Target::MIPS) {
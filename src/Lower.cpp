@@ -8,11 +8,13 @@
 #include "AddImageChecks.h"
 #include "AddParameterChecks.h"
 #include "AllocationBoundsInference.h"
+#include "AsyncProducers.h"
 #include "Bounds.h"
 #include "BoundsInference.h"
 #include "BoundSmallAllocations.h"
 #include "CSE.h"
 #include "CanonicalizeGPUVars.h"
+#include "CompilerProfiling.h"
 #include "Debug.h"
 #include "DebugArguments.h"
 #include "DebugToFile.h"
@@ -49,6 +51,7 @@
 #include "Simplify.h"
 #include "SimplifySpecializations.h"
 #include "SplitTuples.h"
+#include "StageFusion.h"
 #include "StorageFlattening.h"
 #include "StorageFolding.h"
 #include "Substitute.h"
@@ -72,24 +75,219 @@ using std::string;
 using std::vector;
 using std::map;
 
+namespace {
+
+// Everything about a Function that decides which Functions it calls
+// and what values it can compute. Holding the Exprs themselves
+// (rather than pointers to them) keeps them alive, so a changed
+// definition can never alias the one we remember.
+struct FuncKey {
+    Function func;
+    vector<Expr> exprs;
+    vector<Function> extern_funcs;
+    map<string, Function> wrappers;
+    set<string> callees;
+};
+
+void gather_definition_exprs(const Definition &def, vector<Expr> &exprs) {
+    if (!def.defined()) {
+        return;
+    }
+    exprs.insert(exprs.end(), def.args().begin(), def.args().end());
+    exprs.insert(exprs.end(), def.values().begin(), def.values().end());
+    exprs.push_back(def.predicate());
+    for (const ReductionVariable &rv : def.schedule().rvars()) {
+        exprs.push_back(rv.min);
+        exprs.push_back(rv.extent);
+    }
+    for (const Specialization &s : def.specializations()) {
+        exprs.push_back(s.condition);
+        gather_definition_exprs(s.definition, exprs);
+    }
+}
+
+FuncKey make_func_key(const Function &f) {
+    FuncKey key;
+    key.func = f;
+    gather_definition_exprs(f.definition(), key.exprs);
+    for (const Definition &def : f.updates()) {
+        gather_definition_exprs(def, key.exprs);
+    }
+    if (f.has_extern_definition()) {
+        for (const ExternFuncArgument &arg : f.extern_arguments()) {
+            if (arg.is_func()) {
+                key.extern_funcs.push_back(Function(arg.func));
+            }
+        }
+    }
+    for (const auto &it : f.schedule().wrappers()) {
+        key.wrappers.emplace(it.first, Function(it.second));
+    }
+    return key;
+}
+
+template<typename T>
+bool all_same_as(const vector<T> &a, const vector<T> &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (!a[i].same_as(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool same_definitions(const FuncKey &a, const FuncKey &b) {
+    return (a.func.same_as(b.func) &&
+            all_same_as(a.exprs, b.exprs) &&
+            all_same_as(a.extern_funcs, b.extern_funcs));
+}
+
+bool same_wrappers(const FuncKey &a, const FuncKey &b) {
+    if (a.wrappers.size() != b.wrappers.size()) {
+        return false;
+    }
+    for (auto i = a.wrappers.begin(), j = b.wrappers.begin(); i != a.wrappers.end(); ++i, ++j) {
+        if (i->first != j->first || !i->second.same_as(j->second)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+struct LoweringCache::Contents {
+    // The output Functions, the environment they referenced, and the
+    // key of each Function in it, as of the last compilation.
+    vector<Function> outputs;
+    map<string, Function> env;
+    map<string, FuncKey> keys;
+
+    // The realization order of the wrapped environment.
+    vector<string> order;
+
+    // The value bounds of each Function in the order.
+    FuncValueBounds func_bounds;
+
+    // Check if the environment we'd compute for these outputs is the
+    // one we already have.
+    bool env_unchanged(const vector<Function> &output_funcs) const {
+        if (keys.empty() || !all_same_as(outputs, output_funcs)) {
+            return false;
+        }
+        for (const auto &it : keys) {
+            FuncKey key = make_func_key(it.second.func);
+            if (!same_definitions(it.second, key) ||
+                !same_wrappers(it.second, key)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Make the keys for a freshly computed environment, reusing the
+    // list of callees of any Function whose definition is unchanged.
+    map<string, FuncKey> make_keys(const map<string, Function> &new_env) const {
+        map<string, FuncKey> new_keys;
+        for (const auto &it : new_env) {
+            FuncKey key = make_func_key(it.second);
+            auto old = keys.find(it.first);
+            if (old != keys.end() && same_definitions(old->second, key)) {
+                key.callees = old->second.callees;
+            } else {
+                for (const auto &c : find_direct_calls(it.second)) {
+                    key.callees.insert(c.first);
+                }
+                for (const Function &g : key.extern_funcs) {
+                    key.callees.insert(g.name());
+                }
+            }
+            for (const auto &w : key.wrappers) {
+                key.callees.insert(w.second.name());
+            }
+            key.callees.erase(it.first);
+            new_keys.emplace(it.first, std::move(key));
+        }
+        return new_keys;
+    }
+
+    // Find the Functions whose value bounds may differ from the ones
+    // we have: those that are new, those whose definitions or
+    // wrappers changed, and those that call any of them.
+    set<string> find_stale(const map<string, FuncKey> &new_keys) const {
+        set<string> stale;
+        for (const auto &it : new_keys) {
+            auto old = keys.find(it.first);
+            if (old == keys.end() ||
+                !same_definitions(old->second, it.second) ||
+                !same_wrappers(old->second, it.second)) {
+                stale.insert(it.first);
+            }
+        }
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (const auto &it : new_keys) {
+                if (stale.count(it.first)) {
+                    continue;
+                }
+                for (const string &c : it.second.callees) {
+                    if (stale.count(c)) {
+                        stale.insert(it.first);
+                        changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+        return stale;
+    }
+};
+
+LoweringCache::LoweringCache() : contents(new Contents) {}
+
+LoweringCache::~LoweringCache() {}
+
 Module lower(const vector<Function> &output_funcs, const string &pipeline_name, const Target &t,
              const vector<Argument> &args, const Internal::LoweredFunc::LinkageType linkage_type,
-             const vector<IRMutator2 *> &custom_passes) {
+             const vector<IRMutator2 *> &custom_passes,
+             LoweringCache *cache) {
     std::vector<std::string> namespaces;
     std::string simple_pipeline_name = extract_namespaces(pipeline_name, namespaces);
 
     Module result_module(simple_pipeline_name, t);
 
-    // Compute an environment
+    // Compute an environment, unless the cache says it would be the
+    // same as last time.
     map<string, Function> env;
-    for (Function f : output_funcs) {
-        populate_environment(f, env);
+    map<string, FuncKey> keys;
+    bool reuse_env = cache && cache->contents->env_unchanged(output_funcs);
+    if (reuse_env) {
+        env = cache->contents->env;
+        keys = cache->contents->keys;
+    } else {
+        for (Function f : output_funcs) {
+            populate_environment(f, env);
+        }
+        if (cache) {
+            cache->environments_computed++;
+            keys = cache->contents->make_keys(env);
+        }
     }
+    map<string, Function> original_env = env;
 
     // Create a deep-copy of the entire graph of Funcs.
     vector<Function> outputs;
     std::tie(outputs, env) = deep_copy(output_funcs, env);
 
+    // Memoize simplification for the rest of lowering. This comes
+    // after the deep copy, so that the cached Exprs only refer to the
+    // copied Functions.
+    SimplifyCacheScope simplify_cache;
+
     // Output functions should all be computed and stored at root.
     for (Function f: outputs) {
         Func(f).compute_root().store_root();
@@ -103,23 +301,37 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
     // Substitute in wrapper Funcs
     env = wrap_func_calls(env);
 
-    // Compute a realization order
-    vector<string> order = realization_order(outputs, env);
+    // Compute a realization order. It only depends on the
+    // environment, so reuse it if the environment is unchanged.
+    vector<string> order;
+    if (reuse_env) {
+        order = cache->contents->order;
+    } else {
+        order = realization_order(outputs, env);
+        if (cache) {
+            cache->realization_orders_computed++;
+        }
+    }
 
     // Try to simplify the RHS/LHS of a function definition by propagating its
     // specializations' conditions
     simplify_specializations(env);
 
+    CompileProfiler profiler(pipeline_name);
+
+    profiler.begin("creating initial loop nests");
     debug(1) << "Creating initial loop nests...\n";
     bool any_memoized = false;
     Stmt s = schedule_functions(outputs, order, env, t, any_memoized);
     debug(2) << "Lowering after creating initial loop nests:\n" << s << '\n';
 
+    profiler.begin("canonicalizing GPU var names", s);
     debug(1) << "Canonicalizing GPU var names...\n";
     s = canonicalize_gpu_vars(s);
     debug(2) << "Lowering after canonicalizing GPU var names:\n" << s << '\n';
 
     if (any_memoized) {
+        profiler.begin("injecting memoization", s);
         debug(1) << "Injecting memoization...\n";
         s = inject_memoization(s, env, pipeline_name, outputs);
         debug(2) << "Lowering after injecting memoization:\n" << s << '\n';
@@ -127,21 +339,58 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
         debug(1) << "Skipping injecting memoization...\n";
     }
 
+    profiler.begin("injecting tracing", s);
     debug(1) << "Injecting tracing...\n";
     s = inject_tracing(s, pipeline_name, env, outputs, t);
     debug(2) << "Lowering after injecting tracing:\n" << s << '\n';
 
+    profiler.begin("adding checks for parameters", s);
     debug(1) << "Adding checks for parameters\n";
     s = add_parameter_checks(s, t);
     debug(2) << "Lowering after injecting parameter checks:\n" << s << '\n';
 
     // Compute the maximum and minimum possible value of each
     // function. Used in later bounds inference passes.
+    profiler.begin("computing bounds of each function's value", s);
     debug(1) << "Computing bounds of each function's value\n";
-    FuncValueBounds func_bounds = compute_function_value_bounds(order, env);
+    FuncValueBounds func_bounds;
+    if (cache) {
+        // Reuse the value bounds of any Function that, along with
+        // everything it calls, is unchanged since the last
+        // compilation.
+        LoweringCache::Contents &c = *cache->contents;
+        set<string> stale = c.find_stale(keys);
+        set<string> bounded(c.order.begin(), c.order.end());
+        for (const string &name : order) {
+            const Function &f = env.find(name)->second;
+            if (!stale.count(name) && bounded.count(name)) {
+                for (int j = 0; j < f.outputs(); j++) {
+                    auto it = c.func_bounds.find({name, j});
+                    if (it != c.func_bounds.end()) {
+                        func_bounds.emplace(*it);
+                    }
+                }
+                cache->value_bounds_reused++;
+            } else {
+                compute_function_value_bounds(f, func_bounds);
+                cache->value_bounds_computed++;
+            }
+        }
+
+        // Everything schedule-independent is known now, so update
+        // the cache in one go.
+        c.outputs = output_funcs;
+        c.env = std::move(original_env);
+        c.keys = std::move(keys);
+        c.order = order;
+        c.func_bounds = func_bounds;
+    } else {
+        func_bounds = compute_function_value_bounds(order, env);
+    }
 
     // The checks will be in terms of the symbols defined by bounds
     // inference.
+    profiler.begin("adding checks for images", s);
     debug(1) << "Adding checks for images\n";
     s = add_image_checks(s, outputs, t, order, env, func_bounds);
     debug(2) << "Lowering after injecting image checks:\n" << s << '\n';
@@ -149,18 +398,27 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
     // This pass injects nested definitions of variable names, so we
     // can't simplify statements from here until we fix them up. (We
     // can still simplify Exprs).
+    profiler.begin("performing computation bounds inference", s);
     debug(1) << "Performing computation bounds inference...\n";
     s = bounds_inference(s, outputs, order, env, func_bounds, t);
     debug(2) << "Lowering after computation bounds inference:\n" << s << '\n';
 
+    profiler.begin("fusing stages computed with each other", s);
+    debug(1) << "Fusing stages computed with each other...\n";
+    s = fuse_stages(s, env);
+    debug(2) << "Lowering after fusing stages:\n" << s << '\n';
+
+    profiler.begin("performing sliding window optimization", s);
     debug(1) << "Performing sliding window optimization...\n";
     s = sliding_window(s, env);
     debug(2) << "Lowering after sliding window:\n" << s << '\n';
 
+    profiler.begin("performing allocation bounds inference", s);
     debug(1) << "Performing allocation bounds inference...\n";
     s = allocation_bounds_inference(s, env, func_bounds);
     debug(2) << "Lowering after allocation bounds inference:\n" << s << '\n';
 
+    profiler.begin("removing code that depends on undef values", s);
     debug(1) << "Removing code that depends on undef values...\n";
     s = remove_undef(s);
     debug(2) << "Lowering after removing code that depends on undef values:\n" << s << "\n\n";
@@ -168,43 +426,58 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
     // This uniquifies the variable names, so we're good to simplify
     // after this point. This lets later passes assume syntactic
     // equivalence means semantic equivalence.
+    profiler.begin("uniquifying variable names", s);
     debug(1) << "Uniquifying variable names...\n";
     s = uniquify_variable_names(s);
     debug(2) << "Lowering after uniquifying variable names:\n" << s << "\n\n";
 
+    profiler.begin("performing storage folding optimization", s);
     debug(1) << "Performing storage folding optimization...\n";
     s = storage_folding(s, env);
     debug(2) << "Lowering after storage folding:\n" << s << '\n';
 
+    profiler.begin("forking asynchronous producers", s);
+    debug(1) << "Forking asynchronous producers...\n";
+    s = fork_async_producers(s, env);
+    debug(2) << "Lowering after forking asynchronous producers:\n" << s << '\n';
+
+    profiler.begin("injecting debug_to_file calls", s);
     debug(1) << "Injecting debug_to_file calls...\n";
     s = debug_to_file(s, outputs, env);
     debug(2) << "Lowering after injecting debug_to_file calls:\n" << s << '\n';
 
+    profiler.begin("first simplification", s);
     debug(1) << "Simplifying...\n"; // without removing dead lets, because storage flattening needs the strides
     s = simplify(s, false);
     debug(2) << "Lowering after first simplification:\n" << s << "\n\n";
 
+    profiler.begin("injecting prefetches", s);
     debug(1) << "Injecting prefetches...\n";
     s = inject_prefetch(s, env);
     debug(2) << "Lowering after injecting prefetches:\n" << s << "\n\n";
 
+    profiler.begin("dynamically skipping stages", s);
     debug(1) << "Dynamically skipping stages...\n";
     s = skip_stages(s, order);
     debug(2) << "Lowering after dynamically skipping stages:\n" << s << "\n\n";
 
+    profiler.begin("destructuring tuple-valued realizations", s);
     debug(1) << "Destructuring tuple-valued realizations...\n";
     s = split_tuples(s, env);
     debug(2) << "Lowering after destructuring tuple-valued realizations:\n" << s << "\n\n";
 
+    profiler.begin("performing storage flattening", s);
     debug(1) << "Performing storage flattening...\n";
     s = storage_flattening(s, outputs, env, t);
     debug(2) << "Lowering after storage flattening:\n" << s << "\n\n";
 
+    profiler.begin("unpacking buffer arguments", s);
     debug(1) << "Unpacking buffer arguments...\n";
     s = unpack_buffers(s);
     debug(2) << "Lowering after unpacking buffer arguments...\n" << s << "\n\n";
 
     if (any_memoized) {
+        profiler.begin("rewriting memoized allocations", s);
         debug(1) << "Rewriting memoized allocations...\n";
         s = rewrite_memoized_allocations(s, env);
         debug(2) << "Lowering after rewriting memoized allocations:\n" << s << "\n\n";
@@ -216,20 +489,24 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
         t.has_feature(Target::OpenGLCompute) ||
         t.has_feature(Target::OpenGL) ||
         (t.arch != Target::Hexagon && (t.features_any_of({Target::HVX_64, Target::HVX_128})))) {
+        profiler.begin("selecting a GPU API for GPU loops", s);
         debug(1) << "Selecting a GPU API for GPU loops...\n";
         s = select_gpu_api(s, t);
         debug(2) << "Lowering after selecting a GPU API:\n" << s << "\n\n";
 
+        profiler.begin("injecting host <-> dev buffer copies", s);
         debug(1) << "Injecting host <-> dev buffer copies...\n";
         s = inject_host_dev_buffer_copies(s, t);
         debug(2) << "Lowering after injecting host <-> dev buffer copies:\n" << s << "\n\n";
 
+        profiler.begin("selecting a GPU API for extern stages", s);
         debug(1) << "Selecting a GPU API for extern stages...\n";
         s = select_gpu_api(s, t);
         debug(2) << "Lowering after selecting a GPU API for extern stages:\n" << s << "\n\n";
     }
 
     if (t.has_feature(Target::OpenGL)) {
+        profiler.begin("injecting OpenGL texture intrinsics", s);
         debug(1) << "Injecting OpenGL texture intrinsics...\n";
         s = inject_opengl_intrinsics(s);
         debug(2) << "Lowering after OpenGL intrinsics:\n" << s << "\n\n";
@@ -237,95 +514,114 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
 
     if (t.has_gpu_feature() ||
         t.has_feature(Target::OpenGLCompute)) {
+        profiler.begin("injecting per-block gpu synchronization", s);
         debug(1) << "Injecting per-block gpu synchronization...\n";
         s = fuse_gpu_thread_loops(s);
         debug(2) << "Lowering after injecting per-block gpu synchronization:\n" << s << "\n\n";
     }
 
+    profiler.begin("second simplification", s);
     debug(1) << "Simplifying...\n";
     s = simplify(s);
     s = unify_duplicate_lets(s);
     s = remove_trivial_for_loops(s);
     debug(2) << "Lowering after second simplifcation:\n" << s << "\n\n";
 
+    profiler.begin("reduce prefetch dimension", s);
     debug(1) << "Reduce prefetch dimension...\n";
     s = reduce_prefetch_dimension(s, t);
     debug(2) << "Lowering after reduce prefetch dimension:\n" << s << "\n";
 
+    profiler.begin("unrolling", s);
     debug(1) << "Unrolling...\n";
     s = unroll_loops(s);
     s = simplify(s);
     debug(2) << "Lowering after unrolling:\n" << s << "\n\n";
 
+    profiler.begin("vectorizing", s);
     debug(1) << "Vectorizing...\n";
     s = vectorize_loops(s, t);
     s = simplify(s);
     debug(2) << "Lowering after vectorizing:\n" << s << "\n\n";
 
+    profiler.begin("detecting vector interleavings", s);
     debug(1) << "Detecting vector interleavings...\n";
     s = rewrite_interleavings(s);
     s = simplify(s);
     debug(2) << "Lowering after rewriting vector interleavings:\n" << s << "\n\n";
 
+    profiler.begin("partitioning loops to simplify boundary conditions", s);
     debug(1) << "Partitioning loops to simplify boundary conditions...\n";
     s = partition_loops(s);
     s = simplify(s);
     debug(2) << "Lowering after partitioning loops:\n" << s << "\n\n";
 
+    profiler.begin("trimming loops to the region over which they do something", s);
     debug(1) << "Trimming loops to the region over which they do something...\n";
     s = trim_no_ops(s);
     debug(2) << "Lowering after loop trimming:\n" << s << "\n\n";
 
+    profiler.begin("injecting early frees", s);
     debug(1) << "Injecting early frees...\n";
     s = inject_early_frees(s);
     debug(2) << "Lowering after injecting early frees:\n" << s << "\n\n";
 
     if (t.has_feature(Target::Profile)) {
+        profiler.begin("injecting profiling", s);
         debug(1) << "Injecting profiling...\n";
         s = inject_profiling(s, pipeline_name);
         debug(2) << "Lowering after injecting profiling:\n" << s << "\n\n";
     }
 
     if (t.has_feature(Target::FuzzFloatStores)) {
+        profiler.begin("fuzzing floating point stores", s);
         debug(1) << "Fuzzing floating point stores...\n";
         s = fuzz_float_stores(s);
         debug(2) << "Lowering after fuzzing floating point stores:\n" << s << "\n\n";
     }
 
+    profiler.begin("bounding small allocations", s);
     debug(1) << "Bounding small allocations...\n";
     s = bound_small_allocations(s);
     debug(2) << "Lowering after bounding small allocations:\n" << s << "\n\n";
 
+    profiler.begin("common subexpression elimination", s);
     debug(1) << "Simplifying...\n";
     s = common_subexpression_elimination(s);
 
     if (t.has_feature(Target::OpenGL)) {
+        profiler.begin("detecting varying attributes", s);
         debug(1) << "Detecting varying attributes...\n";
         s = find_linear_expressions(s);
         debug(2) << "Lowering after detecting varying attributes:\n" << s << "\n\n";
 
+        profiler.begin("moving varying attribute expressions out of the shader", s);
         debug(1) << "Moving varying attribute expressions out of the shader...\n";
         s = setup_gpu_vertex_buffer(s);
         debug(2) << "Lowering after removing varying attributes:\n" << s << "\n\n";
     }
 
+    profiler.begin("final simplification", s);
     s = remove_dead_allocations(s);
     s = remove_trivial_for_loops(s);
     s = simplify(s);
     s = loop_invariant_code_motion(s);
     debug(1) << "Lowering after final simplification:\n" << s << "\n\n";
 
+    profiler.begin("splitting off Hexagon offload", s);
     debug(1) << "Splitting off Hexagon offload...\n";
     s = inject_hexagon_rpc(s, t, result_module);
     debug(2) << "Lowering after splitting off Hexagon offload:\n" << s << '\n';
 
     if (!custom_passes.empty()) {
         for (size_t i = 0; i < custom_passes.size(); i++) {
+            profiler.begin("custom lowering pass " + std::to_string(i), s);
             debug(1) << "Running custom lowering pass " << i << "...\n";
             s = custom_passes[i]->mutate(s);
             debug(1) << "Lowering after custom pass " << i << ":\n" << s << "\n\n";
         }
     }
+    profiler.end(s);
 
     vector<Argument> public_args = args;
     for (const auto &out : outputs) {
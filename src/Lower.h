@@ -8,6 +8,7 @@
  */
 
 #include <iterator>
+#include <memory>
 
 #include "Argument.h"
 #include "IR.h"
@@ -19,16 +20,44 @@ namespace Internal {
 
 class IRMutator2;
 
+/** State that lowering can carry from one compilation of a pipeline
+ * to the next. Scheduling a Func doesn't change which Funcs the
+ * pipeline calls, the order they must be realized in, or the range
+ * of values they compute, so a recompile after a schedule change
+ * reuses those and only redoes them for Funcs whose definitions (or
+ * whose callees' definitions) changed. The counters record how much
+ * work was done and how much was reused. */
+class LoweringCache {
+public:
+    /** The number of times the graph of Funcs, and the order in
+     * which they must be realized, were computed from scratch. */
+    int environments_computed = 0, realization_orders_computed = 0;
+
+    /** The number of Funcs whose value bounds were computed, and the
+     * number whose value bounds were reused from a previous
+     * compilation. */
+    int value_bounds_computed = 0, value_bounds_reused = 0;
+
+    struct Contents;
+    std::unique_ptr<Contents> contents;
+
+    EXPORT LoweringCache();
+    EXPORT ~LoweringCache();
+};
+
 /** Given a vector of scheduled halide functions, create a Module that
  * evaluates it. Automatically pulls in all the functions f depends
  * on. Some stages of lowering may be target-specific. The Module may
  * contain submodules for computation offloaded to another execution
  * engine or API as well as buffers that are used in the passed in
  * Stmt. Multiple LoweredFuncs are added to support legacy buffer_t
- * calling convention. */
+ * calling convention. If a cache is given, analyses that don't
+ * depend on the schedule are reused from the previous call that used
+ * the same cache where possible. */
 EXPORT Module lower(const std::vector<Function> &output_funcs, const std::string &pipeline_name, const Target &t,
                     const std::vector<Argument> &args, const Internal::LoweredFunc::LinkageType linkage_type,
-                    const std::vector<IRMutator2 *> &custom_passes = std::vector<IRMutator2 *>());
+                    const std::vector<IRMutator2 *> &custom_passes = std::vector<IRMutator2 *>(),
+                    LoweringCache *cache = nullptr);
 
 /** Given a halide function with a schedule, create a statement that
  * evaluates it. Automatically pulls in all the functions f depends
@@ -105,6 +105,61 @@ uint64_t target_feature_mask(const Target &target) {
     return feature_mask;
 }
 
+// The number of threads to use when compiling several Modules at once.
+// If we are running with HL_DEBUG_CODEGEN=1, use threads=1 to enforce
+// sequential execution, so that debug output won't be utterly incomprehensible.
+size_t num_compile_threads() {
+    return (debug::debug_level() > 0) ? 1 : ThreadPool<void>::num_processors_online();
+}
+
+// Split a Module into one NoRuntime Module per function, so that LLVM
+// can optimize and emit each of them on its own thread. Returns an
+// empty vector if the functions can't be compiled separately: embedded
+// buffers and Internal functions are private to the object that defines
+// them, and GPU and Hexagon host code keeps per-Module state. The split
+// never depends on the number of threads, so the objects produced are
+// the same however many threads compile them.
+std::vector<Module> split_by_function(const Module &m) {
+    std::vector<Module> parts;
+    const Target &t = m.target();
+    if (m.functions().size() < 2 ||
+        !m.buffers().empty() ||
+        !m.submodules().empty() ||
+        !m.external_code().empty() ||
+        t.has_feature(Target::JIT) ||
+        t.has_gpu_feature() ||
+        t.features_any_of({Target::HVX_64, Target::HVX_128}) ||
+        t.arch == Target::Hexagon) {
+        return parts;
+    }
+    for (const auto &f : m.functions()) {
+        if (f.linkage == LoweredFunc::Internal) {
+            return parts;
+        }
+    }
+    const auto metadata_name_map = m.get_metadata_name_map();
+    for (const auto &f : m.functions()) {
+        Module part(m.name(), t.with_feature(Target::NoRuntime));
+        part.append(f);
+        for (const auto &it : metadata_name_map) {
+            part.remap_metadata_name(it.first, it.second);
+        }
+        parts.push_back(part);
+    }
+    return parts;
+}
+
+// Whether any of the outputs besides a static library are made from
+// the LLVM module for the whole Module. If so, the objects for a
+// static library come from that module too, rather than being
+// compiled a second time split by function.
+bool needs_whole_llvm_module(const Outputs &output_files) {
+    return !output_files.object_name.empty() ||
+        !output_files.assembly_name.empty() ||
+        !output_files.bitcode_name.empty() ||
+        !output_files.llvm_assembly_name.empty();
+}
+
 }  // namespace
 
 struct ModuleContents {
@@ -351,29 +406,73 @@ void Module::compile(const Outputs &output_files_arg) const {
         return;
     }
 
+    // A static library can hold one object per function, plus one for
+    // the runtime, so if the functions are independent we run LLVM on
+    // each of them in parallel instead of on one big module. If other
+    // outputs need the whole module anyway, the library just holds its
+    // one object, as it does when the functions can't be split.
+    if (!output_files.static_library_name.empty() &&
+        !needs_whole_llvm_module(output_files)) {
+        std::vector<Module> parts = split_by_function(*this);
+        if (!parts.empty()) {
+            TemporaryObjectFileDir temp_dir;
+            std::vector<std::future<void>> futures;
+            {
+                ThreadPool<void> pool(num_compile_threads());
+                for (size_t i = 0; i < parts.size(); i++) {
+                    Outputs part_out = Outputs().object(
+                        temp_dir.add_temp_object_file(output_files.static_library_name, "_" + std::to_string(i), target()));
+                    futures.emplace_back(pool.async([](Module m, Outputs o) {
+                        debug(1) << "Module.compile(): function " << m.functions().front().name << " to " << o.object_name << "\n";
+                        m.compile(o);
+                    }, parts[i], std::move(part_out)));
+                }
+                if (!target().has_feature(Target::NoRuntime)) {
+                    Outputs runtime_out = Outputs().object(
+                        temp_dir.add_temp_object_file(output_files.static_library_name, "_runtime", target()));
+                    futures.emplace_back(pool.async([](Target t, Outputs o) {
+                        debug(1) << "Module.compile(): runtime to " << o.object_name << "\n";
+                        compile_standalone_runtime(o, t);
+                    }, target(), std::move(runtime_out)));
+                }
+                // Use get() rather than wait() so that errors on the
+                // worker threads are rethrown here.
+                for (auto &f : futures) {
+                    f.get();
+                }
+            }
+            debug(1) << "Module.compile(): static_library_name " << output_files.static_library_name << "\n";
+            Target base_target(target().os, target().arch, target().bits);
+            create_static_library(temp_dir.files(), base_target, output_files.static_library_name);
+            output_files.static_library_name.clear();
+        }
+    }
+
     if (!output_files.object_name.empty() || !output_files.assembly_name.empty() ||
         !output_files.bitcode_name.empty() || !output_files.llvm_assembly_name.empty() ||
         !output_files.static_library_name.empty()) {
         llvm::LLVMContext context;
         std::unique_ptr<llvm::Module> llvm_module(compile_module_to_llvm_module(*this, context));
 
+        // The object file and the static library hold the same object,
+        // so generate it once.
+        llvm::SmallVector<char, 4096> object;
+        if (!output_files.object_name.empty() || !output_files.static_library_name.empty()) {
+            llvm::raw_svector_ostream out(object);
+            compile_llvm_module_to_object(*llvm_module, out);
+        }
         if (!output_files.object_name.empty()) {
             debug(1) << "Module.compile(): object_name " << output_files.object_name << "\n";
             auto out = make_raw_fd_ostream(output_files.object_name);
-            compile_llvm_module_to_object(*llvm_module, *out);
+            out->write(object.data(), object.size());
         }
         if (!output_files.static_library_name.empty()) {
-            // To simplify the code, we always create a temporary object output
-            // here, even if output_files.object_name was also set: in practice,
-            // no real-world code ever sets both object_name and static_library_name
-            // at the same time, so there is no meaningful performance advantage
-            // to be had.
             TemporaryObjectFileDir temp_dir;
             {
                 std::string object_name = temp_dir.add_temp_object_file(output_files.static_library_name, "", target());
                 debug(1) << "Module.compile(): temporary object_name " << object_name << "\n";
                 auto out = make_raw_fd_ostream(object_name);
-                compile_llvm_module_to_object(*llvm_module, *out);
+                out->write(object.data(), object.size());
                 out->flush();  // create_static_library() is happier if we do this
             }
             debug(1) << "Module.compile(): static_library_name " << output_files.static_library_name << "\n";
@@ -470,10 +569,7 @@ void compile_multitarget(const std::string &fn_name,
     }
 
     std::vector<std::future<void>> futures;
-    // If we are running with HL_DEBUG_CODEGEN=1, use threads=1 to enforce
-    // sequential execution, so that debug output won't be utterly incomprehensible
-    const size_t num_threads = (debug::debug_level() > 0) ? 1 : Internal::ThreadPool<void>::num_processors_online();
-    Internal::ThreadPool<void> pool(num_threads);
+    Internal::ThreadPool<void> pool(num_compile_threads());
 
     // For safety, the runtime must be built only with features common to all
     // of the targets; given an unusual ordering like
@@ -483,10 +579,37 @@ void compile_multitarget(const std::string &fn_name,
     // we should still always be *correct*: this ordering would never select sse41
     // (since x86-64-linux would be selected first due to ordering), but could
     // crash on non-sse41 machines (if we generated a runtime with sse41 instructions
-    // included). So we'll keep track of the common features as we walk thru the targets.
+    // included). So we'll use only the features that all of the targets have.
     uint64_t runtime_features_mask = (uint64_t)-1LL;
+    for (const Target &target : targets) {
+        runtime_features_mask &= target_feature_mask(target);
+    }
 
     TemporaryObjectFileDir temp_dir;
+
+    // If we haven't specified "no runtime", build a runtime with the base target
+    // and add that to the result. It doesn't depend on any of the sub-targets,
+    // so start it first: it can be compiled while they are being lowered.
+    if (!base_target.has_feature(Target::NoRuntime)) {
+        // Start with a bare Target, set only the features we know are common to all.
+        Target runtime_target(base_target.os, base_target.arch, base_target.bits);
+        // We never want NoRuntime set here.
+        runtime_features_mask &= ~(((uint64_t)(1)) << Target::NoRuntime);
+        if (runtime_features_mask) {
+            for (int i = 0; i < Target::FeatureEnd; ++i) {
+                if (runtime_features_mask & (((uint64_t) 1) << i)) {
+                    runtime_target.set_feature((Target::Feature) i);
+                }
+            }
+        }
+        Outputs runtime_out = Outputs().object(
+            temp_dir.add_temp_object_file(output_files.static_library_name, "_runtime", runtime_target));
+        futures.emplace_back(pool.async([](Target t, Outputs o) {
+            debug(1) << "compile_multitarget: compile_standalone_runtime " << o.static_library_name << "\n";
+            compile_standalone_runtime(o, t);
+        }, std::move(runtime_target), std::move(runtime_out)));
+    }
+
     std::vector<Expr> wrapper_args;
     std::vector<LoweredArgument> base_target_args;
     for (const Target &target : targets) {
@@ -536,7 +659,23 @@ void compile_multitarget(const std::string &fn_name,
 
         Outputs sub_out = add_suffixes(output_files, suffix);
         internal_assert(sub_out.object_name.empty());
-        sub_out.object_name = temp_dir.add_temp_object_file(output_files.static_library_name, suffix, target);
+        // Compile the functions of the sub-target in parallel too, if we
+        // can and nothing else needs the sub-target's whole LLVM module.
+        std::vector<Module> parts;
+        if (!needs_whole_llvm_module(sub_out)) {
+            parts = split_by_function(sub_module);
+        }
+        if (parts.empty()) {
+            sub_out.object_name = temp_dir.add_temp_object_file(output_files.static_library_name, suffix, target);
+        }
+        for (size_t i = 0; i < parts.size(); i++) {
+            Outputs part_out = Outputs().object(
+                temp_dir.add_temp_object_file(output_files.static_library_name, suffix + "_" + std::to_string(i), target));
+            futures.emplace_back(pool.async([](Module m, Outputs o) {
+                debug(1) << "compile_multitarget: compile_sub_target " << o.object_name << "\n";
+                m.compile(o);
+            }, parts[i], std::move(part_out)));
+        }
         futures.emplace_back(pool.async([](Module m, Outputs o) {
             debug(1) << "compile_multitarget: compile_sub_target " << o.object_name << "\n";
             m.compile(o);
@@ -549,34 +688,10 @@ void compile_multitarget(const std::string &fn_name,
                                    {UIntImm::make(UInt(64), cur_target_mask)},
                                    Call::Extern);
 
-        runtime_features_mask &= cur_target_mask;
-
         wrapper_args.push_back(can_use != 0);
         wrapper_args.push_back(sub_fn_name);
     }
 
-    // If we haven't specified "no runtime", build a runtime with the base target
-    // and add that to the result.
-    if (!base_target.has_feature(Target::NoRuntime)) {
-        // Start with a bare Target, set only the features we know are common to all.
-        Target runtime_target(base_target.os, base_target.arch, base_target.bits);
-        // We never want NoRuntime set here.
-        runtime_features_mask &= ~(((uint64_t)(1)) << Target::NoRuntime);
-        if (runtime_features_mask) {
-            for (int i = 0; i < Target::FeatureEnd; ++i) {
-                if (runtime_features_mask & (((uint64_t) 1) << i)) {
-                    runtime_target.set_feature((Target::Feature) i);
-                }
-            }
-        }
-        Outputs runtime_out = Outputs().object(
-            temp_dir.add_temp_object_file(output_files.static_library_name, "_runtime", runtime_target));
-        futures.emplace_back(pool.async([](Target t, Outputs o) {
-            debug(1) << "compile_multitarget: compile_standalone_runtime " << o.static_library_name << "\n";
-            compile_standalone_runtime(o, t);
-        }, std::move(runtime_target), std::move(runtime_out)));
-    }
-
     if (needs_wrapper) {
         Expr indirect_result = Call::make(Int(32), Call::call_cached_indirect_function, wrapper_args, Call::Intrinsic);
         std::string private_result_name = unique_name(fn_name + "_result");
@@ -47,7 +47,10 @@ struct Outputs {
     std::string stmt_html_name;
 
     /** The name of the emitted static library file. Empty if no static library
-     * output is desired. */
+     * output is desired. The library holds the same object as object_name
+     * would. If it is the only output compiled by LLVM and the functions of
+     * the Module are independent, it instead holds one object per function
+     * plus one for the runtime, so that they can be compiled in parallel. */
     std::string static_library_name;
 
     /** The name of the emitted auto-schedule output file. Empty if no auto-schedule
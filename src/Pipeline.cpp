@@ -67,6 +67,11 @@ struct PipelineContents {
     // The outputs
     vector<Function> outputs;
 
+    // Schedule-independent state reused across compilations. Not
+    // cleared by invalidate_cache, because it checks for itself
+    // whether it is still valid.
+    LoweringCache lowering_cache;
+
     // JIT custom overrides
     JITHandlers jit_handlers;
 
@@ -383,7 +388,8 @@ Module Pipeline::compile_to_module(const vector<Argument> &args,
             custom_passes.push_back(p.pass);
         }
 
-        contents->module = lower(contents->outputs, new_fn_name, target, lowering_args, linkage_type, custom_passes);
+        contents->module = lower(contents->outputs, new_fn_name, target, lowering_args, linkage_type, custom_passes,
+                                 &contents->lowering_cache);
     }
 
     return contents->module;
@@ -527,6 +533,11 @@ const JITHandlers &Pipeline::jit_handlers() {
     return contents->jit_handlers;
 }
 
+const LoweringCache &Pipeline::lowering_cache() {
+    user_assert(defined()) << "Pipeline is undefined\n";
+    return contents->lowering_cache;
+}
+
 Realization Pipeline::realize(vector<int32_t> sizes,
                               const Target &target) {
     user_assert(defined()) << "Pipeline is undefined\n";
@@ -26,6 +26,7 @@ struct PipelineContents;
 
 namespace Internal {
 class IRMutator2;
+class LoweringCache;
 }  // namespace Internal
 
 /**
@@ -321,6 +322,12 @@ public:
      * used by JIT. */
     EXPORT const Internal::JITHandlers &jit_handlers();
 
+    /** Get the state lowering carries from one compilation of this
+     * pipeline to the next, including counts of how much of it was
+     * reused. Unlike the compiled code, it survives
+     * invalidate_cache(). */
+    EXPORT const Internal::LoweringCache &lowering_cache();
+
     /** Add a custom pass to be used during lowering. It is run after
      * all other lowering passes. Can be used to verify properties of
      * the lowered Stmt, instrument it with extra code, or otherwise
@@ -47,6 +47,27 @@ private:
 
     bool profiling_memory = true;
 
+    // The slot the current parallel task reports its func in, or
+    // empty if we're not inside a parallel task (or are in offloaded
+    // code, which only reports through current_func).
+    string thread_slot;
+
+    // Set the func the current thread is computing.
+    Stmt set_current_func(Expr tok, Expr idx) {
+        Expr set_task;
+        if (thread_slot.empty()) {
+            Expr profiler_state = Variable::make(Handle(), "profiler_state");
+            // This call gets inlined and becomes a single store instruction.
+            set_task = Call::make(Int(32), "halide_profiler_set_current_func",
+                                  {profiler_state, tok, idx}, Call::Extern);
+        } else {
+            Expr slot = Variable::make(Handle(), thread_slot);
+            set_task = Call::make(Int(32), "halide_profiler_set_thread_func",
+                                  {slot, tok, idx}, Call::Extern);
+        }
+        return Evaluate::make(set_task);
+    }
+
     // Strip down the tuple name, e.g. f.0 into f
     string normalize_name(const string &name) {
         vector<string> v = split_string(name, ".");
@@ -70,6 +91,7 @@ private:
     Expr compute_allocation_size(const vector<Expr> &extents,
                                  const Expr &condition,
                                  const Type &type,
+                                 MemoryType memory_type,
                                  const std::string &name,
                                  bool &on_stack) {
         on_stack = true;
@@ -82,7 +104,10 @@ private:
         int32_t constant_size = Allocate::constant_allocation_size(extents, name);
         if (constant_size > 0) {
             int64_t stack_bytes = constant_size * type.bytes();
-            if (can_allocation_fit_on_stack(stack_bytes)) { // Allocation on stack
+            if (memory_type == MemoryType::Stack ||
+                memory_type == MemoryType::Register ||
+                (memory_type == MemoryType::Auto &&
+                 can_allocation_fit_on_stack(stack_bytes))) { // Allocation on stack
                 return make_const(UInt(64), stack_bytes);
             }
         }
@@ -112,7 +137,7 @@ private:
         Expr condition = mutate(op->condition);
 
         bool on_stack;
-        Expr size = compute_allocation_size(new_extents, condition, op->type, op->name, on_stack);
+        Expr size = compute_allocation_size(new_extents, condition, op->type, op->memory_type, op->name, on_stack);
         internal_assert(size.type() == UInt(64));
         func_alloc_sizes.push(op->name, {on_stack, size});
 
@@ -140,7 +165,7 @@ private:
             new_expr.same_as(op->new_expr)) {
             stmt = op;
         } else {
-            stmt = Allocate::make(op->name, op->type, new_extents, condition, body, new_expr, op->free_function);
+            stmt = Allocate::make(op->name, op->type, op->memory_type, new_extents, condition, body, new_expr, op->free_function);
         }
 
         if (!is_zero(size) && !on_stack && profiling_memory) {
@@ -200,13 +225,7 @@ private:
         }
 
         Expr profiler_token = Variable::make(Int(32), "profiler_token");
-        Expr profiler_state = Variable::make(Handle(), "profiler_state");
-
-        // This call gets inlined and becomes a single store instruction.
-        Expr set_task = Call::make(Int(32), "halide_profiler_set_current_func",
-                                   {profiler_state, profiler_token, idx}, Call::Extern);
-
-        body = Block::make(Evaluate::make(set_task), body);
+        body = Block::make(set_current_func(profiler_token, idx), body);
 
         return ProducerConsumer::make(op->name, op->is_producer, body);
     }
@@ -229,12 +248,24 @@ private:
             Evaluate::make(Call::make(Int(32), "halide_profiler_decr_active_threads",
                                       {state}, Call::Extern));
 
-        if (update_active_threads) {
+        // Tasks of parallel loops on the host report what they're
+        // computing in a slot of their own, so that each thread's
+        // time is billed to the right func. (Memory profiling is off
+        // exactly when we're inside offloaded code.)
+        bool use_thread_slot = (op->is_parallel() &&
+                                profiling_memory &&
+                                (op->device_api == DeviceAPI::None ||
+                                 op->device_api == DeviceAPI::Host));
+        string old_thread_slot = thread_slot;
+        if (use_thread_slot) {
+            thread_slot = unique_name("profiler_thread_slot");
+        } else if (update_active_threads) {
             body = Block::make({incr_active_threads, body, decr_active_threads});
         }
 
         // We profile by storing a token to global memory, so don't enter GPU loops
         if (op->device_api == DeviceAPI::Hexagon) {
+            thread_slot.clear();
             // TODO: This is for all offload targets that support
             // limited internal profiling, which is currently just
             // hexagon. We don't support per-func stats remotely,
@@ -257,9 +288,34 @@ private:
             body = op->body;
         }
 
+        Expr profiler_token = Variable::make(Int(32), "profiler_token");
+        if (use_thread_slot) {
+            // Release the slot as a destructor, so that a task that
+            // fails doesn't leak it.
+            Expr slot = Variable::make(Handle(), thread_slot);
+            Stmt release_slot =
+                Evaluate::make(Call::make(Int(32), Call::register_destructor,
+                                          {Expr("halide_profiler_release_thread_slot_as_destructor"), slot},
+                                          Call::Intrinsic));
+            body = Block::make({release_slot, set_current_func(profiler_token, stack.back()),
+                                incr_active_threads, body, decr_active_threads});
+            body = LetStmt::make(thread_slot,
+                                 Call::make(Handle(), "halide_profiler_acquire_thread_slot",
+                                            {state}, Call::Extern),
+                                 body);
+        }
+        thread_slot = old_thread_slot;
+
         Stmt stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
 
-        if (update_active_threads) {
+        if (use_thread_slot) {
+            // While the tasks run, this thread is only waiting for
+            // them (or running some of them, billed in their own
+            // slots).
+            Stmt set_waiting = set_current_func(halide_profiler_waiting, 0);
+            Stmt set_back = set_current_func(profiler_token, stack.back());
+            stmt = Block::make({decr_active_threads, set_waiting, stmt, set_back, incr_active_threads});
+        } else if (update_active_threads) {
             stmt = Block::make({decr_active_threads, stmt, incr_active_threads});
         }
         return stmt;
@@ -283,14 +339,19 @@ Stmt inject_profiling(Stmt s, string pipeline_name) {
 
     Expr profiler_token = Variable::make(Int(32), "profiler_token");
 
+    Expr profiler_pipeline_state = Variable::make(Handle(), "profiler_pipeline_state");
+
+    // Ends this run, however the pipeline exits. Runs are tracked per
+    // pipeline, so that pipelines running at once (or one called from
+    // an extern stage of another) each get their own span.
     Expr stop_profiler = Call::make(Int(32), Call::register_destructor,
-                                    {Expr("halide_profiler_pipeline_end"), get_state}, Call::Intrinsic);
+                                    {Expr("halide_profiler_pipeline_end"), profiler_pipeline_state},
+                                    Call::Intrinsic);
 
     bool no_stack_alloc = profiling.func_stack_peak.empty();
     if (!no_stack_alloc) {
         Expr func_stack_peak_buf = Variable::make(Handle(), "profiling_func_stack_peak_buf");
 
-        Expr profiler_pipeline_state = Variable::make(Handle(), "profiler_pipeline_state");
         Stmt update_stack = Evaluate::make(Call::make(Int(32), "halide_profiler_stack_peak_update",
                                            {profiler_pipeline_state, func_stack_peak_buf}, Call::Extern));
         s = Block::make(update_stack, s);
@@ -303,7 +364,7 @@ Stmt inject_profiling(Stmt s, string pipeline_name) {
     Stmt decr_active_threads =
         Evaluate::make(Call::make(Int(32), "halide_profiler_decr_active_threads",
                                   {profiler_state}, Call::Extern));
-    s = Block::make({incr_active_threads, s, decr_active_threads});
+    s = Block::make({Evaluate::make(stop_profiler), incr_active_threads, s, decr_active_threads});
 
     s = LetStmt::make("profiler_pipeline_state", get_pipeline_state, s);
     s = LetStmt::make("profiler_state", get_state, s);
@@ -320,7 +381,7 @@ Stmt inject_profiling(Stmt s, string pipeline_name) {
                                         i, Parameter(), const_true()), s);
         }
         s = Block::make(s, Free::make("profiling_func_stack_peak_buf"));
-        s = Allocate::make("profiling_func_stack_peak_buf", UInt(64), {num_funcs}, const_true(), s);
+        s = Allocate::make("profiling_func_stack_peak_buf", UInt(64), MemoryType::Auto, {num_funcs}, const_true(), s);
     }
 
     for (std::pair<string, int> p : profiling.indices) {
@@ -328,8 +389,7 @@ Stmt inject_profiling(Stmt s, string pipeline_name) {
     }
 
     s = Block::make(s, Free::make("profiling_func_names"));
-    s = Allocate::make("profiling_func_names", Handle(), {num_funcs}, const_true(), s);
-    s = Block::make(Evaluate::make(stop_profiler), s);
+    s = Allocate::make("profiling_func_names", Handle(), MemoryType::Auto, {num_funcs}, const_true(), s);
 
     return s;
 }
@@ -385,7 +385,7 @@ private:
             new_expr.same_as(op->new_expr)) {
             return op;
         } else {
-            return Allocate::make(op->name, op->type, new_extents, condition, body, new_expr, op->free_function);
+            return Allocate::make(op->name, op->type, op->memory_type, new_extents, condition, body, new_expr, op->free_function);
         }
     }
 
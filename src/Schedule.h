@@ -274,6 +274,19 @@ struct StorageDim {
     bool fold_forward;
 };
 
+/** The stage that a stage's loops are fused with, and the innermost
+ * loop of that stage they are fused down to. Set by
+ * Stage::compute_with. An empty func name means the stage's loops are
+ * not fused with anything. */
+struct FuseLoopLevel {
+    std::string func;
+    int stage;
+    std::string var;
+
+    FuseLoopLevel() : stage(0) {}
+    FuseLoopLevel(const std::string &f, int s, const std::string &v) : func(f), stage(s), var(v) {}
+};
+
 struct PrefetchDirective {
     std::string name;
     std::string var;
@@ -316,6 +329,20 @@ public:
     bool memoized() const;
     // @}
 
+    /** This flag is set to true if the function should be computed
+     * asynchronously with its consumers. See Func::async. */
+    // @{
+    bool &async();
+    bool async() const;
+    // @}
+
+    /** The kind of memory the storage for this function is
+     * allocated in. See Func::store_in. */
+    // @{
+    MemoryType &memory_type();
+    MemoryType memory_type() const;
+    // @}
+
     /** The list and order of dimensions used to store this
      * function. The first dimension in the vector corresponds to the
      * innermost dimension for storage (i.e. which dimension is
@@ -437,6 +464,19 @@ public:
     bool &allow_race_conditions();
     // @}
 
+    /** Are the stores of this stage atomic? See \ref Stage::atomic */
+    // @{
+    bool atomic() const;
+    bool &atomic();
+    // @}
+
+    /** The stage this stage's loops are fused with. See
+     * \ref Stage::compute_with */
+    // @{
+    const FuseLoopLevel &fuse_level() const;
+    FuseLoopLevel &fuse_level();
+    // @}
+
     /** Pass an IRVisitor through to all Exprs referenced in the
      * Schedule. */
     void accept(IRVisitor *) const;
@@ -58,6 +58,61 @@ bool contains_impure_call(const Expr &expr) {
     return is_not_pure.result;
 }
 
+// Point the reads of an atomic update of a Func at the location it
+// writes to the same variables as the site of the Provide, so that
+// codegen can recognize the read-modify-write after later passes have
+// rewritten the expressions involved.
+class ReplaceSelfCalls : public IRMutator2 {
+    const string &func;
+    const vector<Expr> &site, &new_site;
+
+    using IRMutator2::visit;
+
+    Expr visit(const Call *op) override {
+        if (op->call_type != Call::Halide || op->name != func) {
+            return IRMutator2::visit(op);
+        }
+        for (size_t i = 0; i < site.size(); i++) {
+            user_assert(equal(op->args[i], site[i]))
+                << "Can't make the update of " << func << " atomic, because it reads "
+                << func << " at a location other than the one it writes.\n";
+        }
+        return Call::make(op->type, op->name, new_site, op->call_type,
+                          op->func, op->value_index, op->image, op->param);
+    }
+
+public:
+    ReplaceSelfCalls(const string &f, const vector<Expr> &s, const vector<Expr> &n)
+        : func(f), site(s), new_site(n) {}
+};
+
+Stmt build_atomic_provide(const string &func_name, const vector<Expr> &site,
+                          const vector<Expr> &values) {
+    user_assert(values.size() == 1)
+        << "Can't make the update of " << func_name
+        << " atomic, because it has more than one value.\n";
+
+    vector<Expr> new_site(site.size());
+    vector<pair<string, Expr>> lets;
+    for (size_t i = 0; i < site.size(); i++) {
+        if (site[i].as<Variable>() || is_const(site[i])) {
+            new_site[i] = site[i];
+        } else {
+            string name = func_name + ".atomic_site." + std::to_string(i);
+            lets.push_back({name, site[i]});
+            new_site[i] = Variable::make(site[i].type(), name);
+        }
+    }
+
+    ReplaceSelfCalls replace(func_name, site, new_site);
+    Expr value = replace.mutate(values[0]);
+    Stmt stmt = Atomic::make(func_name, Provide::make(func_name, {value}, new_site));
+    for (size_t i = lets.size(); i > 0; i--) {
+        stmt = LetStmt::make(lets[i - 1].first, lets[i - 1].second, stmt);
+    }
+    return stmt;
+}
+
 // Build a loop nest about a provide node using a schedule
 Stmt build_provide_loop_nest_helper(string func_name,
                                     string prefix,
@@ -74,7 +129,12 @@ Stmt build_provide_loop_nest_helper(string func_name,
     // then wrapping it in for loops.
 
     // Make the (multi-dimensional multi-valued) store node.
-    Stmt stmt = Provide::make(func_name, values, site);
+    Stmt stmt;
+    if (stage_s.atomic()) {
+        stmt = build_atomic_provide(func_name, site, values);
+    } else {
+        stmt = Provide::make(func_name, values, site);
+    }
 
     // A map of the dimensions for which we know the extent is a
     // multiple of some Expr. This can happen due to a bound, or
@@ -574,7 +634,7 @@ Stmt build_produce(Function f, const Target &target) {
             const char *fn = (cropped_buffers.size() == 1 ?
                               "_halide_buffer_retire_crop_after_extern_stage" :
                               "_halide_buffer_retire_crops_after_extern_stage");
-            check = Allocate::make(destructor_name, Handle(), {},
+            check = Allocate::make(destructor_name, Handle(), MemoryType::Stack, {},
                                    const_true(), check, cleanup_struct, fn);
         }
 
@@ -2,13 +2,16 @@
 #include <algorithm>
 #include <cmath>
 #include <limits>
+#include <set>
 #include <stdio.h>
+#include <unordered_map>
 
 #include "Simplify.h"
 #include "IROperator.h"
 #include "IREquality.h"
 #include "IRPrinter.h"
 #include "IRMutator.h"
+#include "IRVisitor.h"
 #include "Scope.h"
 #include "Var.h"
 #include "Debug.h"
@@ -4813,6 +4816,42 @@ private:
         }
     }
 
+    Expr visit(const VectorReduce *op) override {
+        Expr value = mutate(op->value);
+        int lanes = op->type.lanes();
+        int factor = value.type().lanes() / lanes;
+        if (factor == 1) {
+            return value;
+        }
+
+        if (const Broadcast *b = value.as<Broadcast>()) {
+            // Reducing copies of the same value.
+            Expr v;
+            switch (op->op) {
+            case VectorReduce::Add:
+                v = mutate(b->value * factor);
+                break;
+            case VectorReduce::Min:
+            case VectorReduce::Max:
+            case VectorReduce::And:
+            case VectorReduce::Or:
+                v = b->value;
+                break;
+            case VectorReduce::Mul:
+                break;
+            }
+            if (v.defined()) {
+                return lanes > 1 ? Broadcast::make(v, lanes) : v;
+            }
+        }
+
+        if (value.same_as(op->value)) {
+            return op;
+        } else {
+            return VectorReduce::make(op->op, value, lanes);
+        }
+    }
+
     template <typename T>
     Expr hoist_slice_vector(Expr e) {
         const T *op = e.as<T>();
@@ -5164,7 +5203,7 @@ private:
             equal(op->condition, body_if->condition)) {
             // We can move the allocation into the if body case. The
             // else case must not use it.
-            Stmt stmt = Allocate::make(op->name, op->type, new_extents,
+            Stmt stmt = Allocate::make(op->name, op->type, op->memory_type, new_extents,
                                   condition, body_if->then_case,
                                   new_expr, op->free_function);
             return IfThenElse::make(body_if->condition, stmt, body_if->else_case);
@@ -5174,7 +5213,7 @@ private:
                    new_expr.same_as(op->new_expr)) {
             return op;
         } else {
-            return Allocate::make(op->name, op->type, new_extents,
+            return Allocate::make(op->name, op->type, op->memory_type, new_extents,
                                   condition, body,
                                   new_expr, op->free_function);
         }
@@ -5286,10 +5325,265 @@ private:
     }
 };
 
+namespace {
+
+// Summarizes an Expr for the simplifier cache: a hash of its
+// structure, the names of its variables, and its size. Shared
+// subexpressions are only visited once, so Exprs that are equal but
+// shared differently may hash differently; that only costs a miss.
+class SimplifyCacheKey : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+    using IRGraphVisitor::include;
+
+    void mix(uint64_t x) {
+        hash = (hash ^ x) * 1099511628211ULL;
+    }
+
+    void mix(const string &s) {
+        for (char c : s) {
+            mix((uint64_t)(unsigned char)c);
+        }
+    }
+
+    void include(const Expr &e) override {
+        size++;
+        mix((uint64_t)e->node_type);
+        mix(((uint64_t)e.type().code() << 32) | ((uint64_t)e.type().bits() << 16) | e.type().lanes());
+        IRGraphVisitor::include(e);
+    }
+
+    void visit(const IntImm *op) override {
+        mix((uint64_t)op->value);
+    }
+
+    void visit(const UIntImm *op) override {
+        mix(op->value);
+    }
+
+    void visit(const FloatImm *op) override {
+        uint64_t bits;
+        memcpy(&bits, &op->value, sizeof(bits));
+        mix(bits);
+    }
+
+    void visit(const StringImm *op) override {
+        mix(op->value);
+    }
+
+    void visit(const Variable *op) override {
+        mix(op->name);
+        names.insert(op->name);
+    }
+
+    void visit(const Load *op) override {
+        mix(op->name);
+        IRGraphVisitor::visit(op);
+    }
+
+    void visit(const Call *op) override {
+        mix(op->name);
+        IRGraphVisitor::visit(op);
+    }
+
+    void visit(const Let *op) override {
+        mix(op->name);
+        IRGraphVisitor::visit(op);
+    }
+
+public:
+    uint64_t hash = 14695981039346656037ULL;
+    int size = 0;
+    std::set<string> names;
+
+    SimplifyCacheKey(const Expr &e) {
+        include(e);
+    }
+};
+
+// Whether an Expr contains one of the poison values made above. Each
+// of those is unique, so they must not be shared by caching them.
+class ContainsPoison : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    void visit(const Call *op) override {
+        if (op->is_intrinsic(Call::signed_integer_overflow) ||
+            op->is_intrinsic(Call::indeterminate_expression)) {
+            result = true;
+        } else {
+            IRGraphVisitor::visit(op);
+        }
+    }
+public:
+    bool result = false;
+};
+
+// What the simplifier knows about one of the variables in an Expr
+// from the scopes it was given.
+struct VarFacts {
+    string name;
+    bool has_bounds = false, has_alignment = false;
+    int64_t min = 0, max = 0;
+    int modulus = 0, remainder = 0;
+
+    bool operator==(const VarFacts &other) const {
+        return (name == other.name &&
+                has_bounds == other.has_bounds &&
+                min == other.min && max == other.max &&
+                has_alignment == other.has_alignment &&
+                modulus == other.modulus && remainder == other.remainder);
+    }
+};
+
+// Memoized results of simplify(Expr), keyed on the structure of the
+// Expr, the simplify_lets flag, and the facts about its variables
+// that the simplifier would use. It is only used while a
+// SimplifyCacheScope made on the same thread exists, because names
+// (and so keys) are only meaningful within the pipeline being lowered.
+class SimplifyCache {
+    struct Entry {
+        Expr expr;
+        bool simplify_lets;
+        vector<VarFacts> facts;
+        Expr result;
+        // If the simplifier returned its input unchanged, we return
+        // the caller's Expr rather than an equal one, so that
+        // same_as checks on the result still work.
+        bool unchanged;
+    };
+
+    // Start over once there are this many entries.
+    const size_t max_size = 1 << 14;
+
+    int depth = 0;
+    std::unordered_map<uint64_t, vector<Entry>> entries;
+    size_t num_entries = 0;
+    size_t hits = 0, misses = 0;
+
+    void clear() {
+        entries.clear();
+        num_entries = 0;
+    }
+
+public:
+    // Each thread has a cache of its own, so simplifying never waits
+    // on another thread.
+    static SimplifyCache &get() {
+        static thread_local SimplifyCache cache;
+        return cache;
+    }
+
+    void begin() {
+        if (depth == 0) {
+            hits = misses = 0;
+        }
+        // A nested lowering is a different pipeline, in which the
+        // same names may mean different things.
+        clear();
+        depth++;
+    }
+
+    void end() {
+        clear();
+        if (--depth == 0) {
+            size_t total = hits + misses;
+            debug(1) << "Simplifier cache: " << hits << " hits out of " << total << " lookups";
+            if (total) {
+                debug(1) << " (" << (100 * hits) / total << "%)";
+            }
+            debug(1) << "\n";
+        }
+    }
+
+    bool enabled() const {
+        return depth > 0;
+    }
+
+    bool lookup(const Expr &e, uint64_t hash, bool simplify_lets, const vector<VarFacts> &facts, Expr *result) {
+        auto it = entries.find(hash);
+        if (it != entries.end()) {
+            for (const Entry &entry : it->second) {
+                if (entry.simplify_lets == simplify_lets &&
+                    entry.facts == facts &&
+                    graph_equal(entry.expr, e)) {
+                    *result = entry.unchanged ? e : entry.result;
+                    hits++;
+                    return true;
+                }
+            }
+        }
+        misses++;
+        return false;
+    }
+
+    void insert(const Expr &e, uint64_t hash, bool simplify_lets, const vector<VarFacts> &facts, const Expr &result) {
+        if (num_entries >= max_size) {
+            clear();
+        }
+        entries[hash].push_back({e, simplify_lets, facts, result, result.same_as(e)});
+        num_entries++;
+    }
+};
+
+}  // namespace
+
+SimplifyCacheScope::SimplifyCacheScope() {
+    SimplifyCache::get().begin();
+}
+
+SimplifyCacheScope::~SimplifyCacheScope() {
+    SimplifyCache::get().end();
+}
+
 Expr simplify(Expr e, bool simplify_lets,
               const Scope<Interval> &bounds,
               const Scope<ModulusRemainder> &alignment) {
-    return Simplify(simplify_lets, &bounds, &alignment).mutate(e);
+    SimplifyCache &cache = SimplifyCache::get();
+    if (!cache.enabled()) {
+        return Simplify(simplify_lets, &bounds, &alignment).mutate(e);
+    }
+
+    // Small Exprs are as cheap to simplify as to look up.
+    SimplifyCacheKey key(e);
+    if (key.size < 8) {
+        return Simplify(simplify_lets, &bounds, &alignment).mutate(e);
+    }
+
+    vector<VarFacts> facts;
+    for (const string &name : key.names) {
+        VarFacts f;
+        f.name = name;
+        if (bounds.contains(name)) {
+            Interval i = bounds.get(name);
+            const int64_t *i_min = as_const_int(i.min);
+            const int64_t *i_max = as_const_int(i.max);
+            if (i_min && i_max) {
+                f.has_bounds = true;
+                f.min = *i_min;
+                f.max = *i_max;
+            }
+        }
+        if (alignment.contains(name)) {
+            ModulusRemainder mod_rem = alignment.get(name);
+            f.has_alignment = true;
+            f.modulus = mod_rem.modulus;
+            f.remainder = mod_rem.remainder;
+        }
+        if (f.has_bounds || f.has_alignment) {
+            facts.push_back(f);
+        }
+    }
+
+    Expr result;
+    if (cache.lookup(e, key.hash, simplify_lets, facts, &result)) {
+        return result;
+    }
+    result = Simplify(simplify_lets, &bounds, &alignment).mutate(e);
+    ContainsPoison poison;
+    result.accept(&poison);
+    if (!poison.result) {
+        cache.insert(e, key.hash, simplify_lets, facts, result);
+    }
+    return result;
 }
 
 Stmt simplify(Stmt s, bool simplify_lets,
@@ -6883,6 +7177,31 @@ void simplify_test() {
         check(require(x == x, result, "error"), result);
     }
 
+    // Check that the simplifier cache distinguishes the facts in
+    // scope, and returns unchanged Exprs as-is.
+    {
+        SimplifyCacheScope cache;
+        Expr e = (x * 4 + y * 2 + 3) % 2 + min(x, y) * (z + 1);
+        Expr e2 = (x * 4 + y * 2 + 3) % 2 + min(x, y) * (z + 1);
+        Expr expected = min(x, y) * (z + 1) + 1;
+        check(e, expected);
+        check(e2, expected);
+
+        Scope<ModulusRemainder> alignment;
+        alignment.push("x", ModulusRemainder(4, 1));
+        Expr f = (x * 3 + 5) % 4 + max(x, y * 7 + z) / 2;
+        Expr f2 = (x * 3 + 5) % 4 + max(x, y * 7 + z) / 2;
+        Expr without = simplify(f);
+        internal_assert(equal(simplify(f2, true, Scope<Interval>::empty_scope(), alignment),
+                              simplify(f, true, Scope<Interval>::empty_scope(), alignment)));
+        internal_assert(!equal(simplify(f2, true, Scope<Interval>::empty_scope(), alignment), without));
+        internal_assert(equal(simplify(f2), without));
+
+        Expr g = max(x, y * 7 + z) / 2 + min(x * 3, y) * 5;
+        Expr g_simplified = simplify(g);
+        internal_assert(g_simplified.same_as(g) == simplify(g).same_as(g));
+    }
+
     std::cout << "Simplify test passed" << std::endl;
 }
 }
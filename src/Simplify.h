@@ -29,6 +29,21 @@ EXPORT Expr simplify(Expr, bool simplify_lets = true,
                      const Scope<ModulusRemainder> &alignment = Scope<ModulusRemainder>::empty_scope());
 // @}
 
+/** While an object of this type exists, the results of simplify(Expr),
+ * and so of can_prove, are memoized for the thread that made it. The
+ * results are keyed on the structure of the Expr and on the bounds and
+ * alignment facts in scope for its variables. Lowering makes one, as
+ * it simplifies many structurally identical Exprs. Names are only
+ * unique within a pipeline, so the memoized results are dropped when
+ * it is destroyed, and the hit rate is reported at debug level 1. */
+class SimplifyCacheScope {
+public:
+    EXPORT SimplifyCacheScope();
+    EXPORT ~SimplifyCacheScope();
+    SimplifyCacheScope(const SimplifyCacheScope &) = delete;
+    void operator=(const SimplifyCacheScope &) = delete;
+};
+
 /** A common use of the simplifier is to prove boolean expressions are
  * true at compile time. Equivalent to is_one(simplify(e)) */
 EXPORT bool can_prove(Expr e);
@@ -262,7 +262,7 @@ private:
 
     Expr visit(const Call *op) override {
 
-        if ((op->name == "halide_memoization_cache_lookup") &&
+        if ((op->name == "halide_memoization_cache_lookup_partitioned") &&
              memoize_call_uses_buffer(op)) {
             // We need to guard call to halide_memoization_cache_lookup to only
             // be executed if the corresponding buffer is allocated. We ignore
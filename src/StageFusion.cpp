@@ -0,0 +1,562 @@
+#include <algorithm>
+
+#include "StageFusion.h"
+#include "FindCalls.h"
+#include "Function.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Var.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace {
+
+// A stage scheduled with compute_with, and the stage it is fused
+// into. Stage 0 is the pure definition, and stage i+1 is update i.
+struct FusedStages {
+    string parent, child;
+    int parent_stage, child_stage;
+    // The names of the fused loops of each stage, outermost first.
+    vector<string> parent_loops, child_loops;
+};
+
+string stage_name(const string &func, int stage) {
+    if (stage == 0) {
+        return func;
+    }
+    return func + ".update(" + std::to_string(stage - 1) + ")";
+}
+
+const Definition &get_stage(const Function &f, int stage) {
+    if (stage == 0) {
+        return f.definition();
+    }
+    internal_assert(stage - 1 < (int)f.updates().size());
+    return f.updates()[stage - 1];
+}
+
+// Check that every definition of f, and every call it makes to itself,
+// touches only the current coordinate in the dimension of the pure
+// var 'var'. This is what makes it safe to interleave consecutive
+// stages of f over that dimension.
+class CheckSelfCalls : public IRVisitor {
+    const string &func;
+    int dim;
+    const string &var;
+
+    using IRVisitor::visit;
+
+    void visit(const Call *op) override {
+        IRVisitor::visit(op);
+        if (op->call_type == Call::Halide && op->name == func) {
+            const Variable *v = op->args[dim].as<Variable>();
+            if (!v || v->name != var) {
+                result = false;
+            }
+        }
+    }
+
+public:
+    bool result = true;
+    CheckSelfCalls(const string &f, int d, const string &v) : func(f), dim(d), var(v) {}
+};
+
+bool only_touches_current_coordinate(const Function &f, const Definition &def,
+                                     const string &var) {
+    const vector<string> &args = f.args();
+    auto it = std::find(args.begin(), args.end(), var);
+    if (it == args.end()) {
+        return false;
+    }
+    int dim = (int)(it - args.begin());
+    const Variable *v = def.args()[dim].as<Variable>();
+    if (!v || v->name != var) {
+        return false;
+    }
+    CheckSelfCalls check(f.name(), dim, var);
+    for (Expr e : def.args()) {
+        e.accept(&check);
+    }
+    for (Expr e : def.values()) {
+        e.accept(&check);
+    }
+    return check.result;
+}
+
+// Find all the stages scheduled with compute_with, and check that
+// fusing their loops is something this pass can do.
+vector<FusedStages> find_fused_stages(const map<string, Function> &env) {
+    vector<FusedStages> result;
+    for (const auto &iter : env) {
+        const Function &child = iter.second;
+        for (int i = 0; i <= (int)child.updates().size(); i++) {
+            const Definition &child_def = get_stage(child, i);
+            const FuseLoopLevel &fuse = child_def.schedule().fuse_level();
+            if (fuse.func.empty()) {
+                continue;
+            }
+
+            FusedStages f;
+            f.parent = fuse.func;
+            f.parent_stage = fuse.stage;
+            f.child = child.name();
+            f.child_stage = i;
+            string child_stage_name = stage_name(f.child, f.child_stage);
+            string parent_stage_name = stage_name(f.parent, f.parent_stage);
+
+            auto parent_it = env.find(f.parent);
+            user_assert(parent_it != env.end())
+                << "Can't compute " << child_stage_name << " with " << parent_stage_name
+                << ", because " << f.parent << " is not used in this pipeline.\n";
+            const Function &parent = parent_it->second;
+            user_assert(f.parent_stage <= (int)parent.updates().size())
+                << "Can't compute " << child_stage_name << " with " << parent_stage_name
+                << ", because " << f.parent << " has no such stage.\n";
+            const Definition &parent_def = get_stage(parent, f.parent_stage);
+
+            user_assert(child_def.specializations().empty() &&
+                        parent_def.specializations().empty())
+                << "Can't compute " << child_stage_name << " with " << parent_stage_name
+                << ", because stages with specializations can't be fused.\n";
+
+            if (f.parent != f.child) {
+                user_assert(f.child_stage == 0 && f.parent_stage == 0 &&
+                            child.updates().empty() && parent.updates().empty())
+                    << "Can't compute " << child_stage_name << " with " << parent_stage_name
+                    << ". Only Funcs without update definitions can be fused with other Funcs.\n";
+                user_assert(!child.has_extern_definition() && !parent.has_extern_definition())
+                    << "Can't compute " << child_stage_name << " with " << parent_stage_name
+                    << ", because extern stages can't be fused.\n";
+                const FuncSchedule &cs = child.schedule(), &ps = parent.schedule();
+                user_assert(!cs.compute_level().is_inlined() &&
+                            cs.compute_level() == ps.compute_level() &&
+                            cs.store_level() == ps.store_level())
+                    << "Can't compute " << child_stage_name << " with " << parent_stage_name
+                    << ". Both Funcs must be computed and stored at the same loop level.\n";
+                user_assert(!find_transitive_calls(child).count(f.parent) &&
+                            !find_transitive_calls(parent).count(f.child))
+                    << "Can't compute " << child_stage_name << " with " << parent_stage_name
+                    << ", because one of them depends on the other.\n";
+            }
+
+            // The loops of both stages must match from the outermost
+            // loop down to the fused one. The dims are stored
+            // innermost first.
+            const vector<Dim> &parent_dims = parent_def.schedule().dims();
+            const vector<Dim> &child_dims = child_def.schedule().dims();
+            size_t parent_idx = 0, child_idx = 0;
+            while (parent_idx < parent_dims.size() && parent_dims[parent_idx].var != fuse.var) {
+                parent_idx++;
+            }
+            while (child_idx < child_dims.size() && child_dims[child_idx].var != fuse.var) {
+                child_idx++;
+            }
+            user_assert(parent_idx < parent_dims.size() && child_idx < child_dims.size() &&
+                        parent_dims.size() - parent_idx == child_dims.size() - child_idx)
+                << "Can't compute " << child_stage_name << " with " << parent_stage_name
+                << " at " << fuse.var << ", because they don't have the same loops down to "
+                << fuse.var << ".\n";
+            for (size_t j = parent_dims.size(); j > parent_idx; j--) {
+                const Dim &pd = parent_dims[j - 1];
+                const Dim &cd = child_dims[j - 1 - parent_idx + child_idx];
+                user_assert(pd.var == cd.var)
+                    << "Can't compute " << child_stage_name << " with " << parent_stage_name
+                    << " at " << fuse.var << ", because the loop over " << cd.var
+                    << " doesn't match the loop over " << pd.var << ".\n";
+                user_assert(pd.for_type == cd.for_type && pd.device_api == cd.device_api &&
+                            pd.for_type != ForType::Vectorized &&
+                            pd.device_api == DeviceAPI::None)
+                    << "Can't compute " << child_stage_name << " with " << parent_stage_name
+                    << " at " << fuse.var << ", because the loops over " << pd.var
+                    << " must be the same kind of loop, and can't be vectorized"
+                    << " or run on a device.\n";
+                // The dummy outermost loop is gone by now.
+                if (pd.var == Var::outermost().name()) {
+                    continue;
+                }
+                if (f.parent == f.child) {
+                    user_assert(only_touches_current_coordinate(child, parent_def, pd.var) &&
+                                only_touches_current_coordinate(child, child_def, pd.var))
+                        << "Can't compute " << child_stage_name << " with " << parent_stage_name
+                        << " at " << fuse.var << ". Each fused loop must be over a pure var"
+                        << " of " << f.child << " that both stages read and write"
+                        << " only at the current coordinate, and " << pd.var << " isn't.\n";
+                }
+                f.parent_loops.push_back(f.parent + ".s" + std::to_string(f.parent_stage) + "." + pd.var);
+                f.child_loops.push_back(f.child + ".s" + std::to_string(f.child_stage) + "." + cd.var);
+            }
+            result.push_back(f);
+        }
+    }
+    return result;
+}
+
+// Strip the LetStmts off the front of a loop nest, appending them to
+// 'lets', and return the loop underneath.
+const For *peel_lets(Stmt s, vector<pair<string, Expr>> &lets) {
+    while (const LetStmt *l = s.as<LetStmt>()) {
+        lets.push_back({l->name, l->value});
+        s = l->body;
+    }
+    return s.as<For>();
+}
+
+Expr and_condition(Expr a, Expr b) {
+    return is_one(a) ? b : a && b;
+}
+
+// Fuse two loop nests, from the loops at 'depth' in the list of fused
+// loops inwards. 'in_parent' and 'in_child' are the conditions under
+// which the enclosing fused loops are within the bounds of each stage.
+Stmt fuse_loop_nests(const FusedStages &f, Stmt parent, Stmt child, size_t depth,
+                     Expr in_parent, Expr in_child) {
+    if (depth == f.parent_loops.size()) {
+        return Block::make(IfThenElse::make(in_parent, parent),
+                           IfThenElse::make(in_child, child));
+    }
+
+    vector<pair<string, Expr>> lets;
+    const For *p = peel_lets(parent, lets);
+    const For *c = peel_lets(child, lets);
+
+    user_assert(p && c &&
+                p->name == f.parent_loops[depth] &&
+                c->name == f.child_loops[depth])
+        << "Can't compute " << stage_name(f.child, f.child_stage)
+        << " with " << stage_name(f.parent, f.parent_stage)
+        << ", because the loops to be fused have other statements between them.\n";
+
+    Expr p_end = p->min + p->extent;
+    Expr c_end = c->min + c->extent;
+    Expr loop_min = min(p->min, c->min);
+    Expr loop_end = max(p_end, c_end);
+    if (!is_one(in_child)) {
+        loop_min = select(in_child, loop_min, p->min);
+        loop_end = select(in_child, loop_end, p_end);
+    }
+    if (!is_one(in_parent)) {
+        loop_min = select(in_parent, loop_min, c->min);
+        loop_end = select(in_parent, loop_end, c_end);
+    }
+
+    Expr var = Variable::make(Int(32), p->name);
+    in_parent = and_condition(in_parent, var >= p->min && var < p_end);
+    in_child = and_condition(in_child, var >= c->min && var < c_end);
+
+    // The child's loop variable becomes the fused one.
+    Stmt body = fuse_loop_nests(f, p->body, LetStmt::make(c->name, var, c->body),
+                                depth + 1, in_parent, in_child);
+
+    Stmt result = For::make(p->name, loop_min, loop_end - loop_min,
+                            p->for_type, p->device_api, body);
+    for (size_t i = lets.size(); i > 0; i--) {
+        result = LetStmt::make(lets[i - 1].first, lets[i - 1].second, result);
+    }
+    return result;
+}
+
+// Fuse the loop nest of the child into the body of the parent's
+// produce node, looking through the produce nodes of stages already
+// fused into it.
+Stmt fuse_into_producer(const FusedStages &f, Stmt parent, Stmt child) {
+    if (const ProducerConsumer *pc = parent.as<ProducerConsumer>()) {
+        if (pc->is_producer) {
+            return ProducerConsumer::make_produce(pc->name, fuse_into_producer(f, pc->body, child));
+        }
+    }
+    return fuse_loop_nests(f, parent, child, 0, const_true(), const_true());
+}
+
+// Fuse consecutive stages of the same Func, which are consecutive
+// loop nests within its produce node.
+class FuseUpdates : public IRMutator2 {
+    const FusedStages &f;
+
+    using IRMutator2::visit;
+
+    bool is_stage(Stmt s, const string &loop) {
+        vector<pair<string, Expr>> lets;
+        const For *l = peel_lets(s, lets);
+        return l && l->name == loop;
+    }
+
+    Stmt visit(const ProducerConsumer *op) override {
+        if (op->is_producer && op->name == f.parent) {
+            in_producer = true;
+            Stmt s = IRMutator2::visit(op);
+            in_producer = false;
+            return s;
+        }
+        return IRMutator2::visit(op);
+    }
+
+    Stmt visit(const Block *op) override {
+        if (!in_producer || found) {
+            return IRMutator2::visit(op);
+        }
+
+        vector<Stmt> stmts;
+        Stmt rest = op;
+        while (const Block *b = rest.as<Block>()) {
+            stmts.push_back(b->first);
+            rest = b->rest;
+        }
+        stmts.push_back(rest);
+
+        for (size_t i = 0; i + 1 < stmts.size(); i++) {
+            if (is_stage(stmts[i], f.parent_loops[0]) &&
+                is_stage(stmts[i + 1], f.child_loops[0])) {
+                stmts[i] = fuse_loop_nests(f, stmts[i], stmts[i + 1], 0, const_true(), const_true());
+                stmts.erase(stmts.begin() + i + 1);
+                found = true;
+                return Block::make(stmts);
+            }
+        }
+        return IRMutator2::visit(op);
+    }
+
+    bool in_producer = false;
+
+public:
+    bool found = false;
+    FuseUpdates(const FusedStages &f) : f(f) {}
+};
+
+// Find the produce node for a func, and whether it is inside a loop
+// relative to the statement searched.
+class FindProducer : public IRVisitor {
+    const string &func;
+    int loop_depth = 0;
+
+    using IRVisitor::visit;
+
+    void visit(const For *op) override {
+        loop_depth++;
+        IRVisitor::visit(op);
+        loop_depth--;
+    }
+
+    void visit(const ProducerConsumer *op) override {
+        if (op->is_producer && op->name == func) {
+            found = true;
+            in_loop = loop_depth > 0;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+public:
+    bool found = false, in_loop = false;
+    FindProducer(const string &f) : func(f) {}
+};
+
+bool contains_producer(Stmt s, const string &func) {
+    FindProducer find(func);
+    s.accept(&find);
+    return find.found;
+}
+
+// List the produce nodes that are not inside a loop or another
+// produce node, in execution order.
+class ListProducers : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const For *op) override {}
+
+    void visit(const ProducerConsumer *op) override {
+        if (op->is_producer) {
+            names.push_back(op->name);
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+public:
+    vector<string> names;
+};
+
+// Remove the Realize nodes for the fused Funcs that are not inside a
+// loop, keeping them so they can be rewrapped around the fused
+// produce nodes.
+class RemoveRealizations : public IRMutator2 {
+    const FusedStages &f;
+
+    using IRMutator2::visit;
+
+    Stmt visit(const For *op) override {
+        return op;
+    }
+
+    Stmt visit(const Realize *op) override {
+        if (op->name == f.parent || op->name == f.child) {
+            realizations.push_back(op);
+            return mutate(op->body);
+        }
+        return IRMutator2::visit(op);
+    }
+
+public:
+    vector<const Realize *> realizations;
+    RemoveRealizations(const FusedStages &f) : f(f) {}
+};
+
+class GetProducerBody : public IRVisitor {
+    const string &func;
+
+    using IRVisitor::visit;
+
+    void visit(const ProducerConsumer *op) override {
+        if (op->is_producer && op->name == func) {
+            body = op->body;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+public:
+    Stmt body;
+    GetProducerBody(const string &f) : func(f) {}
+};
+
+// Move the produce node of the child into the produce node of the
+// parent, fusing their loop nests.
+class MoveProducer : public IRMutator2 {
+    const FusedStages &f;
+    Stmt child_body;
+
+    using IRMutator2::visit;
+
+    Stmt visit(const ProducerConsumer *op) override {
+        if (op->is_producer && op->name == f.child) {
+            return Evaluate::make(0);
+        } else if (op->is_producer && op->name == f.parent) {
+            Stmt fused = fuse_into_producer(f, op->body, child_body);
+            return ProducerConsumer::make_produce(
+                op->name, ProducerConsumer::make_produce(f.child, fused));
+        } else {
+            return IRMutator2::visit(op);
+        }
+    }
+
+public:
+    MoveProducer(const FusedStages &f, Stmt c) : f(f), child_body(c) {}
+};
+
+// Fuse the produce nodes of two different Funcs, at the innermost
+// statement that contains both of them.
+class FuseProducers : public IRMutator2 {
+    const FusedStages &f;
+    const map<string, Function> &env;
+
+    Stmt fuse(Stmt s) {
+        string child_stage_name = stage_name(f.child, f.child_stage);
+        string parent_stage_name = stage_name(f.parent, f.parent_stage);
+
+        FindProducer find_parent(f.parent), find_child(f.child);
+        s.accept(&find_parent);
+        s.accept(&find_child);
+        user_assert(!find_parent.in_loop && !find_child.in_loop)
+            << "Can't compute " << child_stage_name << " with " << parent_stage_name
+            << ". Both Funcs must be computed at the same loop level.\n";
+
+        // Moving the child's produce node past the produce nodes in
+        // between must not reorder it with respect to its producers or
+        // consumers.
+        ListProducers list;
+        s.accept(&list);
+        auto parent_it = std::find(list.names.begin(), list.names.end(), f.parent);
+        auto child_it = std::find(list.names.begin(), list.names.end(), f.child);
+        internal_assert(parent_it != list.names.end() && child_it != list.names.end());
+        const Function &child = env.find(f.child)->second;
+        map<string, Function> child_calls = find_transitive_calls(child);
+        if (child_it < parent_it) {
+            for (auto it = child_it + 1; it != parent_it; it++) {
+                const Function &g = env.find(*it)->second;
+                user_assert(!find_transitive_calls(g).count(f.child))
+                    << "Can't compute " << child_stage_name << " with " << parent_stage_name
+                    << ", because " << *it << ", which is computed between them, uses "
+                    << f.child << ".\n";
+            }
+        } else {
+            for (auto it = parent_it + 1; it != child_it; it++) {
+                user_assert(!child_calls.count(*it))
+                    << "Can't compute " << child_stage_name << " with " << parent_stage_name
+                    << ", because " << f.child << " uses " << *it
+                    << ", which is computed between them.\n";
+            }
+        }
+
+        // Grab the child's loop nest before removing its produce node.
+        GetProducerBody get_child(f.child);
+        s.accept(&get_child);
+
+        // The storage for both Funcs must now cover both of their
+        // consumers, so hoist their realizations out to here.
+        RemoveRealizations remove(f);
+        s = remove.mutate(s);
+        s = MoveProducer(f, get_child.body).mutate(s);
+        for (const Realize *r : remove.realizations) {
+            s = Realize::make(r->name, r->types, r->bounds, r->condition, s);
+        }
+        return s;
+    }
+
+public:
+    Expr mutate(const Expr &e) override {
+        return e;
+    }
+
+    Stmt mutate(const Stmt &s) override {
+        if (done || !s.defined() ||
+            !contains_producer(s, f.parent) ||
+            !contains_producer(s, f.child)) {
+            return s;
+        }
+        // Look for a smaller statement that contains both.
+        Stmt result = IRMutator2::mutate(s);
+        if (done) {
+            return result;
+        }
+        done = true;
+        return fuse(s);
+    }
+
+    bool done = false;
+    FuseProducers(const FusedStages &f, const map<string, Function> &env) : f(f), env(env) {}
+};
+
+}  // namespace
+
+Stmt fuse_stages(Stmt s, const map<string, Function> &env) {
+    for (const FusedStages &f : find_fused_stages(env)) {
+        if (f.parent == f.child) {
+            if (f.parent_loops.empty()) {
+                // The stages already run one after the other.
+                continue;
+            }
+            FuseUpdates fuse(f);
+            s = fuse.mutate(s);
+            user_assert(fuse.found)
+                << "Can't compute " << stage_name(f.child, f.child_stage)
+                << " with " << stage_name(f.parent, f.parent_stage)
+                << ", because their loop nests are not next to each other.\n";
+        } else {
+            FuseProducers fuse(f, env);
+            s = fuse.mutate(s);
+            user_assert(fuse.done)
+                << "Can't compute " << stage_name(f.child, f.child_stage)
+                << " with " << stage_name(f.parent, f.parent_stage)
+                << ", because they are not both used in the same loop nest.\n";
+        }
+    }
+    return s;
+}
+
+}
+}
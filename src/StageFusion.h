@@ -0,0 +1,28 @@
+#ifndef HALIDE_STAGE_FUSION_H
+#define HALIDE_STAGE_FUSION_H
+
+/** \file
+ * Defines the lowering pass that fuses the loop nests of stages
+ * scheduled with compute_with.
+ */
+
+#include <map>
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Merge the loop nest of each stage scheduled with compute_with into
+ * the loop nest of the stage it is computed with, down to the fused
+ * loop level. The fused loops run over the union of the bounds of
+ * both stages, and each stage's body is guarded by its own
+ * bounds. Should run after bounds inference, so that the loop bounds
+ * of each stage are known, and before sliding window and storage
+ * folding, which rely on the order of the produce nodes. */
+Stmt fuse_stages(Stmt s, const std::map<std::string, Function> &env);
+
+}
+}
+
+#endif
@@ -1,6 +1,7 @@
 #include "StmtToHtml.h"
 #include "IRVisitor.h"
 #include "IROperator.h"
+#include "IRPrinter.h"
 #include "Scope.h"
 
 #include <iterator>
@@ -426,6 +427,9 @@ private:
             print(op->extents[i]);
         }
         stream << matched("]");
+        if (op->memory_type != MemoryType::Auto) {
+            stream << " " << keyword("in") << " " << op->memory_type;
+        }
         if (!is_one(op->condition)) {
             stream << " " << keyword("if") << " ";
             print(op->condition);
@@ -496,6 +500,22 @@ private:
         stream << close_span();
     }
 
+    void visit(const Atomic *op) {
+        stream << open_div("Atomic");
+        int id = unique_id();
+        stream << open_span("Matched");
+        stream << open_expand_button(id);
+        stream << keyword("atomic") << " ";
+        stream << var(op->producer_name);
+        stream << close_expand_button() << " {";
+        stream << close_span();
+        stream << open_div("AtomicBody Indent", id);
+        print(op->body);
+        stream << close_div();
+        stream << matched("}");
+        stream << close_div();
+    }
+
     // To avoid generating ridiculously deep DOMs, we flatten blocks here.
     void visit_block_stmt(Stmt stmt) {
         if (const Block *b = stmt.as<Block>()) {
@@ -589,6 +609,15 @@ private:
         stream << close_span();
     }
 
+    void visit(const VectorReduce *op) {
+        stream << open_span("VectorReduce");
+        stream << open_span("Type") << op->type << close_span();
+        std::ostringstream op_name;
+        op_name << op->op;
+        print_list(symbol("vector_reduce") + "(" + op_name.str() + ", ", {op->value}, ")");
+        stream << close_span();
+    }
+
 public:
     void print(Expr ir) {
         ir.accept(this);
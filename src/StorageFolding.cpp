@@ -444,7 +444,7 @@ class AttemptStorageFoldingOfFunction : public IRMutator {
                             }
                             Stmt init_min = Store::make(dynamic_footprint, init_val, 0, Parameter(), const_true());
                             stmt = Block::make(init_min, stmt);
-                            stmt = Allocate::make(dynamic_footprint, Int(32), {}, const_true(), stmt);
+                            stmt = Allocate::make(dynamic_footprint, Int(32), MemoryType::Stack, {}, const_true(), stmt);
                         }
                         return;
                     } else {
@@ -498,6 +498,23 @@ class StorageFolding : public IRMutator {
         auto func_it = env.find(op->name);
         Function func = func_it != env.end() ? func_it->second : Function();
 
+        // The producer of an async func runs ahead of its consumer
+        // without waiting for it, so it may not wrap around and
+        // overwrite values the consumer hasn't read yet.
+        if (func_it != env.end() && func.schedule().async()) {
+            for (const StorageDim &d : func.schedule().storage_dims()) {
+                user_assert(!d.fold_factor.defined())
+                    << "Can't fold the storage of Func " << func.name()
+                    << " because it is scheduled to be computed asynchronously.\n";
+            }
+            if (body.same_as(op->body)) {
+                stmt = op;
+            } else {
+                stmt = Realize::make(op->name, op->types, op->bounds, op->condition, body);
+            }
+            return;
+        }
+
         // Don't attempt automatic storage folding if there is
         // more than one produce node for this func.
         bool explicit_only = count_producers(body, op->name) != 1;
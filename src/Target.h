@@ -82,6 +82,8 @@ struct Target {
         AVX512_KNL = halide_target_feature_avx512_knl,
         AVX512_Skylake = halide_target_feature_avx512_skylake,
         AVX512_Cannonlake = halide_target_feature_avx512_cannonlake,
+        AVX512_Cascadelake = halide_target_feature_avx512_cascadelake,
+        ARMDotProd = halide_target_feature_arm_dot_prod,
         TraceLoads = halide_target_feature_trace_loads,
         TraceStores = halide_target_feature_trace_stores,
         TraceRealizations = halide_target_feature_trace_realizations,
@@ -256,13 +258,15 @@ struct Target {
             }
         } else if (arch == Target::X86) {
             if (is_integer && (has_feature(Halide::Target::AVX512_Skylake) ||
-                               has_feature(Halide::Target::AVX512_Cannonlake))) {
-                // AVX512BW exists on Skylake and Cannonlake
+                               has_feature(Halide::Target::AVX512_Cannonlake) ||
+                               has_feature(Halide::Target::AVX512_Cascadelake))) {
+                // AVX512BW exists on Skylake, Cannonlake and Cascade Lake
                 return 64 / data_size;
             } else if (t.is_float() && (has_feature(Halide::Target::AVX512) ||
                                         has_feature(Halide::Target::AVX512_KNL) ||
                                         has_feature(Halide::Target::AVX512_Skylake) ||
-                                        has_feature(Halide::Target::AVX512_Cannonlake))) {
+                                        has_feature(Halide::Target::AVX512_Cannonlake) ||
+                                        has_feature(Halide::Target::AVX512_Cascadelake))) {
                 // AVX512F is on all AVX512 architectures
                 return 64 / data_size;
             } else if (has_feature(Halide::Target::AVX2)) {
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <set>
 
 #include "VectorizeLoops.h"
 #include "IRMutator.h"
@@ -343,6 +344,81 @@ public:
     }
 };
 
+// Check if an expression loads from a given buffer.
+class LoadsFrom : public IRVisitor {
+    using IRVisitor::visit;
+
+    const string &name;
+
+    void visit(const Load *op) {
+        if (op->name == name) {
+            result = true;
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    bool result = false;
+    LoadsFrom(const string &n) : name(n) {}
+};
+
+// Check if a store combines the value already at the stored location
+// with something else, using an associative operator that has a
+// vector reduction. If so, return the load of the old value, the
+// something else, and the operator.
+bool match_reduction(const Store *store, Expr &old_value, Expr &rest,
+                            VectorReduce::Operator &reduce_op) {
+    Expr a, b;
+    if (const Add *op = store->value.as<Add>()) {
+        a = op->a;
+        b = op->b;
+        reduce_op = VectorReduce::Add;
+    } else if (const Mul *op = store->value.as<Mul>()) {
+        a = op->a;
+        b = op->b;
+        reduce_op = VectorReduce::Mul;
+    } else if (const Min *op = store->value.as<Min>()) {
+        a = op->a;
+        b = op->b;
+        reduce_op = VectorReduce::Min;
+    } else if (const Max *op = store->value.as<Max>()) {
+        a = op->a;
+        b = op->b;
+        reduce_op = VectorReduce::Max;
+    } else if (const And *op = store->value.as<And>()) {
+        a = op->a;
+        b = op->b;
+        reduce_op = VectorReduce::And;
+    } else if (const Or *op = store->value.as<Or>()) {
+        a = op->a;
+        b = op->b;
+        reduce_op = VectorReduce::Or;
+    } else {
+        return false;
+    }
+
+    const Load *load = b.as<Load>();
+    if (load && load->name == store->name) {
+        std::swap(a, b);
+    }
+    load = a.as<Load>();
+    if (!load || load->name != store->name || !equal(load->index, store->index)) {
+        return false;
+    }
+
+    // The rest must not depend on the old value, or on any other
+    // value of the buffer.
+    LoadsFrom loads(store->name);
+    b.accept(&loads);
+    if (loads.result) {
+        return false;
+    }
+
+    old_value = a;
+    rest = b;
+    return true;
+}
+
 // Substitutes a vector for a scalar var in a Stmt. Used on the
 // body of every vectorized loop.
 class VectorSubs : public IRMutator2 {
@@ -367,6 +443,9 @@ class VectorSubs : public IRMutator2 {
     // version of them if we scalarize inner code.
     vector<pair<string, Expr>> containing_lets;
 
+    // Containing lets that inner code needs done one lane at a time.
+    std::set<string> lets_to_scalarize;
+
     // Widen an expression to the given number of lanes.
     Expr widen(Expr e, int lanes) {
         if (e.type().lanes() == lanes) {
@@ -565,6 +644,10 @@ class VectorSubs : public IRMutator2 {
             containing_lets.pop_back();
             scope.pop(op->name);
 
+            if (lets_to_scalarize.erase(op->name)) {
+                return scalarize(op);
+            }
+
             // Inner code might have extracted my lanes using
             // extract_lane, which introduces a shuffle_vector. If
             // so we should define separate lets for the lanes and
@@ -645,24 +728,101 @@ class VectorSubs : public IRMutator2 {
         }
     }
 
+    // A store to a location that doesn't depend on the vectorized var,
+    // which combines the old value with the rest using an associative
+    // operator, is a horizontal reduction of the lanes of the rest into
+    // that location. Returns an undefined Stmt if the store isn't one.
+    Stmt reduce_across_lanes(const Store *op, Expr index, Expr predicate) {
+        Expr old_value, rest;
+        VectorReduce::Operator reduce_op;
+        if (!index.type().is_scalar() ||
+            !predicate.type().is_scalar() ||
+            !match_reduction(op, old_value, rest, reduce_op)) {
+            return Stmt();
+        }
+        Expr new_rest = mutate(rest);
+        if (!new_rest.type().is_vector()) {
+            return Stmt();
+        }
+        Expr value = vector_reduce_binop(reduce_op, mutate(old_value),
+                                         VectorReduce::make(reduce_op, new_rest, 1));
+        return Store::make(op->name, value, index, op->param, predicate);
+    }
+
     Stmt visit(const Store *op) override {
         Expr predicate = mutate(op->predicate);
-        Expr value = mutate(op->value);
         Expr index = mutate(op->index);
 
+        Stmt reduced = reduce_across_lanes(op, index, predicate);
+        if (reduced.defined()) {
+            return reduced;
+        }
+
+        Expr value = mutate(op->value);
+
         if (predicate.same_as(op->predicate) && value.same_as(op->value) && index.same_as(op->index)) {
             return op;
-        } else {
-            int lanes = std::max(predicate.type().lanes(), std::max(value.type().lanes(), index.type().lanes()));
-            return Store::make(op->name, widen(value, lanes), widen(index, lanes),
-                               op->param, widen(predicate, lanes));
+        } else if (index.type().is_scalar() && value.type().is_vector()) {
+            // Every lane stores to the same place. If the value reads
+            // from it, each lane must see what the lane before it
+            // stored, so do them one at a time.
+            LoadsFrom loads(op->name);
+            op->value.accept(&loads);
+            if (loads.result) {
+                return scalarize(op);
+            }
+
+            // The value may read it through an enclosing let instead,
+            // as the values of a Tuple update do. All lanes of the let
+            // are computed before any lane stores, so the whole let
+            // must be done one lane at a time.
+            Expr value_with_lets = op->value;
+            string let_to_scalarize;
+            for (size_t i = containing_lets.size(); i > 0; i--) {
+                const auto &l = containing_lets[i-1];
+                if (expr_uses_var(value_with_lets, l.first)) {
+                    value_with_lets = Let::make(l.first, l.second, value_with_lets);
+                    LoadsFrom let_loads(op->name);
+                    l.second.accept(&let_loads);
+                    if (let_loads.result) {
+                        let_to_scalarize = l.first;
+                    }
+                }
+            }
+            if (!let_to_scalarize.empty()) {
+                lets_to_scalarize.insert(let_to_scalarize);
+                return op;
+            }
         }
+        int lanes = std::max(predicate.type().lanes(), std::max(value.type().lanes(), index.type().lanes()));
+        return Store::make(op->name, widen(value, lanes), widen(index, lanes),
+                           op->param, widen(predicate, lanes));
     }
 
     Stmt visit(const AssertStmt *op) override {
         return (op->condition.type().lanes() > 1) ? scalarize(op) : op;
     }
 
+    Stmt visit(const Atomic *op) override {
+        if (const Store *store = op->body.as<Store>()) {
+            Stmt reduced = reduce_across_lanes(store, mutate(store->index), mutate(store->predicate));
+            if (reduced.defined()) {
+                // The old value is loaded and updated once per vector,
+                // but other threads may still update the same
+                // location, so it remains atomic.
+                return Atomic::make(op->producer_name, reduced);
+            }
+        }
+
+        // Otherwise several lanes of a vectorized atomic store may
+        // update the same location, so do them one at a time.
+        Stmt body = mutate(op->body);
+        if (body.same_as(op->body)) {
+            return op;
+        }
+        return scalarize(op);
+    }
+
     Stmt visit(const IfThenElse *op) override {
         Expr cond = mutate(op->condition);
         int lanes = cond.type().lanes();
@@ -845,7 +1005,7 @@ class VectorSubs : public IRMutator2 {
         // The variable itself could still exist inside an inner scalarized block.
         body = substitute(v, Variable::make(Int(32), var), body);
 
-        return Allocate::make(op->name, op->type, new_extents, op->condition, body, new_expr, op->free_function);
+        return Allocate::make(op->name, op->type, op->memory_type, new_extents, op->condition, body, new_expr, op->free_function);
     }
 
     Stmt scalarize(Stmt s) {
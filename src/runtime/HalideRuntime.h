@@ -152,6 +152,23 @@ extern int halide_default_do_task(void *user_context, halide_task_t f, int idx,
                                   uint8_t *closure);
 // @}
 
+/** A counting semaphore, used to synchronize the producer of a Func
+ * scheduled with async with its consumer. These are allocated on the
+ * stack by the generated code, and must be initialized with zero,
+ * which is a count of zero. halide_semaphore_acquire blocks until the
+ * count is at least n, and then decrements it by n. Both return
+ * zero. The default thread pool starts the tasks of a parallel loop in
+ * order, which the generated code relies upon to never wait on a task
+ * that hasn't started yet; custom implementations of
+ * halide_do_par_for must do the same to use async. */
+// @{
+struct halide_semaphore_t {
+    uint64_t _private[2];
+};
+extern int halide_semaphore_release(struct halide_semaphore_t *, int n);
+extern int halide_semaphore_acquire(struct halide_semaphore_t *, int n);
+// @}
+
 struct halide_thread;
 
 /** Spawn a thread. Returns a handle to the thread for the purposes of
@@ -180,6 +197,81 @@ extern void halide_join_thread(struct halide_thread *);
  */
 extern int halide_set_num_threads(int n);
 
+/** Turn NUMA-aware placement of thread pool workers on or off. When
+ * on, each worker is pinned to its own core, with consecutive
+ * workers on the same NUMA node. Turning it off restores the CPUs
+ * the process was originally allowed to run on.
+ *
+ * Placement only affects which iterations run where under the
+ * work-stealing scheduler (see halide_set_thread_pool_scheduler),
+ * where each worker starts each parallel loop on the same contiguous
+ * block of iterations every time, so the rows of an output are
+ * computed on the node that first touched them. The shared queue
+ * hands out iterations to whichever worker asks first, so with it
+ * workers are still pinned but there is no locality benefit.
+ *
+ * Defaults to the value of the HL_NUMA_PLACEMENT environment
+ * variable, or off. Returns the old setting, or -1 if placement was
+ * requested but the topology of the host can't be queried, in which
+ * case placement stays off. Supported on Linux and Windows; a no-op
+ * elsewhere.
+ */
+extern int halide_set_numa_placement(int enabled);
+
+/** The scheduling strategies available in the default thread pool. */
+typedef enum halide_thread_pool_scheduler_t {
+    /** Use the HL_THREAD_POOL_SCHEDULER environment variable if set
+     * to "work_stealing", otherwise use the shared queue. */
+    halide_thread_pool_scheduler_default = 0,
+    /** All jobs live on one queue, and workers claim one task index
+     * at a time while holding the queue lock. */
+    halide_thread_pool_scheduler_shared_queue = 1,
+    /** The range of each parallel loop is split across per-worker
+     * deques. Workers claim indices from their own deque without
+     * locking, and steal half of another worker's remaining range
+     * when their own deque runs dry. */
+    halide_thread_pool_scheduler_work_stealing = 2
+} halide_thread_pool_scheduler_t;
+
+/** Select the scheduler used by the default thread pool for
+ * subsequent calls to halide_do_par_for. Returns the old
+ * scheduler. Parallel loops already in flight are unaffected. As with
+ * halide_set_num_threads, custom implementations of
+ * halide_do_par_for may ignore this. */
+extern int halide_set_thread_pool_scheduler(int scheduler);
+
+/** Set how many times an idle worker in the default thread pool
+ * polls for new work before going to sleep. Spinning lets
+ * back-to-back parallel loops start without waking threads through
+ * the OS, at the cost of burning CPU while idle. Defaults to the
+ * value of the HL_THREAD_POOL_SPIN_COUNT environment variable, or
+ * zero. Returns the old value. */
+extern int halide_set_thread_pool_spin_count(int spin_count);
+
+/** Counters describing how the workers in the default thread pool
+ * have waited for work. */
+struct halide_thread_pool_stats_t {
+    /** The number of times an idle worker spun waiting for work, and
+     * the number of those times it found work before giving up. */
+    uint64_t spins, spins_found_work;
+
+    /** The number of times a thread went to sleep on a condition
+     * variable waiting for work (or for its job to finish), and the
+     * number of times it woke up again. */
+    uint64_t sleeps, wakeups;
+
+    /** The number of times a new job had to wake up sleeping
+     * workers. */
+    uint64_t broadcasts;
+};
+
+/** Read back or reset the thread pool counters. Always zero for thread
+ * pools other than the default one. */
+// @{
+extern void halide_thread_pool_get_stats(struct halide_thread_pool_stats_t *stats);
+extern void halide_thread_pool_reset_stats();
+// @}
+
 /** Halide calls these functions to allocate and free memory. To
  * replace in AOT code, use the halide_set_custom_malloc and
  * halide_set_custom_free, or (on platforms that support weak
@@ -208,6 +300,20 @@ extern halide_malloc_t halide_set_custom_malloc(halide_malloc_t user_malloc);
 extern halide_free_t halide_set_custom_free(halide_free_t user_free);
 //@}
 
+/** The default allocator can keep freed blocks on per-size-class free
+ * lists and reuse them for later allocations of similar size, which
+ * helps pipelines that are run many times and allocate the same
+ * intermediates each time. This sets the maximum number of bytes it
+ * may hold on to, and returns the old maximum. Zero (the default,
+ * unless the HL_ALLOCATOR_POOL_SIZE environment variable is set)
+ * disables pooling. Only supported by the POSIX allocator; custom
+ * allocators are unaffected. */
+extern int64_t halide_set_allocator_pool_size(int64_t size);
+
+/** Return all blocks held by the default allocator's pool to the
+ * system. */
+extern void halide_allocator_pool_trim();
+
 /** Halide calls these functions to interact with the underlying
  * system runtime functions. To replace in AOT code on platforms that
  * support weak linking, define these functions yourself, or use
@@ -380,7 +486,10 @@ struct halide_trace_event_t {
  * HL_TRACE_FILE is defined, dumps the trace to that file in a
  * sequence of trace packets. The header for a trace packet is defined
  * below. If the trace is going to be large, you may want to make the
- * file a named pipe, and then read from that pipe into gzip.
+ * file a named pipe, and then read from that pipe into gzip, or set
+ * HL_TRACE_FORMAT=compressed to have the packets written as compressed
+ * blocks (see src/runtime/tracing.cpp for the format, and
+ * util/HalideTraceUtils.cpp for a reader).
  *
  * halide_trace returns a unique ID which will be passed to future
  * events that "belong" to the earlier event as the parent id. The
@@ -651,6 +760,74 @@ extern int halide_get_gpu_device(void *user_context);
  */
 extern void halide_memoization_cache_set_size(int64_t size);
 
+/** Give memoized Funcs their own cache budget, separate from the one
+ *  set by halide_memoization_cache_set_size. The name may be either
+ *  that of a memoized Func, or that of the pipeline (the top-level
+ *  Func) it belongs to. Entries for Funcs that match no partition
+ *  share the default budget. Calling this again with the same name
+ *  changes the budget. A size of zero restores the default size.
+ *  Returns nonzero if the partition could not be created.
+ */
+extern int halide_memoization_cache_set_partition_size(const char *name, int64_t size);
+
+/** Per-partition statistics for the memoization cache. */
+struct halide_memoization_cache_stats_t {
+    /** The partition name, or NULL for the default partition. */
+    const char *partition;
+
+    /** The budget, and the number of bytes currently cached. */
+    int64_t max_size;
+    uint64_t bytes_resident;
+
+    /** The number of lookups that found a cached result, and the
+     * number that had to compute it. */
+    uint64_t hits, misses;
+
+    /** The number of computed results stored in the cache, and the
+     * average time they took to compute (from the lookup miss to the
+     * store). */
+    uint64_t stores, average_cost_ns;
+
+    /** The number of entries evicted, and the average time they spent
+     * in the cache before being evicted. */
+    uint64_t evictions, average_lifetime_ns;
+
+    /** The number of computed results the TinyLFU policy declined to
+     * cache. */
+    uint64_t rejections;
+};
+
+/** Read back the statistics for a cache partition. Index zero is the
+ *  default partition, and the named partitions follow in the order
+ *  they were created. Returns nonzero if there is no partition with
+ *  that index. */
+extern int halide_memoization_cache_get_stats(int index, struct halide_memoization_cache_stats_t *stats);
+
+/** Zero the hit, miss, store, and eviction counts of all cache
+ * partitions. */
+extern void halide_memoization_cache_reset_stats();
+
+/** The policies the memoization cache can use to decide what to evict
+ *  when it is over budget. */
+typedef enum halide_memoization_cache_eviction_policy_t {
+    /** Evict the least recently used entry. */
+    halide_memoization_cache_evict_lru = 0,
+    /** GreedyDual-Size: evict the entry that took the least time to
+     * compute per byte it occupies, aging entries that go unused so
+     * that expensive entries do not stay forever. */
+    halide_memoization_cache_evict_greedy_dual_size = 1,
+    /** Evict least recently used entries, but only cache a new result
+     * if its key has been looked up more often than that of the entry
+     * it would displace, so that one-off results do not flush ones
+     * that are reused. Lookup frequencies are estimated with a small
+     * sketch per cache shard. */
+    halide_memoization_cache_evict_tinylfu = 2
+} halide_memoization_cache_eviction_policy_t;
+
+/** Select the eviction policy of the memoization cache. Returns the
+ *  old policy. Unknown policies are ignored. */
+extern int halide_memoization_cache_set_eviction_policy(int policy);
+
 /** Given a cache key for a memoized result, currently constructed
  *  from the Func name and top-level Func name plus the arguments of
  *  the computation, determine if the result is in the cache and
@@ -667,11 +844,24 @@ extern void halide_memoization_cache_set_size(int64_t size);
  * -1: Signals an error.
  *  0: Success and cache hit.
  *  1: Success and cache miss.
+ *
+ * This looks in the default cache partition. Memoized Funcs call
+ * halide_memoization_cache_lookup_partitioned instead.
  */
 extern int halide_memoization_cache_lookup(void *user_context, const uint8_t *cache_key, int32_t size,
                                            struct halide_buffer_t *realized_bounds,
                                            int32_t tuple_count, struct halide_buffer_t **tuple_buffers);
 
+/** Like halide_memoization_cache_lookup, but the names of the
+ *  pipeline and of the memoized Func select the cache partition (see
+ *  halide_memoization_cache_set_partition_size). Either name may be
+ *  NULL. The partition is recorded with the returned storage, so
+ *  halide_memoization_cache_store does not need them. */
+extern int halide_memoization_cache_lookup_partitioned(void *user_context, const uint8_t *cache_key, int32_t size,
+                                                       struct halide_buffer_t *realized_bounds,
+                                                       int32_t tuple_count, struct halide_buffer_t **tuple_buffers,
+                                                       const char *pipeline_name, const char *func_name);
+
 /** Given a cache key for a memoized result, currently constructed
  *  from the Func name and top-level Func name plus the arguments of
  *  the computation, store the result in the cache for futre access by
@@ -710,6 +900,8 @@ extern void halide_memoization_cache_release(void *user_context, void *host);
 
 /** Free all memory and resources associated with the memoization cache.
  * Must be called at a time when no other threads are accessing the cache.
+ * Partitions created with halide_memoization_cache_set_partition_size
+ * are emptied but keep their budgets.
  */
 extern void halide_memoization_cache_cleanup();
 
@@ -1071,7 +1263,9 @@ typedef enum halide_target_feature_t {
     halide_target_feature_cuda_capability61 = 46,  ///< Enable CUDA compute capability 6.1 (Pascal)
     halide_target_feature_hvx_v65 = 47, ///< Enable Hexagon v65 architecture.
     halide_target_feature_hvx_v66 = 48, ///< Enable Hexagon v66 architecture.
-    halide_target_feature_end = 49, ///< A sentinel. Every target is considered to have this feature, and setting this feature does nothing.
+    halide_target_feature_avx512_cascadelake = 49, ///< Enable the AVX512 features supported by Cascade Lake Xeon server processors. This includes all of the Skylake features, plus AVX512-VNNI.
+    halide_target_feature_arm_dot_prod = 50, ///< Enable the ARMv8.2 dot product instructions (udot and sdot) on 64-bit ARM.
+    halide_target_feature_end = 51, ///< A sentinel. Every target is considered to have this feature, and setting this feature does nothing.
 } halide_target_feature_t;
 
 /** This function is called internally by Halide in some situations to determine
@@ -1412,6 +1606,20 @@ struct halide_filter_metadata_t {
  * the -profile target flag, which runs a sampling profiler thread
  * alongside the pipeline. */
 
+/** The number of hardware performance counters the profiler can
+ * collect. See halide_profiler_counter below. */
+#define HALIDE_PROFILER_NUM_COUNTERS 4
+
+/** The hardware performance counters the profiler collects when the
+ * environment variable HL_PROFILER_COUNTERS is set. Only supported on
+ * x86 Linux. Used as indices into the counters arrays below. */
+enum halide_profiler_counter {
+    halide_profiler_cycles = 0,
+    halide_profiler_instructions = 1,
+    halide_profiler_llc_misses = 2,
+    halide_profiler_branch_misses = 3
+};
+
 /** Per-Func state tracked by the sampling profiler. */
 struct halide_profiler_func_stats {
     /** Total time taken evaluating this Func (in nanoseconds). */
@@ -1437,6 +1645,16 @@ struct halide_profiler_func_stats {
 
     /** The total number of memory allocation of this Func. */
     int num_allocs;
+
+    /** Total CPU time spent evaluating this Func across all threads
+     * (in nanoseconds). Where the time field splits each sample
+     * between the Funcs running at the time, this bills the whole
+     * sample to every thread's Func. */
+    uint64_t cpu_time;
+
+    /** Hardware performance counter totals of the threads computing
+     * this Func, indexed by halide_profiler_counter. */
+    uint64_t counters[HALIDE_PROFILER_NUM_COUNTERS];
 };
 
 /** Per-pipeline state tracked by the sampling profiler. These exist
@@ -1482,6 +1700,42 @@ struct halide_profiler_pipeline_stats {
 
     /** The total number of memory allocation of funcs in this pipeline. */
     int num_allocs;
+
+    /** Total CPU time spent inside this pipeline across all threads
+     * (in nanoseconds). */
+    uint64_t cpu_time;
+
+    /** Hardware performance counter totals inside this pipeline,
+     * indexed by halide_profiler_counter. */
+    uint64_t counters[HALIDE_PROFILER_NUM_COUNTERS];
+
+    /** The number of runs of this pipeline in progress, and when the
+     * earliest of them started. Only tracked for the timeline written
+     * by halide_profiler_report_timeline, where overlapping runs show
+     * up as one span. */
+    int runs_in_progress;
+    uint64_t run_start;
+};
+
+/** The number of threads that can have their own current Func
+ * tracked by the profiler at once. Tasks of parallel loops run on
+ * threads beyond this are not sampled. */
+#define HALIDE_PROFILER_MAX_THREAD_SLOTS 128
+
+/** The current Func of one thread running tasks of parallel loops,
+ * padded to a cache line so that threads don't contend. */
+struct halide_profiler_thread_slot {
+    /** The id of the Func the thread is computing. */
+    int current_func;
+
+    /** Whether a thread has claimed this slot. */
+    int in_use;
+
+    /** The OS id of the thread that claimed this slot, if hardware
+     * performance counters are being collected. */
+    int thread_id;
+
+    int padding[13];
 };
 
 /** The global state of the profiler. */
@@ -1515,6 +1769,23 @@ struct halide_profiler_state {
 
     /** Is the profiler thread running. */
     bool started;
+
+    /** Per-thread current Funcs. The code for each task of a parallel
+     * loop claims a slot, and reports which Func it is computing
+     * there rather than in current_func, so that every thread's time
+     * is billed to the right Func. */
+    struct halide_profiler_thread_slot thread_slots[HALIDE_PROFILER_MAX_THREAD_SLOTS];
+
+    /** Written to by tasks that could not claim a slot. Never read. */
+    int unattributed_func;
+
+    /** The OS id of the thread that launched the running pipeline, if
+     * hardware performance counters are being collected. */
+    int main_thread_id;
+
+    /** A bitmask of the halide_profiler_counter values that could be
+     * collected on at least one thread. */
+    int counters_available;
 };
 
 /** Profiler func ids with special meanings. */
@@ -1524,7 +1795,11 @@ enum {
     /// Set current_func to this value to tell the profiling thread to
     /// halt. It will start up again next time you run a pipeline with
     /// profiling enabled.
-    halide_profiler_please_stop = -2
+    halide_profiler_please_stop = -2,
+    /// A thread's current func takes on this value while it waits for
+    /// the tasks of a parallel loop it launched, which are billed in
+    /// their own slots.
+    halide_profiler_waiting = -3
 };
 
 /** Get a pointer to the global profiler state for programmatic
@@ -1546,6 +1821,23 @@ extern void halide_profiler_reset();
  * reset. Also happens at process exit. */
 extern void halide_profiler_report(void *user_context);
 
+/** Write the same statistics as halide_profiler_report to the named
+ * file as JSON, with one object per pipeline holding its totals and a
+ * list of its Funcs. Times are in nanoseconds and memory in bytes.
+ * Also happens at process exit if the environment variable
+ * HL_PROFILER_JSON names a file. Returns zero on success. */
+extern int halide_profiler_report_json(void *user_context, const char *filename);
+
+/** Write the start and end of every pipeline run, and of every span
+ * of time a thread spent in one Func, to the named file in Chrome's
+ * trace event format (viewable in chrome://tracing). Spans are only
+ * recorded if the environment variable HL_PROFILER_TIMELINE was set
+ * when the first pipeline started, and are written to the file it
+ * names at process exit. The boundaries of Func spans are found by
+ * the sampling thread, so they are only as precise as the sampling
+ * interval. Returns zero on success. */
+extern int halide_profiler_report_timeline(void *user_context, const char *filename);
+
 /// \name "Float16" functions
 /// These functions operate of bits (``uint16_t``) representing a half
 /// precision floating point number (IEEE-754 2008 binary16).
@@ -1,4 +1,5 @@
 #include "HalideRuntime.h"
+#include "runtime_internal.h"
 
 extern "C" {
 
@@ -9,4 +10,13 @@ WEAK int halide_host_cpu_count() {
     return sysconf(97);
 }
 
+// NUMA-aware placement isn't supported on Android.
+WEAK int halide_host_cpus_by_numa_node(int *cpus, int max_cpus) {
+    return 0;
+}
+
+WEAK int halide_pin_current_thread_to_cpu(int cpu) {
+    return -1;
+}
+
 }
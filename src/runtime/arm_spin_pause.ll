@@ -0,0 +1,6 @@
+; Hint to the processor that the thread pool is spin-waiting. The
+; yield hint exists on both ARMv7 and AArch64.
+define weak_odr void @spin_pause_halide() nounwind {
+  call void asm sideeffect "yield", "~{memory}"()
+  ret void
+}
@@ -65,6 +65,8 @@ WEAK bool buffer_has_shape(const halide_buffer_t *buf, const halide_dimension_t
     return true;
 }
 
+struct CachePartition;
+
 struct CacheEntry {
     CacheEntry *next;
     CacheEntry *more_recent;
@@ -80,6 +82,13 @@ struct CacheEntry {
     halide_dimension_t *computed_bounds;
     // The actual stored data.
     halide_buffer_t *buf;
+    // The partition this entry is accounted to, and when it was stored.
+    CachePartition *partition;
+    int64_t created_ns;
+    // How long the entry took to compute, and its GreedyDual-Size
+    // priority. Entries with the lowest priority are evicted first.
+    uint64_t cost_ns;
+    uint64_t priority;
 
     bool init(const uint8_t *cache_key, size_t cache_key_size,
               uint32_t key_hash,
@@ -92,14 +101,19 @@ struct CacheEntry {
 
 struct CacheBlockHeader {
     CacheEntry *entry;
+    CachePartition *partition;
+    // When the lookup missed, to measure how long the result took to
+    // compute.
+    int64_t miss_ns;
     uint32_t hash;
 };
 
 // Each host block has extra space to store a header just before the
 // contents. This block must respect the same alignment as
 // halide_malloc, because it offsets the return value from
-// halide_malloc. The header holds the cache key hash and pointer to
-// the hash entry.
+// halide_malloc. The header holds the cache key hash, the time of the
+// lookup miss, and pointers to the hash entry and the partition it
+// belongs in.
 WEAK __attribute((always_inline)) size_t header_bytes() {
     size_t s = sizeof(CacheBlockHeader);
     size_t mask = halide_malloc_alignment() - 1;
@@ -177,56 +191,197 @@ WEAK void CacheEntry::destroy() {
     halide_free(NULL, metadata_storage);
 }
 
-WEAK uint32_t djb_hash(const uint8_t *key, size_t key_size)  {
-    uint32_t h = 5381;
-    for (size_t i = 0; i < key_size; i++) {
-      h = (h << 5) + h + key[i];
-    }
-    return h;
+// Hash the key a word at a time, using the mixing steps of
+// MurmurHash64A. Keys are mostly made of pointers and 32-bit scalars,
+// so hashing bytes one at a time is needlessly slow.
+WEAK uint32_t hash_key(const uint8_t *key, size_t key_size) {
+    const uint64_t m = UINT64_C(0xc6a4a7935bd1e995);
+    const int r = 47;
+    uint64_t h = UINT64_C(0x8445d61a4e774912) ^ (key_size * m);
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= key_size; i += sizeof(uint64_t)) {
+        uint64_t k;
+        memcpy(&k, key + i, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    if (i < key_size) {
+        uint64_t k = 0;
+        memcpy(&k, key + i, key_size - i);
+        h ^= k;
+        h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return (uint32_t)(h ^ (h >> 32));
 }
 
+// Each cache partition is split into independent shards, selected
+// by the top bits of the key hash, so that threads looking up
+// different keys rarely contend. Each shard has its own lock, LRU
+// list, and hash table, which grows as entries are added. The size
+// budget of a partition is shared by all its shards.
+const int kCacheShardBits = 4;
+const int kNumCacheShards = 1 << kCacheShardBits;
+const uint32_t kInitialBucketCount = 16;
+
+// Size of the count-min sketch used to estimate how often each key is
+// looked up under the TinyLFU policy. The counters saturate at 15, and
+// are halved every kSketchSamplePeriod lookups so that the estimate
+// follows changes in the workload.
+const int kSketchDepth = 4;
+const int kSketchWidthBits = 8;
+const int kSketchWidth = 1 << kSketchWidthBits;
+const uint32_t kSketchSamplePeriod = 10 * kSketchWidth;
+const uint8_t kSketchMaxCount = 15;
+
+struct CacheShard {
+    halide_mutex lock;
+    // A power-of-two sized array of hash chains, indexed by the low
+    // bits of the key hash.
+    CacheEntry **buckets;
+    uint32_t bucket_count;
+    uint32_t entry_count;
+    CacheEntry *most_recently_used;
+    CacheEntry *least_recently_used;
+    // The GreedyDual-Size inflation value: the priority of the last
+    // entry evicted. Entries that are used again are given priorities
+    // relative to it, so that entries which are not used age out.
+    uint64_t inflation;
+    // The TinyLFU frequency sketch.
+    uint32_t sketch_samples;
+    uint8_t sketch[kSketchDepth][kSketchWidth];
+};
+
+// Memoized Funcs can be given a budget of their own, separate from
+// the rest of the cache, by creating a partition named after the Func
+// or after the pipeline it belongs to. Everything else goes in the
+// default partition.
+struct CachePartition {
+    // NULL for the default partition.
+    char *name;
+    size_t name_length;
+    int64_t max_size;
+    // Updated atomically, as shards add to it under their own locks.
+    int64_t current_size;
+    // Statistics, also updated atomically. Hits and misses are
+    // counted at lookup, stores and their compute cost at store, and
+    // lifetimes at eviction.
+    uint64_t hits, misses, stores, stored_cost_ns, evictions, evicted_lifetime_ns, rejections;
+    CacheShard shards[kNumCacheShards];
+};
+
+// Protects the partition list and budgets, and serializes
+// whole-cache operations.
 WEAK halide_mutex memoization_lock;
 
-const size_t kHashTableSize = 256;
+const uint64_t kDefaultCacheSize = 1 << 20;
+WEAK CachePartition default_partition = {NULL, 0, kDefaultCacheSize};
 
-WEAK CacheEntry *cache_entries[kHashTableSize];
+WEAK int eviction_policy = halide_memoization_cache_evict_lru;
 
-WEAK CacheEntry *most_recently_used = NULL;
-WEAK CacheEntry *least_recently_used = NULL;
+const int kMaxCachePartitions = 64;
+// Named partitions are never removed or freed, not even by cleanup,
+// so readers can scan the first num_named_partitions entries without
+// a lock.
+WEAK CachePartition *named_partitions[kMaxCachePartitions];
+WEAK int num_named_partitions = 0;
 
-const uint64_t kDefaultCacheSize = 1 << 20;
-WEAK int64_t max_cache_size = kDefaultCacheSize;
-WEAK int64_t current_cache_size = 0;
+WEAK __attribute__((always_inline)) CacheShard &shard_for_hash(CachePartition *partition, uint32_t h) {
+    return partition->shards[h >> (32 - kCacheShardBits)];
+}
+
+// Find the partition for a memoized Func, by the name of the Func or
+// of the pipeline it belongs to.
+WEAK CachePartition *find_partition(const char *pipeline_name, const char *func_name) {
+    int count = __atomic_load_n(&num_named_partitions, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < count; i++) {
+        CachePartition *partition = named_partitions[i];
+        if ((pipeline_name && strcmp(partition->name, pipeline_name) == 0) ||
+            (func_name && strcmp(partition->name, func_name) == 0)) {
+            return partition;
+        }
+    }
+    return &default_partition;
+}
+
+WEAK __attribute__((always_inline)) CacheEntry *&bucket_for_hash(CacheShard &shard, uint32_t h) {
+    return shard.buckets[h & (shard.bucket_count - 1)];
+}
+
+WEAK __attribute__((always_inline)) int64_t entry_size(const CacheEntry *entry) {
+    int64_t size = 0;
+    for (uint32_t i = 0; i < entry->tuple_count; i++) {
+        size += entry->buf[i].size_in_bytes();
+    }
+    return size;
+}
+
+// Make sure the shard has a hash table with room for one more entry
+// without the chains getting too long. Must be called with the shard
+// locked. Returns false if no table could be allocated.
+WEAK bool reserve_bucket(CacheShard &shard) {
+    if (shard.buckets != NULL && shard.entry_count < 2 * shard.bucket_count) {
+        return true;
+    }
+    uint32_t new_count = shard.buckets ? shard.bucket_count * 2 : kInitialBucketCount;
+    CacheEntry **new_buckets = (CacheEntry **)halide_malloc(NULL, new_count * sizeof(CacheEntry *));
+    if (new_buckets == NULL) {
+        // Growing is only an optimization if we already have a table.
+        return shard.buckets != NULL;
+    }
+    memset(new_buckets, 0, new_count * sizeof(CacheEntry *));
+    for (uint32_t i = 0; i < shard.bucket_count; i++) {
+        CacheEntry *entry = shard.buckets[i];
+        while (entry != NULL) {
+            CacheEntry *next = entry->next;
+            CacheEntry *&bucket = new_buckets[entry->hash & (new_count - 1)];
+            entry->next = bucket;
+            bucket = entry;
+            entry = next;
+        }
+    }
+    if (shard.buckets) {
+        halide_free(NULL, shard.buckets);
+    }
+    shard.buckets = new_buckets;
+    shard.bucket_count = new_count;
+    return true;
+}
 
 #if CACHE_DEBUGGING
-WEAK void validate_cache() {
-    print(NULL) << "validating cache, "
-                << "current size " << current_cache_size
-                << " of maximum " << max_cache_size << "\n";
-    int entries_in_hash_table = 0;
-    for (size_t i = 0; i < kHashTableSize; i++) {
-        CacheEntry *entry = cache_entries[i];
+WEAK void validate_cache(CachePartition *partition, CacheShard &shard) {
+    print(NULL) << "validating cache shard, "
+                << "current size " << partition->current_size
+                << " of maximum " << partition->max_size << "\n";
+    uint32_t entries_in_hash_table = 0;
+    for (size_t i = 0; i < shard.bucket_count; i++) {
+        CacheEntry *entry = shard.buckets[i];
         while (entry != NULL) {
             entries_in_hash_table++;
-            if (entry->more_recent == NULL && entry != most_recently_used) {
+            if (entry->more_recent == NULL && entry != shard.most_recently_used) {
                 halide_print(NULL, "cache invalid case 1\n");
                 __builtin_trap();
             }
-            if (entry->less_recent == NULL && entry != least_recently_used) {
+            if (entry->less_recent == NULL && entry != shard.least_recently_used) {
                 halide_print(NULL, "cache invalid case 2\n");
                 __builtin_trap();
             }
             entry = entry->next;
         }
     }
-    int entries_from_mru = 0;
-    CacheEntry *mru_chain = most_recently_used;
+    uint32_t entries_from_mru = 0;
+    CacheEntry *mru_chain = shard.most_recently_used;
     while (mru_chain != NULL) {
         entries_from_mru++;
         mru_chain = mru_chain->less_recent;
     }
-    int entries_from_lru = 0;
-    CacheEntry *lru_chain = least_recently_used;
+    uint32_t entries_from_lru = 0;
+    CacheEntry *lru_chain = shard.least_recently_used;
     while (lru_chain != NULL) {
         entries_from_lru++;
         lru_chain = lru_chain->more_recent;
@@ -234,7 +389,8 @@ WEAK void validate_cache() {
     print(NULL) << "hash entries " << entries_in_hash_table
                 << ", mru entries " << entries_from_mru
                 << ", lru entries " << entries_from_lru << "\n";
-    if (entries_in_hash_table != entries_from_mru) {
+    if (entries_in_hash_table != entries_from_mru ||
+        entries_in_hash_table != shard.entry_count) {
         halide_print(NULL, "cache invalid case 3\n");
         __builtin_trap();
     }
@@ -242,71 +398,190 @@ WEAK void validate_cache() {
         halide_print(NULL, "cache invalid case 4\n");
         __builtin_trap();
     }
-    if (current_cache_size < 0) {
+    if (partition->current_size < 0) {
         halide_print(NULL, "cache size is negative\n");
         __builtin_trap();
     }
 }
 #endif
 
-WEAK void prune_cache() {
-#if CACHE_DEBUGGING
-    validate_cache();
-#endif
-    CacheEntry *prune_candidate = least_recently_used;
-    while (current_cache_size > max_cache_size &&
-           prune_candidate != NULL) {
-        CacheEntry *more_recent = prune_candidate->more_recent;
-
-        if (prune_candidate->in_use_count == 0) {
-            uint32_t h = prune_candidate->hash;
-            uint32_t index = h % kHashTableSize;
-
-            // Remove from hash table
-            CacheEntry *prev_hash_entry = cache_entries[index];
-            if (prev_hash_entry == prune_candidate) {
-                cache_entries[index] = prune_candidate->next;
-            } else {
-                while (prev_hash_entry != NULL && prev_hash_entry->next != prune_candidate) {
-                    prev_hash_entry = prev_hash_entry->next;
-                }
-                halide_assert(NULL, prev_hash_entry != NULL);
-                prev_hash_entry->next = prune_candidate->next;
-            }
+// The sketch rows are indexed by different bits of a remix of the key
+// hash.
+WEAK __attribute__((always_inline)) uint32_t sketch_index(uint32_t h, int row) {
+    const uint32_t seeds[kSketchDepth] = {0x9e3779b1, 0x85ebca6b, 0xc2b2ae35, 0x27d4eb2f};
+    return (h * seeds[row]) >> (32 - kSketchWidthBits);
+}
 
-            // Remove from less recent chain.
-            if (least_recently_used == prune_candidate) {
-                least_recently_used = more_recent;
-            }
-            if (more_recent != NULL) {
-                more_recent->less_recent = prune_candidate->less_recent;
+// Must be called with the shard locked.
+WEAK void record_frequency(CacheShard &shard, uint32_t h) {
+    for (int row = 0; row < kSketchDepth; row++) {
+        uint8_t &count = shard.sketch[row][sketch_index(h, row)];
+        if (count < kSketchMaxCount) {
+            count++;
+        }
+    }
+    if (++shard.sketch_samples >= kSketchSamplePeriod) {
+        for (int row = 0; row < kSketchDepth; row++) {
+            for (int i = 0; i < kSketchWidth; i++) {
+                shard.sketch[row][i] >>= 1;
             }
+        }
+        shard.sketch_samples = 0;
+    }
+}
 
-            // Remove from more recent chain.
-            if (most_recently_used == prune_candidate) {
-                most_recently_used = prune_candidate->less_recent;
-            }
-            if (prune_candidate->less_recent != NULL) {
-                prune_candidate->less_recent = more_recent;
-            }
+// Must be called with the shard locked.
+WEAK uint8_t estimate_frequency(const CacheShard &shard, uint32_t h) {
+    uint8_t result = kSketchMaxCount;
+    for (int row = 0; row < kSketchDepth; row++) {
+        uint8_t count = shard.sketch[row][sketch_index(h, row)];
+        result = count < result ? count : result;
+    }
+    return result;
+}
 
-            // Decrease cache used amount.
-            for (uint32_t i = 0; i < prune_candidate->tuple_count; i++) {
-                current_cache_size -= prune_candidate->buf[i].size_in_bytes();
-            }
+// The priority of an entry under GreedyDual-Size: the inflation value
+// plus the cost of recomputing the entry per byte it occupies, so
+// that cheap, large entries go first.
+WEAK uint64_t greedy_dual_size_priority(const CacheShard &shard, const CacheEntry *entry) {
+    uint64_t size = entry_size(entry);
+    return shard.inflation + (entry->cost_ns << 16) / (size ? size : 1);
+}
 
-            // Deallocate the entry.
-            prune_candidate->destroy();
-            halide_free(NULL, prune_candidate);
+// The entry to evict next under the current policy, or NULL if every
+// entry in the shard is in use. Must be called with the shard locked.
+WEAK CacheEntry *choose_victim(CacheShard &shard) {
+    CacheEntry *victim = NULL;
+    for (CacheEntry *candidate = shard.least_recently_used;
+         candidate != NULL; candidate = candidate->more_recent) {
+        if (candidate->in_use_count != 0) {
+            continue;
+        }
+        if (eviction_policy != halide_memoization_cache_evict_greedy_dual_size) {
+            return candidate;
         }
+        // GreedyDual-Size needs a scan of the whole shard. Ties go to
+        // the least recently used entry.
+        if (victim == NULL || candidate->priority < victim->priority) {
+            victim = candidate;
+        }
+    }
+    return victim;
+}
+
+// Unlink an entry from its shard's hash table and LRU list, and free
+// it. Must be called with the shard locked.
+WEAK void evict_entry(CacheShard &shard, CacheEntry *entry) {
+    CachePartition *partition = entry->partition;
+
+    // Remove from hash table
+    CacheEntry *&bucket = bucket_for_hash(shard, entry->hash);
+    CacheEntry *prev_hash_entry = bucket;
+    if (prev_hash_entry == entry) {
+        bucket = entry->next;
+    } else {
+        while (prev_hash_entry != NULL && prev_hash_entry->next != entry) {
+            prev_hash_entry = prev_hash_entry->next;
+        }
+        halide_assert(NULL, prev_hash_entry != NULL);
+        prev_hash_entry->next = entry->next;
+    }
+
+    // Remove from less recent chain.
+    CacheEntry *more_recent = entry->more_recent;
+    if (shard.least_recently_used == entry) {
+        shard.least_recently_used = more_recent;
+    }
+    if (more_recent != NULL) {
+        more_recent->less_recent = entry->less_recent;
+    }
 
-        prune_candidate = more_recent;
+    // Remove from more recent chain.
+    if (shard.most_recently_used == entry) {
+        shard.most_recently_used = entry->less_recent;
+    }
+    if (entry->less_recent != NULL) {
+        entry->less_recent->more_recent = more_recent;
+    }
+
+    shard.entry_count--;
+
+    if (entry->priority > shard.inflation) {
+        shard.inflation = entry->priority;
+    }
+
+    // Decrease cache used amount.
+    __sync_fetch_and_sub(&partition->current_size, entry_size(entry));
+    __sync_fetch_and_add(&partition->evictions, 1);
+    __sync_fetch_and_add(&partition->evicted_lifetime_ns,
+                         halide_current_time_ns(NULL) - entry->created_ns);
+
+    // Deallocate the entry.
+    entry->destroy();
+    halide_free(NULL, entry);
+}
+
+// Evict entries from one shard until its partition as a whole is
+// within budget, or nothing more in this shard can be evicted. Must
+// be called with the shard locked.
+WEAK void prune_cache(CachePartition *partition, CacheShard &shard) {
+#if CACHE_DEBUGGING
+    validate_cache(partition, shard);
+#endif
+    while (__atomic_load_n(&partition->current_size, __ATOMIC_RELAXED) > partition->max_size) {
+        CacheEntry *victim = choose_victim(shard);
+        if (victim == NULL) {
+            break;
+        }
+        evict_entry(shard, victim);
     }
 #if CACHE_DEBUGGING
-    validate_cache();
+    validate_cache(partition, shard);
 #endif
 }
 
+// Bring a partition within budget by pruning every shard in turn,
+// starting after the given one. No shard lock may be held by the
+// caller.
+WEAK void prune_all_shards(CachePartition *partition, int first_shard) {
+    for (int i = 0; i < kNumCacheShards; i++) {
+        if (__atomic_load_n(&partition->current_size, __ATOMIC_RELAXED) <= partition->max_size) {
+            return;
+        }
+        CacheShard &shard = partition->shards[(first_shard + i) % kNumCacheShards];
+        ScopedMutexLock lock(&shard.lock);
+        prune_cache(partition, shard);
+    }
+}
+
+WEAK void cleanup_partition(CachePartition *partition) {
+    for (int s = 0; s < kNumCacheShards; s++) {
+        CacheShard &shard = partition->shards[s];
+        for (uint32_t i = 0; i < shard.bucket_count; i++) {
+            CacheEntry *entry = shard.buckets[i];
+            while (entry != NULL) {
+                CacheEntry *next = entry->next;
+                entry->destroy();
+                halide_free(NULL, entry);
+                entry = next;
+            }
+        }
+        if (shard.buckets) {
+            halide_free(NULL, shard.buckets);
+        }
+        shard.buckets = NULL;
+        shard.bucket_count = 0;
+        shard.entry_count = 0;
+        shard.most_recently_used = NULL;
+        shard.least_recently_used = NULL;
+        shard.inflation = 0;
+        shard.sketch_samples = 0;
+        memset(shard.sketch, 0, sizeof(shard.sketch));
+        halide_mutex_destroy(&shard.lock);
+    }
+    partition->current_size = 0;
+}
+
 }}} // namespace Halide::Runtime::Internal
 
 extern "C" {
@@ -318,16 +593,122 @@ WEAK void halide_memoization_cache_set_size(int64_t size) {
 
     ScopedMutexLock lock(&memoization_lock);
 
-    max_cache_size = size;
-    prune_cache();
+    default_partition.max_size = size;
+    prune_all_shards(&default_partition, 0);
+}
+
+WEAK int halide_memoization_cache_set_partition_size(const char *name, int64_t size) {
+    if (size == 0) {
+        size = kDefaultCacheSize;
+    }
+
+    ScopedMutexLock lock(&memoization_lock);
+
+    CachePartition *partition = NULL;
+    size_t name_length = strlen(name);
+    for (int i = 0; i < num_named_partitions; i++) {
+        if (named_partitions[i]->name_length == name_length &&
+            strcmp(named_partitions[i]->name, name) == 0) {
+            partition = named_partitions[i];
+        }
+    }
+
+    if (partition == NULL) {
+        if (num_named_partitions == kMaxCachePartitions) {
+            halide_error(NULL, "halide_memoization_cache_set_partition_size: too many partitions.\n");
+            return -1;
+        }
+        partition = (CachePartition *)halide_malloc(NULL, sizeof(CachePartition));
+        char *name_copy = (char *)halide_malloc(NULL, name_length + 1);
+        if (!partition || !name_copy) {
+            if (partition) {
+                halide_free(NULL, partition);
+            }
+            if (name_copy) {
+                halide_free(NULL, name_copy);
+            }
+            return -1;
+        }
+        memset(partition, 0, sizeof(CachePartition));
+        memcpy(name_copy, name, name_length + 1);
+        partition->name = name_copy;
+        partition->name_length = name_length;
+        partition->max_size = size;
+        named_partitions[num_named_partitions] = partition;
+        // Publish the partition only once it's fully constructed.
+        __atomic_store_n(&num_named_partitions, num_named_partitions + 1, __ATOMIC_RELEASE);
+    }
+
+    partition->max_size = size;
+    prune_all_shards(partition, 0);
+    return 0;
+}
+
+WEAK int halide_memoization_cache_get_stats(int index, halide_memoization_cache_stats_t *stats) {
+    ScopedMutexLock lock(&memoization_lock);
+
+    CachePartition *partition;
+    if (index == 0) {
+        partition = &default_partition;
+    } else if (index > 0 && index <= num_named_partitions) {
+        partition = named_partitions[index - 1];
+    } else {
+        return -1;
+    }
+
+    stats->partition = partition->name;
+    stats->max_size = partition->max_size;
+    stats->bytes_resident = __atomic_load_n(&partition->current_size, __ATOMIC_RELAXED);
+    stats->hits = __atomic_load_n(&partition->hits, __ATOMIC_RELAXED);
+    stats->misses = __atomic_load_n(&partition->misses, __ATOMIC_RELAXED);
+    stats->stores = __atomic_load_n(&partition->stores, __ATOMIC_RELAXED);
+    stats->average_cost_ns = stats->stores ?
+        __atomic_load_n(&partition->stored_cost_ns, __ATOMIC_RELAXED) / stats->stores : 0;
+    stats->evictions = __atomic_load_n(&partition->evictions, __ATOMIC_RELAXED);
+    stats->rejections = __atomic_load_n(&partition->rejections, __ATOMIC_RELAXED);
+    stats->average_lifetime_ns = stats->evictions ?
+        __atomic_load_n(&partition->evicted_lifetime_ns, __ATOMIC_RELAXED) / stats->evictions : 0;
+    return 0;
+}
+
+WEAK void halide_memoization_cache_reset_stats() {
+    ScopedMutexLock lock(&memoization_lock);
+
+    for (int i = 0; i <= num_named_partitions; i++) {
+        CachePartition *partition = i == 0 ? &default_partition : named_partitions[i - 1];
+        __atomic_store_n(&partition->hits, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&partition->misses, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&partition->stores, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&partition->stored_cost_ns, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&partition->evictions, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&partition->evicted_lifetime_ns, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&partition->rejections, 0, __ATOMIC_RELAXED);
+    }
+}
+
+WEAK int halide_memoization_cache_set_eviction_policy(int policy) {
+    ScopedMutexLock lock(&memoization_lock);
+    int old_policy = eviction_policy;
+    if (policy >= halide_memoization_cache_evict_lru &&
+        policy <= halide_memoization_cache_evict_tinylfu) {
+        __atomic_store_n(&eviction_policy, policy, __ATOMIC_RELAXED);
+    }
+    return old_policy;
 }
 
 WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cache_key, int32_t size,
                                          halide_buffer_t *computed_bounds, int32_t tuple_count, halide_buffer_t **tuple_buffers) {
-    uint32_t h = djb_hash(cache_key, size);
-    uint32_t index = h % kHashTableSize;
+    return halide_memoization_cache_lookup_partitioned(user_context, cache_key, size, computed_bounds,
+                                                       tuple_count, tuple_buffers, NULL, NULL);
+}
 
-    ScopedMutexLock lock(&memoization_lock);
+WEAK int halide_memoization_cache_lookup_partitioned(void *user_context, const uint8_t *cache_key, int32_t size,
+                                                     halide_buffer_t *computed_bounds, int32_t tuple_count,
+                                                     halide_buffer_t **tuple_buffers,
+                                                     const char *pipeline_name, const char *func_name) {
+    uint32_t h = hash_key(cache_key, size);
+    CachePartition *partition = find_partition(pipeline_name, func_name);
+    CacheShard &shard = shard_for_hash(partition, h);
 
 #if CACHE_DEBUGGING
     debug_print_key(user_context, "halide_memoization_cache_lookup", cache_key, size);
@@ -342,52 +723,66 @@ WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cach
     }
 #endif
 
-    CacheEntry *entry = cache_entries[index];
-    while (entry != NULL) {
-        if (entry->hash == h && entry->key_size == (size_t)size &&
-            keys_equal(entry->key, cache_key, size) &&
-            buffer_has_shape(computed_bounds, entry->computed_bounds) &&
-            entry->tuple_count == (uint32_t)tuple_count) {
-
-            // Check all the tuple buffers have the same bounds (they should).
-            bool all_bounds_equal = true;
-            for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
-                all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
-            }
+    {
+        ScopedMutexLock lock(&shard.lock);
 
-            if (all_bounds_equal) {
-                if (entry != most_recently_used) {
-                    halide_assert(user_context, entry->more_recent != NULL);
-                    if (entry->less_recent != NULL) {
-                        entry->less_recent->more_recent = entry->more_recent;
-                    } else {
-                        halide_assert(user_context, least_recently_used == entry);
-                        least_recently_used = entry->more_recent;
-                    }
-                    halide_assert(user_context, entry->more_recent != NULL);
-                    entry->more_recent->less_recent = entry->less_recent;
+        if (eviction_policy == halide_memoization_cache_evict_tinylfu) {
+            record_frequency(shard, h);
+        }
 
-                    entry->more_recent = NULL;
-                    entry->less_recent = most_recently_used;
-                    if (most_recently_used != NULL) {
-                        most_recently_used->more_recent = entry;
-                    }
-                    most_recently_used = entry;
-                }
+        CacheEntry *entry = shard.buckets ? bucket_for_hash(shard, h) : NULL;
+        while (entry != NULL) {
+            if (entry->hash == h && entry->key_size == (size_t)size &&
+                keys_equal(entry->key, cache_key, size) &&
+                buffer_has_shape(computed_bounds, entry->computed_bounds) &&
+                entry->tuple_count == (uint32_t)tuple_count) {
 
-                for (int32_t i = 0; i < tuple_count; i++) {
-                    halide_buffer_t *buf = tuple_buffers[i];
-                    *buf = entry->buf[i];
+                // Check all the tuple buffers have the same bounds (they should).
+                bool all_bounds_equal = true;
+                for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
+                    all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
                 }
 
-                entry->in_use_count += tuple_count;
+                if (all_bounds_equal) {
+                    if (entry != shard.most_recently_used) {
+                        halide_assert(user_context, entry->more_recent != NULL);
+                        if (entry->less_recent != NULL) {
+                            entry->less_recent->more_recent = entry->more_recent;
+                        } else {
+                            halide_assert(user_context, shard.least_recently_used == entry);
+                            shard.least_recently_used = entry->more_recent;
+                        }
+                        halide_assert(user_context, entry->more_recent != NULL);
+                        entry->more_recent->less_recent = entry->less_recent;
+
+                        entry->more_recent = NULL;
+                        entry->less_recent = shard.most_recently_used;
+                        if (shard.most_recently_used != NULL) {
+                            shard.most_recently_used->more_recent = entry;
+                        }
+                        shard.most_recently_used = entry;
+                    }
+
+                    for (int32_t i = 0; i < tuple_count; i++) {
+                        halide_buffer_t *buf = tuple_buffers[i];
+                        *buf = entry->buf[i];
+                    }
+
+                    entry->in_use_count += tuple_count;
+                    entry->priority = greedy_dual_size_priority(shard, entry);
 
-                return 0;
+                    __sync_fetch_and_add(&partition->hits, 1);
+                    return 0;
+                }
             }
+            entry = entry->next;
         }
-        entry = entry->next;
     }
 
+    // A miss. Allocating the storage for the caller to compute into
+    // doesn't need the lock.
+    __sync_fetch_and_add(&partition->misses, 1);
+    int64_t miss_ns = halide_current_time_ns(user_context);
     for (int32_t i = 0; i < tuple_count; i++) {
         halide_buffer_t *buf = tuple_buffers[i];
 
@@ -402,13 +797,11 @@ WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cach
         buf->host += header_bytes();
         CacheBlockHeader *header = get_pointer_to_header(buf->host);
         header->hash = h;
+        header->partition = partition;
+        header->miss_ns = miss_ns;
         header->entry = NULL;
     }
 
-#if CACHE_DEBUGGING
-    validate_cache();
-#endif
-
     return 1;
 }
 
@@ -417,107 +810,151 @@ WEAK int halide_memoization_cache_store(void *user_context, const uint8_t *cache
                                         int32_t tuple_count, halide_buffer_t **tuple_buffers) {
     debug(user_context) << "halide_memoization_cache_store\n";
 
-    uint32_t h = get_pointer_to_header(tuple_buffers[0]->host)->hash;
+    CacheBlockHeader *header = get_pointer_to_header(tuple_buffers[0]->host);
+    uint32_t h = header->hash;
+    CachePartition *partition = header->partition;
 
-    uint32_t index = h % kHashTableSize;
+    CacheShard &shard = shard_for_hash(partition, h);
 
-    ScopedMutexLock lock(&memoization_lock);
+    bool over_budget = false;
+    {
+        ScopedMutexLock lock(&shard.lock);
 
 #if CACHE_DEBUGGING
-    debug_print_key(user_context, "halide_memoization_cache_store", cache_key, size);
+        debug_print_key(user_context, "halide_memoization_cache_store", cache_key, size);
 
-    debug_print_buffer(user_context, "computed_bounds", *computed_bounds);
+        debug_print_buffer(user_context, "computed_bounds", *computed_bounds);
 
-    {
-        for (int32_t i = 0; i < tuple_count; i++) {
-            halide_buffer_t *buf = tuple_buffers[i];
-            debug_print_buffer(user_context, "Allocation bounds", *buf);
+        {
+            for (int32_t i = 0; i < tuple_count; i++) {
+                halide_buffer_t *buf = tuple_buffers[i];
+                debug_print_buffer(user_context, "Allocation bounds", *buf);
+            }
         }
-    }
 #endif
 
-    CacheEntry *entry = cache_entries[index];
-    while (entry != NULL) {
-        if (entry->hash == h && entry->key_size == (size_t)size &&
-            keys_equal(entry->key, cache_key, size) &&
-            buffer_has_shape(computed_bounds, entry->computed_bounds) &&
-            entry->tuple_count == (uint32_t)tuple_count) {
+        CacheEntry *entry = shard.buckets ? bucket_for_hash(shard, h) : NULL;
+        while (entry != NULL) {
+            if (entry->hash == h && entry->key_size == (size_t)size &&
+                keys_equal(entry->key, cache_key, size) &&
+                buffer_has_shape(computed_bounds, entry->computed_bounds) &&
+                entry->tuple_count == (uint32_t)tuple_count) {
+
+                bool all_bounds_equal = true;
+                bool no_host_pointers_equal = true;
+                {
+                    for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
+                        halide_buffer_t *buf = tuple_buffers[i];
+                        all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
+                        if (entry->buf[i].host == buf->host) {
+                            no_host_pointers_equal = false;
+                        }
+                    }
+                }
+                if (all_bounds_equal) {
+                    halide_assert(user_context, no_host_pointers_equal);
+                    // This entry is still in use by the caller. Mark it as having no cache entry
+                    // so halide_memoization_cache_release can free the buffer.
+                    for (int32_t i = 0; i < tuple_count; i++) {
+                        get_pointer_to_header(tuple_buffers[i]->host)->entry = NULL;
 
-            bool all_bounds_equal = true;
-            bool no_host_pointers_equal = true;
-            {
-                for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
-                    halide_buffer_t *buf = tuple_buffers[i];
-                    all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
-                    if (entry->buf[i].host == buf->host) {
-                        no_host_pointers_equal = false;
                     }
+                    return 0;
                 }
             }
-            if (all_bounds_equal) {
-                halide_assert(user_context, no_host_pointers_equal);
-                // This entry is still in use by the caller. Mark it as having no cache entry
-                // so halide_memoization_cache_release can free the buffer.
-                for (int32_t i = 0; i < tuple_count; i++) {
-                    get_pointer_to_header(tuple_buffers[i]->host)->entry = NULL;
+            entry = entry->next;
+        }
 
-                }
-                return 0;
+        uint64_t added_size = 0;
+        {
+            for (int32_t i = 0; i < tuple_count; i++) {
+                halide_buffer_t *buf = tuple_buffers[i];
+                added_size += buf->size_in_bytes();
             }
         }
-        entry = entry->next;
-    }
 
-    uint64_t added_size = 0;
-    {
-        for (int32_t i = 0; i < tuple_count; i++) {
-            halide_buffer_t *buf = tuple_buffers[i];
-            added_size += buf->size_in_bytes();
+        // Under TinyLFU, when the partition is full, only admit the new
+        // entry if it is used more often than the entry it would
+        // displace.
+        bool admit = true;
+        if (eviction_policy == halide_memoization_cache_evict_tinylfu &&
+            __atomic_load_n(&partition->current_size, __ATOMIC_RELAXED) + (int64_t)added_size > partition->max_size) {
+            CacheEntry *victim = choose_victim(shard);
+            if (victim != NULL &&
+                estimate_frequency(shard, h) <= estimate_frequency(shard, victim->hash)) {
+                __sync_fetch_and_add(&partition->rejections, 1);
+                admit = false;
+            }
         }
-    }
-    current_cache_size += added_size;
-    prune_cache();
 
-    CacheEntry *new_entry = (CacheEntry *)halide_malloc(NULL, sizeof(CacheEntry));
-    bool inited = false;
-    if (new_entry) {
-        inited = new_entry->init(cache_key, size, h, computed_bounds, tuple_count, tuple_buffers);
-    }
-    if (!inited) {
-        current_cache_size -= added_size;
+        if (admit) {
+            __sync_fetch_and_add(&partition->current_size, added_size);
+            prune_cache(partition, shard);
+        }
 
-        // This entry is still in use by the caller. Mark it as having no cache entry
-        // so halide_memoization_cache_release can free the buffer.
-        for (int32_t i = 0; i < tuple_count; i++) {
-            get_pointer_to_header(tuple_buffers[i]->host)->entry = NULL;
+        CacheEntry *new_entry = NULL;
+        bool inited = false;
+        if (admit && reserve_bucket(shard)) {
+            new_entry = (CacheEntry *)halide_malloc(NULL, sizeof(CacheEntry));
+            if (new_entry) {
+                inited = new_entry->init(cache_key, size, h, computed_bounds, tuple_count, tuple_buffers);
+            }
         }
+        if (!inited) {
+            if (admit) {
+                __sync_fetch_and_sub(&partition->current_size, added_size);
+            }
 
-        if (new_entry) {
-            halide_free(user_context, new_entry);
+            // This entry is still in use by the caller. Mark it as having no cache entry
+            // so halide_memoization_cache_release can free the buffer.
+            for (int32_t i = 0; i < tuple_count; i++) {
+                get_pointer_to_header(tuple_buffers[i]->host)->entry = NULL;
+            }
+
+            if (new_entry) {
+                halide_free(user_context, new_entry);
+            }
+            return 0;
         }
-        return 0;
-    }
 
-    new_entry->next = cache_entries[index];
-    new_entry->less_recent = most_recently_used;
-    if (most_recently_used != NULL) {
-        most_recently_used->more_recent = new_entry;
-    }
-    most_recently_used = new_entry;
-    if (least_recently_used == NULL) {
-        least_recently_used = new_entry;
-    }
-    cache_entries[index] = new_entry;
+        CacheEntry *&bucket = bucket_for_hash(shard, h);
+        new_entry->next = bucket;
+        new_entry->less_recent = shard.most_recently_used;
+        if (shard.most_recently_used != NULL) {
+            shard.most_recently_used->more_recent = new_entry;
+        }
+        shard.most_recently_used = new_entry;
+        if (shard.least_recently_used == NULL) {
+            shard.least_recently_used = new_entry;
+        }
+        bucket = new_entry;
+        shard.entry_count++;
+        new_entry->partition = partition;
+        new_entry->created_ns = halide_current_time_ns(user_context);
+        new_entry->cost_ns = new_entry->created_ns - header->miss_ns;
+        new_entry->priority = greedy_dual_size_priority(shard, new_entry);
+        __sync_fetch_and_add(&partition->stores, 1);
+        __sync_fetch_and_add(&partition->stored_cost_ns, new_entry->cost_ns);
 
-    new_entry->in_use_count = tuple_count;
+        new_entry->in_use_count = tuple_count;
 
-    for (int32_t i = 0; i < tuple_count; i++) {
-        get_pointer_to_header(tuple_buffers[i]->host)->entry = new_entry;
-    }
+        for (int32_t i = 0; i < tuple_count; i++) {
+            get_pointer_to_header(tuple_buffers[i]->host)->entry = new_entry;
+        }
 
 #if CACHE_DEBUGGING
-    validate_cache();
+        validate_cache(partition, shard);
 #endif
+
+        over_budget = __atomic_load_n(&partition->current_size, __ATOMIC_RELAXED) > partition->max_size;
+    }
+
+    // This shard didn't have enough unused entries to make room, so
+    // evict from the others.
+    if (over_budget) {
+        prune_all_shards(partition, (&shard - partition->shards) + 1);
+    }
+
     debug(user_context) << "Exiting halide_memoization_cache_store\n";
 
     return 0;
@@ -531,12 +968,13 @@ WEAK void halide_memoization_cache_release(void *user_context, void *host) {
     if (entry == NULL) {
         halide_free(user_context, header);
     } else {
-        ScopedMutexLock lock(&memoization_lock);
+        CacheShard &shard = shard_for_hash(entry->partition, header->hash);
+        ScopedMutexLock lock(&shard.lock);
 
         halide_assert(user_context, entry->in_use_count > 0);
         entry->in_use_count--;
 #if CACHE_DEBUGGING
-        validate_cache();
+        validate_cache(entry->partition, shard);
 #endif
     }
 
@@ -545,19 +983,16 @@ WEAK void halide_memoization_cache_release(void *user_context, void *host) {
 
 WEAK void halide_memoization_cache_cleanup() {
     debug(NULL) << "halide_memoization_cache_cleanup\n";
-    for (size_t i = 0; i < kHashTableSize; i++) {
-        CacheEntry *entry = cache_entries[i];
-        cache_entries[i] = NULL;
-        while (entry != NULL) {
-            CacheEntry *next = entry->next;
-            entry->destroy();
-            halide_free(NULL, entry);
-            entry = next;
+    {
+        ScopedMutexLock lock(&memoization_lock);
+        // Only the contents of the partitions are freed. Lookups find
+        // their partition without taking memoization_lock, so the
+        // partitions themselves (and their budgets) must stay valid.
+        cleanup_partition(&default_partition);
+        for (int i = 0; i < num_named_partitions; i++) {
+            cleanup_partition(named_partitions[i]);
         }
     }
-    current_cache_size = 0;
-    most_recently_used = NULL;
-    least_recently_used = NULL;
     halide_mutex_destroy(&memoization_lock);
 }
 
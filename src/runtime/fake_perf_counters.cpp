@@ -0,0 +1,22 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+// Used where the profiler can't read hardware performance counters.
+
+extern "C" {
+
+WEAK int halide_perf_counters_thread_id() {
+    return 0;
+}
+
+WEAK void halide_perf_counters_sample() {
+}
+
+WEAK int halide_perf_counters_read(int thread_id, uint64_t *deltas) {
+    return 0;
+}
+
+WEAK void halide_perf_counters_shutdown() {
+}
+
+}
@@ -25,6 +25,10 @@ namespace Halide { namespace Runtime { namespace Internal {
 WEAK halide_do_task_t custom_do_task = halide_default_do_task;
 WEAK halide_do_par_for_t custom_do_par_for = halide_default_do_par_for;
 
+WEAK bool halide_helper_threads_supported() {
+    return false;
+}
+
 }}} // namespace Halide::Runtime::Internal
 
 extern "C" {
@@ -54,6 +58,26 @@ WEAK int halide_set_num_threads(int n) {
     return 1;
 }
 
+WEAK int halide_set_numa_placement(int enabled) {
+    return enabled ? -1 : 0;
+}
+
+WEAK int halide_set_thread_pool_spin_count(int spin_count) {
+    return 0;
+}
+
+WEAK void halide_thread_pool_get_stats(halide_thread_pool_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+WEAK void halide_thread_pool_reset_stats() {
+}
+
+WEAK int halide_set_thread_pool_scheduler(int scheduler) {
+    // There is only one way to schedule work here.
+    return halide_thread_pool_scheduler_default;
+}
+
 WEAK halide_do_task_t halide_set_custom_do_task(halide_do_task_t f) {
     halide_do_task_t result = custom_do_task;
     custom_do_task = f;
@@ -66,6 +90,25 @@ WEAK halide_do_par_for_t halide_set_custom_do_par_for(halide_do_par_for_t f) {
     return result;
 }
 
+// Tasks run serially and in order here, so the producer side of an
+// async Func always finishes before its consumer starts, and an
+// acquire never has to wait.
+WEAK int halide_semaphore_release(halide_semaphore_t *s, int n) {
+    int *value = (int *)s;
+    *value += n;
+    return 0;
+}
+
+WEAK int halide_semaphore_acquire(halide_semaphore_t *s, int n) {
+    int *value = (int *)s;
+    if (*value < n) {
+        halide_error(NULL, "halide_semaphore_acquire would wait forever without threads.");
+        return -1;
+    }
+    *value -= n;
+    return 0;
+}
+
 WEAK int halide_do_task(void *user_context, halide_task_t f, int idx,
                         uint8_t *closure) {
     return (*custom_do_task)(user_context, f, idx, closure);
@@ -24,6 +24,8 @@ extern long dispatch_semaphore_wait(dispatch_semaphore_t dsema, dispatch_time_t
 extern long dispatch_semaphore_signal(dispatch_semaphore_t dsema);
 extern void dispatch_release(void *object);
 
+extern int sched_yield();
+
 }
 
 namespace Halide { namespace Runtime { namespace Internal {
@@ -130,6 +132,12 @@ namespace Halide { namespace Runtime { namespace Internal {
 WEAK halide_do_task_t custom_do_task = halide_default_do_task;
 WEAK halide_do_par_for_t custom_do_par_for = halide_default_do_par_for;
 
+// Semaphore waiters spin here, so a helper thread sleeping on one
+// would burn a core.
+WEAK bool halide_helper_threads_supported() {
+    return false;
+}
+
 }}}  // namespace Halide::Runtime::Internal
 
 extern "C" {
@@ -156,6 +164,26 @@ WEAK void halide_mutex_unlock(halide_mutex *mutex_arg) {
 WEAK void halide_shutdown_thread_pool() {
 }
 
+// Semaphores must work from zero-initialized memory and need no
+// cleanup, so rather than wrapping a dispatch semaphore, waiters
+// poll the count, yielding between polls.
+WEAK int halide_semaphore_release(halide_semaphore_t *s, int n) {
+    int *value = (int *)s;
+    __sync_fetch_and_add(value, n);
+    return 0;
+}
+
+WEAK int halide_semaphore_acquire(halide_semaphore_t *s, int n) {
+    volatile int *value = (volatile int *)s;
+    while (true) {
+        int old = *value;
+        if (old >= n && __sync_bool_compare_and_swap(value, old, old - n)) {
+            return 0;
+        }
+        sched_yield();
+    }
+}
+
 WEAK int halide_set_num_threads(int n) {
     if (n < 0) {
         halide_error(NULL, "halide_set_num_threads: must be >= 0.");
@@ -165,6 +193,26 @@ WEAK int halide_set_num_threads(int n) {
     return old_custom_num_threads;
 }
 
+WEAK int halide_set_numa_placement(int enabled) {
+    return enabled ? -1 : 0;
+}
+
+WEAK int halide_set_thread_pool_spin_count(int spin_count) {
+    return 0;
+}
+
+WEAK void halide_thread_pool_get_stats(halide_thread_pool_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+WEAK void halide_thread_pool_reset_stats() {
+}
+
+WEAK int halide_set_thread_pool_scheduler(int scheduler) {
+    // There is only one way to schedule work here.
+    return halide_thread_pool_scheduler_default;
+}
+
 WEAK halide_do_task_t halide_set_custom_do_task(halide_do_task_t f) {
     halide_do_task_t result = custom_do_task;
     custom_do_task = f;
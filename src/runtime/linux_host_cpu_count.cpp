@@ -1,11 +1,126 @@
 #include "HalideRuntime.h"
+#include "runtime_internal.h"
 
 extern "C" {
 
 extern long sysconf(int);
+extern int sched_getaffinity(int pid, size_t cpusetsize, void *mask);
+extern int sched_setaffinity(int pid, size_t cpusetsize, const void *mask);
+extern size_t fread(void *, size_t, size_t, void *);
+
+} // extern "C"
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// Same layout as glibc's cpu_set_t, which supports 1024 CPUs.
+#define MAX_CPUS 1024
+#define MAX_NUMA_NODES 64
+struct cpu_mask {
+    uint64_t bits[MAX_CPUS / 64];
+    bool get(int cpu) const {
+        return (bits[cpu / 64] >> (cpu % 64)) & 1;
+    }
+    void set(int cpu) {
+        bits[cpu / 64] |= (uint64_t)1 << (cpu % 64);
+    }
+};
+
+// Append the allowed CPUs in a Linux cpulist string
+// (e.g. "0-15,32-47") to cpus, skipping any already placed.
+WEAK int append_cpu_list(const char *list, const cpu_mask &allowed, cpu_mask &placed,
+                         int *cpus, int num_cpus, int max_cpus) {
+    const char *p = list;
+    while (*p >= '0' && *p <= '9') {
+        int first = atoi(p);
+        while (*p >= '0' && *p <= '9') p++;
+        int last = first;
+        if (*p == '-') {
+            p++;
+            last = atoi(p);
+            while (*p >= '0' && *p <= '9') p++;
+        }
+        for (int cpu = first; cpu <= last && cpu < MAX_CPUS; cpu++) {
+            if (num_cpus < max_cpus && allowed.get(cpu) && !placed.get(cpu)) {
+                placed.set(cpu);
+                cpus[num_cpus++] = cpu;
+            }
+        }
+        if (*p == ',') p++;
+    }
+    return num_cpus;
+}
+
+// The affinity mask of the process before any threads were pinned.
+WEAK cpu_mask original_affinity;
+WEAK bool original_affinity_saved = false;
+
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
 
 WEAK int halide_host_cpu_count() {
     return sysconf(84);
 }
 
+WEAK int halide_host_cpus_by_numa_node(int *cpus, int max_cpus) {
+    // Only consider CPUs we're allowed to run on (e.g. respect taskset
+    // and container cpusets).
+    cpu_mask allowed, placed;
+    memset(&placed, 0, sizeof(placed));
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return 0;
+    }
+    // Remember the CPUs we started out with, so that unpinning a
+    // thread restores them rather than allowing every CPU.
+    if (!original_affinity_saved) {
+        original_affinity = allowed;
+        original_affinity_saved = true;
+    }
+
+    int num_cpus = 0;
+    for (int node = 0; node < MAX_NUMA_NODES; node++) {
+        char path[64], list[1024];
+        char *end = path + sizeof(path);
+        char *dst = halide_string_to_string(path, end, "/sys/devices/system/node/node");
+        dst = halide_int64_to_string(dst, end, node, 1);
+        halide_string_to_string(dst, end, "/cpulist");
+        void *f = fopen(path, "r");
+        if (!f) {
+            continue;
+        }
+        size_t bytes = fread(list, 1, sizeof(list) - 1, f);
+        fclose(f);
+        list[bytes] = 0;
+        num_cpus = append_cpu_list(list, allowed, placed, cpus, num_cpus, max_cpus);
+    }
+
+    // Kernels without NUMA support have no node directories. Treat
+    // anything not listed as belonging to one more node.
+    for (int cpu = 0; cpu < MAX_CPUS && num_cpus < max_cpus; cpu++) {
+        if (allowed.get(cpu) && !placed.get(cpu)) {
+            placed.set(cpu);
+            cpus[num_cpus++] = cpu;
+        }
+    }
+    return num_cpus;
+}
+
+WEAK int halide_pin_current_thread_to_cpu(int cpu) {
+    cpu_mask mask;
+    if (cpu < 0) {
+        if (!original_affinity_saved) {
+            // Nothing has been pinned yet.
+            return 0;
+        }
+        mask = original_affinity;
+    } else if (cpu < MAX_CPUS) {
+        memset(&mask, 0, sizeof(mask));
+        mask.set(cpu);
+    } else {
+        return -1;
+    }
+    // A pid of zero means the calling thread.
+    return sched_setaffinity(0, sizeof(mask), &mask);
+}
+
 }
@@ -0,0 +1,283 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+// Hardware performance counters for the profiler, read with
+// perf_event_open. Like linux_clock, this makes the syscalls directly
+// and is only used on x86.
+
+extern "C" {
+
+extern int syscall(int num, ...);
+extern ssize_t read(int fd, void *buf, size_t count);
+
+struct pollfd {
+    int fd;
+    short events;
+    short revents;
+};
+extern int poll(pollfd *fds, unsigned long nfds, int timeout);
+extern void *mmap(void *addr, size_t length, int prot, int flags, int fd, long offset);
+extern int munmap(void *addr, size_t length);
+
+}
+
+#ifdef BITS_64
+#define SYS_GETTID 186
+#define SYS_PERF_EVENT_OPEN 298
+#endif
+
+#ifdef BITS_32
+#define SYS_GETTID 224
+#define SYS_PERF_EVENT_OPEN 336
+#endif
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// The first version of the kernel's struct perf_event_attr. Newer
+// kernels accept it and zero the fields it lacks.
+struct perf_event_attr {
+    uint32_t type;
+    uint32_t size;
+    uint64_t config;
+    uint64_t sample_period;
+    uint64_t sample_type;
+    uint64_t read_format;
+    uint64_t flags;
+    uint32_t wakeup_events;
+    uint32_t bp_type;
+    uint64_t config1;
+    uint64_t config2;
+};
+
+#define PERF_TYPE_HARDWARE 0
+#define PERF_FORMAT_TOTAL_TIME_ENABLED (1 << 0)
+#define PERF_FORMAT_TOTAL_TIME_RUNNING (1 << 1)
+#define PERF_FORMAT_GROUP (1 << 3)
+#define PERF_FLAG_EXCLUDE_KERNEL (1 << 5)
+#define PERF_FLAG_EXCLUDE_HV (1 << 6)
+#define POLLHUP 0x10
+#define PROT_READ 1
+#define MAP_SHARED 1
+#define MAP_FAILED ((void *)-1)
+#define PAGE_SIZE 4096
+
+// The hardware events, in the order of halide_profiler_counter.
+WEAK uint64_t perf_event_configs[HALIDE_PROFILER_NUM_COUNTERS] = {
+    0, // PERF_COUNT_HW_CPU_CYCLES
+    1, // PERF_COUNT_HW_INSTRUCTIONS
+    3, // PERF_COUNT_HW_CACHE_MISSES
+    5, // PERF_COUNT_HW_BRANCH_MISSES
+};
+
+// What a read of a counter group returns.
+struct GroupReading {
+    uint64_t num_counters;
+    // How long the group was enabled, and how long it was actually
+    // counting. They differ when the kernel multiplexes more events
+    // than the hardware has counters.
+    uint64_t time_enabled;
+    uint64_t time_running;
+    uint64_t values[HALIDE_PROFILER_NUM_COUNTERS];
+};
+
+// Thread ids are reused by new threads once a thread exits, so an
+// entry only stands for the thread that was running when its counters
+// were opened. The kernel reports POLLHUP on the group leader once
+// that thread exits, at which point the entry is retired, and a new
+// thread with the same id gets counters of its own. (Until its first
+// page is mapped, the kernel reports POLLHUP on an event regardless.)
+#define THREAD_ID_FREE 0
+#define THREAD_ID_RETIRED (-1)
+
+struct CountedThread {
+    // Or one of the values above.
+    int thread_id;
+
+    // The fd of the group leader, or -1 if no counter could be opened.
+    int group_fd;
+    // The leader's first page, or NULL if it couldn't be mapped, in
+    // which case we can't tell when the thread exits.
+    void *group_page;
+
+    // A bitmask of the counters in the group, which the kernel
+    // returns in halide_profiler_counter order.
+    int available;
+    int num_counters;
+    int fds[HALIDE_PROFILER_NUM_COUNTERS];
+
+    GroupReading last;
+    uint64_t deltas[HALIDE_PROFILER_NUM_COUNTERS];
+};
+
+// Threads beyond this many aren't counted. Thread pools are created
+// once, so this is only reached by programs that keep making new
+// threads that run pipelines.
+#define MAX_COUNTED_THREADS 256
+
+// Only touched by the profiler's sampling thread, with the profiler
+// lock held.
+WEAK CountedThread counted_threads[MAX_COUNTED_THREADS];
+
+WEAK int perf_event_open(perf_event_attr *attr, int thread_id, int group_fd) {
+    return syscall(SYS_PERF_EVENT_OPEN, attr, thread_id, -1, group_fd, 0);
+}
+
+// Open as many of the counters as this machine and the
+// perf_event_paranoid setting allow for one thread. Counters that
+// can't be opened are skipped.
+WEAK void open_counters(CountedThread *t) {
+    t->group_fd = -1;
+    t->group_page = NULL;
+    t->available = 0;
+    t->num_counters = 0;
+    for (int i = 0; i < HALIDE_PROFILER_NUM_COUNTERS; i++) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = perf_event_configs[i];
+        attr.read_format = (PERF_FORMAT_GROUP |
+                            PERF_FORMAT_TOTAL_TIME_ENABLED |
+                            PERF_FORMAT_TOTAL_TIME_RUNNING);
+        attr.flags = PERF_FLAG_EXCLUDE_KERNEL | PERF_FLAG_EXCLUDE_HV;
+        int fd = perf_event_open(&attr, t->thread_id, t->group_fd);
+        if (fd < 0) {
+            continue;
+        }
+        if (t->group_fd < 0) {
+            t->group_fd = fd;
+            t->group_page = mmap(NULL, PAGE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+            if (t->group_page == MAP_FAILED) {
+                t->group_page = NULL;
+            }
+        }
+        t->available |= 1 << i;
+        t->fds[t->num_counters++] = fd;
+        t->deltas[i] = 0;
+    }
+    memset(&t->last, 0, sizeof(t->last));
+}
+
+WEAK void close_counters(CountedThread *t) {
+    if (t->group_page) {
+        munmap(t->group_page, PAGE_SIZE);
+        t->group_page = NULL;
+    }
+    for (int i = 0; i < t->num_counters; i++) {
+        close(t->fds[i]);
+    }
+    t->group_fd = -1;
+    t->num_counters = 0;
+    t->available = 0;
+}
+
+// Read all of a thread's counters at once and work out how much each
+// advanced by since the last read, scaled up by how much of that time
+// they were actually counting.
+WEAK void sample_counters(CountedThread *t) {
+    GroupReading now;
+    ssize_t bytes = read(t->group_fd, &now, sizeof(now));
+    if (bytes < (ssize_t)((t->num_counters + 3) * sizeof(uint64_t))) {
+        return;
+    }
+    uint64_t enabled = now.time_enabled - t->last.time_enabled;
+    uint64_t running = now.time_running - t->last.time_running;
+    double scale = running ? (double)enabled / running : 0.0;
+    int j = 0;
+    for (int i = 0; i < HALIDE_PROFILER_NUM_COUNTERS; i++) {
+        if (t->available & (1 << i)) {
+            t->deltas[i] = (uint64_t)((now.values[j] - t->last.values[j]) * scale);
+            j++;
+        }
+    }
+    t->last = now;
+}
+
+// Retire the entries of threads that have exited.
+WEAK void retire_exited_threads() {
+    pollfd fds[MAX_COUNTED_THREADS];
+    int entries[MAX_COUNTED_THREADS];
+    int n = 0;
+    for (int i = 0; i < MAX_COUNTED_THREADS; i++) {
+        CountedThread *t = counted_threads + i;
+        if (t->thread_id > 0 && t->group_page) {
+            fds[n].fd = t->group_fd;
+            fds[n].events = 0;
+            fds[n].revents = 0;
+            entries[n++] = i;
+        }
+    }
+    if (n == 0 || poll(fds, n, 0) <= 0) {
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        if (fds[i].revents & POLLHUP) {
+            CountedThread *t = counted_threads + entries[i];
+            close_counters(t);
+            t->thread_id = THREAD_ID_RETIRED;
+        }
+    }
+}
+
+}}}
+
+using namespace Halide::Runtime::Internal;
+
+extern "C" {
+
+WEAK int halide_perf_counters_thread_id() {
+    return syscall(SYS_GETTID);
+}
+
+WEAK void halide_perf_counters_sample() {
+    retire_exited_threads();
+    for (int i = 0; i < MAX_COUNTED_THREADS; i++) {
+        CountedThread *t = counted_threads + i;
+        if (t->thread_id > 0 && t->group_fd >= 0) {
+            sample_counters(t);
+        }
+    }
+}
+
+WEAK int halide_perf_counters_read(int thread_id, uint64_t *deltas) {
+    // Open addressing on the thread id.
+    CountedThread *retired = NULL;
+    for (int i = 0; i < MAX_COUNTED_THREADS; i++) {
+        CountedThread *t = counted_threads + (thread_id + i) % MAX_COUNTED_THREADS;
+        if (t->thread_id == thread_id) {
+            for (int j = 0; j < HALIDE_PROFILER_NUM_COUNTERS; j++) {
+                deltas[j] = (t->available & (1 << j)) ? t->deltas[j] : 0;
+            }
+            return t->available;
+        } else if (t->thread_id == THREAD_ID_RETIRED) {
+            if (!retired) {
+                retired = t;
+            }
+        } else if (t->thread_id == THREAD_ID_FREE) {
+            if (retired) {
+                t = retired;
+            }
+            // First time we've seen this thread. Its counters start
+            // now, so there is nothing to bill yet.
+            t->thread_id = thread_id;
+            open_counters(t);
+            if (t->group_fd >= 0) {
+                sample_counters(t);
+            }
+            return 0;
+        }
+    }
+    return 0;
+}
+
+WEAK void halide_perf_counters_shutdown() {
+    for (int i = 0; i < MAX_COUNTED_THREADS; i++) {
+        CountedThread *t = counted_threads + i;
+        if (t->thread_id > 0) {
+            close_counters(t);
+        }
+        t->thread_id = THREAD_ID_FREE;
+    }
+}
+
+}
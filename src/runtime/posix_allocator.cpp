@@ -1,12 +1,206 @@
 #include "HalideRuntime.h"
 #include "runtime_internal.h"
+#include "scoped_mutex_lock.h"
 
 extern "C" {
 
 extern void *malloc(size_t);
 extern void free(void *);
 
+}
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// Pipelines that are run many times tend to allocate the same
+// intermediate sizes on every run. When enabled, freed blocks are
+// kept on free lists, one per size class, and handed back out by
+// later allocations of the same class instead of going back to
+// malloc. There are no thread-locals in the runtime, so each thread
+// uses the set of free lists picked by the address of its stack,
+// which keeps threads from contending for the same lists.
+//
+// Block sizes are rounded up to one of four classes per power of two,
+// from 64 bytes to 64MB. Larger blocks always go to malloc.
+const int kPoolMinClassBits = 6;
+const int kPoolMaxClassBits = 26;
+const int kPoolClassesPerPowerOfTwo = 4;
+const int kPoolNumClasses = (kPoolMaxClassBits - kPoolMinClassBits) * kPoolClassesPerPowerOfTwo + 1;
+const int kPoolNumStripes = 16;
+
+struct PoolStripe {
+    halide_mutex lock;
+    void *free_list[kPoolNumClasses];
+};
+
+WEAK PoolStripe pool_stripes[kPoolNumStripes];
+
+// The maximum number of bytes held on the free lists. Zero disables
+// pooling.
+WEAK int64_t pool_limit = 0;
+WEAK bool pool_limit_set = false;
+// Updated atomically.
+WEAK int64_t pool_retained = 0;
+
+WEAK int64_t default_pool_limit() {
+    char *limit_str = getenv("HL_ALLOCATOR_POOL_SIZE");
+    if (!limit_str || *limit_str == '-') {
+        return 0;
+    }
+    // Pools may be larger than 2GB, so don't use atoi.
+    uint64_t limit = strtoull(limit_str, NULL, 10);
+    const uint64_t max_limit = ~(uint64_t)0 >> 1;
+    return (int64_t)(limit < max_limit ? limit : max_limit);
+}
+
+WEAK __attribute__((always_inline)) int64_t get_pool_limit() {
+    if (!pool_limit_set) {
+        // Racing threads will all compute the same value.
+        pool_limit = default_pool_limit();
+        pool_limit_set = true;
+    }
+    return pool_limit;
+}
+
+// The smallest size class that can hold x bytes, or -1 if x is too
+// large to pool.
+WEAK int pool_size_class(size_t x) {
+    if (x <= ((size_t)1 << kPoolMinClassBits)) {
+        return 0;
+    }
+    if (x > ((size_t)1 << kPoolMaxClassBits)) {
+        return -1;
+    }
+    int bits = 64 - __builtin_clzll((uint64_t)(x - 1));
+    // x is in (2^(bits-1), 2^bits]. Split that range in quarters.
+    size_t step = (size_t)1 << (bits - 1 - 2);
+    int quarter = (int)((x - 1 - ((size_t)1 << (bits - 1))) / step);
+    return (bits - 1 - kPoolMinClassBits) * kPoolClassesPerPowerOfTwo + quarter + 1;
+}
+
+WEAK size_t pool_class_bytes(int size_class) {
+    if (size_class == 0) {
+        return (size_t)1 << kPoolMinClassBits;
+    }
+    int bits = kPoolMinClassBits + (size_class - 1) / kPoolClassesPerPowerOfTwo;
+    int quarter = (size_class - 1) % kPoolClassesPerPowerOfTwo;
+    return ((size_t)1 << bits) + (quarter + 1) * ((size_t)1 << (bits - 2));
+}
+
+WEAK PoolStripe &pool_stripe_for_current_thread() {
+    // Thread stacks are megabytes apart.
+    int marker;
+    uintptr_t sp = (uintptr_t)&marker;
+    return pool_stripes[((sp >> 20) ^ (sp >> 24)) % kPoolNumStripes];
+}
+
+// Blocks from the pool store their size class just before the
+// original pointer, and mark the original pointer with its low bit.
+WEAK __attribute__((always_inline)) void *aligned_block(void *orig, size_t header, size_t alignment) {
+    return (void *)(((size_t)orig + alignment + header - 1) & ~(alignment - 1));
+}
+
+WEAK void *pool_malloc(size_t x) {
+    int size_class = pool_size_class(x);
+    if (size_class < 0) {
+        return NULL;
+    }
+
+    PoolStripe &stripe = pool_stripe_for_current_thread();
+    {
+        ScopedMutexLock lock(&stripe.lock);
+        void *ptr = stripe.free_list[size_class];
+        if (ptr) {
+            stripe.free_list[size_class] = *(void **)ptr;
+            __sync_fetch_and_sub(&pool_retained, pool_class_bytes(size_class));
+            return ptr;
+        }
+    }
+
+    const size_t alignment = halide_malloc_alignment();
+    void *orig = malloc(pool_class_bytes(size_class) + alignment + 2 * sizeof(void *));
+    if (orig == NULL) {
+        return NULL;
+    }
+    void *ptr = aligned_block(orig, 2 * sizeof(void *), alignment);
+    ((void **)ptr)[-1] = (void *)((size_t)orig | 1);
+    ((size_t *)ptr)[-2] = size_class;
+    return ptr;
+}
+
+// Returns false if the block should be freed instead.
+WEAK bool pool_free(void *ptr) {
+    int size_class = (int)((size_t *)ptr)[-2];
+    size_t bytes = pool_class_bytes(size_class);
+    if (__sync_add_and_fetch(&pool_retained, bytes) > get_pool_limit()) {
+        __sync_fetch_and_sub(&pool_retained, bytes);
+        return false;
+    }
+
+    PoolStripe &stripe = pool_stripe_for_current_thread();
+    ScopedMutexLock lock(&stripe.lock);
+    // Pooling may have been turned off (and this stripe trimmed)
+    // since the check above.
+    if (__atomic_load_n(&pool_limit, __ATOMIC_ACQUIRE) == 0) {
+        __sync_fetch_and_sub(&pool_retained, bytes);
+        return false;
+    }
+    *(void **)ptr = stripe.free_list[size_class];
+    stripe.free_list[size_class] = ptr;
+    return true;
+}
+
+WEAK __attribute__((always_inline)) void free_block(void *ptr) {
+    free((void *)((size_t)((void **)ptr)[-1] & ~(size_t)1));
+}
+
+WEAK void pool_trim() {
+    for (int i = 0; i < kPoolNumStripes; i++) {
+        PoolStripe &stripe = pool_stripes[i];
+        ScopedMutexLock lock(&stripe.lock);
+        for (int c = 0; c < kPoolNumClasses; c++) {
+            void *ptr = stripe.free_list[c];
+            while (ptr) {
+                void *next = *(void **)ptr;
+                __sync_fetch_and_sub(&pool_retained, pool_class_bytes(c));
+                free_block(ptr);
+                ptr = next;
+            }
+            stripe.free_list[c] = NULL;
+        }
+    }
+}
+
+WEAK void set_pool_limit(int64_t size) {
+    pool_limit_set = true;
+    __atomic_store_n(&pool_limit, size > 0 ? size : 0, __ATOMIC_RELEASE);
+    if (__atomic_load_n(&pool_retained, __ATOMIC_RELAXED) > size) {
+        pool_trim();
+    }
+}
+
+// Other destructors, such as the memoization cache's, may free pooled
+// blocks after this one has run. Turning pooling off makes those go
+// straight back to the system instead of onto a free list that will
+// never be trimmed again.
+__attribute__((destructor))
+WEAK void halide_allocator_pool_cleanup() {
+    set_pool_limit(0);
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+using namespace Halide::Runtime::Internal;
+
+extern "C" {
+
 WEAK void *halide_default_malloc(void *user_context, size_t x) {
+    if (get_pool_limit() > 0) {
+        void *ptr = pool_malloc(x);
+        if (ptr) {
+            return ptr;
+        }
+    }
+
     // Allocate enough space for aligning the pointer we return.
     const size_t alignment = halide_malloc_alignment();
     void *orig = malloc(x + alignment);
@@ -15,13 +209,28 @@ WEAK void *halide_default_malloc(void *user_context, size_t x) {
         return NULL;
     }
     // We want to store the original pointer prior to the pointer we return.
-    void *ptr = (void *)(((size_t)orig + alignment + sizeof(void*) - 1) & ~(alignment - 1));
+    void *ptr = aligned_block(orig, sizeof(void *), alignment);
     ((void **)ptr)[-1] = orig;
     return ptr;
 }
 
 WEAK void halide_default_free(void *user_context, void *ptr) {
-    free(((void**)ptr)[-1]);
+    // Blocks from the pool go back to it, unless it is full.
+    bool pooled = ((size_t)((void **)ptr)[-1] & 1) != 0;
+    if (pooled && pool_free(ptr)) {
+        return;
+    }
+    free_block(ptr);
+}
+
+WEAK int64_t halide_set_allocator_pool_size(int64_t size) {
+    int64_t old_size = get_pool_limit();
+    set_pool_limit(size);
+    return old_size;
+}
+
+WEAK void halide_allocator_pool_trim() {
+    pool_trim();
 }
 
 }
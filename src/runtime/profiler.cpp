@@ -37,6 +37,8 @@ WEAK halide_profiler_pipeline_stats *find_or_create_pipeline(const char *pipelin
     p->first_func_id = s->first_free_id;
     p->num_funcs = num_funcs;
     p->runs = 0;
+    p->runs_in_progress = 0;
+    p->run_start = 0;
     p->time = 0;
     p->samples = 0;
     p->memory_current = 0;
@@ -45,6 +47,10 @@ WEAK halide_profiler_pipeline_stats *find_or_create_pipeline(const char *pipelin
     p->num_allocs = 0;
     p->active_threads_numerator = 0;
     p->active_threads_denominator = 0;
+    p->cpu_time = 0;
+    for (int i = 0; i < HALIDE_PROFILER_NUM_COUNTERS; i++) {
+        p->counters[i] = 0;
+    }
     p->funcs = (halide_profiler_func_stats *)malloc(num_funcs * sizeof(halide_profiler_func_stats));
     if (!p->funcs) {
         free(p);
@@ -60,13 +66,23 @@ WEAK halide_profiler_pipeline_stats *find_or_create_pipeline(const char *pipelin
         p->funcs[i].stack_peak = 0;
         p->funcs[i].active_threads_numerator = 0;
         p->funcs[i].active_threads_denominator = 0;
+        p->funcs[i].cpu_time = 0;
+        for (int j = 0; j < HALIDE_PROFILER_NUM_COUNTERS; j++) {
+            p->funcs[i].counters[j] = 0;
+        }
     }
     s->first_free_id += num_funcs;
     s->pipelines = p;
     return p;
 }
 
-WEAK void bill_func(halide_profiler_state *s, int func_id, uint64_t time, int active_threads) {
+// Bill a func for a share of a sample. time is the share of the
+// wall-clock time, and cpu_time is the time the thread running the
+// func spent in it. counters, if not null, is what that thread's
+// hardware performance counters advanced by. Only the first func
+// billed for a sample counts it.
+WEAK void bill_func(halide_profiler_state *s, int func_id, uint64_t time, uint64_t cpu_time,
+                    const uint64_t *counters, int active_threads, bool new_sample) {
     halide_profiler_pipeline_stats *p_prev = NULL;
     for (halide_profiler_pipeline_stats *p = s->pipelines; p;
          p = (halide_profiler_pipeline_stats *)(p->next)) {
@@ -79,12 +95,22 @@ WEAK void bill_func(halide_profiler_state *s, int func_id, uint64_t time, int ac
             }
             halide_profiler_func_stats *f = p->funcs + func_id - p->first_func_id;
             f->time += time;
+            f->cpu_time += cpu_time;
             f->active_threads_numerator += active_threads;
             f->active_threads_denominator += 1;
             p->time += time;
-            p->samples++;
-            p->active_threads_numerator += active_threads;
-            p->active_threads_denominator += 1;
+            p->cpu_time += cpu_time;
+            if (counters) {
+                for (int i = 0; i < HALIDE_PROFILER_NUM_COUNTERS; i++) {
+                    f->counters[i] += counters[i];
+                    p->counters[i] += counters[i];
+                }
+            }
+            if (new_sample) {
+                p->samples++;
+                p->active_threads_numerator += active_threads;
+                p->active_threads_denominator += 1;
+            }
             return;
         }
         p_prev = p;
@@ -92,6 +118,253 @@ WEAK void bill_func(halide_profiler_state *s, int func_id, uint64_t time, int ac
     // Someone must have called reset_state while a kernel was running. Do nothing.
 }
 
+// Bill the time since the last sample to whatever each thread is
+// computing. The thread that launched the pipeline reports its func
+// in current_func, and threads running tasks of parallel loops report
+// theirs in thread slots. The wall-clock time is split evenly between
+// them, so that the funcs of a pipeline add up to its running time.
+WEAK void bill_threads(halide_profiler_state *s, int main_func, uint64_t time, int active_threads,
+                       bool read_counters) {
+    int funcs[HALIDE_PROFILER_MAX_THREAD_SLOTS + 1];
+    int thread_ids[HALIDE_PROFILER_MAX_THREAD_SLOTS + 1];
+    int num_funcs = 0;
+    if (main_func >= 0) {
+        thread_ids[num_funcs] = s->main_thread_id;
+        funcs[num_funcs++] = main_func;
+    }
+    for (int i = 0; i < HALIDE_PROFILER_MAX_THREAD_SLOTS; i++) {
+        const halide_profiler_thread_slot &slot = s->thread_slots[i];
+        if (slot.in_use) {
+            int func = slot.current_func;
+            if (func >= 0) {
+                thread_ids[num_funcs] = slot.thread_id;
+                funcs[num_funcs++] = func;
+            }
+        }
+    }
+    if (read_counters) {
+        // Read every thread's counters, even those not computing a
+        // func right now, so that what they count while idle isn't
+        // billed to the next func they run.
+        halide_perf_counters_sample();
+    }
+    for (int i = 0; i < num_funcs; i++) {
+        uint64_t counters[HALIDE_PROFILER_NUM_COUNTERS];
+        bool have_counters = false;
+        if (read_counters && thread_ids[i]) {
+            int available = halide_perf_counters_read(thread_ids[i], counters);
+            s->counters_available |= available;
+            have_counters = available != 0;
+        }
+        bill_func(s, funcs[i], time / num_funcs, time, have_counters ? counters : NULL,
+                  active_threads, i == 0);
+    }
+}
+
+
+// A span of time one thread spent in one Func, or that one run of a
+// pipeline took, for the timeline written by
+// halide_profiler_report_timeline. Func spans are seen by the
+// sampling thread, so their boundaries are only as precise as the
+// sampling interval.
+struct TimelineSpan {
+    int func_id;
+    // Zero for a whole run of a pipeline, one for the thread that
+    // launched it, and two onwards for the thread slots.
+    int thread;
+    uint64_t start, end;
+};
+
+// Spans beyond this many are counted but not kept.
+#define MAX_TIMELINE_SPANS (1 << 20)
+
+struct Timeline {
+    TimelineSpan *spans;
+    int count, capacity;
+    uint64_t dropped;
+
+    // What each thread was last seen computing, and since when.
+    int current[HALIDE_PROFILER_MAX_THREAD_SLOTS + 2];
+    uint64_t since[HALIDE_PROFILER_MAX_THREAD_SLOTS + 2];
+};
+
+WEAK Timeline timeline;
+
+// Optional modes, set from the environment when the first pipeline
+// starts.
+WEAK bool timeline_enabled = false;
+WEAK bool perf_counters_enabled = false;
+WEAK bool checked_env = false;
+
+WEAK void add_timeline_span(int func_id, int thread, uint64_t start, uint64_t end) {
+    if (timeline.count == timeline.capacity) {
+        if (timeline.capacity == MAX_TIMELINE_SPANS) {
+            timeline.dropped++;
+            return;
+        }
+        int new_capacity = timeline.capacity ? timeline.capacity * 2 : 1024;
+        TimelineSpan *new_spans = (TimelineSpan *)malloc(new_capacity * sizeof(TimelineSpan));
+        if (!new_spans) {
+            timeline.dropped++;
+            return;
+        }
+        if (timeline.spans) {
+            memcpy(new_spans, timeline.spans, timeline.count * sizeof(TimelineSpan));
+            free(timeline.spans);
+        }
+        timeline.spans = new_spans;
+        timeline.capacity = new_capacity;
+    }
+    TimelineSpan &span = timeline.spans[timeline.count++];
+    span.func_id = func_id;
+    span.thread = thread;
+    span.start = start;
+    span.end = end;
+}
+
+// Close the span of any thread whose Func has changed since the last
+// sample, and open a new one. Must be called with the lock held.
+WEAK void update_timeline(halide_profiler_state *s, int main_func, bool check_slots, uint64_t t_now) {
+    for (int i = 1; i < HALIDE_PROFILER_MAX_THREAD_SLOTS + 2; i++) {
+        int func = halide_profiler_outside_of_halide;
+        if (i == 1) {
+            func = main_func;
+        } else if (check_slots && s->thread_slots[i - 2].in_use) {
+            func = s->thread_slots[i - 2].current_func;
+        }
+        if (func != timeline.current[i]) {
+            if (timeline.current[i] >= 0) {
+                add_timeline_span(timeline.current[i], i, timeline.since[i], t_now);
+            }
+            timeline.current[i] = func;
+            timeline.since[i] = t_now;
+        }
+    }
+}
+
+WEAK void clear_timeline() {
+    free(timeline.spans);
+    timeline.spans = NULL;
+    timeline.count = timeline.capacity = 0;
+    timeline.dropped = 0;
+    for (int i = 0; i < HALIDE_PROFILER_MAX_THREAD_SLOTS + 2; i++) {
+        timeline.current[i] = halide_profiler_outside_of_halide;
+    }
+}
+
+// Accumulates JSON text and writes it to a file in chunks.
+class JsonWriter {
+    void *f;
+    bool failed;
+    char buf[4096];
+    Printer<StringStreamPrinter, sizeof(buf)> sstr;
+
+public:
+    JsonWriter(void *user_context, const char *filename) :
+        f(fopen(filename, "w")), failed(false), sstr(user_context, buf) {
+    }
+
+    ~JsonWriter() {
+        if (f) {
+            fclose(f);
+        }
+    }
+
+    bool open() const {
+        return f != NULL;
+    }
+
+    // Write out what has been accumulated once there is enough of
+    // it. Each call site adds less than this margin in between.
+    void maybe_flush() {
+        if (sstr.size() > sizeof(buf) / 2) {
+            flush();
+        }
+    }
+
+    bool flush() {
+        if (sstr.size() && !fwrite(sstr.str(), sstr.size(), 1, f)) {
+            failed = true;
+        }
+        sstr.clear();
+        return !failed;
+    }
+
+    Printer<StringStreamPrinter, sizeof(buf)> &out() {
+        return sstr;
+    }
+
+    // Func and pipeline names shouldn't contain anything that needs
+    // escaping, but a stray quote would make the whole file invalid.
+    void quoted(const char *str) {
+        char escaped[512];
+        char *dst = escaped;
+        char *end = escaped + sizeof(escaped) - 2;
+        for (; *str && dst < end; str++) {
+            if (*str == '"' || *str == '\\') {
+                *dst++ = '\\';
+            }
+            *dst++ = *str;
+        }
+        *dst = 0;
+        sstr << "\"" << escaped << "\"";
+    }
+};
+
+// Print what can be derived from the hardware performance counters
+// that were collected.
+template<typename P>
+void print_counters(P &sstr, const uint64_t *counters, int available) {
+    const int cycles = 1 << halide_profiler_cycles;
+    const int instructions = 1 << halide_profiler_instructions;
+    const int llc_misses = 1 << halide_profiler_llc_misses;
+    const int branch_misses = 1 << halide_profiler_branch_misses;
+    uint64_t kinstr = counters[halide_profiler_instructions] / 1000;
+    if ((available & (cycles | instructions)) == (cycles | instructions) &&
+        counters[halide_profiler_cycles]) {
+        sstr << " ipc: " << (float)counters[halide_profiler_instructions] / counters[halide_profiler_cycles];
+        sstr.erase(4);
+    }
+    if (available & llc_misses) {
+        if ((available & instructions) && kinstr) {
+            sstr << " llc misses/kinstr: " << (float)counters[halide_profiler_llc_misses] / kinstr;
+            sstr.erase(4);
+        } else {
+            sstr << " llc misses: " << counters[halide_profiler_llc_misses];
+        }
+    }
+    if (available & branch_misses) {
+        if ((available & instructions) && kinstr) {
+            sstr << " branch misses/kinstr: " << (float)counters[halide_profiler_branch_misses] / kinstr;
+            sstr.erase(4);
+        } else {
+            sstr << " branch misses: " << counters[halide_profiler_branch_misses];
+        }
+    }
+}
+
+// Add the hardware performance counters that were collected to a
+// JSON object.
+WEAK void json_counters(JsonWriter &w, const uint64_t *counters, int available) {
+    const char *names[HALIDE_PROFILER_NUM_COUNTERS] = {"cycles", "instructions", "llc_misses", "branch_misses"};
+    for (int i = 0; i < HALIDE_PROFILER_NUM_COUNTERS; i++) {
+        if (available & (1 << i)) {
+            w.out() << ", \"" << names[i] << "\": " << counters[i];
+        }
+    }
+}
+
+// Find the pipeline a func id belongs to.
+WEAK halide_profiler_pipeline_stats *find_pipeline_of_func(halide_profiler_state *s, int func_id) {
+    for (halide_profiler_pipeline_stats *p = s->pipelines; p;
+         p = (halide_profiler_pipeline_stats *)(p->next)) {
+        if (func_id >= p->first_func_id && func_id < p->first_func_id + p->num_funcs) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
 WEAK void sampling_profiler_thread(void *) {
     halide_profiler_state *s = halide_profiler_get_state();
 
@@ -104,7 +377,8 @@ WEAK void sampling_profiler_thread(void *) {
         uint64_t t = t1;
         while (1) {
             int func, active_threads;
-            if (s->get_remote_profiler_state) {
+            bool remote = s->get_remote_profiler_state != NULL;
+            if (remote) {
                 // Execution has disappeared into remote code running
                 // on an accelerator (e.g. Hexagon DSP)
                 s->get_remote_profiler_state(&func, &active_threads);
@@ -113,12 +387,20 @@ WEAK void sampling_profiler_thread(void *) {
                 active_threads = s->active_threads;
             }
             uint64_t t_now = halide_current_time_ns(NULL);
+            if (timeline_enabled) {
+                update_timeline(s, func == halide_profiler_please_stop ? halide_profiler_outside_of_halide : func,
+                                !remote && func != halide_profiler_please_stop, t_now);
+            }
             if (func == halide_profiler_please_stop) {
                 break;
-            } else if (func >= 0) {
+            } else if (remote) {
                 // Assume all time since I was last awake is due to
                 // the currently running func.
-                bill_func(s, func, t_now - t, active_threads);
+                if (func >= 0) {
+                    bill_func(s, func, t_now - t, t_now - t, NULL, active_threads, true);
+                }
+            } else {
+                bill_threads(s, func, t_now - t, active_threads, perf_counters_enabled);
             }
             t = t_now;
 
@@ -180,6 +462,14 @@ WEAK int halide_profiler_pipeline_start(void *user_context,
 
     ScopedMutexLock lock(&s->lock);
 
+    if (!checked_env) {
+        checked_env = true;
+        timeline_enabled = getenv("HL_PROFILER_TIMELINE") != NULL;
+        clear_timeline();
+        const char *counters = getenv("HL_PROFILER_COUNTERS");
+        perf_counters_enabled = counters && counters[0] && strcmp(counters, "0");
+    }
+
     if (!s->started) {
         halide_start_clock(user_context);
         halide_spawn_thread(sampling_profiler_thread, NULL);
@@ -194,9 +484,45 @@ WEAK int halide_profiler_pipeline_start(void *user_context,
     }
     p->runs++;
 
+    if (perf_counters_enabled) {
+        s->main_thread_id = halide_perf_counters_thread_id();
+    }
+
+    if (timeline_enabled && p->runs_in_progress++ == 0) {
+        p->run_start = halide_current_time_ns(user_context);
+    }
+
     return p->first_func_id;
 }
 
+WEAK int *halide_profiler_acquire_thread_slot(void *state) {
+    halide_profiler_state *s = (halide_profiler_state *)state;
+    for (int i = 0; i < HALIDE_PROFILER_MAX_THREAD_SLOTS; i++) {
+        halide_profiler_thread_slot *slot = s->thread_slots + i;
+        if (!slot->in_use && __sync_bool_compare_and_swap(&slot->in_use, 0, 1)) {
+            slot->current_func = halide_profiler_outside_of_halide;
+            if (perf_counters_enabled) {
+                slot->thread_id = halide_perf_counters_thread_id();
+            }
+            return &slot->current_func;
+        }
+    }
+    return &s->unattributed_func;
+}
+
+// Registered as a destructor of the task, so that the slot is
+// released however the task exits.
+WEAK void halide_profiler_release_thread_slot_as_destructor(void *user_context, void *obj) {
+    halide_profiler_state *s = halide_profiler_get_state();
+    int *current_func = (int *)obj;
+    if (current_func != &s->unattributed_func) {
+        halide_profiler_thread_slot *slot = (halide_profiler_thread_slot *)current_func;
+        slot->current_func = halide_profiler_outside_of_halide;
+        __sync_synchronize();
+        slot->in_use = 0;
+    }
+}
+
 WEAK void halide_profiler_stack_peak_update(void *user_context,
                                             void *pipeline_state,
                                             uint64_t *f_values) {
@@ -305,10 +631,15 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
              << "  runs: " << p->runs
              << "  time/run: " << t / p->runs << " ms\n";
         if (!serial) {
-            sstr << " average threads used: " << threads << "\n";
+            sstr << " average threads used: " << threads
+                 << "  cpu time/run: " << p->cpu_time / (p->runs * 1000000.0f) << " ms\n";
         }
         sstr << " heap allocations: " << p->num_allocs
              << "  peak heap usage: " << p->memory_peak << " bytes\n";
+        if (s->counters_available) {
+            print_counters(sstr, p->counters, s->counters_available);
+            sstr << "\n";
+        }
         halide_print(user_context, sstr.str());
 
         bool print_f_states = p->time || p->memory_total;
@@ -358,6 +689,13 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
                     sstr.erase(3);
                     cursor += 15;
                     while (sstr.size() < cursor) sstr << " ";
+
+                    float cpu = fs->cpu_time / (p->runs * 1000000.0f);
+                    sstr << "cpu: " << cpu;
+                    sstr.erase(3);
+                    sstr << "ms";
+                    cursor += 15;
+                    while (sstr.size() < cursor) sstr << " ";
                 }
 
                 int alloc_avg = 0;
@@ -377,6 +715,9 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
                 if (fs->stack_peak > 0) {
                     sstr << " stack: " << fs->stack_peak;
                 }
+                if (s->counters_available && fs->time) {
+                    print_counters(sstr, fs->counters, s->counters_available);
+                }
                 sstr << "\n";
 
                 halide_print(user_context, sstr.str());
@@ -391,6 +732,120 @@ WEAK void halide_profiler_report(void *user_context) {
     halide_profiler_report_unlocked(user_context, s);
 }
 
+WEAK int halide_profiler_report_json_unlocked(void *user_context, halide_profiler_state *s, const char *filename) {
+    JsonWriter w(user_context, filename);
+    if (!w.open()) {
+        error(user_context) << "Failed to open profiler report file " << filename << "\n";
+        return halide_error_code_generic_error;
+    }
+
+    w.out() << "{\"pipelines\": [";
+    bool first_pipeline = true;
+    for (halide_profiler_pipeline_stats *p = s->pipelines; p;
+         p = (halide_profiler_pipeline_stats *)(p->next)) {
+        if (!p->runs) continue;
+        w.out() << (first_pipeline ? "\n" : ",\n") << "  {\"name\": ";
+        first_pipeline = false;
+        w.quoted(p->name);
+        w.out() << ", \"runs\": " << p->runs
+                << ", \"samples\": " << p->samples
+                << ", \"time_ns\": " << p->time
+                << ", \"cpu_time_ns\": " << p->cpu_time
+                << ", \"average_threads\": "
+                << (float)(p->active_threads_numerator / (p->active_threads_denominator + 1e-10))
+                << ", \"memory_current\": " << p->memory_current
+                << ", \"memory_peak\": " << p->memory_peak
+                << ", \"memory_total\": " << p->memory_total
+                << ", \"num_allocs\": " << p->num_allocs;
+        json_counters(w, p->counters, s->counters_available);
+        w.out() << ",\n   \"funcs\": [";
+        for (int i = 0; i < p->num_funcs; i++) {
+            halide_profiler_func_stats *fs = p->funcs + i;
+            w.out() << (i == 0 ? "\n" : ",\n") << "    {\"name\": ";
+            w.quoted(fs->name);
+            w.out() << ", \"time_ns\": " << fs->time
+                    << ", \"cpu_time_ns\": " << fs->cpu_time
+                    << ", \"average_threads\": "
+                    << (float)(fs->active_threads_numerator / (fs->active_threads_denominator + 1e-10))
+                    << ", \"memory_current\": " << fs->memory_current
+                    << ", \"memory_peak\": " << fs->memory_peak
+                    << ", \"memory_total\": " << fs->memory_total
+                    << ", \"num_allocs\": " << fs->num_allocs
+                    << ", \"stack_peak\": " << fs->stack_peak;
+            json_counters(w, fs->counters, s->counters_available);
+            w.out() << "}";
+            w.maybe_flush();
+        }
+        w.out() << "]}";
+        w.maybe_flush();
+    }
+    w.out() << "\n]}\n";
+
+    if (!w.flush()) {
+        error(user_context) << "Failed to write profiler report file " << filename << "\n";
+        return halide_error_code_generic_error;
+    }
+    return halide_error_code_success;
+}
+
+WEAK int halide_profiler_report_json(void *user_context, const char *filename) {
+    halide_profiler_state *s = halide_profiler_get_state();
+    ScopedMutexLock lock(&s->lock);
+    return halide_profiler_report_json_unlocked(user_context, s, filename);
+}
+
+WEAK int halide_profiler_report_timeline_unlocked(void *user_context, halide_profiler_state *s, const char *filename) {
+    JsonWriter w(user_context, filename);
+    if (!w.open()) {
+        error(user_context) << "Failed to open profiler timeline file " << filename << "\n";
+        return halide_error_code_generic_error;
+    }
+
+    // Chrome's trace viewer (about:tracing) format. Times are in
+    // microseconds.
+    w.out() << "{\"displayTimeUnit\": \"ms\",\n"
+            << " \"otherData\": {\"dropped_spans\": " << timeline.dropped << "},\n"
+            << " \"traceEvents\": [\n"
+            << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": 0, \"args\": {\"name\": \"pipeline runs\"}},\n"
+            << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": 1, \"args\": {\"name\": \"launching thread\"}}";
+    bool seen_slot[HALIDE_PROFILER_MAX_THREAD_SLOTS + 2] = {false};
+    for (int i = 0; i < timeline.count; i++) {
+        const TimelineSpan &span = timeline.spans[i];
+        halide_profiler_pipeline_stats *p = find_pipeline_of_func(s, span.func_id);
+        if (!p) continue;
+        if (span.thread >= 2 && !seen_slot[span.thread]) {
+            seen_slot[span.thread] = true;
+            w.out() << ",\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << span.thread
+                    << ", \"args\": {\"name\": \"thread slot " << span.thread - 2 << "\"}}";
+        }
+        w.out() << ",\n  {\"name\": ";
+        if (span.thread == 0) {
+            w.quoted(p->name);
+        } else {
+            w.quoted(p->funcs[span.func_id - p->first_func_id].name);
+        }
+        w.out() << ", \"cat\": ";
+        w.quoted(p->name);
+        w.out() << ", \"ph\": \"X\", \"pid\": 0, \"tid\": " << span.thread
+                << ", \"ts\": " << span.start / 1000
+                << ", \"dur\": " << (span.end - span.start) / 1000 << "}";
+        w.maybe_flush();
+    }
+    w.out() << "\n]}\n";
+
+    if (!w.flush()) {
+        error(user_context) << "Failed to write profiler timeline file " << filename << "\n";
+        return halide_error_code_generic_error;
+    }
+    return halide_error_code_success;
+}
+
+WEAK int halide_profiler_report_timeline(void *user_context, const char *filename) {
+    halide_profiler_state *s = halide_profiler_get_state();
+    ScopedMutexLock lock(&s->lock);
+    return halide_profiler_report_timeline_unlocked(user_context, s, filename);
+}
+
 
 WEAK void halide_profiler_reset() {
     // WARNING: Do not call this method while any other halide
@@ -408,6 +863,7 @@ WEAK void halide_profiler_reset() {
         free(p);
     }
     s->first_free_id = 0;
+    clear_timeline();
 }
 
 namespace {
@@ -425,6 +881,13 @@ WEAK void halide_profiler_shutdown() {
     // Print results. No need to lock anything because we just shut
     // down the thread.
     halide_profiler_report_unlocked(NULL, s);
+    if (const char *filename = getenv("HL_PROFILER_JSON")) {
+        halide_profiler_report_json_unlocked(NULL, s, filename);
+    }
+    if (const char *filename = getenv("HL_PROFILER_TIMELINE")) {
+        halide_profiler_report_timeline_unlocked(NULL, s, filename);
+    }
+    halide_perf_counters_shutdown();
 
     // Leak the memory. Not all implementations of ScopedMutexLock may
     // be safe to use at static destruction time (windows).
@@ -432,8 +895,17 @@ WEAK void halide_profiler_shutdown() {
 }
 }
 
-WEAK void halide_profiler_pipeline_end(void *user_context, void *state) {
-    ((halide_profiler_state *)state)->current_func = halide_profiler_outside_of_halide;
+WEAK void halide_profiler_pipeline_end(void *user_context, void *pipeline_state) {
+    halide_profiler_state *s = halide_profiler_get_state();
+    s->current_func = halide_profiler_outside_of_halide;
+    if (timeline_enabled) {
+        halide_profiler_pipeline_stats *p = (halide_profiler_pipeline_stats *)pipeline_state;
+        ScopedMutexLock lock(&s->lock);
+        if (p->runs_in_progress > 0 && --p->runs_in_progress == 0) {
+            add_timeline_span(p->first_func_id, 0, p->run_start,
+                              halide_current_time_ns(user_context));
+        }
+    }
 }
 
 } // extern "C"
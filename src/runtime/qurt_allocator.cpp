@@ -119,4 +119,12 @@ WEAK void halide_free(void *user_context, void *ptr) {
     halide_default_free(user_context, ptr);
 }
 
+// The fixed pool above is used instead.
+WEAK int64_t halide_set_allocator_pool_size(int64_t size) {
+    return 0;
+}
+
+WEAK void halide_allocator_pool_trim() {
+}
+
 }
@@ -18,6 +18,14 @@ int halide_host_cpu_count() {
     return 4;
 }
 
+int halide_host_cpus_by_numa_node(int *cpus, int max_cpus) {
+    return 0;
+}
+
+int halide_pin_current_thread_to_cpu(int cpu) {
+    return -1;
+}
+
 namespace {
 struct spawned_thread {
     void (*f)(void *);
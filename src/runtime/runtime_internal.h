@@ -64,6 +64,7 @@ void free(void *);
 void *malloc(size_t);
 const char *strstr(const char *, const char *);
 int atoi(const char *);
+unsigned long long strtoull(const char *, char **, int);
 int strcmp(const char* s, const char* t);
 int strncmp(const char* s, const char* t, size_t n);
 size_t strlen(const char* s);
@@ -134,8 +135,34 @@ WEAK int halide_profiler_pipeline_start(void *user_context,
                                         const char *pipeline_name,
                                         int num_funcs,
                                         const uint64_t *func_names);
+// The state is declared as void* for the same reason. Tasks of
+// parallel loops claim a slot to report their current func in, and
+// register the release as a destructor.
+WEAK int *halide_profiler_acquire_thread_slot(void *state);
+WEAK void halide_profiler_release_thread_slot_as_destructor(void *user_context, void *slot);
+// Hardware performance counters for the profiler. The OS id of the
+// calling thread, or zero if counters aren't supported. sample reads
+// the counters of every thread seen so far, and read returns what
+// one thread's counters advanced by at the last sample, along with a
+// bitmask of which counters could be collected. shutdown closes them
+// all.
+WEAK int halide_perf_counters_thread_id();
+WEAK void halide_perf_counters_sample();
+WEAK int halide_perf_counters_read(int thread_id, uint64_t *deltas);
+WEAK void halide_perf_counters_shutdown();
+
 WEAK int halide_host_cpu_count();
 
+// Fill in up to max_cpus ids of the CPUs this process may run on,
+// ordered so that CPUs on the same NUMA node are adjacent. Returns
+// the number of CPUs written, or zero if the topology can't be
+// queried on this platform.
+WEAK int halide_host_cpus_by_numa_node(int *cpus, int max_cpus);
+// Restrict the calling thread to the given CPU, or restore the CPUs
+// the process was originally allowed to run on if cpu is
+// negative. Returns zero on success.
+WEAK int halide_pin_current_thread_to_cpu(int cpu);
+
 WEAK int halide_device_and_host_malloc(void *user_context, struct halide_buffer_t *buf,
                                        const struct halide_device_interface_t *device_interface);
 WEAK int halide_device_and_host_free(void *user_context, struct halide_buffer_t *buf);
@@ -185,6 +212,11 @@ namespace Halide { namespace Runtime { namespace Internal {
 extern WEAK void halide_use_jit_module();
 extern WEAK void halide_release_jit_module();
 
+// Whether halide_spawn_thread can be used for a long-running helper
+// thread that sleeps on a halide_semaphore_t. Defined by each thread
+// pool.
+extern WEAK bool halide_helper_threads_supported();
+
 // Return a mask with all CPU-specific features supported by the current CPU set.
 struct CpuFeatures {
     uint64_t known;     // mask of the CPU features we know how to detect
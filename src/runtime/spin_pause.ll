@@ -0,0 +1,6 @@
+; Used by the thread pool on architectures without a spin-wait hint
+; instruction. Only acts as a compiler barrier.
+define weak_odr void @spin_pause_halide() nounwind {
+  call void asm sideeffect "", "~{memory}"()
+  ret void
+}
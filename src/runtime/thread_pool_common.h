@@ -1,6 +1,25 @@
 
 namespace Halide { namespace Runtime { namespace Internal {
 
+// Defined per architecture in *spin_pause.ll. Emits pause on x86 and
+// yield on ARM.
+extern "C" void spin_pause_halide();
+
+// A per-worker deque of task indices used by the work-stealing
+// scheduler. Because a parallel for loop is a dense range of
+// indices, each deque is just a range [begin, end) relative to the
+// start of the loop. Both ends are packed into a single 64-bit word
+// so that the owner (which takes from the front) and thieves (which
+// take the back half) can claim indices with a single
+// compare-and-swap and no lock.
+struct steal_slot {
+    uint64_t range;
+    // Non-zero if some thread is currently using this slot as its deque.
+    int owned;
+    // Pad to a cache line so that workers don't false-share their deques.
+    uint8_t padding[64 - sizeof(uint64_t) - sizeof(int)];
+};
+
 struct work {
     work *next_job;
     int (*f)(void *, int, uint8_t *);
@@ -9,11 +28,33 @@ struct work {
     uint8_t *closure;
     int active_workers;
     int exit_status;
-    bool running() { return next < max || active_workers > 0; }
+
+    // Only used by the work-stealing scheduler. When slots is
+    // non-NULL, next is the loop min and is never advanced, max is
+    // unused, and the job is complete once all tasks have been run
+    // and every worker has left it.
+    steal_slot *slots;
+    int num_slots;
+    int tasks_remaining;
+    int next_slot_hint;
+
+    bool running() {
+        if (slots) {
+            return __atomic_load_n(&tasks_remaining, __ATOMIC_ACQUIRE) > 0 || active_workers > 0;
+        }
+        return next < max || active_workers > 0;
+    }
 };
 
 // The work queue and thread pool is weak, so one big work queue is shared by all halide functions
-#define MAX_THREADS 64
+
+// A sanity limit on the number of threads. The thread array itself is
+// grown on demand.
+#define MAX_THREADS 4096
+
+// The most deques a work-stealing job splits its range into. Each is
+// a cache line on the stack of the thread that starts the job.
+#define MAX_STEAL_SLOTS 64
 struct work_queue_t {
     // all fields are protected by this mutex.
     halide_mutex mutex;
@@ -32,18 +73,23 @@ struct work_queue_t {
     // Broadcast when a job completes.
     halide_cond wakeup_owners;
 
-    // Broadcast whenever items are added to the work queue.
+    // Broadcast whenever items are added to the work queue and some
+    // members of the A team are asleep.
     halide_cond wakeup_a_team;
 
+    // The number of A team members waiting on wakeup_a_team. Members
+    // that are spinning don't need to be woken.
+    int a_team_sleepers;
+
     // May also be broadcast when items are added to the work queue if
     // more threads are required than are currently in the A team.
     halide_cond wakeup_b_team;
 
     // Keep track of threads so they can be joined at shutdown
-    halide_thread *threads[MAX_THREADS];
+    halide_thread **threads;
 
-    // The number threads created
-    int threads_created;
+    // The number threads created, and the size of the threads array
+    int threads_created, threads_capacity;
 
     // The desired number threads doing work.
     int desired_num_threads;
@@ -52,6 +98,27 @@ struct work_queue_t {
     // whether the thread pool has been initialized.
     bool shutdown, initialized;
 
+    // Which halide_thread_pool_scheduler_t to use for new jobs.
+    int scheduler;
+
+    // If NUMA placement is on, worker i is pinned to cpu_order[i %
+    // num_cpus], where cpu_order lists the CPUs grouped by NUMA
+    // node. Workers compare placement_epoch against the value they
+    // last saw to notice when they need to re-pin themselves.
+    bool numa_placement, numa_placement_set;
+    int *cpu_order;
+    int num_cpus;
+    int placement_epoch;
+
+    // How many times an idle A team member polls for new work before
+    // going to sleep. Back-to-back parallel loops can then start
+    // without a round trip through the kernel.
+    int spin_count;
+    bool spin_count_set;
+
+    // Counters reported by halide_thread_pool_get_stats.
+    halide_thread_pool_stats_t stats;
+
     bool running() {
         return !shutdown;
     }
@@ -83,7 +150,276 @@ WEAK int default_desired_num_threads() {
     return desired_num_threads;
 }
 
-WEAK void worker_thread_already_locked(work *owned_job) {
+WEAK bool default_numa_placement() {
+    char *placement_str = getenv("HL_NUMA_PLACEMENT");
+    return placement_str && atoi(placement_str) != 0;
+}
+
+// Build the list of CPUs to pin workers to. Must be called with the
+// work queue locked.
+WEAK void set_numa_placement_already_locked(bool enabled) {
+    work_queue.numa_placement_set = true;
+    if (enabled && !work_queue.cpu_order) {
+        int max_cpus = halide_host_cpu_count();
+        if (max_cpus < 1) {
+            max_cpus = 1;
+        }
+        work_queue.cpu_order = (int *)malloc(max_cpus * sizeof(int));
+        work_queue.num_cpus = halide_host_cpus_by_numa_node(work_queue.cpu_order, max_cpus);
+    }
+    // Fall back to no placement on platforms where we can't query
+    // the topology.
+    if (work_queue.num_cpus <= 0) {
+        enabled = false;
+    }
+    if (enabled != work_queue.numa_placement) {
+        work_queue.numa_placement = enabled;
+        work_queue.placement_epoch++;
+    }
+}
+
+// Pin the calling worker thread according to the current placement
+// policy, if it has changed since the worker last looked.
+WEAK void update_worker_placement_already_locked(int worker_id, int *placement_epoch) {
+    if (*placement_epoch == work_queue.placement_epoch) {
+        return;
+    }
+    *placement_epoch = work_queue.placement_epoch;
+    int cpu = -1;
+    if (work_queue.numa_placement) {
+        cpu = work_queue.cpu_order[worker_id % work_queue.num_cpus];
+    }
+    halide_pin_current_thread_to_cpu(cpu);
+}
+
+WEAK int default_spin_count() {
+    char *spin_str = getenv("HL_THREAD_POOL_SPIN_COUNT");
+    return spin_str ? max(0, atoi(spin_str)) : 0;
+}
+
+// Sleep on a condition variable, keeping count.
+WEAK void sleep_already_locked(halide_cond *cond) {
+    work_queue.stats.sleeps++;
+    halide_cond_wait(cond, &work_queue.mutex);
+    work_queue.stats.wakeups++;
+}
+
+// Poll for new work for a bounded number of iterations without
+// holding the lock. Returns true if there is work (or the pool is
+// shutting down) once the lock has been reacquired, in which case the
+// caller should not go to sleep.
+WEAK bool spin_for_work_already_locked() {
+    int spin_count = work_queue.spin_count;
+    if (spin_count <= 0) {
+        return false;
+    }
+    work_queue.stats.spins++;
+    halide_mutex_unlock(&work_queue.mutex);
+    for (int i = 0; i < spin_count; i++) {
+        if (__atomic_load_n(&work_queue.jobs, __ATOMIC_ACQUIRE) != NULL ||
+            __atomic_load_n(&work_queue.shutdown, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        // Also stops the compiler from hoisting the loads out of
+        // the loop.
+        spin_pause_halide();
+    }
+    halide_mutex_lock(&work_queue.mutex);
+    // Work that arrived between the end of the spin and retaking the
+    // lock is caught here. Anything later will see us in
+    // a_team_sleepers and wake us.
+    if (work_queue.jobs != NULL || work_queue.shutdown) {
+        work_queue.stats.spins_found_work++;
+        return true;
+    }
+    return false;
+}
+
+WEAK int default_scheduler() {
+    // The env var lets the two schedulers be compared without
+    // recompiling.
+    char *scheduler_str = getenv("HL_THREAD_POOL_SCHEDULER");
+    if (scheduler_str && strcmp(scheduler_str, "work_stealing") == 0) {
+        return halide_thread_pool_scheduler_work_stealing;
+    }
+    return halide_thread_pool_scheduler_shared_queue;
+}
+
+WEAK __attribute__((always_inline)) uint64_t pack_range(uint32_t begin, uint32_t end) {
+    return ((uint64_t)end << 32) | begin;
+}
+
+// Loops with many cheap iterations would spend most of their time
+// claiming tasks if we claimed them one at a time, so workers claim
+// runs of tasks at once. The size of the run is a fraction of the
+// work remaining, so it shrinks geometrically as the job nears
+// completion, and the tail of the job is still spread across all the
+// threads (guided scheduling).
+WEAK __attribute__((always_inline)) int guided_batch_size(int remaining, int num_workers) {
+    return max(1, remaining / (2 * num_workers));
+}
+
+// When claiming from our own deque, leave most of it behind for
+// thieves.
+#define OWN_DEQUE_BATCH_FRACTION 8
+
+// Claim a run of task indices from the front of a deque. This is
+// normally our own deque, but workers that couldn't get a deque of
+// their own take from the front of others' too. The run is [*idx,
+// *idx + *count).
+WEAK bool claim_from_slot(steal_slot *slot, uint32_t *idx, uint32_t *count) {
+    uint64_t old_range = __atomic_load_n(&slot->range, __ATOMIC_ACQUIRE);
+    while (true) {
+        uint32_t begin = (uint32_t)old_range, end = (uint32_t)(old_range >> 32);
+        if (begin >= end) {
+            return false;
+        }
+        uint32_t batch = max((uint32_t)1, (end - begin) / OWN_DEQUE_BATCH_FRACTION);
+        uint64_t prev = __sync_val_compare_and_swap(&slot->range, old_range, pack_range(begin + batch, end));
+        if (prev == old_range) {
+            *idx = begin;
+            *count = batch;
+            return true;
+        }
+        old_range = prev;
+    }
+}
+
+// Steal the back half of someone else's deque. The first stolen
+// index is returned for immediate execution, and the rest are placed
+// in the thief's (empty) deque where they can in turn be stolen.
+WEAK bool steal_from_slot(steal_slot *victim, steal_slot *thief, uint32_t *idx) {
+    uint64_t old_range = __atomic_load_n(&victim->range, __ATOMIC_ACQUIRE);
+    while (true) {
+        uint32_t begin = (uint32_t)old_range, end = (uint32_t)(old_range >> 32);
+        if (begin >= end) {
+            return false;
+        }
+        uint32_t mid = begin + (end - begin) / 2;
+        uint64_t prev = __sync_val_compare_and_swap(&victim->range, old_range, pack_range(begin, mid));
+        if (prev == old_range) {
+            *idx = mid;
+            __atomic_store_n(&thief->range, pack_range(mid + 1, end), __ATOMIC_RELEASE);
+            return true;
+        }
+        old_range = prev;
+    }
+}
+
+// Remove a job from the job stack, wherever it is. Nested
+// parallelism may have pushed other jobs on top of it.
+WEAK void remove_job_already_locked(work *job) {
+    work **prev = &work_queue.jobs;
+    while (*prev) {
+        if (*prev == job) {
+            *prev = job->next_job;
+            return;
+        }
+        prev = &((*prev)->next_job);
+    }
+}
+
+// Whether a job is still on the job stack, and so may have tasks
+// left to claim.
+WEAK bool job_is_queued_already_locked(work *job) {
+    for (work *j = work_queue.jobs; j; j = j->next_job) {
+        if (j == job) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Work on a job scheduled by the work-stealing scheduler until no
+// more tasks can be found in it. The work queue lock is only taken to
+// join and leave the job. Task indices are claimed lock-free.
+WEAK void work_on_stealing_job_already_locked(work *job, int worker_id) {
+    job->active_workers++;
+    bool numa_placement = work_queue.numa_placement;
+    halide_mutex_unlock(&work_queue.mutex);
+
+    // Find a deque to call our own. Worker i prefers deque i, and
+    // threads outside the pool prefer the last one. Deque i starts
+    // with the i'th contiguous block of the loop, so with NUMA
+    // placement on, a given block of the output is consistently
+    // computed (and hence first touched) on the same node. Otherwise
+    // start from a rotating position so that the first few workers to
+    // arrive pick up the initial partition of the range.
+    int num_slots = job->num_slots;
+    int start;
+    if (numa_placement) {
+        start = (worker_id >= 0) ? worker_id % num_slots : num_slots - 1;
+    } else {
+        start = __sync_fetch_and_add(&job->next_slot_hint, 1);
+    }
+    int my_slot = -1;
+    for (int i = 0; i < num_slots; i++) {
+        int s = (start + i) % num_slots;
+        if (__sync_bool_compare_and_swap(&job->slots[s].owned, 0, 1)) {
+            my_slot = s;
+            break;
+        }
+    }
+
+    int exit_status = 0;
+    while (true) {
+        uint32_t idx, count = 1;
+        bool found = false;
+        if (my_slot >= 0) {
+            steal_slot *mine = job->slots + my_slot;
+            found = claim_from_slot(mine, &idx, &count);
+            for (int i = 1; !found && i < num_slots; i++) {
+                found = steal_from_slot(job->slots + (my_slot + i) % num_slots, mine, &idx);
+            }
+        } else {
+            // The number of deques was fixed, and capped, when the
+            // job started, so threads beyond that number, threads
+            // spawned since then, or a nested job's owner re-entering
+            // a job it is already working on, may find them all
+            // taken. Such threads have nowhere to put stolen
+            // tasks, so they take runs from the front of other deques
+            // instead.
+            for (int i = 0; !found && i < num_slots; i++) {
+                found = claim_from_slot(job->slots + (start + i) % num_slots, &idx, &count);
+            }
+        }
+        if (!found) {
+            break;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            int result = halide_do_task(job->user_context, job->f, job->next + (int)(idx + i),
+                                        job->closure);
+            if (result) {
+                exit_status = result;
+            }
+        }
+        __sync_fetch_and_sub(&job->tasks_remaining, (int)count);
+    }
+
+    if (my_slot >= 0) {
+        __sync_lock_release(&job->slots[my_slot].owned);
+    }
+
+    halide_mutex_lock(&work_queue.mutex);
+
+    if (exit_status) {
+        job->exit_status = exit_status;
+    }
+
+    // We couldn't find any unclaimed tasks, so there's no point in
+    // other workers joining this job. Any tasks still in flight are
+    // being run by the workers that claimed them. Removing the job
+    // also stops a thread without a deque from selecting it again
+    // and spinning on it.
+    remove_job_already_locked(job);
+
+    job->active_workers--;
+}
+
+WEAK void worker_thread_already_locked(work *owned_job, int worker_id) {
+    // The placement epoch this worker last pinned itself for.
+    int placement_epoch = 0;
+
     // If I'm a job owner, then I was the thread that called
     // do_par_for, and I should only stay in this function until my
     // job is complete. If I'm a lowly worker thread, I should stay in
@@ -91,34 +427,58 @@ WEAK void worker_thread_already_locked(work *owned_job) {
     while (owned_job != NULL ? owned_job->running()
            : work_queue.running()) {
 
-        if (work_queue.jobs == NULL) {
+        if (owned_job == NULL) {
+            update_worker_placement_already_locked(worker_id, &placement_epoch);
+        }
+
+        // Owners only work on their own job. A task of some other job
+        // might wait on something (e.g. the producer of an async
+        // Func) that is suspended further up the owner's own stack.
+        work *job = work_queue.jobs;
+        if (owned_job) {
+            job = job_is_queued_already_locked(owned_job) ? owned_job : NULL;
+        }
+
+        if (job == NULL) {
             if (owned_job) {
-                // There are no jobs pending. Wait for the last worker
-                // to signal that the job is finished.
-                halide_cond_wait(&work_queue.wakeup_owners, &work_queue.mutex);
+                // There are no tasks of my job pending. Wait for the
+                // last worker to signal that the job is finished.
+                sleep_already_locked(&work_queue.wakeup_owners);
             } else if (work_queue.a_team_size <= work_queue.target_a_team_size) {
-                // There are no jobs pending. Wait until more jobs are enqueued.
-                halide_cond_wait(&work_queue.wakeup_a_team, &work_queue.mutex);
+                // There are no jobs pending. Spin for a while in case
+                // another job arrives soon, then wait until more jobs
+                // are enqueued.
+                if (!spin_for_work_already_locked()) {
+                    work_queue.a_team_sleepers++;
+                    sleep_already_locked(&work_queue.wakeup_a_team);
+                    work_queue.a_team_sleepers--;
+                }
             } else {
                 // There are no jobs pending, and there are too many
                 // threads in the A team. Transition to the B team
                 // until the wakeup_b_team condition is fired.
                 work_queue.a_team_size--;
-                halide_cond_wait(&work_queue.wakeup_b_team, &work_queue.mutex);
+                sleep_already_locked(&work_queue.wakeup_b_team);
                 work_queue.a_team_size++;
             }
-        } else {
-            // Grab the next job.
-            work *job = work_queue.jobs;
+        } else if (job->slots) {
+            work_on_stealing_job_already_locked(job, owned_job ? -1 : worker_id);
 
-            // Claim a task from it.
+            // If the job is done and I'm not the owner of it, wake up
+            // the owner.
+            if (!job->running() && job != owned_job) {
+                halide_cond_broadcast(&work_queue.wakeup_owners);
+            }
+        } else {
+            // Claim a run of tasks from the job.
             work myjob = *job;
-            job->next++;
+            int batch = guided_batch_size(job->max - job->next, work_queue.desired_num_threads);
+            job->next += batch;
 
             // If there were no more tasks pending for this job,
             // remove it from the stack.
             if (job->next == job->max) {
-                work_queue.jobs = job->next_job;
+                remove_job_already_locked(job);
             }
 
             // Increment the active_worker count so that other threads
@@ -126,13 +486,19 @@ WEAK void worker_thread_already_locked(work *owned_job) {
             // though there are no outstanding tasks for it.
             job->active_workers++;
 
-            // Release the lock and do the task.
+            // Release the lock and do the tasks.
             halide_mutex_unlock(&work_queue.mutex);
-            int result = halide_do_task(myjob.user_context, myjob.f, myjob.next,
-                                        myjob.closure);
+            int result = 0;
+            for (int i = 0; i < batch; i++) {
+                int r = halide_do_task(myjob.user_context, myjob.f, myjob.next + i,
+                                       myjob.closure);
+                if (r) {
+                    result = r;
+                }
+            }
             halide_mutex_lock(&work_queue.mutex);
 
-            // If this task failed, set the exit status on the job.
+            // If any task failed, set the exit status on the job.
             if (result) {
                 job->exit_status = result;
             }
@@ -149,9 +515,49 @@ WEAK void worker_thread_already_locked(work *owned_job) {
     }
 }
 
-WEAK void worker_thread(void *) {
+struct halide_semaphore_impl_t {
+    int value;
+};
+
+// Threads waiting on a semaphore sleep on one of a fixed set of
+// condition variables, chosen by the address of the semaphore, so
+// that semaphores neither contend for the work queue lock nor wake
+// the waiters of unrelated semaphores. Each bucket's mutex protects
+// the values of the semaphores that hash to it. Semaphores may be
+// used with a custom do_par_for, and by threads outside the pool
+// (e.g. the trace file writer), so the buckets are initialized on
+// first use rather than with the thread pool, and outlive it.
+#define SEMAPHORE_BUCKETS 64
+struct semaphore_bucket {
+    halide_mutex mutex;
+    halide_cond cond;
+    int waiters;
+    bool initialized;
+};
+WEAK semaphore_bucket semaphore_buckets[SEMAPHORE_BUCKETS];
+
+// Returns the semaphore's bucket, locked.
+WEAK semaphore_bucket *lock_semaphore_bucket(halide_semaphore_t *s) {
+    // Semaphores are 16 bytes, so the low bits of the address carry
+    // no information.
+    semaphore_bucket *bucket = semaphore_buckets + (((uintptr_t)s >> 4) % SEMAPHORE_BUCKETS);
+    // The mutex is safe to use zero-initialized.
+    halide_mutex_lock(&bucket->mutex);
+    if (!bucket->initialized) {
+        halide_cond_init(&bucket->cond);
+        bucket->initialized = true;
+    }
+    return bucket;
+}
+
+WEAK bool halide_helper_threads_supported() {
+    return true;
+}
+
+WEAK void worker_thread(void *arg) {
+    int worker_id = (int)(intptr_t)arg;
     halide_mutex_lock(&work_queue.mutex);
-    worker_thread_already_locked(NULL);
+    worker_thread_already_locked(NULL, worker_id);
     halide_mutex_unlock(&work_queue.mutex);
 }
 
@@ -183,6 +589,13 @@ WEAK int halide_default_do_par_for(void *user_context, halide_task_t f,
         halide_cond_init(&work_queue.wakeup_a_team);
         halide_cond_init(&work_queue.wakeup_b_team);
         work_queue.jobs = NULL;
+        if (!work_queue.scheduler) {
+            work_queue.scheduler = default_scheduler();
+        }
+        if (!work_queue.spin_count_set) {
+            work_queue.spin_count = default_spin_count();
+            work_queue.spin_count_set = true;
+        }
 
         // Compute the desired number of threads to use. Other code
         // can also mess with this value, but only when the work queue
@@ -192,6 +605,9 @@ WEAK int halide_default_do_par_for(void *user_context, halide_task_t f,
         }
         work_queue.desired_num_threads = clamp_num_threads(work_queue.desired_num_threads);
         work_queue.threads_created = 0;
+        if (!work_queue.numa_placement_set) {
+            set_numa_placement_already_locked(default_numa_placement());
+        }
 
         // Everyone starts on the a team.
         work_queue.a_team_size = work_queue.desired_num_threads;
@@ -202,19 +618,68 @@ WEAK int halide_default_do_par_for(void *user_context, halide_task_t f,
     while (work_queue.threads_created < work_queue.desired_num_threads - 1) {
         // We might need to make some new threads, if work_queue.desired_num_threads has
         // increased.
-        work_queue.threads[work_queue.threads_created++] =
-            halide_spawn_thread(worker_thread, NULL);
+        if (work_queue.threads_created == work_queue.threads_capacity) {
+            int new_capacity = max(16, work_queue.threads_capacity * 2);
+            halide_thread **new_threads = (halide_thread **)malloc(new_capacity * sizeof(halide_thread *));
+            if (work_queue.threads) {
+                memcpy(new_threads, work_queue.threads, work_queue.threads_created * sizeof(halide_thread *));
+                free(work_queue.threads);
+            }
+            work_queue.threads = new_threads;
+            work_queue.threads_capacity = new_capacity;
+        }
+        int worker_id = work_queue.threads_created++;
+        work_queue.threads[worker_id] =
+            halide_spawn_thread(worker_thread, (void *)(intptr_t)worker_id);
     }
 
-    // Make the job.
+    // Make the job. The caller claims the first task for itself
+    // before anyone else can see the job, so task zero always starts
+    // before any other task does. The forks of async Funcs put the
+    // producer first, so a consumer never waits on a producer that
+    // no thread has started, however the forks are nested.
     work job;
     job.f = f;               // The job should call this function. It takes an index and a closure.
     job.user_context = user_context;
-    job.next = min;          // Start at this index.
+    job.next = min + 1;      // Start at this index.
     job.max  = min + size;   // Keep going until one less than this index.
     job.closure = closure;   // Use this closure.
     job.exit_status = 0;     // The job hasn't failed yet
-    job.active_workers = 0;  // Nobody is working on this yet
+    job.active_workers = 1;  // The caller, on the first task
+    job.slots = NULL;        // Use the shared queue unless told otherwise
+
+    if (work_queue.scheduler == halide_thread_pool_scheduler_work_stealing) {
+        // One deque for every thread that might help out, plus one
+        // for the caller, but no more than there are tasks to put in
+        // them, or than MAX_STEAL_SLOTS, as they live on the stack of
+        // every nested job. Threads that find no free deque take runs
+        // from the front of the others. Split the rest of the range
+        // evenly amongst the deques. They hold indices relative to
+        // min, which next holds for this scheduler.
+        job.next = min;
+        int rest = size - 1;
+        int num_slots = work_queue.threads_created + 1;
+        if (num_slots > rest) {
+            num_slots = rest;
+        }
+        if (num_slots > MAX_STEAL_SLOTS) {
+            num_slots = MAX_STEAL_SLOTS;
+        }
+        if (num_slots < 1) {
+            num_slots = 1;
+        }
+        job.num_slots = num_slots;
+        job.slots = (steal_slot *)__builtin_alloca(num_slots * sizeof(steal_slot));
+        memset(job.slots, 0, num_slots * sizeof(steal_slot));
+        int active_slots = num_slots < rest ? num_slots : rest;
+        for (int i = 0; i < active_slots; i++) {
+            uint32_t begin = 1 + (uint32_t)(((int64_t)rest * i) / active_slots);
+            uint32_t end = 1 + (uint32_t)(((int64_t)rest * (i + 1)) / active_slots);
+            job.slots[i].range = pack_range(begin, end);
+        }
+        job.tasks_remaining = rest;
+        job.next_slot_hint = 0;
+    }
 
     if (!work_queue.jobs && size < work_queue.desired_num_threads) {
         // If there's no nested parallelism happening and there are
@@ -230,21 +695,34 @@ WEAK int halide_default_do_par_for(void *user_context, halide_task_t f,
         work_queue.target_a_team_size = work_queue.desired_num_threads;
     }
 
-    // Push the job onto the stack.
-    job.next_job = work_queue.jobs;
-    work_queue.jobs = &job;
+    if (size > 1) {
+        // Push the job onto the stack.
+        job.next_job = work_queue.jobs;
+        work_queue.jobs = &job;
 
-    // Wake up our A team.
-    halide_cond_broadcast(&work_queue.wakeup_a_team);
+        // Wake up the sleeping members of our A team. The rest are
+        // spinning and will find the job on their own.
+        if (work_queue.a_team_sleepers > 0) {
+            work_queue.stats.broadcasts++;
+            halide_cond_broadcast(&work_queue.wakeup_a_team);
+        }
 
-    // If there are fewer threads than we would like on the a team,
-    // wake up the b team too.
-    if (work_queue.target_a_team_size > work_queue.a_team_size) {
-        halide_cond_broadcast(&work_queue.wakeup_b_team);
+        // If there are fewer threads than we would like on the a team,
+        // wake up the b team too.
+        if (work_queue.target_a_team_size > work_queue.a_team_size) {
+            halide_cond_broadcast(&work_queue.wakeup_b_team);
+        }
     }
 
-    // Do some work myself.
-    worker_thread_already_locked(&job);
+    // Do the first task, then help with the rest.
+    halide_mutex_unlock(&work_queue.mutex);
+    int result = halide_do_task(user_context, f, min, closure);
+    halide_mutex_lock(&work_queue.mutex);
+    if (result) {
+        job.exit_status = result;
+    }
+    job.active_workers--;
+    worker_thread_already_locked(&job, -1);
 
     halide_mutex_unlock(&work_queue.mutex);
 
@@ -270,6 +748,81 @@ WEAK int halide_set_num_threads(int n) {
     return old;
 }
 
+WEAK int halide_set_thread_pool_spin_count(int spin_count) {
+    if (spin_count < 0) {
+        halide_error(NULL, "halide_set_thread_pool_spin_count: must be >= 0.");
+        return -1;
+    }
+    halide_mutex_lock(&work_queue.mutex);
+    int old = work_queue.spin_count_set ? work_queue.spin_count : default_spin_count();
+    work_queue.spin_count = spin_count;
+    work_queue.spin_count_set = true;
+    halide_mutex_unlock(&work_queue.mutex);
+    return old;
+}
+
+WEAK void halide_thread_pool_get_stats(halide_thread_pool_stats_t *stats) {
+    halide_mutex_lock(&work_queue.mutex);
+    *stats = work_queue.stats;
+    halide_mutex_unlock(&work_queue.mutex);
+}
+
+WEAK void halide_thread_pool_reset_stats() {
+    halide_mutex_lock(&work_queue.mutex);
+    memset(&work_queue.stats, 0, sizeof(work_queue.stats));
+    halide_mutex_unlock(&work_queue.mutex);
+}
+
+WEAK int halide_set_numa_placement(int enabled) {
+    halide_mutex_lock(&work_queue.mutex);
+    int old = work_queue.numa_placement ? 1 : 0;
+    set_numa_placement_already_locked(enabled != 0);
+    int result = (enabled && !work_queue.numa_placement) ? -1 : old;
+    halide_mutex_unlock(&work_queue.mutex);
+    return result;
+}
+
+WEAK int halide_set_thread_pool_scheduler(int scheduler) {
+    if (scheduler < halide_thread_pool_scheduler_default ||
+        scheduler > halide_thread_pool_scheduler_work_stealing) {
+        halide_error(NULL, "halide_set_thread_pool_scheduler: unknown scheduler.");
+        return -1;
+    }
+    halide_mutex_lock(&work_queue.mutex);
+    if (scheduler == halide_thread_pool_scheduler_default) {
+        scheduler = default_scheduler();
+    }
+    int old = work_queue.scheduler ? work_queue.scheduler : default_scheduler();
+    work_queue.scheduler = scheduler;
+    halide_mutex_unlock(&work_queue.mutex);
+    return old;
+}
+
+WEAK int halide_semaphore_release(halide_semaphore_t *s, int n) {
+    halide_semaphore_impl_t *sem = (halide_semaphore_impl_t *)s;
+    semaphore_bucket *bucket = lock_semaphore_bucket(s);
+    sem->value += n;
+    if (bucket->waiters) {
+        // Other semaphores may share the bucket, so wake everyone.
+        halide_cond_broadcast(&bucket->cond);
+    }
+    halide_mutex_unlock(&bucket->mutex);
+    return 0;
+}
+
+WEAK int halide_semaphore_acquire(halide_semaphore_t *s, int n) {
+    halide_semaphore_impl_t *sem = (halide_semaphore_impl_t *)s;
+    semaphore_bucket *bucket = lock_semaphore_bucket(s);
+    while (sem->value < n) {
+        bucket->waiters++;
+        halide_cond_wait(&bucket->cond, &bucket->mutex);
+        bucket->waiters--;
+    }
+    sem->value -= n;
+    halide_mutex_unlock(&bucket->mutex);
+    return 0;
+}
+
 WEAK void halide_shutdown_thread_pool() {
     if (!work_queue.initialized) return;
 
@@ -286,12 +839,17 @@ WEAK void halide_shutdown_thread_pool() {
     for (int i = 0; i < work_queue.threads_created; i++) {
         halide_join_thread(work_queue.threads[i]);
     }
+    free(work_queue.threads);
+    work_queue.threads = NULL;
+    work_queue.threads_capacity = 0;
 
     // Tidy up
     halide_mutex_destroy(&work_queue.mutex);
     halide_cond_destroy(&work_queue.wakeup_owners);
     halide_cond_destroy(&work_queue.wakeup_a_team);
     halide_cond_destroy(&work_queue.wakeup_b_team);
+    // The semaphore buckets are left alone, as threads outside the
+    // pool may still be using semaphores.
     work_queue.initialized = false;
 }
 
@@ -1,5 +1,6 @@
 #include "HalideRuntime.h"
 #include "printer.h"
+#include "scoped_mutex_lock.h"
 #include "scoped_spin_lock.h"
 
 extern "C" {
@@ -68,17 +69,233 @@ public:
     SharedExclusiveSpinLock() : lock(0) {}
 };
 
-const static int buffer_size = 1024 * 1024;
+const static int buffer_size = 256 * 1024;
+
+// When HL_TRACE_FORMAT is set to "compressed", each buffer of packets
+// is encoded as a self-contained block before it is written out:
+//
+//   uint32 magic, uint32 compressed size, uint32 encoded size,
+//   uint32 packet count, compressed bytes
+//
+// The magic number can't be mistaken for the size of a raw packet, so
+// readers can tell blocks and raw packets apart, and a file appended
+// to by runs with different settings can hold both. Within a block,
+// each packet is encoded as:
+//
+//   varint zigzag(id - previous id)
+//   varint func index, followed by a varint length and the name if
+//     the index is that of the next new name
+//   event, type code, and type bits as bytes, varint lanes
+//   varint zigzag(parent_id - parent_id of the func's last packet)
+//   varint value_index, varint dimensions
+//   for each coordinate, varint zigzag(coordinate - the same
+//     coordinate of the func's last packet), if it had the same
+//     number of dimensions, otherwise varint zigzag(coordinate)
+//   the value bytes
+//
+// and the result is compressed with a simple LZ77 scheme: each
+// sequence is a token byte holding a literal count and a match
+// length minus four (with 15 meaning more length bytes follow, each
+// adding up to 255), the literals, and a two-byte match offset. The
+// final sequence has only literals. util/HalideTraceUtils.cpp has the
+// matching decoder.
+const static uint32_t trace_block_magic = 0x5a544c48; // "HLTZ"
+const static int trace_max_names = 256;
+const static int trace_hash_bits = 12;
+const static int trace_min_match = 4;
+
+class TraceEncoder {
+    struct FuncState {
+        const char *name;
+        uint32_t name_length;
+        const halide_trace_packet_t *last;
+    };
+    FuncState funcs[trace_max_names];
+    int num_funcs;
+    uint8_t *encoded;
+    uint8_t *compressed;
+    uint32_t hash_table[1 << trace_hash_bits];
+
+    static __attribute__((always_inline)) uint8_t *put_varint(uint8_t *dst, uint32_t x) {
+        while (x >= 0x80) {
+            *dst++ = (uint8_t)(x | 0x80);
+            x >>= 7;
+        }
+        *dst++ = (uint8_t)x;
+        return dst;
+    }
+
+    static __attribute__((always_inline)) uint8_t *put_signed(uint8_t *dst, int32_t x) {
+        return put_varint(dst, ((uint32_t)x << 1) ^ (uint32_t)(x >> 31));
+    }
+
+    static __attribute__((always_inline)) uint8_t *put_length(uint8_t *dst, uint32_t x) {
+        while (x >= 255) {
+            *dst++ = 255;
+            x -= 255;
+        }
+        *dst++ = (uint8_t)x;
+        return dst;
+    }
+
+    int find_func(const char *name, uint32_t name_length) {
+        for (int i = 0; i < num_funcs; i++) {
+            if (funcs[i].name_length == name_length &&
+                memcmp(funcs[i].name, name, name_length) == 0) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    uint8_t *encode_packet(uint8_t *dst, const halide_trace_packet_t *p, int32_t *last_id) {
+        dst = put_signed(dst, p->id - *last_id);
+        *last_id = p->id;
+
+        const char *name = p->func();
+        uint32_t name_length = strlen(name);
+        int f = find_func(name, name_length);
+        const halide_trace_packet_t *last = NULL;
+        if (f >= 0) {
+            dst = put_varint(dst, f);
+            last = funcs[f].last;
+            funcs[f].last = p;
+        } else {
+            dst = put_varint(dst, num_funcs);
+            dst = put_varint(dst, name_length);
+            memcpy(dst, name, name_length);
+            dst += name_length;
+            if (num_funcs < trace_max_names) {
+                funcs[num_funcs].name = name;
+                funcs[num_funcs].name_length = name_length;
+                funcs[num_funcs].last = p;
+                num_funcs++;
+            }
+        }
+
+        *dst++ = (uint8_t)p->event;
+        *dst++ = p->type.code;
+        *dst++ = p->type.bits;
+        dst = put_varint(dst, p->type.lanes);
+        dst = put_signed(dst, p->parent_id - (last ? last->parent_id : 0));
+        dst = put_varint(dst, p->value_index);
+        dst = put_varint(dst, p->dimensions);
+        const int32_t *coords = p->coordinates();
+        const int32_t *last_coords = (last && last->dimensions == p->dimensions) ? last->coordinates() : NULL;
+        for (int i = 0; i < p->dimensions; i++) {
+            dst = put_signed(dst, coords[i] - (last_coords ? last_coords[i] : 0));
+        }
+        uint32_t value_bytes = p->type.lanes * p->type.bytes();
+        memcpy(dst, p->value(), value_bytes);
+        return dst + value_bytes;
+    }
+
+    // Returns the compressed size.
+    uint32_t compress(const uint8_t *src, uint32_t size, uint8_t *dst) {
+        uint8_t *out = dst;
+        for (int i = 0; i < (1 << trace_hash_bits); i++) {
+            hash_table[i] = 0xffffffff;
+        }
+        uint32_t literal_start = 0, pos = 0;
+        while (pos + trace_min_match <= size) {
+            uint32_t word;
+            memcpy(&word, src + pos, sizeof(word));
+            uint32_t h = (word * 2654435761U) >> (32 - trace_hash_bits);
+            uint32_t candidate = hash_table[h];
+            hash_table[h] = pos;
+            if (candidate == 0xffffffff || pos - candidate > 0xffff ||
+                memcmp(src + candidate, src + pos, trace_min_match) != 0) {
+                pos++;
+                continue;
+            }
+            uint32_t match_length = trace_min_match;
+            while (pos + match_length < size && src[candidate + match_length] == src[pos + match_length]) {
+                match_length++;
+            }
+            uint32_t literals = pos - literal_start;
+            uint32_t extra = match_length - trace_min_match;
+            *out++ = (uint8_t)(((literals < 15 ? literals : 15) << 4) | (extra < 15 ? extra : 15));
+            if (literals >= 15) {
+                out = put_length(out, literals - 15);
+            }
+            memcpy(out, src + literal_start, literals);
+            out += literals;
+            *out++ = (uint8_t)(pos - candidate);
+            *out++ = (uint8_t)((pos - candidate) >> 8);
+            if (extra >= 15) {
+                out = put_length(out, extra - 15);
+            }
+            pos += match_length;
+            literal_start = pos;
+        }
+        uint32_t literals = size - literal_start;
+        *out++ = (uint8_t)((literals < 15 ? literals : 15) << 4);
+        if (literals >= 15) {
+            out = put_length(out, literals - 15);
+        }
+        memcpy(out, src + literal_start, literals);
+        out += literals;
+        return (uint32_t)(out - dst);
+    }
+
+public:
+    bool init() {
+        // Encoding can at most double the size of a packet, and
+        // compression adds a byte per 255 bytes of incompressible
+        // input, plus a little.
+        encoded = (uint8_t *)malloc(2 * buffer_size);
+        compressed = (uint8_t *)malloc(2 * buffer_size + (2 * buffer_size) / 255 + 64);
+        return encoded && compressed;
+    }
+
+    void destroy() {
+        free(encoded);
+        free(compressed);
+    }
+
+    // Encode and write out a buffer full of packets. Only called by
+    // whoever holds the writer lock.
+    bool write_block(int fd, const uint8_t *buf, uint32_t size) {
+        num_funcs = 0;
+        int32_t last_id = 0;
+        uint32_t packet_count = 0;
+        uint8_t *dst = encoded;
+        for (uint32_t pos = 0; pos < size; packet_count++) {
+            const halide_trace_packet_t *p = (const halide_trace_packet_t *)(buf + pos);
+            dst = encode_packet(dst, p, &last_id);
+            pos += p->size;
+        }
+        uint32_t encoded_size = (uint32_t)(dst - encoded);
+        uint32_t header[4] = {trace_block_magic, 0, encoded_size, packet_count};
+        header[1] = compress(encoded, encoded_size, compressed + sizeof(header));
+        memcpy(compressed, header, sizeof(header));
+        uint32_t total = sizeof(header) + header[1];
+        return total == (uint32_t)write(fd, compressed, total);
+    }
+};
+
+// Each packet in a TraceBuffer is preceded by a sequence number,
+// taken when its space is claimed. Packets are written out in
+// sequence order, which is the order in which the threads claimed
+// them, so the file reads as if there were a single buffer even
+// though the packets went into different ones. The sequence numbers
+// are not written out.
+typedef uint32_t trace_seq_t;
 
 class TraceBuffer {
     SharedExclusiveSpinLock lock;
     uint32_t cursor;
+    // Set when the buffer is full and waiting for the writer.
+    volatile uint32_t pending;
     uint8_t buf[buffer_size];
 
+public:
     // Attempt to atomically acquire space in the buffer to write a
-    // packet. Returns NULL if the buffer was full.
-    __attribute__((always_inline)) halide_trace_packet_t *try_acquire_packet(void *user_context, uint32_t size) {
+    // packet, and give it the next sequence number. Returns NULL if
+    // the buffer was full.
+    __attribute__((always_inline)) halide_trace_packet_t *try_acquire_packet(void *user_context, uint32_t size, trace_seq_t *seq) {
         lock.acquire_shared();
+        size += sizeof(trace_seq_t);
         halide_assert(user_context, size <= buffer_size);
         uint32_t my_cursor = __sync_fetch_and_add(&cursor, size);
         if (my_cursor + size > sizeof(buf)) {
@@ -86,55 +303,395 @@ class TraceBuffer {
             lock.release_shared();
             return NULL;
         } else {
-            return (halide_trace_packet_t *)(buf + my_cursor);
+            // Taking the sequence number while holding the buffer
+            // means that once the writer has drained every buffer,
+            // it has every packet numbered before it started.
+            trace_seq_t my_seq = __sync_fetch_and_add(seq, 1);
+            memcpy(buf + my_cursor, &my_seq, sizeof(my_seq));
+            return (halide_trace_packet_t *)(buf + my_cursor + sizeof(my_seq));
         }
     }
 
-public:
+    // Release a packet, allowing it to be drained.
+    __attribute__((always_inline)) void release_packet(halide_trace_packet_t *) {
+        // Need a memory barrier to guarantee all the writes are done.
+        __sync_synchronize();
+        lock.release_shared();
+    }
 
     // Wait for all writers to finish with their packets, stall any
-    // new writers, and flush the buffer to the fd.
-    __attribute__((always_inline)) void flush(void *user_context, int fd) {
+    // new writers, and move the contents into dst, which must have
+    // room for buffer_size bytes. Returns the number of bytes moved.
+    uint32_t drain(uint8_t *dst) {
         lock.acquire_exclusive();
-        bool success = true;
-        if (cursor) {
-            success = (cursor == (uint32_t)write(fd, buf, cursor));
-            cursor = 0;
-        }
+        uint32_t size = cursor;
+        memcpy(dst, buf, size);
+        cursor = 0;
+        pending = 0;
         lock.release_exclusive();
-        halide_assert(user_context, success && "Could not write to trace file");
+        return size;
+    }
+
+    __attribute__((always_inline)) bool is_pending() const {
+        return pending != 0;
+    }
+
+    __attribute__((always_inline)) void mark_pending() {
+        __sync_synchronize();
+        pending = 1;
+    }
+};
+
+// The contents of a drained TraceBuffer, waiting for the packets
+// numbered before them to be written out.
+const static uint32_t max_packets_per_buffer = buffer_size / (sizeof(trace_seq_t) + sizeof(halide_trace_packet_t));
+
+struct StagedBlock {
+    uint8_t data[buffer_size];
+    // Offsets of the packets in data, sorted by sequence number.
+    uint32_t offsets[max_packets_per_buffer];
+    uint32_t count;
+    // The first offset not yet written out.
+    uint32_t next;
+
+    __attribute__((always_inline)) trace_seq_t seq(uint32_t i) const {
+        trace_seq_t s;
+        memcpy(&s, data + offsets[i], sizeof(s));
+        return s;
+    }
+
+    void index(uint32_t size) {
+        count = 0;
+        next = 0;
+        for (uint32_t pos = 0; pos < size; count++) {
+            offsets[count] = pos;
+            const halide_trace_packet_t *p = (const halide_trace_packet_t *)(data + pos + sizeof(trace_seq_t));
+            pos += sizeof(trace_seq_t) + p->size;
+        }
+        // Packets are nearly in order already, as threads claim space
+        // and sequence numbers one after the other, so use an
+        // insertion sort.
+        for (uint32_t i = 1; i < count; i++) {
+            uint32_t offset = offsets[i];
+            trace_seq_t s = seq(i);
+            uint32_t j = i;
+            while (j > 0 && seq(j - 1) > s) {
+                offsets[j] = offsets[j - 1];
+                j--;
+            }
+            offsets[j] = offset;
+        }
+    }
+};
+
+// Each thread writes packets into one of several double-buffered
+// stripes, chosen by where its stack is, so that tracing threads
+// rarely touch the same cache lines. When the active half of a stripe
+// fills up, the thread that noticed hands it to a writer thread and
+// carries on with the other half. Threads only wait if the writer
+// has fallen a whole buffer behind.
+//
+// The writer drains full halves into staged blocks, and writes out
+// packets from them in sequence order for as long as the next one is
+// there. If too many blocks pile up waiting for packets still sitting
+// in other stripes, it drains every stripe. All stripes are also
+// drained at the end of each pipeline.
+const static int num_trace_stripes = 8;
+const static int max_staged_blocks = 6 * num_trace_stripes;
+
+struct TraceStripe {
+    TraceBuffer halves[2];
+    // The index of the half currently being filled.
+    volatile int active;
+};
+
+struct TraceBuffers {
+    TraceStripe stripes[num_trace_stripes];
+    // The sequence number of the next packet to be claimed.
+    trace_seq_t next_seq;
+    // The writer thread, and the semaphore it sleeps on. NULL on
+    // platforms that cannot run one, in which case the thread that
+    // fills a buffer writes out everything itself.
+    halide_thread *writer;
+    halide_semaphore_t writer_wakeup;
+    volatile bool stop_writer;
+    // Everything below is only touched with writer_lock held.
+    halide_mutex writer_lock;
+    // NULL unless writing the compressed format.
+    TraceEncoder *encoder;
+    StagedBlock *staged[max_staged_blocks];
+    int num_staged;
+    StagedBlock *free_blocks[max_staged_blocks];
+    int num_free_blocks;
+    // The sequence number of the next packet to write out.
+    trace_seq_t written_seq;
+    // Packets gathered in order for the next write.
+    uint8_t out[buffer_size];
+    uint32_t out_size;
+    // The file to write to.
+    volatile int fd;
+    volatile bool write_failed;
+
+    __attribute__((always_inline)) TraceStripe &stripe_for_current_thread() {
+        // Thread stacks are typically at least a megabyte apart.
+        int on_stack;
+        uintptr_t addr = (uintptr_t)&on_stack;
+        return stripes[((addr >> 20) ^ (addr >> 23)) % num_trace_stripes];
+    }
+
+    __attribute__((always_inline)) void wake_writer() {
+        halide_semaphore_release(&writer_wakeup, 1);
     }
 
     // Acquire and return a packet's worth of space in the trace
-    // buffer, flushing the trace buffer to the given fd to make space
-    // if necessary. The region acquired is protected from other
-    // threads writing or reading to it, so it must be released before
-    // a flush can occur.
-    __attribute__((always_inline)) halide_trace_packet_t *acquire_packet(void *user_context, int fd, uint32_t size) {
-        halide_trace_packet_t *packet = NULL;
-        while (!(packet = try_acquire_packet(user_context, size))) {
-            // Couldn't acquire space to write a packet. Flush and try again.
-            flush(user_context, fd);
+    // buffer of the current thread's stripe. The region acquired is
+    // protected from being drained, so it must be released promptly.
+    __attribute__((always_inline)) halide_trace_packet_t *acquire_packet(void *user_context, int fd, uint32_t size, TraceBuffer **buffer) {
+        this->fd = fd;
+        TraceStripe &stripe = stripe_for_current_thread();
+        while (1) {
+            int idx = stripe.active;
+            TraceBuffer &b = stripe.halves[idx];
+            halide_trace_packet_t *packet = b.try_acquire_packet(user_context, size, &next_seq);
+            if (packet) {
+                *buffer = &b;
+                return packet;
+            }
+            // This half is full. Switch to the other one once the
+            // writer is done with it.
+            TraceBuffer &other = stripe.halves[1 - idx];
+            if (other.is_pending()) {
+                if (!writer) {
+                    write_out(true);
+                } else {
+                    // Let the writer thread catch up.
+                    halide_sleep_ms(user_context, 0);
+                }
+                continue;
+            }
+            if (__sync_bool_compare_and_swap(&stripe.active, idx, 1 - idx)) {
+                b.mark_pending();
+                if (writer) {
+                    wake_writer();
+                } else {
+                    write_out(true);
+                }
+            }
         }
-        return packet;
     }
 
-    // Release a packet, allowing it to be written out with flush
-    __attribute__((always_inline)) void release_packet(halide_trace_packet_t *) {
-        // Need a memory barrier to guarantee all the writes are done.
-        __sync_synchronize();
-        lock.release_shared();
+    StagedBlock *new_block() {
+        if (num_free_blocks > 0) {
+            return free_blocks[--num_free_blocks];
+        }
+        return (StagedBlock *)malloc(sizeof(StagedBlock));
+    }
+
+    // Move the contents of a buffer into a new staged block. Must be
+    // called with writer_lock held.
+    void stage(TraceBuffer &b) {
+        while (num_staged == max_staged_blocks) {
+            // Too many blocks are waiting on packets that haven't
+            // turned up. Give up on them and write out the earliest
+            // packets we have. Any stragglers get written when they
+            // arrive.
+            trace_seq_t earliest = staged[0]->seq(staged[0]->next);
+            for (int i = 1; i < num_staged; i++) {
+                trace_seq_t s = staged[i]->seq(staged[i]->next);
+                if ((int32_t)(s - earliest) < 0) {
+                    earliest = s;
+                }
+            }
+            written_seq = earliest;
+            write_staged();
+        }
+        StagedBlock *block = new_block();
+        if (!block) {
+            write_failed = true;
+            return;
+        }
+        uint32_t size = b.drain(block->data);
+        if (size == 0) {
+            free_blocks[num_free_blocks++] = block;
+            return;
+        }
+        block->index(size);
+        staged[num_staged++] = block;
     }
 
-    TraceBuffer() : cursor(0) {}
+    void flush_out() {
+        if (out_size == 0) {
+            return;
+        }
+        bool success;
+        if (encoder) {
+            success = encoder->write_block(fd, out, out_size);
+        } else {
+            success = (out_size == (uint32_t)write(fd, out, out_size));
+        }
+        if (!success) {
+            write_failed = true;
+        }
+        out_size = 0;
+    }
+
+    // Whether the packet with the given sequence number can be
+    // written out now: it's either the next one, or one we gave up
+    // waiting for.
+    __attribute__((always_inline)) bool is_due(trace_seq_t s) const {
+        return (int32_t)(s - written_seq) <= 0;
+    }
+
+    // Write out packets from the staged blocks for as long as the
+    // next one in sequence is there. Must be called with writer_lock
+    // held.
+    void write_staged() {
+        while (num_staged > 0) {
+            int found = -1;
+            for (int i = 0; i < num_staged; i++) {
+                if (is_due(staged[i]->seq(staged[i]->next))) {
+                    found = i;
+                    break;
+                }
+            }
+            if (found < 0) {
+                break;
+            }
+            // Take as many packets from this block as are due.
+            StagedBlock *block = staged[found];
+            while (block->next < block->count && is_due(block->seq(block->next))) {
+                const halide_trace_packet_t *p =
+                    (const halide_trace_packet_t *)(block->data + block->offsets[block->next] + sizeof(trace_seq_t));
+                if (out_size + p->size > buffer_size) {
+                    flush_out();
+                }
+                memcpy(out + out_size, p, p->size);
+                out_size += p->size;
+                if (block->seq(block->next) == written_seq) {
+                    written_seq++;
+                }
+                block->next++;
+            }
+            if (block->next == block->count) {
+                staged[found] = staged[--num_staged];
+                free_blocks[num_free_blocks++] = block;
+            }
+        }
+        flush_out();
+    }
+
+    // Drain the full halves (or, if all is set, everything) and write
+    // out as much as can be written in order.
+    void write_out(bool all) {
+        ScopedMutexLock lock(&writer_lock);
+        if (!all) {
+            for (int i = 0; i < num_trace_stripes; i++) {
+                for (int j = 0; j < 2; j++) {
+                    TraceBuffer &b = stripes[i].halves[j];
+                    if (b.is_pending()) {
+                        stage(b);
+                    }
+                }
+            }
+            write_staged();
+            // The packets the staged blocks are waiting for are in
+            // buffers that aren't full yet. Don't let them pile up.
+            all = num_staged > 2 * num_trace_stripes;
+        }
+        if (all) {
+            for (int i = 0; i < num_trace_stripes; i++) {
+                TraceStripe &stripe = stripes[i];
+                int idx = stripe.active;
+                stage(stripe.halves[1 - idx]);
+                stage(stripe.halves[idx]);
+            }
+            write_staged();
+        }
+    }
+
+    void destroy() {
+        for (int i = 0; i < num_staged; i++) {
+            free(staged[i]);
+        }
+        for (int i = 0; i < num_free_blocks; i++) {
+            free(free_blocks[i]);
+        }
+        if (encoder) {
+            encoder->destroy();
+            free(encoder);
+        }
+        halide_mutex_destroy(&writer_lock);
+    }
 };
 
-WEAK TraceBuffer *halide_trace_buffer = NULL;
+WEAK TraceBuffers *halide_trace_buffer = NULL;
 WEAK int halide_trace_file = -1; // -1 indicates uninitialized
 WEAK int halide_trace_file_lock = 0;
 WEAK bool halide_trace_file_initialized = false;
 WEAK void *halide_trace_file_internally_opened = NULL;
 
+WEAK void trace_writer_thread(void *) {
+    TraceBuffers *buffers = halide_trace_buffer;
+    while (1) {
+        halide_semaphore_acquire(&buffers->writer_wakeup, 1);
+        if (buffers->stop_writer) {
+            break;
+        }
+        buffers->write_out(false);
+    }
+}
+
+// Must be called with halide_trace_file_lock held.
+WEAK TraceBuffers *create_trace_buffers() {
+    if (!halide_trace_buffer) {
+        TraceBuffers *buffers = (TraceBuffers *)malloc(sizeof(TraceBuffers));
+        if (!buffers) {
+            return NULL;
+        }
+        memset(buffers, 0, sizeof(TraceBuffers));
+        buffers->fd = halide_trace_file;
+        const char *format = getenv("HL_TRACE_FORMAT");
+        if (format && strcmp(format, "compressed") == 0) {
+            TraceEncoder *encoder = (TraceEncoder *)malloc(sizeof(TraceEncoder));
+            if (encoder) {
+                memset(encoder, 0, sizeof(TraceEncoder));
+                if (encoder->init()) {
+                    buffers->encoder = encoder;
+                } else {
+                    encoder->destroy();
+                    free(encoder);
+                }
+            }
+        }
+        __sync_synchronize();
+        halide_trace_buffer = buffers;
+        if (halide_helper_threads_supported()) {
+            buffers->writer = halide_spawn_thread(trace_writer_thread, NULL);
+        }
+    }
+    return halide_trace_buffer;
+}
+
+// Stop the writer thread, write out everything buffered, and free
+// the buffers.
+WEAK bool destroy_trace_buffers() {
+    TraceBuffers *buffers = halide_trace_buffer;
+    if (!buffers) {
+        return true;
+    }
+    if (buffers->writer) {
+        buffers->stop_writer = true;
+        buffers->wake_writer();
+        halide_join_thread(buffers->writer);
+    }
+    buffers->write_out(true);
+    bool success = !buffers->write_failed;
+    halide_trace_buffer = NULL;
+    buffers->destroy();
+    free(buffers);
+    return success;
+}
+
 }}}
 
 extern "C" {
@@ -155,8 +712,17 @@ WEAK int32_t halide_default_trace(void *user_context, const halide_trace_event_t
         uint32_t total_size_without_padding = header_bytes + value_bytes + coords_bytes + name_bytes;
         uint32_t total_size = (total_size_without_padding + 3) & ~3;
 
+        TraceBuffers *buffers = halide_trace_buffer;
+        if (!buffers) {
+            // The trace file was set directly with halide_set_trace_file.
+            ScopedSpinLock lock(&halide_trace_file_lock);
+            buffers = create_trace_buffers();
+            halide_assert(user_context, buffers && "Could not allocate trace buffers");
+        }
+
         // Claim some space to write to in the trace buffer
-        halide_trace_packet_t *packet = halide_trace_buffer->acquire_packet(user_context, fd, total_size);
+        TraceBuffer *buffer;
+        halide_trace_packet_t *packet = buffers->acquire_packet(user_context, fd, total_size, &buffer);
 
         if (total_size > 4096) {
             print(NULL) << total_size << "\n";
@@ -179,13 +745,14 @@ WEAK int32_t halide_default_trace(void *user_context, const halide_trace_event_t
         memcpy((void *)packet->func(), e->func, name_bytes);
 
         // Release it
-        halide_trace_buffer->release_packet(packet);
+        buffer->release_packet(packet);
 
         // We should also flush the trace buffer if we hit an event
         // that might be the end of the trace.
         if (e->event == halide_trace_end_pipeline) {
-            halide_trace_buffer->flush(user_context, fd);
+            buffers->write_out(true);
         }
+        halide_assert(user_context, !buffers->write_failed && "Could not write to trace file");
 
     } else {
         uint8_t buffer[4096];
@@ -321,9 +888,7 @@ WEAK int halide_get_trace_file(void *user_context) {
             halide_assert(user_context, file && "Failed to open trace file\n");
             halide_set_trace_file(fileno(file));
             halide_trace_file_internally_opened = file;
-            if (!halide_trace_buffer) {
-                halide_trace_buffer = (TraceBuffer *)malloc(sizeof(TraceBuffer));
-            }
+            create_trace_buffers();
         } else {
             halide_set_trace_file(0);
         }
@@ -336,17 +901,15 @@ WEAK int32_t halide_trace(void *user_context, const halide_trace_event_t *e) {
 }
 
 WEAK int halide_shutdown_trace() {
+    bool flushed = destroy_trace_buffers();
     if (halide_trace_file_internally_opened) {
         int ret = fclose(halide_trace_file_internally_opened);
         halide_trace_file = 0;
         halide_trace_file_initialized = false;
         halide_trace_file_internally_opened = NULL;
-        if (halide_trace_buffer) {
-            free(halide_trace_buffer);
-        }
-        return ret;
+        return flushed ? ret : -1;
     } else {
-        return 0;
+        return flushed ? 0 : -1;
     }
 }
 
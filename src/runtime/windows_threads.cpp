@@ -28,6 +28,20 @@ extern WIN32API void LeaveCriticalSection(CriticalSection *);
 extern WIN32API int32_t WaitForSingleObject(Thread, int32_t timeout);
 extern WIN32API bool InitOnceExecuteOnce(InitOnce *, bool WIN32API (*f)(InitOnce *, void *, void **), void *, void **);
 
+typedef struct {
+    uintptr_t mask;
+    uint16_t group;
+    uint16_t reserved[3];
+} GroupAffinity;
+
+extern WIN32API void *GetCurrentProcess();
+extern WIN32API Thread GetCurrentThread();
+extern WIN32API bool GetProcessAffinityMask(void *, uintptr_t *, uintptr_t *);
+extern WIN32API uintptr_t SetThreadAffinityMask(Thread, uintptr_t);
+extern WIN32API bool GetNumaHighestNodeNumber(uint32_t *);
+extern WIN32API bool GetNumaNodeProcessorMaskEx(uint16_t, GroupAffinity *);
+extern WIN32API bool GetThreadGroupAffinity(Thread, GroupAffinity *);
+
 } // extern "C"
 
 namespace Halide { namespace Runtime { namespace Internal {
@@ -53,6 +67,9 @@ WEAK void *spawn_thread_helper(void *arg) {
     return NULL;
 }
 
+// The affinity mask of the process before any threads were pinned.
+WEAK uintptr_t original_affinity = 0;
+
 }}} // namespace Halide::Runtime::Internal
 
 extern "C" {
@@ -122,4 +139,67 @@ WEAK int halide_host_cpu_count() {
     }
 }
 
+WEAK int halide_host_cpus_by_numa_node(int *cpus, int max_cpus) {
+    // Only consider CPUs we're allowed to run on. Affinity masks
+    // only cover the processor group the process runs in, which is
+    // the group of this thread and of the threads it spawns, so CPUs
+    // in other groups are never used.
+    uintptr_t allowed = 0, system = 0;
+    uint32_t highest_node = 0;
+    GroupAffinity current;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &allowed, &system) ||
+        !GetThreadGroupAffinity(GetCurrentThread(), &current) ||
+        !GetNumaHighestNodeNumber(&highest_node)) {
+        return 0;
+    }
+    if (!original_affinity) {
+        original_affinity = allowed;
+    }
+
+    const int bits = sizeof(uintptr_t) * 8;
+    uintptr_t placed = 0;
+    int num_cpus = 0;
+    for (uint32_t node = 0; node <= highest_node; node++) {
+        GroupAffinity affinity;
+        if (!GetNumaNodeProcessorMaskEx((uint16_t)node, &affinity) ||
+            affinity.group != current.group) {
+            continue;
+        }
+        for (int cpu = 0; cpu < bits && num_cpus < max_cpus; cpu++) {
+            uintptr_t bit = (uintptr_t)1 << cpu;
+            if ((affinity.mask & allowed & ~placed) & bit) {
+                placed |= bit;
+                cpus[num_cpus++] = cpu;
+            }
+        }
+    }
+
+    // Treat anything not listed as belonging to one more node.
+    for (int cpu = 0; cpu < bits && num_cpus < max_cpus; cpu++) {
+        uintptr_t bit = (uintptr_t)1 << cpu;
+        if ((allowed & ~placed) & bit) {
+            placed |= bit;
+            cpus[num_cpus++] = cpu;
+        }
+    }
+    return num_cpus;
+}
+
+WEAK int halide_pin_current_thread_to_cpu(int cpu) {
+    uintptr_t mask;
+    if (cpu < 0) {
+        if (!original_affinity) {
+            // Nothing has been pinned yet.
+            return 0;
+        }
+        mask = original_affinity;
+    } else if (cpu < (int)(sizeof(uintptr_t) * 8)) {
+        mask = (uintptr_t)1 << cpu;
+    } else {
+        return -1;
+    }
+    // Returns the previous mask, or zero on failure.
+    return SetThreadAffinityMask(GetCurrentThread(), mask) ? 0 : -1;
+}
+
 } // extern "C"
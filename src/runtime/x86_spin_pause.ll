@@ -0,0 +1,8 @@
+; Hint to the processor that the thread pool is spin-waiting, which
+; saves power and frees resources for the other hyperthread.
+define weak_odr void @spin_pause_halide() nounwind {
+  call void @llvm.x86.sse2.pause()
+  ret void
+}
+
+declare void @llvm.x86.sse2.pause() nounwind
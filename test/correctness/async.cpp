@@ -0,0 +1,91 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int check(Buffer<int> result) {
+    for (int y = 0; y < result.height(); y++) {
+        for (int x = 0; x < result.width(); x++) {
+            int correct = 2 * x + 4 * y;
+            if (result(x, y) != correct) {
+                printf("result(%d, %d) = %d instead of %d\n",
+                       x, y, result(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Var x, y;
+
+    // A producer running ahead of a serial consumer, across the loop
+    // over y.
+    {
+        Func f, g;
+        f(x, y) = x + y;
+        g(x, y) = f(x, y - 1) + f(x, y + 1);
+
+        f.store_root().compute_at(g, y).async();
+
+        if (check(g.realize(64, 64))) return -1;
+    }
+
+    // The same with a vectorized consumer, and a producer that is
+    // itself parallel.
+    {
+        Func f, g;
+        f(x, y) = x + y;
+        g(x, y) = f(x, y - 1) + f(x, y + 1);
+
+        Var yo, yi;
+        f.store_root().compute_at(g, yi).async().parallel(x, 16);
+        g.split(y, yo, yi, 8).vectorize(x, 8);
+
+        if (check(g.realize(128, 128))) return -1;
+    }
+
+    // Async producers nested within a parallel loop of the consumer.
+    {
+        Func f, g;
+        f(x, y) = x + y;
+        g(x, y) = f(x, y - 1) + f(x, y + 1);
+
+        Var yo, yi;
+        g.split(y, yo, yi, 16).parallel(yo);
+        f.store_at(g, yo).compute_at(g, yi).async();
+
+        if (check(g.realize(64, 64))) return -1;
+    }
+
+    // Async producers with storage hoisted out of a parallel loop of
+    // the consumer. Each iteration must wait for its own production.
+    {
+        Func f, g;
+        f(x, y) = x + y;
+        g(x, y) = f(x, y - 1) + f(x, y + 1);
+
+        g.parallel(y);
+        f.store_root().compute_at(g, y).async();
+
+        if (check(g.realize(64, 64))) return -1;
+    }
+
+    // The same with a serial loop inside the parallel one, across
+    // which the producer runs ahead.
+    {
+        Func f, g;
+        f(x, y) = x + y;
+        g(x, y) = f(x, y - 1) + f(x, y + 1);
+
+        Var yo, yi;
+        g.split(y, yo, yi, 8).parallel(yo);
+        f.store_root().compute_at(g, yi).async();
+
+        if (check(g.realize(64, 64))) return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
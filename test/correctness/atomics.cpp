@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <stdio.h>
+#include "Halide.h"
+
+using namespace Halide;
+
+template<typename T>
+int check(Buffer<T> result, const T *reference, const char *name) {
+    for (int i = 0; i < result.width(); i++) {
+        if (result(i) != reference[i]) {
+            printf("%s: bucket %d is %f instead of %f\n",
+                   name, i, (double)result(i), (double)reference[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int W = 256, H = 256;
+
+    Buffer<uint8_t> in(W, H);
+    int reference_hist[256] = {0};
+    float reference_weights[256] = {0};
+    int reference_max[256];
+    for (int i = 0; i < 256; i++) {
+        reference_max[i] = -1;
+    }
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            in(x, y) = rand() & 0xff;
+            reference_hist[in(x, y)] += 1;
+            // Small integers, so the float sums are exact in any order.
+            reference_weights[in(x, y)] += (float)(x & 3);
+            reference_max[in(x, y)] = std::max(reference_max[in(x, y)], x + y);
+        }
+    }
+
+    Var x;
+    RDom r(in);
+    RVar ryo, ryi;
+
+    // An integer histogram, which becomes an atomic add.
+    {
+        Func hist;
+        hist(x) = 0;
+        hist(cast<int>(in(r.x, r.y))) += 1;
+
+        hist.update().atomic().split(r.y, ryo, ryi, 16).parallel(ryo).vectorize(r.x, 8);
+
+        Buffer<int> result = hist.realize(256);
+        if (check(result, reference_hist, "hist")) return -1;
+    }
+
+    // A float histogram, which needs a compare-and-swap loop.
+    {
+        Func hist;
+        hist(x) = 0.0f;
+        hist(cast<int>(in(r.x, r.y))) += cast<float>(r.x % 4);
+
+        hist.update().atomic().split(r.y, ryo, ryi, 16).parallel(ryo);
+
+        Buffer<float> result = hist.realize(256);
+        if (check(result, reference_weights, "weights")) return -1;
+    }
+
+    // A scattered max, which becomes an atomic max.
+    {
+        Func hist;
+        hist(x) = -1;
+        hist(cast<int>(in(r.x, r.y))) = max(hist(cast<int>(in(r.x, r.y))), r.x + r.y);
+
+        hist.update().atomic().parallel(r.y);
+
+        Buffer<int> result = hist.realize(256);
+        if (check(result, reference_max, "max")) return -1;
+    }
+
+    // A histogram that reads the bucket it updates through an index
+    // that is only equal to it at runtime, which also needs a
+    // compare-and-swap loop.
+    {
+        Param<int> zero;
+        zero.set(0);
+        Func hist;
+        hist(x) = 0;
+        Expr bucket = cast<int>(in(r.x, r.y));
+        hist(bucket) = hist(bucket + zero) + 1;
+
+        hist.update().atomic().split(r.y, ryo, ryi, 16).parallel(ryo);
+
+        Buffer<int> result = hist.realize(256);
+        if (check(result, reference_hist, "hist with an offset")) return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+// Check the records HL_COMPILE_PROFILE writes. They are written when
+// the process exits, so the compiling is done by a second run of this
+// test.
+
+namespace {
+
+int count_of(const std::string &s, const std::string &pattern) {
+    int count = 0;
+    for (size_t pos = s.find(pattern); pos != std::string::npos; pos = s.find(pattern, pos + 1)) {
+        count++;
+    }
+    return count;
+}
+
+void compile_pipeline(const std::string &prefix) {
+    Func f("f"), g("g");
+    Var x("x"), y("y");
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) + f(x + 1, y);
+    f.compute_root();
+    g.compile_to(Outputs().object(prefix + ".o").assembly(prefix + ".s"), {}, "compile_profile");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::string prefix = Internal::get_test_tmp_dir() + "compile_profile";
+    std::string json = prefix + ".json";
+
+    if (argc > 1) {
+        compile_pipeline(prefix);
+        return 0;
+    }
+
+    Internal::ensure_no_file_exists(json);
+    setenv("HL_COMPILE_PROFILE", json.c_str(), 1);
+    std::string command = std::string("\"") + argv[0] + "\" compile";
+    if (system(command.c_str()) != 0) {
+        printf("Running %s failed\n", command.c_str());
+        return -1;
+    }
+
+    FILE *f = fopen(json.c_str(), "r");
+    if (!f) {
+        printf("No compile profile written to %s\n", json.c_str());
+        return -1;
+    }
+    std::string profile;
+    char block[4096];
+    size_t read;
+    while ((read = fread(block, 1, sizeof(block), f)) > 0) {
+        profile.append(block, read);
+    }
+    fclose(f);
+
+    if (count_of(profile, "\"name\": \"compile_profile\"") == 0 ||
+        count_of(profile, "\"name\": \"first simplification\"") != 1) {
+        printf("Lowering passes missing from the compile profile:\n%s", profile.c_str());
+        return -1;
+    }
+
+    // Each output is generated once, and recorded as what it is.
+    if (count_of(profile, "\"name\": \"LLVM code generation (object)\"") != 1 ||
+        count_of(profile, "\"name\": \"LLVM code generation (assembly)\"") != 1) {
+        printf("Expected one code generation record for each of the object and assembly:\n%s",
+               profile.c_str());
+        return -1;
+    }
+
+    // Memory use is recorded per pass.
+    if (count_of(profile, "\"memory_delta_bytes\": ") != count_of(profile, "\"time_ms\": ")) {
+        printf("Not every pass has a memory record:\n%s", profile.c_str());
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+// The functions of a Module are compiled in parallel when it is
+// compiled to a static library. Check that the library is the same as
+// the one a serial compile makes (HL_DEBUG_CODEGEN forces one thread,
+// so that compile is done by a second run of this test), and that a
+// library compiled along with an object holds that object.
+
+namespace {
+
+#ifdef _MSC_VER
+const char *lib_ext = ".lib";
+const char *obj_ext = ".obj";
+#else
+const char *lib_ext = ".a";
+const char *obj_ext = ".o";
+#endif
+
+Module make_module() {
+    Target t = get_target_from_environment();
+    Var x("x"), y("y");
+    Func f("f"), g("g");
+    f(x, y) = x + y;
+    g(x, y) = cast<float>(x) * 0.5f - y;
+    g.vectorize(x, 8);
+
+    Module m("parallel_library", t);
+    m.append(Pipeline(f).compile_to_module({}, "first", t).functions()[0]);
+    m.append(Pipeline(g).compile_to_module({}, "second", t).functions()[0]);
+    return m;
+}
+
+std::string read_file(const std::string &name) {
+    std::string contents;
+    FILE *f = fopen(name.c_str(), "rb");
+    if (!f) {
+        return contents;
+    }
+    char block[4096];
+    size_t read;
+    while ((read = fread(block, 1, sizeof(block), f)) > 0) {
+        contents.append(block, read);
+    }
+    fclose(f);
+    return contents;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::string prefix = Internal::get_test_tmp_dir() + "compile_to_static_library_parallel";
+    std::string lib = prefix + lib_ext;
+
+    if (argc > 1) {
+        make_module().compile(Outputs().static_library(lib));
+        return 0;
+    }
+
+    std::string parallel_lib = prefix + "_parallel" + lib_ext;
+    Internal::ensure_no_file_exists(lib);
+    Internal::ensure_no_file_exists(parallel_lib);
+    make_module().compile(Outputs().static_library(lib));
+    if (rename(lib.c_str(), parallel_lib.c_str())) {
+        printf("Could not rename %s\n", lib.c_str());
+        return -1;
+    }
+
+    setenv("HL_DEBUG_CODEGEN", "1", 1);
+    std::string command = std::string("\"") + argv[0] + "\" serial";
+    if (system(command.c_str()) != 0) {
+        printf("Running %s failed\n", command.c_str());
+        return -1;
+    }
+    unsetenv("HL_DEBUG_CODEGEN");
+
+    std::string serial = read_file(lib), parallel = read_file(parallel_lib);
+    if (serial.empty() || serial != parallel) {
+        printf("The static libraries compiled serially and in parallel differ\n");
+        return -1;
+    }
+
+    // An object and a static library compiled together hold the same
+    // code.
+    std::string obj = prefix + obj_ext;
+    Internal::ensure_no_file_exists(obj);
+    Internal::ensure_no_file_exists(lib);
+    make_module().compile(Outputs().object(obj).static_library(lib));
+    std::string object = read_file(obj);
+    if (object.empty() || read_file(lib).find(object) == std::string::npos) {
+        printf("The static library does not hold the object compiled with it\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int check(Buffer<int> result, int offset) {
+    for (int y = 0; y < result.height(); y++) {
+        for (int x = 0; x < result.width(); x++) {
+            int correct = 4 * (x + y) + offset;
+            if (result(x, y) != correct) {
+                printf("result(%d, %d) = %d instead of %d\n",
+                       x, y, result(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Var x, y;
+
+    // Two producers of the same consumer, with different bounds, fused
+    // within the consumer's loop over y.
+    {
+        Func f, g, h;
+        f(x, y) = x + y;
+        g(x, y) = x + y;
+        h(x, y) = f(x, y) + g(x + 1, y) + f(x - 1, y) + g(x + 2, y);
+
+        f.compute_at(h, y);
+        g.compute_at(h, y).compute_with(f, x);
+
+        if (check(h.realize(64, 64), 2)) return -1;
+    }
+
+    // Two root producers fused down to the loop over x.
+    {
+        Func f, g, h;
+        f(x, y) = x + y;
+        g(x, y) = x + y;
+        h(x, y) = f(x, y) + g(x + 1, y) + f(x - 1, y) + g(x + 2, y);
+
+        f.compute_root();
+        g.compute_root().compute_with(f, x);
+
+        if (check(h.realize(64, 64), 2)) return -1;
+    }
+
+    // An update stage fused with the pure definition over y, so each
+    // row is updated right after it is initialized.
+    {
+        Func f, h;
+        f(x, y) = x + y;
+        f(x, y) = f(x, y) * 2 + 1;
+        h(x, y) = f(x, y) + 2 * (x + y);
+
+        f.compute_root();
+        f.update(0).compute_with(f, y);
+
+        if (check(h.realize(64, 64), 1)) return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,154 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "test/common/halide_test_dirs.h"
+
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+using namespace Halide;
+
+// Check that the on-disk cache of JIT-compiled code is hit when the
+// same pipeline is compiled again. Lowering makes up some names
+// differently each time, so this also checks that they don't end up
+// in the cache keys.
+
+namespace {
+
+Func make_pipeline(int k) {
+    Func f("f");
+    Var x("x"), y("y"), xi("xi");
+    // CSE introduces lets with made-up names here.
+    Expr e = (x + y) * k;
+    f(x, y) = e * e + e;
+    f.split(x, x, xi, 8).vectorize(xi).parallel(y);
+    return f;
+}
+
+int expected(int k, int x, int y) {
+    int e = (x + y) * k;
+    return e * e + e;
+}
+
+int check(Buffer<int> out, int k) {
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            if (out(x, y) != expected(k, x, y)) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), expected(k, x, y));
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+#ifndef _WIN32
+// The names of the files in a directory.
+std::vector<std::string> list_dir(const std::string &dir) {
+    std::vector<std::string> files;
+    DIR *d = opendir(dir.c_str());
+    if (!d) {
+        return files;
+    }
+    while (struct dirent *entry = readdir(d)) {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..") {
+            files.push_back(name);
+        }
+    }
+    closedir(d);
+    return files;
+}
+
+// The one file in dir with the given extension, or the empty string.
+std::string find_entry(const std::string &dir, const std::string &ext) {
+    std::string found;
+    for (const std::string &name : list_dir(dir)) {
+        if (Internal::ends_with(name, ext)) {
+            if (!found.empty()) {
+                return "";
+            }
+            found = dir + "/" + name;
+        }
+    }
+    return found;
+}
+
+// Remove what a previous run left in the cache directory.
+void make_empty_dir(const std::string &dir) {
+    for (const std::string &name : list_dir(dir)) {
+        Internal::ensure_no_file_exists(dir + "/" + name);
+    }
+}
+
+bool copy_file(const std::string &from, const std::string &to) {
+    FILE *in = fopen(from.c_str(), "rb");
+    FILE *out = fopen(to.c_str(), "wb");
+    bool ok = in && out;
+    char block[4096];
+    size_t read;
+    while (ok && (read = fread(block, 1, sizeof(block), in)) > 0) {
+        ok = fwrite(block, 1, read, out) == read;
+    }
+    if (in) fclose(in);
+    if (out) fclose(out);
+    return ok;
+}
+#endif
+
+}  // namespace
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("Skipping test on Windows\n");
+    return 0;
+#else
+    const int W = 64, H = 16;
+    std::string dir_a = Internal::get_test_tmp_dir() + "jit_cache_a";
+    std::string dir_b = Internal::get_test_tmp_dir() + "jit_cache_b";
+    make_empty_dir(dir_a);
+    make_empty_dir(dir_b);
+
+    // Compile two pipelines that differ only in a constant, each into
+    // a cache of its own.
+    setenv("HL_JIT_CACHE_DIR", dir_a.c_str(), 1);
+    if (check(make_pipeline(1).realize(W, H), 1)) return -1;
+    setenv("HL_JIT_CACHE_DIR", dir_b.c_str(), 1);
+    if (check(make_pipeline(2).realize(W, H), 2)) return -1;
+
+    std::string object_a = find_entry(dir_a, ".o"), entry_points_a = find_entry(dir_a, ".bc");
+    std::string object_b = find_entry(dir_b, ".o"), entry_points_b = find_entry(dir_b, ".bc");
+    if (object_a.empty() || entry_points_a.empty() ||
+        object_b.empty() || entry_points_b.empty()) {
+        printf("Expected one cache entry in each of %s and %s\n", dir_a.c_str(), dir_b.c_str());
+        return -1;
+    }
+
+    // Compiling the first pipeline again should find its entry...
+    setenv("HL_JIT_CACHE_DIR", dir_a.c_str(), 1);
+    if (check(make_pipeline(1).realize(W, H), 1)) return -1;
+    if (list_dir(dir_a).size() != 2) {
+        printf("Compiling the same pipeline again added a cache entry\n");
+        return -1;
+    }
+
+    // ...so if its entry holds the code of the second pipeline, that
+    // is what runs.
+    if (!copy_file(object_b, object_a) || !copy_file(entry_points_b, entry_points_a)) {
+        printf("Could not copy the cache entry of the second pipeline\n");
+        return -1;
+    }
+    if (check(make_pipeline(1).realize(W, H), 2)) {
+        printf("Compiling the same pipeline again did not hit the cache\n");
+        return -1;
+    }
+
+    unsetenv("HL_JIT_CACHE_DIR");
+    printf("Success!\n");
+    return 0;
+#endif
+}
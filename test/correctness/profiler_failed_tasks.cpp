@@ -0,0 +1,73 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+// Tasks of parallel loops claim a profiler slot to report what they
+// are computing in. Check that tasks that fail give theirs back, so
+// that later pipelines are still attributed correctly.
+
+int percentage = -1;
+void my_print(void *, const char *msg) {
+    float this_ms;
+    int this_percentage;
+    int val = sscanf(msg, " busy: %fms (%d", &this_ms, &this_percentage);
+    if (val == 2) {
+        percentage = this_percentage;
+    }
+}
+
+int errors = 0;
+void my_error(void *, const char *msg) {
+    errors++;
+}
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment().with_feature(Target::Profile);
+    Var x, y;
+
+    // Every task of this pipeline fails. Run it enough times to fail
+    // more tasks than there are slots.
+    Param<int> limit;
+    Func fails("fails");
+    fails(x, y) = require(y < limit, x + y, "y is too large:", y);
+    fails.parallel(y);
+    fails.set_error_handler(&my_error);
+    fails.set_custom_print(&my_print);
+    fails.compile_jit(t);
+    limit.set(0);
+    for (int i = 0; i < 2 * HALIDE_PROFILER_MAX_THREAD_SLOTS; i++) {
+        fails.realize(16, 64, t);
+    }
+    if (errors == 0) {
+        printf("The failing pipeline didn't fail\n");
+        return -1;
+    }
+
+    // Now a pipeline that spends nearly all of its time in one Func.
+    Func busy("busy"), out("out");
+    Expr e = cast<float>(x + y);
+    for (int i = 0; i < 200; i++) {
+        e = sin(e);
+    }
+    busy(x, y) = e;
+    out(x, y) = busy(x, y) * 2.0f;
+    busy.compute_at(out, y);
+    out.parallel(y);
+    out.set_custom_print(&my_print);
+    out.realize(1000, 1000, t);
+
+    if (percentage < 0) {
+        printf("No profiler report for busy\n");
+        return -1;
+    }
+    if (percentage < 40) {
+        printf("Percentage of runtime spent in busy: %d\n"
+               "It should be nearly all of it. Did the failed tasks leak their slots?\n",
+               percentage);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
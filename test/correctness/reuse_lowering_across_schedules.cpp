@@ -0,0 +1,81 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+bool check_stats(Pipeline p, int envs, int orders, int computed, int reused) {
+    const Internal::LoweringCache &c = p.lowering_cache();
+    if (c.environments_computed != envs ||
+        c.realization_orders_computed != orders ||
+        c.value_bounds_computed != computed ||
+        c.value_bounds_reused != reused) {
+        printf("Expected %d environments, %d realization orders, %d value bounds computed and %d reused\n"
+               "Got %d environments, %d realization orders, %d value bounds computed and %d reused\n",
+               envs, orders, computed, reused,
+               c.environments_computed, c.realization_orders_computed,
+               c.value_bounds_computed, c.value_bounds_reused);
+        return false;
+    }
+    return true;
+}
+
+bool check_output(Pipeline p) {
+    Buffer<int> out = p.realize(100);
+    for (int x = 0; x < out.width(); x++) {
+        // f[i](x) = f[i-1](x) + i, so f[5](x) = x + 15.
+        int correct = x + 15;
+        if (out(x) != correct) {
+            printf("out(%d) = %d instead of %d\n", x, out(x), correct);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const int n = 6;
+    Func f[n];
+    Var x;
+    f[0](x) = x;
+    for (int i = 1; i < n; i++) {
+        f[i](x) = f[i-1](x) + i;
+    }
+
+    Pipeline p(f[n-1]);
+
+    // The first compile has to work everything out.
+    if (!check_output(p) || !check_stats(p, 1, 1, 6, 0)) {
+        return -1;
+    }
+
+    // Changing only the schedule reuses the graph of Funcs, the
+    // realization order, and the value bounds of every Func.
+    f[2].compute_root();
+    f[4].compute_root().vectorize(x, 4);
+    p.invalidate_cache();
+    if (!check_output(p) || !check_stats(p, 1, 1, 6, 6)) {
+        return -1;
+    }
+
+    // Specializing a Func changes its definition, so the graph and
+    // order have to be recomputed, along with the value bounds of
+    // that Func and everything that calls it. The Funcs it calls are
+    // still reused.
+    Param<int> param;
+    param.set(1);
+    f[3].specialize(param > 0);
+    p.invalidate_cache();
+    if (!check_output(p) || !check_stats(p, 2, 2, 9, 9)) {
+        return -1;
+    }
+
+    // Running with a different value of the param doesn't lower
+    // anything.
+    param.set(0);
+    if (!check_output(p) || !check_stats(p, 2, 2, 9, 9)) {
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
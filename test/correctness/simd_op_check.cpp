@@ -31,6 +31,9 @@ const Expr max_u32 = UInt(32).max();
 
 const Var x{"x"}, y{"y"};
 
+// The reduction domain of the tests of horizontal reductions.
+const RDom r_reduce{0, 64, "r_reduce"};
+
 struct TestResult {
     string op;
     string error_msg;
@@ -41,6 +44,7 @@ struct Task {
     string name;
     int vector_width;
     Expr expr;
+    bool reduction;
 };
 
 size_t num_threads = Halide::Internal::ThreadPool<void>::num_processors_online();
@@ -49,6 +53,7 @@ struct Test {
     bool use_avx2{false};
     bool use_avx512{false};
     bool use_avx512_cannonlake{false};
+    bool use_avx512_cascadelake{false};
     bool use_avx512_knl{false};
     bool use_avx512_skylake{false};
     bool use_avx{false};
@@ -85,7 +90,9 @@ struct Test {
             .with_feature(Target::NoRuntime);
         use_avx512_knl = target.has_feature(Target::AVX512_KNL);
         use_avx512_cannonlake = target.has_feature(Target::AVX512_Cannonlake);
-        use_avx512_skylake = use_avx512_cannonlake || target.has_feature(Target::AVX512_Skylake);
+        use_avx512_cascadelake = target.has_feature(Target::AVX512_Cascadelake);
+        use_avx512_skylake = use_avx512_cannonlake || use_avx512_cascadelake ||
+            target.has_feature(Target::AVX512_Skylake);
         use_avx512 = use_avx512_knl || use_avx512_skylake || use_avx512_cannonlake || target.has_feature(Target::AVX512);
         use_avx2 = use_avx512 || target.has_feature(Target::AVX2);
         use_avx = use_avx2 || target.has_feature(Target::AVX);
@@ -139,10 +146,10 @@ struct Test {
         // A bunch of feature flags also need to match between the
         // compiled code and the host in order to run the code.
         for (Target::Feature f : {Target::SSE41, Target::AVX,
-                    Target::AVX2, Target::AVX512,
+                    Target::AVX2, Target::AVX512, Target::AVX512_Cascadelake,
                     Target::FMA, Target::FMA4, Target::F16C,
                     Target::VSX, Target::POWER_ARCH_2_07,
-                    Target::ARMv7s, Target::NoNEON, Target::MinGW}) {
+                    Target::ARMv7s, Target::ARMDotProd, Target::NoNEON, Target::MinGW}) {
             if (target.has_feature(f) != host_target.has_feature(f)) {
                 can_run_the_code = false;
             }
@@ -190,18 +197,31 @@ struct Test {
         return wildcard_match("*" + p + "*", str);
     }
 
-    TestResult check_one(const string &op, const string &name, int vector_width, Expr e) const {
+    TestResult check_one(const string &op, const string &name, int vector_width, Expr e, bool reduction) const {
         std::ostringstream error_msg;
 
-        // Define a vectorized Func that uses the pattern.
+        // Define a vectorized Func that uses the pattern. A reduction
+        // sums the pattern over r_reduce, vectorized across r_reduce.
         Func f(name);
-        f(x, y) = e;
-        f.bound(x, 0, W).vectorize(x, vector_width);
+        if (reduction) {
+            f(x, y) = cast(e.type(), 0);
+            f(x, y) += e;
+            f.update().vectorize(r_reduce, vector_width);
+        } else {
+            f(x, y) = e;
+            f.vectorize(x, vector_width);
+        }
+        f.bound(x, 0, W);
         f.compute_root();
 
         // Include a scalar version
         Func f_scalar("scalar_" + name);
-        f_scalar(x, y) = e;
+        if (reduction) {
+            f_scalar(x, y) = cast(e.type(), 0);
+            f_scalar(x, y) += e;
+        } else {
+            f_scalar(x, y) = e;
+        }
         f_scalar.bound(x, 0, W);
         f_scalar.compute_root();
 
@@ -258,7 +278,7 @@ struct Test {
         return { op, error_msg.str() };
     }
 
-    void check(string op, int vector_width, Expr e) {
+    void check(string op, int vector_width, Expr e, bool reduction = false) {
         // Make a name for the test by uniquing then sanitizing the op name
         string name = "op_" + op;
         for (size_t i = 0; i < name.size(); i++) {
@@ -272,7 +292,12 @@ struct Test {
         // settings.
         if (!wildcard_match(filter, op)) return;
 
-        tasks.emplace_back(Task {op, name, vector_width, e});
+        tasks.emplace_back(Task {op, name, vector_width, e, reduction});
+    }
+
+    // Check a horizontal sum of e over r_reduce.
+    void check_reduce(string op, int vector_width, Expr e) {
+        check(op, vector_width, e, true);
     }
 
     void check_sse_all() {
@@ -460,6 +485,14 @@ struct Test {
             check("pmaddwd", 8, i32(i16_1) * 3 + i32(i16_2) * 4);
         }
 
+        // Sums of products of 16-bit values reduced across a vector.
+        for (int w = 2; w <= 4; w++) {
+            check_reduce("pmaddwd", 4*w, i32(in_i16(x + r_reduce)) * i32(in_i16(x + r_reduce + 16)));
+        }
+        if (use_avx2) {
+            check_reduce("vpmaddwd*ymm", 16, i32(in_i16(x + r_reduce)) * i32(in_i16(x + r_reduce + 16)));
+        }
+
         // llvm doesn't distinguish between signed and unsigned multiplies
         //check("pmuldq", 4, i64(i32_1) * i64(i32_2));
 
@@ -646,6 +679,9 @@ struct Test {
             check("vreducepd", 8, f64_1 - trunc(f64_1*8)/8);
 #endif
         }
+        if (use_avx512_cascadelake) {
+            check_reduce("vpdpbusd", 64, i32(in_u8(x + r_reduce)) * i32(in_i8(x + r_reduce + 16)));
+        }
         if (use_avx512_skylake) {
             check("vpabsq", 8, abs(i64_1));
             check("vpmaxuq", 8, max(u64_1, u64_2));
@@ -1423,6 +1459,15 @@ struct Test {
         // Interleave or deinterleave two vectors. Given that we use
         // interleaving loads and stores, it's hard to hit this op with
         // halide.
+
+        // UDOT/SDOT    -       Dot Product
+        // Sums groups of four products of bytes.
+        if (!arm32 && target.has_feature(Target::ARMDotProd)) {
+            for (int w = 1; w <= 4; w++) {
+                check_reduce("udot", 16*w, u32(in_u8(x + r_reduce)) * u32(in_u8(x + r_reduce + 16)));
+                check_reduce("sdot", 16*w, i32(in_i8(x + r_reduce)) * i32(in_i8(x + r_reduce + 16)));
+            }
+        }
     }
 
     void check_hvx_all() {
@@ -2078,7 +2123,7 @@ check("v*.w += vrmpy(v*.b,v*.b)", hvx_width, i32_1 + i32(i8_1)*i8_1 + i32(i8_2)*
         std::vector<std::future<TestResult>> futures;
         for (const Task &task : tasks) {
             futures.push_back(pool.async([this, task]() {
-                return check_one(task.op, task.name, task.vector_width, task.expr);
+                return check_one(task.op, task.name, task.vector_width, task.expr, task.reduction);
             }));
         }
 
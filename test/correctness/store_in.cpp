@@ -0,0 +1,91 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Halide;
+
+bool malloc_called = false;
+
+void *my_malloc(void *user_context, size_t x) {
+    malloc_called = true;
+    void *orig = malloc(x + 32);
+    void *ptr = (void *)((((size_t)orig + 32) >> 5) << 5);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void my_free(void *user_context, void *ptr) {
+    free(((void **)ptr)[-1]);
+}
+
+int check(Buffer<int> result) {
+    for (int y = 0; y < result.height(); y++) {
+        for (int x = 0; x < result.width(); x++) {
+            int correct = 2 * x + 3 * y + 1;
+            if (result(x, y) != correct) {
+                printf("result(%d, %d) = %d instead of %d\n",
+                       x, y, result(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Var x, y;
+
+    // A small intermediate forced onto the heap.
+    {
+        Func f, g;
+        f(x, y) = x + y;
+        g(x, y) = f(x, y) + f(x + 1, y) + y;
+
+        f.compute_at(g, y).store_in(MemoryType::Heap);
+        g.set_custom_allocator(my_malloc, my_free);
+
+        malloc_called = false;
+        if (check(g.realize(64, 64))) return -1;
+        if (!malloc_called) {
+            printf("A heap allocation did not call halide_malloc\n");
+            return -1;
+        }
+    }
+
+    // A large intermediate forced onto the stack. Its size is only
+    // bounded by a constant via the bounds of its consumer.
+    {
+        Func f, g;
+        f(x, y) = x + y;
+        g(x, y) = f(x, y) + f(x + 1, y) + y;
+
+        Var xo, xi;
+        g.split(x, xo, xi, 1024);
+        f.compute_at(g, xo).store_in(MemoryType::Stack);
+        g.set_custom_allocator(my_malloc, my_free);
+
+        malloc_called = false;
+        if (check(g.realize(4096, 4))) return -1;
+        if (malloc_called) {
+            printf("A stack allocation called halide_malloc\n");
+            return -1;
+        }
+    }
+
+    // A small intermediate held in registers, with all accesses to it
+    // made constant by unrolling and vectorization.
+    {
+        Func f, g;
+        f(x, y) = x + y;
+        g(x, y) = f(x, y) + f(x + 1, y) + y;
+
+        Var xo, xi;
+        g.split(x, xo, xi, 8).vectorize(xi);
+        f.compute_at(g, xo).store_in(MemoryType::Register).vectorize(x, 8).unroll(x);
+
+        if (check(g.realize(64, 64))) return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "Halide.h"
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+// LLVM TargetMachines are pooled and reused across compilations. Check
+// that compiling the same and different targets from many threads at
+// once gives the same objects as compiling each one with a
+// TargetMachine of its own.
+
+namespace {
+
+const int num_pipelines = 2;
+
+Pipeline make_pipeline(int which) {
+    // Explicit names, so that every copy compiles to the same object.
+    Var x("x"), y("y");
+    Func f("f");
+    if (which == 0) {
+        f(x, y) = x + y;
+        f.vectorize(x, 8);
+    } else {
+        f(x, y) = sqrt(cast<float>(x) * 0.5f - y);
+        f.vectorize(x, 4).unroll(y, 2);
+    }
+    return Pipeline(f);
+}
+
+std::string read_file(const std::string &name) {
+    std::string contents;
+    FILE *f = fopen(name.c_str(), "rb");
+    if (!f) {
+        return contents;
+    }
+    char block[4096];
+    size_t read;
+    while ((read = fread(block, 1, sizeof(block), f)) > 0) {
+        contents.append(block, read);
+    }
+    fclose(f);
+    return contents;
+}
+
+std::string compile(int which, const Target &t, const std::string &object) {
+    Internal::ensure_no_file_exists(object);
+    make_pipeline(which).compile_to_object(object, {}, "pipeline", t);
+    return read_file(object);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::string targets[] = {
+        "x86-64-linux",
+        "x86-64-linux-sse41-avx-avx2",
+        "x86-32-linux",
+        "x86-64-windows",
+        "arm-64-linux",
+        "arm-32-linux",
+        "arm-32-linux-armv7s",
+    };
+
+    std::vector<Target> supported;
+    for (const std::string &t : targets) {
+        Target target(t);
+        if (target.supported()) {
+            supported.push_back(target.with_feature(Target::NoRuntime));
+        }
+    }
+    if (supported.empty()) {
+        printf("Not running test because none of its targets are supported.\n");
+        return 0;
+    }
+
+    std::string prefix = Internal::get_test_tmp_dir() + "target_machine_pool";
+
+    // Compile everything with a fresh TargetMachine each time.
+    std::vector<std::string> reference;
+    setenv("HL_TARGET_MACHINE_POOL", "0", 1);
+    for (const Target &t : supported) {
+        for (int p = 0; p < num_pipelines; p++) {
+            reference.push_back(compile(p, t, prefix + "_reference.o"));
+            if (reference.back().empty()) {
+                printf("Compiling pipeline %d for %s made an empty object\n",
+                       p, t.to_string().c_str());
+                return -1;
+            }
+        }
+    }
+    unsetenv("HL_TARGET_MACHINE_POOL");
+
+    // Now compile them all again from several threads, each going
+    // through them in a different order, so that threads share
+    // TargetMachines and a TargetMachine used for one pipeline is
+    // reused for another one, or for another target.
+    const int num_threads = 8;
+    const int num_jobs = (int)reference.size();
+    std::atomic<int> failures(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+        threads.emplace_back([&, i]{
+            std::string object = prefix + "_" + std::to_string(i) + ".o";
+            for (int j = 0; j < 2 * num_jobs; j++) {
+                int job = (i * 3 + j) % num_jobs;
+                const Target &t = supported[job / num_pipelines];
+                int p = job % num_pipelines;
+                if (compile(p, t, object) != reference[job]) {
+                    printf("Thread %d compiled a different object for pipeline %d on %s\n",
+                           i, p, t.to_string().c_str());
+                    failures++;
+                }
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    if (failures) {
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
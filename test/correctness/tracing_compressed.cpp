@@ -0,0 +1,118 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "test/common/halide_test_dirs.h"
+#include "util/HalideTraceUtils.cpp"
+
+using namespace Halide;
+
+// Check that the compressed trace format decodes back into the events
+// that were traced.
+
+namespace {
+
+struct Event {
+    std::string func;
+    int event, value_index, dimensions;
+    halide_type_t type;
+    // Empty if the event had none, in which case the runtime writes
+    // whatever was in its buffer.
+    std::vector<int> coords;
+    std::vector<uint8_t> value;
+};
+
+std::vector<Event> expected;
+
+int record_trace(void *user_context, const halide_trace_event_t *e) {
+    static int id = 0;
+    Event ev;
+    ev.func = e->func;
+    ev.event = e->event;
+    ev.value_index = e->value_index;
+    ev.dimensions = e->dimensions;
+    ev.type = e->type;
+    if (e->coordinates) {
+        ev.coords.assign(e->coordinates, e->coordinates + e->dimensions);
+    }
+    if (e->value) {
+        const uint8_t *v = (const uint8_t *)e->value;
+        ev.value.assign(v, v + e->type.lanes * e->type.bytes());
+    }
+    expected.push_back(ev);
+    return ++id;
+}
+
+Func make_pipeline() {
+    Func f("f"), g("g"), h("h");
+    Var x("x"), y("y");
+    f(x, y) = cast<uint8_t>(x * 3 + y);
+    g(x, y) = cast<float>(f(x, y)) * 0.5f + f(x + 1, y);
+    h(x, y) = Tuple(g(x, y) - g(x, y + 1), cast<int16_t>(x - y));
+    f.compute_root().trace_stores().trace_loads().trace_realizations();
+    g.compute_root().vectorize(x, 4).trace_stores().trace_loads();
+    h.trace_stores();
+    return h;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::string trace_file = Internal::get_test_tmp_dir() + "tracing_compressed.bin";
+    Internal::ensure_no_file_exists(trace_file);
+    // The runtime reads these the first time anything is traced.
+    setenv("HL_TRACE_FILE", trace_file.c_str(), 1);
+    setenv("HL_TRACE_FORMAT", "compressed", 1);
+
+    // Record what the pipeline traces...
+    Func recorded = make_pipeline();
+    recorded.set_custom_trace(record_trace);
+    recorded.realize(37, 19);
+
+    // ...then trace the same pipeline to the file.
+    Func traced = make_pipeline();
+    traced.realize(37, 19);
+
+    FILE *file = fopen(trace_file.c_str(), "rb");
+    if (!file) {
+        printf("Could not open %s\n", trace_file.c_str());
+        return -1;
+    }
+
+    Internal::TraceReader reader(file);
+    Internal::Packet p;
+    size_t count = 0;
+    while (reader.read(&p)) {
+        if (count >= expected.size()) {
+            printf("More packets in the trace than were traced\n");
+            return -1;
+        }
+        const Event &e = expected[count];
+        if (e.func != p.func() ||
+            e.event != p.event ||
+            e.value_index != p.value_index ||
+            e.dimensions != p.dimensions ||
+            e.type != p.type ||
+            (!e.coords.empty() &&
+             memcmp(e.coords.data(), p.coordinates(), e.coords.size() * sizeof(int))) ||
+            (!e.value.empty() &&
+             memcmp(e.value.data(), p.value(), e.value.size()))) {
+            printf("Packet %d for %s did not decode to what was traced\n",
+                   (int)count, e.func.c_str());
+            return -1;
+        }
+        count++;
+    }
+    fclose(file);
+
+    if (count != expected.size()) {
+        printf("Decoded %d packets, expected %d\n", (int)count, (int)expected.size());
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
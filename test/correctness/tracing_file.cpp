@@ -0,0 +1,94 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+// Check that packets traced to a file by many threads come out in the
+// order the events happened, even though the threads write them into
+// separate buffers.
+
+int main(int argc, char **argv) {
+    std::string trace_file = Internal::get_test_tmp_dir() + "tracing_file.bin";
+    Internal::ensure_no_file_exists(trace_file);
+    // The runtime reads this the first time anything is traced.
+    setenv("HL_TRACE_FILE", trace_file.c_str(), 1);
+    unsetenv("HL_TRACE_FORMAT");
+
+    const int size = 256;
+    Func f("f"), g("g");
+    Var x, y;
+    f(x, y) = x + y * size;
+    g(x, y) = f(x, y) + f(size - 1 - x, y);
+    f.compute_root().parallel(y);
+    g.parallel(y);
+    f.trace_stores();
+    g.trace_stores();
+    Buffer<int> out = g.realize(size, size);
+
+    FILE *file = fopen(trace_file.c_str(), "rb");
+    if (!file) {
+        printf("Could not open %s\n", trace_file.c_str());
+        return -1;
+    }
+    std::vector<uint8_t> data;
+    uint8_t block[4096];
+    size_t read;
+    while ((read = fread(block, 1, sizeof(block), file)) > 0) {
+        data.insert(data.end(), block, block + read);
+    }
+    fclose(file);
+
+    int f_stores = 0, g_stores = 0;
+    std::vector<int> events;
+    for (size_t pos = 0; pos < data.size();) {
+        const halide_trace_packet_t *p = (const halide_trace_packet_t *)(&data[pos]);
+        if (p->size < sizeof(halide_trace_packet_t) || pos + p->size > data.size()) {
+            printf("Malformed packet at offset %d\n", (int)pos);
+            return -1;
+        }
+        events.push_back(p->event);
+        if (p->event == halide_trace_store) {
+            const int *coords = p->coordinates();
+            int value = *(const int *)p->value();
+            if (strcmp(p->func(), "f") == 0) {
+                if (g_stores) {
+                    printf("Store to f traced after a store to g\n");
+                    return -1;
+                }
+                if (value != coords[0] + coords[1] * size) {
+                    printf("Bad value for f(%d, %d): %d\n", coords[0], coords[1], value);
+                    return -1;
+                }
+                f_stores++;
+            } else if (strcmp(p->func(), "g") == 0) {
+                if (value != out(coords[0], coords[1])) {
+                    printf("Bad value for g(%d, %d): %d\n", coords[0], coords[1], value);
+                    return -1;
+                }
+                g_stores++;
+            }
+        }
+        pos += p->size;
+    }
+
+    if (events.empty() ||
+        events.front() != halide_trace_begin_pipeline ||
+        events.back() != halide_trace_end_pipeline) {
+        printf("Trace does not start and end with the pipeline\n");
+        return -1;
+    }
+
+    if (f_stores != size * size || g_stores != size * size) {
+        printf("Expected %d stores to each of f and g, got %d and %d\n",
+               size * size, f_stores, g_stores);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <stdio.h>
+#include "Halide.h"
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    const int N = 1024;
+
+    Buffer<uint8_t> a(N);
+    Buffer<int8_t> b(N);
+    Buffer<int16_t> im(N, 64);
+    a.for_each_value([](uint8_t &v) { v = (uint8_t)rand(); });
+    b.for_each_value([](int8_t &v) { v = (int8_t)rand(); });
+    im.for_each_value([](int16_t &v) { v = (int16_t)rand(); });
+
+    // A dot product of bytes, vectorized across the reduction
+    // domain. On x86 this becomes pmaddwd (or vpdpbusd on AVX512-VNNI),
+    // and udot or sdot on ARM with the dot product extension.
+    {
+        RDom r(0, N);
+        Func dot;
+        dot() = 0;
+        dot() += cast<int>(a(r)) * cast<int>(b(r));
+
+        dot.update().atomic().vectorize(r, 16);
+
+        int correct = 0;
+        for (int i = 0; i < N; i++) {
+            correct += (int)a(i) * (int)b(i);
+        }
+
+        Buffer<int> result = dot.realize();
+        if (result() != correct) {
+            printf("dot() = %d instead of %d\n", result(), correct);
+            return -1;
+        }
+    }
+
+    // The same dot product without atomic(). Every lane updates the
+    // same location, so vectorizing across the reduction domain is safe.
+    {
+        RDom r(0, N);
+        Func dot;
+        dot() = 0;
+        dot() += cast<int>(a(r)) * cast<int>(b(r));
+
+        dot.update().vectorize(r, 16);
+
+        int correct = 0;
+        for (int i = 0; i < N; i++) {
+            correct += (int)a(i) * (int)b(i);
+        }
+
+        Buffer<int> result = dot.realize();
+        if (result() != correct) {
+            printf("non-atomic dot() = %d instead of %d\n", result(), correct);
+            return -1;
+        }
+    }
+
+    // An update that isn't a reduction the lanes can be combined
+    // with. Each lane must see what the lane before it stored.
+    {
+        RDom r(0, N);
+        Func f;
+        f() = 0;
+        f() = f() * 3 + cast<int>(a(r));
+
+        f.update().vectorize(r, 8);
+
+        int correct = 0;
+        for (int i = 0; i < N; i++) {
+            correct = correct * 3 + (int)a(i);
+        }
+
+        Buffer<int> result = f.realize();
+        if (result() != correct) {
+            printf("f() = %d instead of %d\n", result(), correct);
+            return -1;
+        }
+    }
+
+    // A Tuple update. Each value is computed into a let before
+    // either is stored, and the second one reads the old value of
+    // the first.
+    {
+        RDom r(0, N);
+        Func f;
+        f() = {0, 0};
+        f() = {f()[0] + cast<int>(a(r)), f()[1] + f()[0] * cast<int>(b(r))};
+
+        f.update().vectorize(r, 8);
+
+        int correct0 = 0, correct1 = 0;
+        for (int i = 0; i < N; i++) {
+            int old0 = correct0;
+            correct0 = old0 + (int)a(i);
+            correct1 = correct1 + old0 * (int)b(i);
+        }
+
+        Realization result = f.realize();
+        Buffer<int> result0 = result[0], result1 = result[1];
+        if (result0() != correct0 || result1() != correct1) {
+            printf("f() = {%d, %d} instead of {%d, %d}\n",
+                   result0(), result1(), correct0, correct1);
+            return -1;
+        }
+    }
+
+    // The max of each row, vectorized across the row and parallel
+    // across rows.
+    {
+        Var y;
+        RDom r(0, N);
+        Func row_max;
+        row_max(y) = cast<int16_t>(-32768);
+        row_max(y) = max(row_max(y), im(r, y));
+
+        row_max.update().atomic().vectorize(r, 8).parallel(y);
+
+        Buffer<int16_t> result = row_max.realize(im.height());
+        for (int j = 0; j < im.height(); j++) {
+            int16_t correct = -32768;
+            for (int i = 0; i < N; i++) {
+                correct = std::max(correct, im(i, j));
+            }
+            if (result(j) != correct) {
+                printf("row_max(%d) = %d instead of %d\n", j, result(j), correct);
+                return -1;
+            }
+        }
+    }
+
+    // A float sum with a vector width that isn't a power of two.
+    {
+        RDom r(0, 960);
+        Func sum;
+        sum() = 0.0f;
+        sum() += cast<float>(a(r));
+
+        sum.update().atomic().vectorize(r, 12);
+
+        // The inputs are small integers, so the sum is exact in any
+        // order.
+        float correct = 0.0f;
+        for (int i = 0; i < 960; i++) {
+            correct += a(i);
+        }
+
+        Buffer<float> result = sum.realize();
+        if (result() != correct) {
+            printf("sum() = %f instead of %f\n", result(), correct);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,25 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Func f, g;
+    Var x, y, bx, by, tx, ty;
+    f(x, y) = x + y;
+    g(x, y) = f(x, y - 1) + f(x, y + 1);
+
+    g.gpu_tile(x, y, bx, by, tx, ty, 8, 8);
+
+    // This schedule should be forbidden, because the producer would
+    // have to be forked from inside a GPU kernel.
+    f.store_root().compute_at(g, bx).async();
+
+    Target t = get_host_target().with_feature(Target::CUDA);
+    g.compile_to_module(g.infer_arguments(), "async_gpu_loop", t);
+
+    // We shouldn't reach here, because there should have been a compile error.
+    printf("There should have been an error\n");
+
+    return 0;
+}
@@ -0,0 +1,24 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Func f("f"), g("g");
+    Var x("x"), y("y"), xo("xo"), xi("xi");
+
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) + f(x + 1, y);
+
+    g.split(x, xo, xi, 8);
+
+    // f has a constant size, but it is accessed at indices that vary
+    // within the loop over x, so it can't live in registers. It would
+    // have to be unrolled or vectorized.
+    f.compute_at(g, xo).store_in(MemoryType::Register);
+
+    g.realize(64, 64);
+
+    printf("There should have been an error\n");
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "allocator_pool.h"
+
+using namespace Halide::Runtime;
+
+const int W = 1000;
+
+int run(int offset) {
+    Buffer<int> out(W);
+    int ret = allocator_pool(offset, out);
+    if (ret) {
+        printf("Non zero exit code: %d\n", ret);
+        return -1;
+    }
+    for (int x = 0; x < W; x++) {
+        int correct = (x + offset) * 3;
+        if (out(x) != correct) {
+            printf("With offset %d, out(%d) = %d instead of %d\n",
+                   offset, x, out(x), correct);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    // The limit must be parsed as a 64-bit value. This has to happen
+    // before anything else touches the allocator.
+    char pool_size[] = "HL_ALLOCATOR_POOL_SIZE=3000000000";
+    putenv(pool_size);
+    int64_t old_size = halide_set_allocator_pool_size(1 << 24);
+    if (old_size != 3000000000LL) {
+        printf("HL_ALLOCATOR_POOL_SIZE was read as %lld\n", (long long)old_size);
+        return -1;
+    }
+
+    // A freed block should be handed back out by the next allocation
+    // of the same size class.
+    void *a = halide_malloc(NULL, 4000);
+    halide_free(NULL, a);
+    void *b = halide_malloc(NULL, 3900);
+    if (a != b) {
+        printf("Freed block was not reused\n");
+        return -1;
+    }
+    halide_free(NULL, b);
+
+    for (int i = 0; i < 100; i++) {
+        if (run(i % 10)) return -1;
+    }
+
+    // Turn the pool off before the cache frees its entries, as
+    // happens when the pool's destructor runs before the cache's at
+    // exit. The entries must go back to the system, and both must
+    // keep working afterwards.
+    halide_set_allocator_pool_size(0);
+    halide_memoization_cache_cleanup();
+    for (int i = 0; i < 10; i++) {
+        if (run(i)) return -1;
+    }
+
+    halide_set_allocator_pool_size(1 << 24);
+    for (int i = 0; i < 10; i++) {
+        if (run(i)) return -1;
+    }
+    halide_memoization_cache_cleanup();
+    halide_allocator_pool_trim();
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,27 @@
+#include "Halide.h"
+
+namespace {
+
+class AllocatorPool : public Halide::Generator<AllocatorPool> {
+public:
+    Input<int> offset{"offset"};
+    Output<Buffer<int>> output{"output", 1};
+
+    void generate() {
+        // A heap-allocated intermediate, and a memoized one whose
+        // storage is owned by the cache.
+        Var x;
+        Func f("f"), g("g");
+
+        f(x) = x + offset;
+        g(x) = f(x) * 2;
+        output(x) = f(x) + g(x);
+
+        f.compute_root();
+        g.compute_root().memoize();
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(AllocatorPool, allocator_pool)
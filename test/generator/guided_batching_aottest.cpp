@@ -0,0 +1,54 @@
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+
+#include <atomic>
+#include <stdio.h>
+
+#include "guided_batching.h"
+
+using namespace Halide::Runtime;
+
+const int max_extent = 1001;
+
+std::atomic<int> runs[max_extent];
+
+extern "C" int guided_batching_task(int x) {
+    runs[x]++;
+    return x * 3;
+}
+
+int main(int argc, char **argv) {
+    // Workers on the shared queue claim runs of tasks whose size
+    // depends on the work remaining and the number of threads. Check
+    // that the runs neither overlap nor leave gaps when the extent
+    // doesn't divide evenly.
+    halide_set_thread_pool_scheduler(halide_thread_pool_scheduler_shared_queue);
+
+    const int extents[] = {1, 2, 3, 5, 7, 13, 31, 97, 255, 1001};
+    for (int threads = 1; threads <= 5; threads++) {
+        halide_set_num_threads(threads);
+        for (int extent : extents) {
+            for (int i = 0; i < extent; i++) {
+                runs[i] = 0;
+            }
+
+            Buffer<int> out(extent);
+            int ret = guided_batching(out);
+            if (ret) {
+                printf("Non zero exit code: %d\n", ret);
+                return -1;
+            }
+
+            for (int i = 0; i < extent; i++) {
+                if (runs[i] != 1 || out(i) != i * 3) {
+                    printf("With %d threads and extent %d, task %d ran %d times and produced %d\n",
+                           threads, extent, i, (int)runs[i], out(i));
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
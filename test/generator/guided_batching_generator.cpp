@@ -0,0 +1,23 @@
+#include "Halide.h"
+
+namespace {
+
+HalideExtern_1(int, guided_batching_task, int);
+
+class GuidedBatching : public Halide::Generator<GuidedBatching> {
+public:
+    Output<Buffer<int>> output{"output", 1};
+
+    void generate() {
+        // A parallel loop with one task per element, with a task that
+        // records every time it runs.
+        Var x;
+
+        output(x) = guided_batching_task(x);
+        output.parallel(x);
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(GuidedBatching, guided_batching)
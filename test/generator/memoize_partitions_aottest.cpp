@@ -0,0 +1,112 @@
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "memoize_partitions.h"
+
+using namespace Halide::Runtime;
+
+const int W = 256;
+const int kEntryBytes = W * sizeof(int);
+const int kPartitionEntries = 4;
+const int kOffsets = 32;
+
+int run(int offset) {
+    Buffer<int> out(W);
+    int ret = memoize_partitions(offset, out);
+    if (ret) {
+        printf("Non zero exit code: %d\n", ret);
+        return -1;
+    }
+    for (int x = 0; x < W; x++) {
+        int correct = (x + offset) + x * offset;
+        if (out(x) != correct) {
+            printf("With offset %d, out(%d) = %d instead of %d\n",
+                   offset, x, out(x), correct);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int get_stats(int index, halide_memoization_cache_stats_t *stats) {
+    if (halide_memoization_cache_get_stats(index, stats)) {
+        printf("No cache partition with index %d\n", index);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    // Give big a partition with room for a few entries, and leave
+    // small in the default partition, which has room for all of them.
+    halide_memoization_cache_set_size(1 << 20);
+    if (halide_memoization_cache_set_partition_size("big", kPartitionEntries * kEntryBytes)) {
+        printf("Could not create partition\n");
+        return -1;
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        halide_memoization_cache_reset_stats();
+
+        for (int offset = 0; offset < kOffsets; offset++) {
+            if (run(offset)) return -1;
+        }
+
+        halide_memoization_cache_stats_t default_stats, big_stats;
+        if (get_stats(0, &default_stats) || get_stats(1, &big_stats)) {
+            return -1;
+        }
+
+        if (big_stats.partition == NULL || strcmp(big_stats.partition, "big") != 0) {
+            printf("Partition 1 is not big\n");
+            return -1;
+        }
+
+        // The partition must have evicted down to its own budget...
+        if (big_stats.bytes_resident > (uint64_t)(kPartitionEntries * kEntryBytes) ||
+            big_stats.misses != kOffsets ||
+            big_stats.evictions != kOffsets - big_stats.bytes_resident / kEntryBytes) {
+            printf("Pass %d: partition big has %llu bytes resident after %llu misses and %llu evictions\n",
+                   pass,
+                   (unsigned long long)big_stats.bytes_resident,
+                   (unsigned long long)big_stats.misses,
+                   (unsigned long long)big_stats.evictions);
+            return -1;
+        }
+
+        // ...without touching the default partition.
+        if (default_stats.bytes_resident != (uint64_t)(kOffsets * kEntryBytes) ||
+            default_stats.misses != kOffsets ||
+            default_stats.evictions != 0) {
+            printf("Pass %d: default partition has %llu bytes resident after %llu misses and %llu evictions\n",
+                   pass,
+                   (unsigned long long)default_stats.bytes_resident,
+                   (unsigned long long)default_stats.misses,
+                   (unsigned long long)default_stats.evictions);
+            return -1;
+        }
+
+        // Everything in the default partition is still cached.
+        for (int offset = 0; offset < kOffsets; offset++) {
+            if (run(offset)) return -1;
+        }
+        if (get_stats(0, &default_stats)) {
+            return -1;
+        }
+        if (default_stats.hits != kOffsets) {
+            printf("Pass %d: default partition hit %llu times instead of %d\n",
+                   pass, (unsigned long long)default_stats.hits, kOffsets);
+            return -1;
+        }
+
+        // Empty the cache. The partition and its budget survive, so
+        // the second pass should behave the same way.
+        halide_memoization_cache_cleanup();
+    }
+
+    printf("Success!\n");
+    return 0;
+}
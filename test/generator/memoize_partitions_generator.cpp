@@ -0,0 +1,27 @@
+#include "Halide.h"
+
+namespace {
+
+class MemoizePartitions : public Halide::Generator<MemoizePartitions> {
+public:
+    Input<int> offset{"offset"};
+    Output<Buffer<int>> output{"output", 1};
+
+    void generate() {
+        // Two memoized Funcs, so that one can be given a partition of
+        // its own and the other left in the default partition.
+        Var x;
+        Func big("big"), small("small");
+
+        big(x) = x + offset;
+        small(x) = x * offset;
+        output(x) = big(x) + small(x);
+
+        big.compute_root().memoize();
+        small.compute_root().memoize();
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(MemoizePartitions, memoize_partitions)
@@ -0,0 +1,118 @@
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+
+#include <stdio.h>
+
+#include "memoize_stats.h"
+
+using namespace Halide::Runtime;
+
+const int W = 256;
+const int kEntryBytes = W * sizeof(int);
+
+int calls = 0;
+
+extern "C" int memoize_stats_count(int x) {
+    calls++;
+    return x;
+}
+
+int lookups = 0;
+
+int run(int offset) {
+    Buffer<int> out(W);
+    lookups++;
+    int ret = memoize_stats(offset, out);
+    if (ret) {
+        printf("Non zero exit code: %d\n", ret);
+        return -1;
+    }
+    for (int x = 0; x < W; x++) {
+        int correct = (x + offset) * 2;
+        if (out(x) != correct) {
+            printf("With offset %d, out(%d) = %d instead of %d\n",
+                   offset, x, out(x), correct);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void reset(int policy, int64_t size) {
+    halide_memoization_cache_cleanup();
+    halide_memoization_cache_set_eviction_policy(policy);
+    halide_memoization_cache_set_size(size);
+    halide_memoization_cache_reset_stats();
+    calls = 0;
+    lookups = 0;
+}
+
+// Check the counts that hold under every policy: every lookup is a hit
+// or a miss, every miss is computed once, and every computed result is
+// either stored or rejected. Everything stored is resident or evicted.
+int check_consistent(const char *name, halide_memoization_cache_stats_t *stats) {
+    if (halide_memoization_cache_get_stats(0, stats)) {
+        printf("No default cache partition\n");
+        return -1;
+    }
+    printf("%s: %llu hits, %llu misses, %llu stores, %llu rejections, %llu evictions, %llu bytes resident\n",
+           name,
+           (unsigned long long)stats->hits,
+           (unsigned long long)stats->misses,
+           (unsigned long long)stats->stores,
+           (unsigned long long)stats->rejections,
+           (unsigned long long)stats->evictions,
+           (unsigned long long)stats->bytes_resident);
+    if (stats->hits + stats->misses != (uint64_t)lookups ||
+        stats->misses * W != (uint64_t)calls ||
+        stats->stores + stats->rejections != stats->misses ||
+        stats->stores - stats->evictions != stats->bytes_resident / kEntryBytes ||
+        stats->bytes_resident > (uint64_t)stats->max_size) {
+        printf("%s: inconsistent statistics after %d lookups and %d calls\n",
+               name, lookups, calls);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    halide_memoization_cache_stats_t stats;
+
+    // Everything fits. The second sweep should hit every time.
+    reset(halide_memoization_cache_evict_lru, 1 << 20);
+    for (int pass = 0; pass < 2; pass++) {
+        for (int offset = 0; offset < 10; offset++) {
+            if (run(offset)) return -1;
+        }
+    }
+    if (check_consistent("lru, large", &stats)) return -1;
+    if (stats.hits != 10 || stats.misses != 10 || stats.stores != 10 ||
+        stats.evictions != 0 || stats.rejections != 0) {
+        printf("Expected 10 hits, 10 misses and 10 stores\n");
+        return -1;
+    }
+
+    // Room for four entries, with every policy.
+    for (int policy : {halide_memoization_cache_evict_lru,
+                       halide_memoization_cache_evict_greedy_dual_size,
+                       halide_memoization_cache_evict_tinylfu}) {
+        reset(policy, 4 * kEntryBytes);
+        // A few keys used over and over, mixed with one-off keys.
+        for (int i = 0; i < 64; i++) {
+            if (run(i % 3) || run(100 + i)) return -1;
+        }
+        const char *names[] = {"lru", "greedy dual size", "tinylfu"};
+        if (check_consistent(names[policy], &stats)) return -1;
+        if (stats.evictions == 0 && stats.rejections == 0) {
+            printf("%s: expected evictions or rejections with a full cache\n", names[policy]);
+            return -1;
+        }
+        if (policy != halide_memoization_cache_evict_tinylfu && stats.rejections != 0) {
+            printf("%s: only tinylfu should reject\n", names[policy]);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,27 @@
+#include "Halide.h"
+
+namespace {
+
+HalideExtern_1(int, memoize_stats_count, int);
+
+class MemoizeStats : public Halide::Generator<MemoizeStats> {
+public:
+    Input<int> offset{"offset"};
+    Output<Buffer<int>> output{"output", 1};
+
+    void generate() {
+        // A memoized Func with a task that records every time it is
+        // actually computed.
+        Var x;
+        Func f("f");
+
+        f(x) = memoize_stats_count(x) + offset;
+        output(x) = f(x) * 2;
+
+        f.compute_root().memoize();
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(MemoizeStats, memoize_stats)
@@ -0,0 +1,105 @@
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#include "profiler_timeline.h"
+
+using namespace Halide::Runtime;
+
+const int W = 16;
+const int sleep_ms = 50;
+
+// The extern stage of the pipeline. Runs the pipeline again, one
+// level deeper, then takes a while.
+extern "C" int profiler_timeline_nested(int depth, halide_buffer_t *out) {
+    if (out->is_bounds_query()) {
+        return 0;
+    }
+    if (depth > 0) {
+        Buffer<int> inner(W);
+        int ret = profiler_timeline(depth - 1, inner);
+        if (ret) {
+            return ret;
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms));
+    Buffer<int>(*out).fill(depth);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    // Timeline spans are only recorded if this is set when the first
+    // pipeline starts.
+    const char *filename = "profiler_timeline.json";
+    setenv("HL_PROFILER_TIMELINE", filename, 1);
+
+    const int depth = 2;
+    Buffer<int> out(W);
+    auto start = std::chrono::steady_clock::now();
+    int ret = profiler_timeline(depth, out);
+    auto end = std::chrono::steady_clock::now();
+    if (ret) {
+        printf("Non zero exit code: %d\n", ret);
+        return -1;
+    }
+    for (int x = 0; x < W; x++) {
+        if (out(x) != depth + 1) {
+            printf("out(%d) = %d instead of %d\n", x, out(x), depth + 1);
+            return -1;
+        }
+    }
+    long long outer_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+    if (halide_profiler_report_timeline(nullptr, filename)) {
+        printf("Failed to write the timeline\n");
+        return -1;
+    }
+
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        printf("Could not open %s\n", filename);
+        return -1;
+    }
+    // The nested runs overlap the outer one, which must still get a
+    // span of its own covering all of it.
+    int runs = 0;
+    long long longest_us = 0;
+    char line[4096];
+    while (fgets(line, sizeof(line), f)) {
+        if (!strstr(line, "\"ph\": \"X\"") || !strstr(line, "\"tid\": 0,")) {
+            continue;
+        }
+        const char *dur = strstr(line, "\"dur\": ");
+        if (!dur) {
+            printf("Pipeline run without a duration: %s", line);
+            return -1;
+        }
+        long long us = atoll(dur + strlen("\"dur\": "));
+        if (us > longest_us) {
+            longest_us = us;
+        }
+        runs++;
+    }
+    fclose(f);
+
+    if (runs == 0) {
+        printf("No pipeline runs in the timeline\n");
+        return -1;
+    }
+    // Allow for the time spent outside the profiled region.
+    if (longest_us < outer_us - 1000 * sleep_ms / 2) {
+        printf("The longest pipeline run in the timeline took %lld us, "
+               "but the outermost run took %lld us\n",
+               longest_us, outer_us);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
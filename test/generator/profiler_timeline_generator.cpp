@@ -0,0 +1,23 @@
+#include "Halide.h"
+
+namespace {
+
+class ProfilerTimeline : public Halide::Generator<ProfilerTimeline> {
+public:
+    Input<int> depth{"depth"};
+    Output<Buffer<int>> output{"output", 1};
+
+    void generate() {
+        // The extern stage runs this pipeline again with one less
+        // depth, so runs of it nest.
+        Var x;
+        Func nested("nested");
+        nested.define_extern("profiler_timeline_nested", {depth}, Int(32), 1);
+        output(x) = nested(x) + 1;
+        nested.compute_root();
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(ProfilerTimeline, profiler_timeline)
@@ -0,0 +1,74 @@
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+
+#include <stdio.h>
+#include <thread>
+
+#include "thread_pool_spin.h"
+
+using namespace Halide::Runtime;
+
+const int W = 16;
+
+extern "C" int thread_pool_spin_task(int x) {
+    return x * 2;
+}
+
+int main(int argc, char **argv) {
+    Buffer<int> out(W);
+
+    for (int spin_count : {0, 1000000}) {
+        halide_set_num_threads(4);
+        halide_set_thread_pool_spin_count(spin_count);
+        halide_thread_pool_reset_stats();
+
+        // Back-to-back parallel loops. With spinning enabled, idle
+        // workers should pick up the next loop before going to sleep.
+        for (int i = 0; i < 1000; i++) {
+            out.fill(0);
+            int ret = thread_pool_spin(out);
+            if (ret) {
+                printf("Non zero exit code: %d\n", ret);
+                return -1;
+            }
+            for (int x = 0; x < W; x++) {
+                if (out(x) != x * 2) {
+                    printf("With spin count %d, out(%d) = %d instead of %d\n",
+                           spin_count, x, out(x), x * 2);
+                    return -1;
+                }
+            }
+        }
+
+        halide_thread_pool_stats_t stats;
+        halide_thread_pool_get_stats(&stats);
+        printf("Spin count %d: %llu spins, %llu found work, %llu sleeps\n",
+               spin_count,
+               (unsigned long long)stats.spins,
+               (unsigned long long)stats.spins_found_work,
+               (unsigned long long)stats.sleeps);
+
+        if (spin_count == 0 && stats.spins != 0) {
+            printf("Workers spun with spinning disabled\n");
+            return -1;
+        }
+        if (spin_count > 0 && stats.spins == 0) {
+            printf("Workers never spun with spinning enabled\n");
+            return -1;
+        }
+        // A spinning worker can only see the next loop arrive if it
+        // isn't competing with the main thread for a single core.
+        if (spin_count > 0 && std::thread::hardware_concurrency() > 1 &&
+            stats.spins_found_work == 0) {
+            printf("Spinning workers never found work\n");
+            return -1;
+        }
+    }
+
+    // Disable spinning again so that the idle workers don't burn CPU
+    // while the process exits.
+    halide_set_thread_pool_spin_count(0);
+
+    printf("Success!\n");
+    return 0;
+}
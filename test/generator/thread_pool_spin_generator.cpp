@@ -0,0 +1,24 @@
+#include "Halide.h"
+
+namespace {
+
+HalideExtern_1(int, thread_pool_spin_task, int);
+
+class ThreadPoolSpin : public Halide::Generator<ThreadPoolSpin> {
+public:
+    Output<Buffer<int>> output{"output", 1};
+
+    void generate() {
+        // A short parallel loop, so that the workers go idle almost
+        // immediately and spend most of their time waiting for the
+        // next one.
+        Var x;
+
+        output(x) = thread_pool_spin_task(x);
+        output.parallel(x);
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(ThreadPoolSpin, thread_pool_spin)
@@ -31,6 +31,18 @@ int main(int argc, char **argv) {
     Buffer<float> out(64, 64);
 
     for (int i = 0; i < 1000; i++) {
+        // Alternate between the two thread pool schedulers too, so
+        // that we hunt for deadlocks in both and in the hand-off
+        // between them.
+        halide_set_thread_pool_scheduler((i & 1) ?
+                                         halide_thread_pool_scheduler_work_stealing :
+                                         halide_thread_pool_scheduler_shared_queue);
+        // Workers re-pin themselves when NUMA placement is toggled,
+        // so toggle it occasionally. (It returns -1 on hosts where
+        // it's unsupported, which is fine.)
+        if (i % 100 == 0) {
+            halide_set_numa_placement((i / 100) & 1);
+        }
         // The number of threads will oscilate randomly, but the range
         // will slowly ramp up and back down so you can watch it
         // working in a process monitor.
@@ -0,0 +1,62 @@
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+
+#include <atomic>
+#include <stdio.h>
+
+#include "work_stealing.h"
+
+using namespace Halide::Runtime;
+
+const int W = 67, H = 53;
+
+std::atomic<int> runs[H][W];
+int grow_to = 0;
+
+extern "C" int work_stealing_task(int x, int y) {
+    // Grow the thread pool partway through the outer loop, so that
+    // the new workers join jobs that were split amongst fewer
+    // deques than there are now threads.
+    if (x == 0 && y == H / 2 && grow_to) {
+        halide_set_num_threads(grow_to);
+    }
+    runs[y][x]++;
+    return x + y * W;
+}
+
+int main(int argc, char **argv) {
+    halide_set_thread_pool_scheduler(halide_thread_pool_scheduler_work_stealing);
+
+    Buffer<int> out(W, H);
+
+    for (int threads = 1; threads <= 8; threads++) {
+        for (int grow = 0; grow < 2; grow++) {
+            halide_set_num_threads(threads);
+            grow_to = grow ? threads * 2 : 0;
+            for (int y = 0; y < H; y++) {
+                for (int x = 0; x < W; x++) {
+                    runs[y][x] = 0;
+                }
+            }
+
+            int ret = work_stealing(out);
+            if (ret) {
+                printf("Non zero exit code: %d\n", ret);
+                return -1;
+            }
+
+            for (int y = 0; y < H; y++) {
+                for (int x = 0; x < W; x++) {
+                    if (runs[y][x] != 1 || out(x, y) != x + y * W) {
+                        printf("With %d threads, task (%d, %d) ran %d times and produced %d\n",
+                               threads, x, y, (int)runs[y][x], out(x, y));
+                        return -1;
+                    }
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
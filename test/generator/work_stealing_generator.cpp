@@ -0,0 +1,23 @@
+#include "Halide.h"
+
+namespace {
+
+HalideExtern_2(int, work_stealing_task, int, int);
+
+class WorkStealing : public Halide::Generator<WorkStealing> {
+public:
+    Output<Buffer<int>> output{"output", 2};
+
+    void generate() {
+        // Nested parallel loops, with a task that records every time
+        // it runs.
+        Var x, y, xo, xi;
+
+        output(x, y) = work_stealing_task(x, y);
+        output.split(x, xo, xi, 2).parallel(y).parallel(xo);
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(WorkStealing, work_stealing)
@@ -4,18 +4,211 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <string>
+#include <vector>
+
 namespace Halide {
 namespace Internal {
 
-bool Packet::read_from_stdin() {
-    return read_from_filedesc(stdin);
+// Decodes the compressed blocks written by the runtime when
+// HL_TRACE_FORMAT=compressed. See src/runtime/tracing.cpp for the
+// format.
+class TraceBlockDecoder {
+    static const int max_names = 256;
+
+    struct FuncState {
+        std::string name;
+        int32_t parent_id;
+        std::vector<int32_t> coords;
+    };
+
+    std::vector<uint8_t> compressed, encoded;
+    std::vector<FuncState> funcs;
+    size_t cursor = 0;
+    uint32_t packets_left = 0;
+    int32_t last_id = 0;
+
+    [[noreturn]] static void corrupt() {
+        fprintf(stderr, "Corrupt compressed block in trace stream\n");
+        abort();
+    }
+
+    uint8_t next_byte() {
+        if (cursor >= encoded.size()) corrupt();
+        return encoded[cursor++];
+    }
+
+    uint32_t next_varint() {
+        uint32_t result = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            uint8_t b = next_byte();
+            result |= (uint32_t)(b & 0x7f) << shift;
+            if (!(b & 0x80)) return result;
+        }
+        corrupt();
+    }
+
+    int32_t next_signed() {
+        uint32_t x = next_varint();
+        return (int32_t)(x >> 1) ^ -(int32_t)(x & 1);
+    }
+
+    void decompress(uint32_t encoded_size) {
+        encoded.resize(encoded_size);
+        const uint8_t *src = compressed.data(), *end = src + compressed.size();
+        size_t out = 0;
+        auto length = [&](uint32_t len) {
+            if (len == 15) {
+                uint8_t b;
+                do {
+                    if (src >= end) corrupt();
+                    b = *src++;
+                    len += b;
+                } while (b == 255);
+            }
+            return len;
+        };
+        while (src < end) {
+            uint8_t token = *src++;
+            uint32_t literals = length(token >> 4);
+            if (literals > (size_t)(end - src) || out + literals > encoded_size) corrupt();
+            memcpy(&encoded[out], src, literals);
+            src += literals;
+            out += literals;
+            if (src == end) break;
+            if (end - src < 2) corrupt();
+            uint32_t offset = src[0] | (src[1] << 8);
+            src += 2;
+            uint32_t match_length = length(token & 15) + 4;
+            if (offset == 0 || offset > out || out + match_length > encoded_size) corrupt();
+            // Matches may overlap their own output.
+            for (uint32_t i = 0; i < match_length; i++, out++) {
+                encoded[out] = encoded[out - offset];
+            }
+        }
+        if (out != encoded_size) corrupt();
+    }
+
+public:
+    static const uint32_t block_magic = 0x5a544c48;
+
+    bool has_packets() const {
+        return packets_left > 0;
+    }
+
+    // Read the rest of a block whose magic number has already been
+    // consumed.
+    bool read_block(FILE *fdesc) {
+        uint32_t header[3];
+        if (!Packet::read(header, sizeof(header), fdesc)) return false;
+        compressed.resize(header[0]);
+        if (!Packet::read(compressed.data(), compressed.size(), fdesc)) return false;
+        decompress(header[1]);
+        packets_left = header[2];
+        cursor = 0;
+        last_id = 0;
+        funcs.clear();
+        return true;
+    }
+
+    // Reconstruct the next packet in the block, laid out as the
+    // runtime would have written it.
+    void next_packet(Packet *p) {
+        packets_left--;
+        p->id = last_id + next_signed();
+        last_id = p->id;
+
+        uint32_t f = next_varint();
+        FuncState fresh, *func;
+        if (f < funcs.size()) {
+            func = &funcs[f];
+        } else if (f == funcs.size()) {
+            uint32_t len = next_varint();
+            if (len > encoded.size() - cursor) corrupt();
+            fresh.name.assign((const char *)&encoded[cursor], len);
+            fresh.parent_id = 0;
+            cursor += len;
+            if (funcs.size() < max_names) {
+                funcs.push_back(fresh);
+                func = &funcs.back();
+            } else {
+                func = &fresh;
+            }
+        } else {
+            corrupt();
+        }
+
+        p->event = (halide_trace_event_code_t)next_byte();
+        p->type.code = (halide_type_code_t)next_byte();
+        p->type.bits = next_byte();
+        p->type.lanes = (uint16_t)next_varint();
+        p->parent_id = func->parent_id + next_signed();
+        func->parent_id = p->parent_id;
+        p->value_index = next_varint();
+        p->dimensions = next_varint();
+
+        uint32_t value_bytes = p->type.lanes * p->type.bytes();
+        size_t size = sizeof(halide_trace_packet_t) + p->dimensions * sizeof(int32_t) +
+            value_bytes + func->name.size() + 1;
+        p->size = (size + 3) & ~3;
+        if (p->size - sizeof(halide_trace_packet_t) > sizeof(p->payload)) {
+            fprintf(stderr, "Payload larger than %d bytes in trace stream (%d)\n",
+                    (int)sizeof(p->payload), (int)(p->size - sizeof(halide_trace_packet_t)));
+            abort();
+        }
+
+        bool delta = func->coords.size() == (size_t)p->dimensions;
+        if (!delta) func->coords.assign(p->dimensions, 0);
+        int *coords = p->coordinates();
+        for (int i = 0; i < p->dimensions; i++) {
+            coords[i] = func->coords[i] + next_signed();
+            func->coords[i] = coords[i];
+        }
+        if (value_bytes > encoded.size() - cursor) corrupt();
+        memcpy(p->value(), &encoded[cursor], value_bytes);
+        cursor += value_bytes;
+        memcpy(p->func(), func->name.c_str(), func->name.size() + 1);
+    }
+};
+
+TraceReader::TraceReader(FILE *fdesc) : fdesc(fdesc), decoder(new TraceBlockDecoder) {
 }
 
-bool Packet::read_from_filedesc(FILE *fdesc){
-    size_t header_size = sizeof(halide_trace_packet_t);
-    if (!Packet::read(this, header_size, fdesc)) {
-        return false;
+TraceReader::~TraceReader() {
+}
+
+bool TraceReader::read(Packet *p) {
+    while (!decoder->has_packets()) {
+        uint32_t magic;
+        if (!Packet::read(&magic, sizeof(magic), fdesc)) {
+            return false;
+        }
+        if (magic != TraceBlockDecoder::block_magic) {
+            // A raw packet. We've already read its size.
+            p->size = magic;
+            size_t header_size = sizeof(halide_trace_packet_t);
+            if (!Packet::read((uint8_t *)p + sizeof(magic), header_size - sizeof(magic), fdesc)) {
+                fprintf(stderr, "Unexpected EOF mid-packet\n");
+                return false;
+            }
+            return p->read_payload(fdesc);
+        }
+        if (!decoder->read_block(fdesc)) {
+            fprintf(stderr, "Unexpected EOF mid-block\n");
+            return false;
+        }
     }
+    decoder->next_packet(p);
+    return true;
+}
+
+bool TraceReader::rewind() {
+    decoder.reset(new TraceBlockDecoder);
+    return fseek(fdesc, 0, SEEK_SET) == 0;
+}
+
+bool Packet::read_payload(FILE *fdesc) {
+    size_t header_size = sizeof(halide_trace_packet_t);
     size_t payload_size = size - header_size;
     if (payload_size > sizeof(payload)) {
         fprintf(stderr, "Payload larger than %d bytes in trace stream (%d)\n", (int)sizeof(payload), (int)payload_size);
@@ -23,7 +216,7 @@ bool Packet::read_from_filedesc(FILE *fdesc){
         return false;
     }
     if (!Packet::read(payload, payload_size, fdesc)) {
-        fprintf(stderr, "Unexpected EOF mid-packet");
+        fprintf(stderr, "Unexpected EOF mid-packet\n");
         return false;
     }
     return true;
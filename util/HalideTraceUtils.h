@@ -4,6 +4,8 @@
 #include "HalideRuntime.h"
 #include <stdio.h>
 
+#include <memory>
+
 namespace Halide {
 namespace Internal {
 
@@ -77,15 +79,37 @@ struct Packet : public halide_trace_packet_t {
         return value_as<T>(type, (const halide_scalar_value_t *)val);
     }
 
-    // Grab a packet from stdin. Returns false when stdin closes.
-    bool read_from_stdin();
-
-    // Grab a packet from a particular fctl file descriptor. Returns false when end is reached.
-    bool read_from_filedesc(FILE *fdesc);
-
 private:
+    // Read the rest of a raw packet, given its header.
+    bool read_payload(FILE *fdesc);
+
     // Do a blocking read of some number of bytes from a unistd file descriptor.
-    bool read(void *d, size_t size, FILE *fdesc);
+    static bool read(void *d, size_t size, FILE *fdesc);
+
+    friend class TraceBlockDecoder;
+    friend class TraceReader;
+};
+
+class TraceBlockDecoder;
+
+// Reads packets from a trace stream. Reads both raw packets and the
+// compressed blocks written when HL_TRACE_FORMAT=compressed. A
+// compressed block holds many packets, so use one reader for the
+// whole stream.
+class TraceReader {
+    FILE *fdesc;
+    std::unique_ptr<TraceBlockDecoder> decoder;
+
+public:
+    explicit TraceReader(FILE *fdesc);
+    ~TraceReader();
+
+    // Grab the next packet. Returns false when the end is reached.
+    bool read(Packet *p);
+
+    // Seek back to the start of the stream and drop any partially
+    // read block.
+    bool rewind();
 };
 
 }
@@ -532,6 +532,7 @@ int run(int argc, char **argv) {
     map<uint32_t, PipelineInfo> pipeline_info;
 
     size_t end_counter = 0;
+    TraceReader reader(stdin);
     size_t packet_clock = 0;
     for (;;) {
         // Hold for some number of frames once the trace has finished.
@@ -601,7 +602,7 @@ int run(int argc, char **argv) {
 
         // Read a tracing packet
         Packet p;
-        if (!p.read_from_stdin()) {
+        if (!reader.read(&p)) {
             end_counter++;
             continue;
         }